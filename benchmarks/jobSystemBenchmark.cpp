@@ -0,0 +1,170 @@
+/*
+* MIT License
+*
+* Copyright(c) 2018 Jimmie Bergmann
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*/
+
+#include "flare/system/jobSystem.hpp"
+#include <iostream>
+#include <chrono>
+#include <vector>
+#include <cmath>
+#include <stdexcept>
+
+using Clock = std::chrono::high_resolution_clock;
+
+static double getMilliseconds(const Clock::time_point & start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static float heavyWork(const size_t index)
+{
+    float value = static_cast<float>(index);
+    for (size_t i = 0; i < 64; i++)
+    {
+        value = std::sqrt(value * value + 1.0f);
+    }
+    return value;
+}
+
+int main()
+{
+    const size_t elementCount = 1 << 20;
+    const size_t iterations = 10;
+    const size_t tinyJobCount = 1 << 16;
+    const size_t tinyJobBatchSize = 1024;
+
+    Flare::JobSystem jobSystem;
+    std::cout << "Workers: " << jobSystem.getWorkerCount() << std::endl;
+
+    std::vector<float> output(elementCount);
+
+    // Serial loop.
+    Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < iterations; i++)
+    {
+        for (size_t j = 0; j < elementCount; j++)
+        {
+            output[j] = heavyWork(j);
+        }
+    }
+    const double serialTime = getMilliseconds(start) / iterations;
+    std::cout << "Serial loop:       " << serialTime << " ms" << std::endl;
+
+    // Parallel for.
+    start = Clock::now();
+    for (size_t i = 0; i < iterations; i++)
+    {
+        jobSystem.parallelFor(0, elementCount, 0, [&output](const size_t begin, const size_t end)
+        {
+            for (size_t j = begin; j < end; j++)
+            {
+                output[j] = heavyWork(j);
+            }
+        });
+    }
+    const double parallelTime = getMilliseconds(start) / iterations;
+    std::cout << "Parallel for:      " << parallelTime << " ms (" << serialTime / parallelTime << "x)" << std::endl;
+
+    // Parallel for with far more grains than job slots, every element must still be processed.
+    std::vector<uint8_t> processed(elementCount, 0);
+    start = Clock::now();
+    jobSystem.parallelFor(0, elementCount, 1, [&processed](const size_t begin, const size_t end)
+    {
+        for (size_t j = begin; j < end; j++)
+        {
+            processed[j]++;
+        }
+    });
+    const double fineTime = getMilliseconds(start);
+    size_t missed = 0;
+    for (const uint8_t value : processed)
+    {
+        missed += value != 1 ? 1 : 0;
+    }
+    std::cout << "Fine grained for:  " << fineTime << " ms (" << missed << " elements missed)" << std::endl;
+
+    // Exceptions thrown by jobs are rethrown by wait.
+    bool rethrown = false;
+    try
+    {
+        jobSystem.parallelFor(0, elementCount, 1, [](const size_t begin, const size_t end)
+        {
+            if (begin <= 12345 && 12345 < end)
+            {
+                throw std::runtime_error("Job failed.");
+            }
+        });
+    }
+    catch (const std::runtime_error &)
+    {
+        rethrown = true;
+    }
+    std::cout << "Job exceptions:    " << (rethrown ? "rethrown" : "lost") << std::endl;
+
+    // Tiny jobs, measures scheduling overhead.
+    // Submitted in batches, a thread with a full job ring executes jobs itself until a slot is finished.
+    std::atomic<size_t> counter(0);
+    Flare::Job * root = nullptr;
+    start = Clock::now();
+    for (size_t i = 0; i < tinyJobCount; i += tinyJobBatchSize)
+    {
+        root = jobSystem.createJob([]() {});
+        for (size_t j = 0; j < tinyJobBatchSize; j++)
+        {
+            jobSystem.run(jobSystem.createChildJob(root, [&counter]()
+            {
+                counter.fetch_add(1, std::memory_order_relaxed);
+            }));
+        }
+        jobSystem.run(root);
+        jobSystem.wait(root);
+    }
+    const double tinyTime = getMilliseconds(start);
+    std::cout << "Tiny jobs:         " << (tinyTime * 1000000.0) / tinyJobCount << " ns/job" << std::endl;
+
+    // Nested parent/child jobs.
+    counter = 0;
+    start = Clock::now();
+    root = jobSystem.createJob([&jobSystem, &counter](Flare::Job & parent)
+    {
+        for (size_t i = 0; i < 32; i++)
+        {
+            jobSystem.run(jobSystem.createChildJob(&parent, [&jobSystem, &counter](Flare::Job & child)
+            {
+                for (size_t j = 0; j < 64; j++)
+                {
+                    jobSystem.run(jobSystem.createChildJob(&child, [&counter]()
+                    {
+                        counter.fetch_add(1, std::memory_order_relaxed);
+                    }));
+                }
+            }));
+        }
+    });
+    jobSystem.run(root);
+    jobSystem.wait(root);
+    std::cout << "Nested jobs:       " << getMilliseconds(start) << " ms (" << counter << " jobs)" << std::endl;
+
+    return (missed == 0 && rethrown) ? 0 : 1;
+}
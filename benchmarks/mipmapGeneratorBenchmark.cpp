@@ -0,0 +1,103 @@
+/*
+* MIT License
+*
+* Copyright(c) 2018 Jimmie Bergmann
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*/
+
+#include "flare/graphics/mipmapGenerator.hpp"
+#include "flare/system/jobSystem.hpp"
+#include <iostream>
+#include <chrono>
+#include <vector>
+#include <random>
+
+using Clock = std::chrono::high_resolution_clock;
+
+static double getMilliseconds(const Clock::time_point & start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static double run(const Flare::MipmapGenerator & generator, const std::vector<uint8_t> & image, const Flare::Vector2ui32 & size,
+                  const Flare::MipmapGenerator::Settings & settings, std::vector<uint8_t> & output, const size_t iterations)
+{
+    std::vector<Flare::MipmapGenerator::Level> levels;
+    const Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < iterations; i++)
+    {
+        generator.generate(image.data(), size, Flare::Texture::PixelFormat::RGBA, output, levels, settings);
+    }
+    return getMilliseconds(start) / iterations;
+}
+
+int main()
+{
+    const Flare::Vector2ui32 size(2048, 2048);
+    const size_t iterations = 10;
+
+    Flare::JobSystem jobSystem;
+    std::cout << "Workers: " << jobSystem.getWorkerCount() << std::endl;
+    std::cout << "Image:   " << size.x << "x" << size.y << " RGBA" << std::endl;
+
+    std::vector<uint8_t> image(static_cast<size_t>(size.x) * size.y * 4);
+    std::mt19937 random(1);
+    for (auto & value : image)
+    {
+        value = static_cast<uint8_t>(random());
+    }
+
+    std::vector<uint8_t> output;
+    const Flare::MipmapGenerator serialGenerator;
+    const Flare::MipmapGenerator parallelGenerator(&jobSystem);
+    const double megapixels = static_cast<double>(size.x) * size.y / 1000000.0;
+
+    struct Case
+    {
+        const char * name;
+        Flare::MipmapGenerator::Filter filter;
+        bool gammaCorrect;
+        bool preserveAlphaCoverage;
+    };
+
+    const Case cases[] =
+    {
+        { "Box, linear:          ", Flare::MipmapGenerator::Filter::Box, false, false },
+        { "Box, sRGB:            ", Flare::MipmapGenerator::Filter::Box, true, false },
+        { "Box, sRGB, coverage:  ", Flare::MipmapGenerator::Filter::Box, true, true },
+        { "Kaiser, sRGB:         ", Flare::MipmapGenerator::Filter::Kaiser, true, false }
+    };
+
+    for (const auto & testCase : cases)
+    {
+        Flare::MipmapGenerator::Settings settings;
+        settings.filter = testCase.filter;
+        settings.gammaCorrect = testCase.gammaCorrect;
+        settings.preserveAlphaCoverage = testCase.preserveAlphaCoverage;
+
+        const double serialTime = run(serialGenerator, image, size, settings, output, iterations);
+        const double parallelTime = run(parallelGenerator, image, size, settings, output, iterations);
+        std::cout << testCase.name << serialTime << " ms serial, " << parallelTime << " ms parallel ("
+                  << serialTime / parallelTime << "x, " << megapixels / (parallelTime / 1000.0) << " MP/s)" << std::endl;
+    }
+
+    return 0;
+}
@@ -30,12 +30,17 @@
 
 #if defined(FLARE_VULKAN)
 #include "flare/graphics/vulkan/vulkanRenderer.hpp"
+#include "flare/graphics/vulkan/vulkanPipeline.hpp"
 #include "flare/graphics/vulkan/vulkanTexture.hpp"
 #endif
 
+#include "flare/graphics/software/softwareRenderer.hpp"
+#include "flare/graphics/software/softwareTexture.hpp"
 #include "flare/graphics/scene.hpp"
 #include "flare/graphics/material.hpp"
+#include "flare/graphics/renderGraph.hpp"
 
+#include "flare/system/jobSystem.hpp"
 #include "flare/window/window.hpp"
 #include "flare/math/vector.hpp"
 #include "flare/math/matrix.hpp"
@@ -0,0 +1,88 @@
+/*
+* MIT License
+*
+* Copyright(c) 2018 Jimmie Bergmann
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*/
+
+#ifndef FLARE_GRAPHICS_IMAGE_DECODER_HPP
+#define FLARE_GRAPHICS_IMAGE_DECODER_HPP
+
+#include "flare/build.hpp"
+#include "flare/graphics/texture.hpp"
+#include <string>
+#include <vector>
+
+namespace Flare
+{
+
+    class JobSystem;
+
+    // Decodes image files straight into a caller provided buffer, such as mapped staging memory.
+    // PNG and TGA decode to RGBA, RGB sources are expanded while decoding and PNG is inflated row by row without
+    // holding the compressed or filtered image in memory. DDS and KTX2 files of block compressed formats are passed through,
+    // they must contain the whole mip chain. Rows of uncompressed data are converted on the job system,
+    // everything else is decoded on the calling thread. All methods are thread safe, Texture::loadAsync() decodes on a job.
+    class FLARE_API ImageDecoder
+    {
+
+    public:
+
+        enum class Format
+        {
+            Png,
+            Tga,
+            Dds,
+            Ktx2
+        };
+
+        struct Info
+        {
+            Format                  format;
+            Vector2ui32             size;
+
+            // RGBA for decoded formats, the stored format of passed through ones.
+            Texture::PixelFormat    pixelFormat;
+        };
+
+        ImageDecoder(JobSystem * jobSystem = nullptr);
+
+        static void readFile(const std::string & filename, std::vector<uint8_t> & data);
+
+        // Throws if the image is not of a supported format.
+        static Info readInfo(const uint8_t * data, const size_t size);
+
+        // Bytes written by decode(), see TextureCompressor::getBufferSize.
+        static size_t getOutputSize(const Info & info);
+
+        void decode(const uint8_t * data, const size_t size, const Info & info, uint8_t * output) const;
+
+    private:
+
+        ImageDecoder(const ImageDecoder &) = delete;
+
+        JobSystem * m_pJobSystem;
+
+    };
+
+}
+
+#endif
\ No newline at end of file
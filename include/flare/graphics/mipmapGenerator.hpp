@@ -0,0 +1,100 @@
+/*
+* MIT License
+*
+* Copyright(c) 2018 Jimmie Bergmann
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*/
+
+#ifndef FLARE_GRAPHICS_MIPMAP_GENERATOR_HPP
+#define FLARE_GRAPHICS_MIPMAP_GENERATOR_HPP
+
+#include "flare/build.hpp"
+#include "flare/graphics/texture.hpp"
+#include "flare/math/vector.hpp"
+#include <vector>
+
+namespace Flare
+{
+
+    class JobSystem;
+
+    // Builds mip chains of 8 bit RGB or RGBA images on the CPU, written as tightly packed RGBA levels.
+    // Each level is filtered from the previous one in floating point. Rows are split across the job system if one is given.
+    class FLARE_API MipmapGenerator
+    {
+
+    public:
+
+        enum class Filter
+        {
+            Box,
+            Kaiser
+        };
+
+        struct FLARE_API Settings
+        {
+            Settings();
+
+            Filter      filter;
+
+            // Color is sRGB encoded and filtered in linear space, alpha is always linear.
+            bool        gammaCorrect;
+
+            // Scales the alpha of every level to keep the fraction of pixels passing the alpha test of the first level.
+            bool        preserveAlphaCoverage;
+            float       alphaReference;
+
+            // Number of levels to generate, the full chain down to 1x1 if zero.
+            uint32_t    maxLevels;
+        };
+
+        struct Level
+        {
+            Vector2ui32 size;
+            size_t      offset;
+            size_t      byteSize;
+        };
+
+        MipmapGenerator(JobSystem * jobSystem = nullptr);
+
+        static uint32_t getLevelCount(const Vector2ui32 & size, const uint32_t maxLevels = 0);
+
+        // Layout of the levels in the output, returns the size of the whole chain in bytes.
+        static size_t getLevels(const Vector2ui32 & size, const uint32_t levelCount, std::vector<Level> & levels);
+
+        // The output must hold the whole chain described by levels, it is only written to, never read.
+        // RGBA sources may be the first level of the output itself, generating the chain in place.
+        void generate(const uint8_t * source, const Vector2ui32 & size, const Texture::PixelFormat pixelFormat,
+                      uint8_t * output, const std::vector<Level> & levels, const Settings & settings = Settings()) const;
+        void generate(const uint8_t * source, const Vector2ui32 & size, const Texture::PixelFormat pixelFormat,
+                      std::vector<uint8_t> & output, std::vector<Level> & levels, const Settings & settings = Settings()) const;
+
+    private:
+
+        MipmapGenerator(const MipmapGenerator &) = delete;
+
+        JobSystem * m_pJobSystem;
+
+    };
+
+}
+
+#endif
\ No newline at end of file
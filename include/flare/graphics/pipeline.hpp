@@ -27,23 +27,50 @@
 #define FLARE_GRAPHICS_PIPELINE_HPP
 
 #include "flare/build.hpp"
+#include "flare/graphics/renderer.hpp"
+#include <string>
 
 namespace Flare
 {
 
-    class Renderer;
-
-    class FLARE_API Pipeline
+    // Shader program and fixed function state of a draw.
+    // Shaders are loaded and compiled asynchronously, load() returns right away and the pipeline
+    // acts as the handle of the build. Draws keep using the previously built pipeline, or the renderer's
+    // fallback pipeline, until the build is ready. Loading again during a build queues the new shaders.
+    class FLARE_API Pipeline : public RenderObject
     {
 
     public:
 
+        enum class Status
+        {
+            Unloaded,
+            Loading,
+            Ready,
+            Failed
+        };
+
         Pipeline(Renderer & renderer);
+        virtual ~Pipeline();
 
-    private:
+        virtual void load(const std::string & vertexShader, const std::string & fragmentShader) = 0;
+        virtual void unload() = 0;
+
+        // Blocks until the current build and any queued one have finished.
+        virtual void wait() = 0;
+
+        virtual Status getStatus() const = 0;
+
+        // Reason of the last failed build.
+        virtual std::string getError() const = 0;
+
+    protected:
 
         Renderer & m_renderer;
 
+    private:
+
+        Pipeline(const Pipeline &) = delete;
 
     };
 
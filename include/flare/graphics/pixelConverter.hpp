@@ -0,0 +1,56 @@
+/*
+* MIT License
+*
+* Copyright(c) 2018 Jimmie Bergmann
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*/
+
+#ifndef FLARE_GRAPHICS_PIXEL_CONVERTER_HPP
+#define FLARE_GRAPHICS_PIXEL_CONVERTER_HPP
+
+#include "flare/build.hpp"
+#include <cstddef>
+#include <cstdint>
+
+namespace Flare
+{
+
+    // Conversions of tightly packed 8 bit pixels into RGBA, used on the upload and readback paths.
+    // Sixteen pixels are converted at once with SSSE3 byte shuffles if the CPU supports them, otherwise with SSE2
+    // or four pixels per 32 bit word, only the remaining pixels are converted one by one.
+    // The source and output must not overlap, except for swizzles which may convert in place.
+    class FLARE_API PixelConverter
+    {
+
+    public:
+
+        static void rgbToRgba(const uint8_t * source, uint8_t * output, const size_t pixelCount);
+        static void bgrToRgba(const uint8_t * source, uint8_t * output, const size_t pixelCount);
+        static void bgraToRgba(const uint8_t * source, uint8_t * output, const size_t pixelCount);
+        static void grayToRgba(const uint8_t * source, uint8_t * output, const size_t pixelCount);
+
+        static bool hasSsse3();
+
+    };
+
+}
+
+#endif
\ No newline at end of file
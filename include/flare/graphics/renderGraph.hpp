@@ -0,0 +1,202 @@
+/*
+* MIT License
+*
+* Copyright(c) 2018 Jimmie Bergmann
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*/
+
+#ifndef FLARE_GRAPHICS_RENDER_GRAPH_HPP
+#define FLARE_GRAPHICS_RENDER_GRAPH_HPP
+
+#include "flare/build.hpp"
+#include "flare/graphics/subpass.hpp"
+#include "flare/math/vector.hpp"
+#include <string>
+#include <vector>
+
+namespace Flare
+{
+
+    enum class RenderGraphFormat
+    {
+        Backbuffer,
+        Rgba8,
+        Rgba16f,
+        Depth32f,
+        Depth24Stencil8
+    };
+
+    enum class RenderGraphAccess
+    {
+        ColorAttachment,
+        DepthAttachment,
+        InputAttachment,
+        Sampled
+    };
+
+    // Attachments of size zero follow the backbuffer size.
+    struct FLARE_API RenderGraphResourceDesc
+    {
+        RenderGraphFormat   format;
+        Vector2ui32         size;
+    };
+
+    typedef uint32_t RenderGraphResource;
+
+    class RenderGraph;
+
+    // Passed to Subpass::setup, records the accesses of a single pass.
+    class FLARE_API RenderGraphBuilder
+    {
+
+    public:
+
+        static const RenderGraphResource InvalidResource = 0xFFFFFFFF;
+
+        void setName(const std::string & name);
+        void setSideEffects();
+
+        RenderGraphResource create(const std::string & name, const RenderGraphResourceDesc & desc);
+        RenderGraphResource find(const std::string & name) const;
+        RenderGraphResource getBackbuffer() const;
+
+        void read(const RenderGraphResource resource, const RenderGraphAccess access);
+        void write(const RenderGraphResource resource, const RenderGraphAccess access);
+
+    private:
+
+        RenderGraphBuilder(RenderGraph & graph, const uint32_t pass);
+        RenderGraphBuilder(const RenderGraphBuilder &) = delete;
+
+        RenderGraph &   m_graph;
+        uint32_t        m_pass;
+
+        friend class RenderGraph;
+
+    };
+
+    // Base of the backend specific state handed to Subpass::prepare and Subpass::execute.
+    class FLARE_API RenderGraphContext
+    {
+
+    public:
+
+        virtual ~RenderGraphContext();
+
+        virtual Vector2ui32 getExtent() const = 0;
+
+    };
+
+    // Frame graph compiled from the passes of a multipass.
+    // Passes run in declaration order. Compiling culls passes that contribute neither to the backbuffer nor have side effects,
+    // computes the barriers needed between the remaining passes, merges consecutive passes into batches that can run as
+    // subpasses of one render pass, and computes the lifetime of every transient resource for memory aliasing.
+    class FLARE_API RenderGraph
+    {
+
+    public:
+
+        struct Access
+        {
+            RenderGraphResource resource;
+            RenderGraphAccess   access;
+            bool                read;
+            bool                write;
+        };
+
+        // Synchronization of a resource between its previous and next access, undefined previous contents are discarded.
+        struct Barrier
+        {
+            RenderGraphResource resource;
+            RenderGraphAccess   srcAccess;
+            bool                srcWrite;
+            RenderGraphAccess   dstAccess;
+            bool                dstRead;
+            bool                dstWrite;
+            bool                discard;
+            uint32_t            srcPass;
+        };
+
+        struct Pass
+        {
+            Subpass *               subpass;
+            std::string             name;
+            std::vector<Access>     accesses;
+            std::vector<Barrier>    barriers;
+            bool                    sideEffects;
+            bool                    culled;
+            uint32_t                batch;
+        };
+
+        struct Resource
+        {
+            std::string             name;
+            RenderGraphResourceDesc desc;
+            bool                    imported;
+            uint32_t                firstBatch;
+            uint32_t                lastBatch;
+        };
+
+        struct Batch
+        {
+            std::vector<uint32_t>   passes;
+        };
+
+        static const uint32_t InvalidIndex = 0xFFFFFFFF;
+
+        RenderGraph();
+
+        void clear();
+        void setup(Multipass & multipass);
+        void compile();
+
+        const std::vector<Pass> & getPasses() const;
+        const std::vector<Resource> & getResources() const;
+        const std::vector<Batch> & getBatches() const;
+        RenderGraphResource getBackbuffer() const;
+        uint32_t findPass(const Subpass * subpass) const;
+
+        // Transient resources may share memory if their lifetimes do not overlap.
+        bool canAlias(const RenderGraphResource first, const RenderGraphResource second) const;
+
+    private:
+
+        RenderGraph(const RenderGraph &) = delete;
+
+        void setupSubpass(Subpass * subpass);
+        void cullPasses();
+        void mergePasses();
+        void computeBarriers();
+        void computeLifetimes();
+        bool canMerge(const Batch & batch, const Pass & pass) const;
+
+        std::vector<Pass>       m_passes;
+        std::vector<Resource>   m_resources;
+        std::vector<Batch>      m_batches;
+        RenderGraphResource     m_backbuffer;
+
+        friend class RenderGraphBuilder;
+
+    };
+
+}
+
+#endif
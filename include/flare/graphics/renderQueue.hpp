@@ -0,0 +1,83 @@
+/*
+* MIT License
+*
+* Copyright(c) 2018 Jimmie Bergmann
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*/
+
+#ifndef FLARE_GRAPHICS_RENDER_QUEUE_HPP
+#define FLARE_GRAPHICS_RENDER_QUEUE_HPP
+
+#include "flare/build.hpp"
+#include <vector>
+#include <cstdint>
+
+namespace Flare
+{
+
+    // Draws ordered by 64 bit sort keys, built and sorted once per frame.
+    // From the most significant bit, a key holds the pass (4 bits), pipeline (12 bits), material (16 bits),
+    // mesh (16 bits) and quantized depth (16 bits). Sorted draws share as much state as possible with their neighbours.
+    class FLARE_API RenderQueue
+    {
+
+    public:
+
+        struct Item
+        {
+            uint64_t    key;
+            uint32_t    index;
+        };
+
+        static const uint32_t MaxPasses = 1 << 4;
+        static const uint32_t MaxPipelines = 1 << 12;
+        static const uint32_t MaxMaterials = 1 << 16;
+        static const uint32_t MaxMeshes = 1 << 16;
+
+        // Ids out of range wrap around, depth is clamped to [0, 1]. Pass depth as 1 - depth to sort back to front.
+        static uint64_t createKey(const uint32_t pass, const uint32_t pipeline, const uint32_t material, const uint32_t mesh, const float depth);
+
+        RenderQueue();
+
+        void clear();
+        void reserve(const size_t count);
+
+        // The index refers to the draw in the caller's own list.
+        void push(const uint64_t key, const uint32_t index);
+
+        // Stable least significant digit radix sort, equal keys keep their submission order.
+        void sort();
+
+        size_t getSize() const;
+        const std::vector<Item> & getItems() const;
+
+    private:
+
+        RenderQueue(const RenderQueue &) = delete;
+
+        std::vector<Item> m_items;
+        std::vector<Item> m_scratch;
+
+    };
+
+}
+
+#endif
\ No newline at end of file
@@ -31,6 +31,7 @@
 #include "flare/window/windowProxy.hpp"
 #include "flare/math/vector.hpp"
 #include "flare/system/memoryAllocator.hpp"
+#include "flare/system/framePacer.hpp"
 #include <string>
 #include <vector>
 #include <optional>
@@ -41,6 +42,17 @@ namespace Flare
 
     class Texture;
     class Pipeline;
+    class JobSystem;
+    class Multipass;
+
+    // Preferred way of presenting, unsupported modes fall back to the closest supported one and finally to fifo.
+    enum class PresentMode
+    {
+        Fifo,
+        FifoRelaxed,
+        Mailbox,
+        Immediate
+    };
 
     class FLARE_API RendererSettings
     {
@@ -61,22 +73,70 @@ namespace Flare
         void setUnlimitedFrameRate();
         float getMaxFrameRate() const;
 
+        void setMaxFramesInFlight(const size_t count);
+        size_t getMaxFramesInFlight() const;
+
         void setWindow(Window * window);
         Window * getWindow() const;
 
         void setWindowProxy(const WindowProxy & windowProxy);
         const WindowProxy & getWindowProxy() const;
 
+        void setJobSystem(JobSystem * jobSystem);
+        JobSystem * getJobSystem() const;
+
+        void setPipelineCacheFile(const std::string & filename);
+        const std::string & getPipelineCacheFile() const;
+
+        void setGpuProfiling(const bool flag);
+        bool getGpuProfiling() const;
+
+        void setHeadless(const bool flag);
+        bool getHeadless() const;
+
+        void setHeadlessSize(const Vector2ui32 & size);
+        const Vector2ui32 & getHeadlessSize() const;
+
+        void setPresentMode(const PresentMode presentMode);
+        PresentMode getPresentMode() const;
+
+        void setSwapChainImageCount(const uint32_t count);
+        uint32_t getSwapChainImageCount() const;
+
+        void setLowLatency(const bool flag);
+        bool getLowLatency() const;
+
     private:
 
         std::vector<std::string> m_arguments;
         bool m_debug;
         float m_frameRate;
+        size_t m_maxFramesInFlight;
 
         // Window configurations.
         Window * m_pWindow;
         WindowProxy m_windowProxy;
 
+        // Job system used for command recording, the renderer creates its own if not set.
+        JobSystem * m_pJobSystem;
+
+        // Pipeline cache persisted between runs, not stored if empty.
+        std::string m_pipelineCacheFile;
+
+        // Timestamp queries around passes, read back through Renderer::getGpuProfile.
+        bool m_gpuProfiling;
+
+        // Render into offscreen images without window, surface or presentation.
+        bool m_headless;
+        Vector2ui32 m_headlessSize;
+
+        // Swapchain configuration, an image count of zero is one more than the surface minimum.
+        PresentMode m_presentMode;
+        uint32_t m_swapChainImageCount;
+
+        // Renderer::waitForInput waits for the previous frame to finish on the GPU, not only for a free frame.
+        bool m_lowLatency;
+
     };
 
 
@@ -99,7 +159,54 @@ namespace Flare
         VertexBuffer,
     };
 
-    typedef RamMemoryAllocator<RenderObjectType, 4> RenderMemoryAllocator;
+    typedef RamMemoryAllocator<RenderObjectType, 6> RenderMemoryAllocator;
+
+
+    // Timing of a named GPU scope, in milliseconds from the start of the frame.
+    struct FLARE_API GpuProfileScope
+    {
+        std::string                     name;
+        double                          start;
+        double                          duration;
+        std::vector<GpuProfileScope>    children;
+    };
+
+    struct FLARE_API GpuFrameProfile
+    {
+        uint64_t                        frame;
+        std::vector<GpuProfileScope>    scopes;
+    };
+
+    // Input to present latency in milliseconds.
+    struct FLARE_API RenderLatency
+    {
+        RenderLatency();
+
+        void record(const double latency);
+
+        uint64_t    frameCount;
+        double      lastLatency;
+        double      averageLatency;
+        double      maxLatency;
+    };
+
+    // Draws and state changes of the latest recorded frame. Changes skipped because the sorted
+    // neighbouring draw already had the same state are counted as avoided. The descriptor table stays bound
+    // for the whole frame, draws select their textures and buffers through pushed constants.
+    struct FLARE_API DrawStatistics
+    {
+        DrawStatistics();
+
+        void add(const DrawStatistics & statistics);
+
+        uint64_t    draws;
+        uint64_t    pipelineBinds;
+        uint64_t    pipelineBindsAvoided;
+        uint64_t    constantPushes;
+        uint64_t    constantPushesAvoided;
+        uint64_t    vertexBufferBinds;
+        uint64_t    vertexBufferBindsAvoided;
+    };
 
 
     class FLARE_API Renderer
@@ -117,9 +224,33 @@ namespace Flare
 
         virtual const RenderMemoryAllocator & memory() const = 0;
 
+        // Latest frame with resolved GPU timings, a few frames behind the one being rendered.
+        virtual bool getGpuProfile(GpuFrameProfile & profile) const = 0;
+
         virtual std::shared_ptr<Texture> createTexture() = 0;
         virtual std::shared_ptr<Pipeline> createPipeline() = 0;
 
+        // Pipeline of the main pass. Swapping it never blocks, the previous pipeline or the built-in
+        // fallback pipeline is drawn with until the new one has finished building.
+        virtual void setPipeline(const std::shared_ptr<Pipeline> & pipeline) = 0;
+
+        // Copies the latest rendered frame as tightly packed RGBA, waiting for it to finish.
+        virtual void readFrame(std::vector<uint8_t> & pixels, Vector2ui32 & size) = 0;
+
+        // Call right before sampling input. Blocks until the next frame can start and marks the start of its
+        // input to present latency, which otherwise starts when render is called.
+        virtual void waitForInput() = 0;
+        virtual const RenderLatency & getLatency() const = 0;
+
+        virtual const DrawStatistics & getDrawStatistics() const = 0;
+
+        // Paces presentation to RendererSettings::getMaxFrameRate and measures the frame times.
+        virtual FramePacer & getFramePacer() = 0;
+
+        // Passes of the render graph, initially holding the main pass writing the backbuffer.
+        // Changes are picked up by the next rendered frame.
+        virtual Multipass & getMultipass() = 0;
+
     private:
 
         Renderer(const Renderer &) = delete;
@@ -0,0 +1,195 @@
+/*
+* MIT License
+*
+* Copyright(c) 2018 Jimmie Bergmann
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*/
+
+#ifndef FLARE_GRAPHICS_SOFTWARE_RASTERIZER_HPP
+#define FLARE_GRAPHICS_SOFTWARE_RASTERIZER_HPP
+
+#include "flare/build.hpp"
+#include "flare/math/vector.hpp"
+#include <mutex>
+#include <vector>
+
+namespace Flare
+{
+
+    class JobSystem;
+
+    // Vertex in clip space, visible if w > 0 and 0 <= z <= w.
+    struct FLARE_API SoftwareVertex
+    {
+        Vector4f position;
+        Vector3f normal;
+        Vector4f color;
+    };
+
+    // Lighting applied when resolving the G-buffer, pixels are lit by ambient + color * max(dot(normal, -direction), 0).
+    struct FLARE_API SoftwareLighting
+    {
+        Vector3f ambient;
+        Vector3f direction;
+        Vector3f color;
+    };
+
+    // Tile-binned triangle rasterizer writing albedo, normal and depth into a G-buffer.
+    // Triangles are clipped, set up and binned on flush, after which the tiles are rasterized in parallel.
+    // Every tile processes its triangles in draw order, so the output does not depend on the worker count.
+    // Coverage is computed with fixed-point edge functions four pixels at a time, 8x8 pixel blocks are
+    // rejected against a per block and per tile maximum depth before any pixel is touched.
+    class FLARE_API SoftwareRasterizer
+    {
+
+    public:
+
+        static const uint32_t TileSize = 64;
+        static const uint32_t BlockSize = 8;
+        static const uint32_t MaxSize = 16384;
+
+        struct Statistics
+        {
+            uint64_t draws;
+            uint64_t triangles;
+            uint64_t culledTriangles;
+            uint64_t clippedTriangles;
+            uint64_t binnedTriangles;
+            uint64_t rasterizedBlocks;
+            uint64_t rejectedBlocks;
+            uint64_t rejectedTiles;
+        };
+
+        SoftwareRasterizer();
+
+        void resize(const Vector2ui32 & size);
+
+        // Clears the G-buffer and the statistics, tiles are cleared lazily on the next flush.
+        void clear(const Vector4f & color, const float depth = 1.0f);
+
+        // Culls counter-clockwise triangles in framebuffer coordinates, enabled by default.
+        // Matches the clockwise front face of the Vulkan renderer's pipeline.
+        void setBackFaceCulling(const bool flag);
+
+        // Queues a triangle list, rasterized on the next flush.
+        void draw(const SoftwareVertex * pVertices, const size_t vertexCount);
+        void flush(JobSystem & jobSystem);
+
+        // Lights the G-buffer into the color buffer.
+        void resolve(JobSystem & jobSystem, const SoftwareLighting & lighting);
+
+        const Vector2ui32 & getSize() const;
+        Statistics getStatistics() const;
+
+        // Tightly packed RGBA8 pixels of the latest resolve.
+        const std::vector<uint32_t> & getColorBuffer() const;
+
+        // G-buffer, rows are padded to a multiple of TileSize pixels.
+        uint32_t getStride() const;
+        const std::vector<uint32_t> & getAlbedoBuffer() const;
+        const std::vector<uint32_t> & getNormalBuffer() const;
+        const std::vector<float> & getDepthBuffer() const;
+
+    private:
+
+        SoftwareRasterizer(const SoftwareRasterizer &) = delete;
+
+        static const uint32_t AttributeCount = 7;
+        static const uint32_t TriangleChunkSize = 256;
+
+        // Linear function of the pixel center position, relative to the first vertex of the triangle.
+        struct Plane
+        {
+            float origin;
+            float dx;
+            float dy;
+        };
+
+        struct ClipVertex
+        {
+            float position[4];
+            float attributes[AttributeCount];
+        };
+
+        struct Triangle
+        {
+            int32_t     minX;
+            int32_t     minY;
+            int32_t     maxX;
+            int32_t     maxY;
+            int64_t     edgeOrigin[3];
+            int32_t     edgeDx[3];
+            int32_t     edgeDy[3];
+            float       originX;
+            float       originY;
+            float       minDepth;
+            Plane       depth;
+            Plane       invW;
+            Plane       attributes[AttributeCount];
+        };
+
+        struct Tile
+        {
+            std::vector<const Triangle *>   triangles;
+            float                           maxDepth;
+            bool                            clear;
+        };
+
+        struct TriangleChunk
+        {
+            std::vector<Triangle>   triangles;
+            uint64_t                culledTriangles;
+            uint64_t                clippedTriangles;
+        };
+
+        void setupTriangles(TriangleChunk & chunk, const size_t first, const size_t last);
+        void clipTriangle(TriangleChunk & chunk, const ClipVertex * pVertices);
+        void setupTriangle(TriangleChunk & chunk, const ClipVertex & vertex0, const ClipVertex & vertex1, const ClipVertex & vertex2);
+        void binTriangles(const size_t chunkCount);
+        void clearTile(const uint32_t tileX, const uint32_t tileY);
+        void rasterizeTile(const uint32_t tileX, const uint32_t tileY);
+        bool rasterizeBlock(const Triangle & triangle, const uint32_t blockX, const uint32_t blockY, const int32_t * pEdges, const bool full);
+        float computeBlockDepth(const uint32_t blockX, const uint32_t blockY) const;
+
+        Vector2ui32                 m_size;
+        uint32_t                    m_stride;
+        uint32_t                    m_paddedHeight;
+        uint32_t                    m_tileCountX;
+        uint32_t                    m_tileCountY;
+        bool                        m_backFaceCulling;
+        uint32_t                    m_clearAlbedo;
+        float                       m_clearDepth;
+        std::vector<SoftwareVertex> m_vertices;
+        std::vector<TriangleChunk>  m_chunks;
+        std::vector<Tile>           m_tiles;
+        std::vector<float>          m_blockDepth;
+        std::vector<uint32_t>       m_albedo;
+        std::vector<uint32_t>       m_normal;
+        std::vector<float>          m_depth;
+        std::vector<uint32_t>       m_color;
+        mutable std::mutex          m_statisticsMutex;
+        Statistics                  m_statistics;
+
+    };
+
+}
+
+#endif
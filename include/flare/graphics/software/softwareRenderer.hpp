@@ -0,0 +1,160 @@
+/*
+* MIT License
+*
+* Copyright(c) 2018 Jimmie Bergmann
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*/
+
+#ifndef FLARE_GRAPHICS_SOFTWARE_RENDERER_HPP
+#define FLARE_GRAPHICS_SOFTWARE_RENDERER_HPP
+
+#include "flare/graphics/renderer.hpp"
+#include "flare/graphics/renderGraph.hpp"
+#include "softwareRasterizer.hpp"
+#include "flare/system/jobSystem.hpp"
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Flare
+{
+
+    // Handed to the passes of the software renderer, all passes draw into the G-buffer of the rasterizer.
+    class FLARE_API SoftwareRenderGraphContext : public RenderGraphContext
+    {
+
+    public:
+
+        virtual Vector2ui32 getExtent() const;
+
+        SoftwareRasterizer & getRasterizer() const;
+        JobSystem & getJobSystem() const;
+
+    private:
+
+        SoftwareRenderGraphContext(SoftwareRasterizer & rasterizer, JobSystem & jobSystem);
+        SoftwareRenderGraphContext(const SoftwareRenderGraphContext &) = delete;
+
+        SoftwareRasterizer &    m_rasterizer;
+        JobSystem &             m_jobSystem;
+
+        friend class SoftwareRenderer;
+
+    };
+
+    // Renderer running entirely on the CPU, for machines without a GPU and for deterministic output.
+    // Every batch of the render graph is rasterized on the job system, the G-buffer is then lit into the frame.
+    // Frames are presented through GDI when a window is set, timings of the batches are reported as the GPU profile.
+    class FLARE_API SoftwareRenderer : public Renderer
+    {
+
+    public:
+
+        SoftwareRenderer();
+        SoftwareRenderer(const RendererSettings & settings);
+        ~SoftwareRenderer();
+
+        virtual void load(const RendererSettings & settings);
+        virtual void unload();
+        virtual void render();
+        virtual void resize(const Vector2ui32 & size);
+
+        virtual const RenderMemoryAllocator & memory() const;
+
+        virtual bool getGpuProfile(GpuFrameProfile & profile) const;
+
+        virtual std::shared_ptr<Texture> createTexture();
+        virtual std::shared_ptr<Pipeline> createPipeline();
+        virtual void setPipeline(const std::shared_ptr<Pipeline> & pipeline);
+
+        virtual void readFrame(std::vector<uint8_t> & pixels, Vector2ui32 & size);
+
+        virtual void waitForInput();
+        virtual const RenderLatency & getLatency() const;
+
+        virtual const DrawStatistics & getDrawStatistics() const;
+
+        virtual FramePacer & getFramePacer();
+
+        virtual Multipass & getMultipass();
+
+        void setLighting(const SoftwareLighting & lighting);
+        const SoftwareLighting & getLighting() const;
+
+        const SoftwareRasterizer & getRasterizer() const;
+
+    private:
+
+        SoftwareRenderer(const SoftwareRenderer &) = delete;
+
+        // Built-in pass drawing the draw list into the backbuffer.
+        class MainSubpass : public Subpass
+        {
+
+        public:
+
+            MainSubpass(SoftwareRenderer & renderer);
+
+            virtual void load(Renderer & renderer);
+            virtual void setup(RenderGraphBuilder & builder);
+            virtual void execute(RenderGraphContext & context);
+
+        private:
+
+            SoftwareRenderer & m_renderer;
+
+        };
+
+        Vector2ui32 loadGetSize() const;
+        void loadCreateRenderGraph();
+        void present();
+
+        Multipass                   m_multipass;
+        MainSubpass                 m_mainSubpass;
+        uint64_t                    m_multipassRevision;
+        RenderGraph                 m_renderGraph;
+        SoftwareRasterizer          m_rasterizer;
+        SoftwareLighting            m_lighting;
+        std::vector<SoftwareVertex> m_drawVertices;
+        std::vector<uint32_t>       m_presentBuffer;
+        uint64_t                    m_frame;
+
+        mutable std::mutex          m_profileMutex;
+        GpuFrameProfile             m_profile;
+        bool                        m_hasProfile;
+        FramePacer                  m_framePacer;
+        std::chrono::steady_clock::time_point m_inputTime;
+        bool                        m_hasInputTime;
+        RenderLatency               m_latency;
+        DrawStatistics              m_drawStatistics;
+
+        RenderMemoryAllocator       m_memory;
+        RendererSettings            m_settings;
+        JobSystem *                 m_pJobSystem;
+        std::unique_ptr<JobSystem>  m_ownedJobSystem;
+        bool                        m_loaded;
+
+    };
+
+}
+
+#endif
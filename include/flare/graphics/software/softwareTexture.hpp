@@ -0,0 +1,92 @@
+/*
+* MIT License
+*
+* Copyright(c) 2018 Jimmie Bergmann
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*/
+
+#ifndef FLARE_GRAPHICS_SOFTWARE_TEXTURE_HPP
+#define FLARE_GRAPHICS_SOFTWARE_TEXTURE_HPP
+
+#include "flare/graphics/texture.hpp"
+#include <string>
+#include <vector>
+
+namespace Flare
+{
+
+    class SoftwareRenderer;
+
+    class FLARE_API SoftwareTexture : public Texture
+    {
+
+    public:
+
+        ~SoftwareTexture();
+
+        virtual void load(const uint8_t * buffer = nullptr,
+                          const Vector2ui32 & size = { 0, 0 },
+                          const PixelFormat & pixelFormat = PixelFormat::RGBA,
+                          const bool storeBuffer = false);
+
+        virtual void load(const std::string & filename, const bool storeBuffer = false);
+
+        // Loaded right away, the software renderer has no upload to finish later.
+        virtual void loadAsync(const std::string & filename, const bool storeBuffer = false);
+
+        virtual void unload();
+
+        virtual Status getStatus() const;
+
+        virtual std::string getError() const;
+
+        virtual const uint8_t * getBuffer() const;
+
+        virtual size_t getBufferSize() const;
+
+        virtual PixelFormat getPixelFormat() const;
+
+        virtual PixelFormat getStorageFormat() const;
+
+        virtual Vector2ui32 getSize() const;
+
+        // Pixels as sampled by the rasterizer, always RGBA.
+        const std::vector<uint8_t> & getPixels() const;
+
+    private:
+
+        SoftwareTexture(RenderMemoryAllocator & allocator);
+        SoftwareTexture(const SoftwareTexture &) = delete;
+
+        Vector2ui32             m_size;
+        PixelFormat             m_pixelFormat;
+        uint8_t *               m_pBuffer;
+        std::vector<uint8_t>    m_pixels;
+        Status                  m_status;
+        std::string             m_error;
+
+        friend class SoftwareRenderer;
+
+    };
+
+}
+
+#endif
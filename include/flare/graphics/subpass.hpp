@@ -33,6 +33,8 @@ namespace Flare
 {
 
     class Renderer;
+    class RenderGraphBuilder;
+    class RenderGraphContext;
 
     class FLARE_API Subpass
     {
@@ -43,14 +45,28 @@ namespace Flare
 
         virtual void load(Renderer & renderer) = 0;
 
+        // Declares the resources read and written by the pass, called when the render graph is compiled.
+        virtual void setup(RenderGraphBuilder & builder) = 0;
+
+        // Called before the render pass containing this pass begins, e.g. for recording in parallel.
+        virtual void prepare(RenderGraphContext & context);
+
+        // Records the pass, only called for passes that survived culling.
+        virtual void execute(RenderGraphContext & context) = 0;
+
     };
 
-    class Multipass : public Subpass
+    // Ordered list of passes, nested multipasses are flattened into the render graph.
+    class FLARE_API Multipass : public Subpass
     {
 
     public:
 
-        virtual void load(Renderer & renderer) = 0;
+        Multipass();
+
+        virtual void load(Renderer & renderer);
+        virtual void setup(RenderGraphBuilder & builder);
+        virtual void execute(RenderGraphContext & context);
 
         std::vector<Subpass *>::const_iterator addSubpass(Subpass * subpass);
         std::vector<Subpass *>::const_iterator addSubpass(std::vector<Subpass *>::const_iterator position, Subpass * subpass);
@@ -58,12 +74,16 @@ namespace Flare
         std::vector<Subpass *>::const_iterator firstSubpass() const;
         std::vector<Subpass *>::const_iterator lastSubpass() const;
 
+        // Increases on every change, including changes of nested multipasses.
+        uint64_t getRevision() const;
+
     private:
 
         std::vector<Subpass *> m_subpasses;
+        uint64_t m_revision;
 
     };
 
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -39,12 +39,26 @@ namespace Flare
 
     public:
 
+        // Buffers of block compressed formats hold the whole mip chain, see TextureCompressor.
         enum class PixelFormat
         {
             RGB,
-            RGBA
+            RGBA,
+            BC1,
+            BC3,
+            BC5,
+            BC7
         }; 
 
+        // Loading is only reported by loadAsync(), the other loads have finished or thrown when they return.
+        enum class Status
+        {
+            Unloaded,
+            Loading,
+            Ready,
+            Failed
+        };
+
         Texture(RenderMemoryAllocator & allocator);
         
         virtual ~Texture();
@@ -56,14 +70,26 @@ namespace Flare
         
         virtual void load(const std::string & filename, const bool storeBuffer = false) = 0;
 
+        // Returns right away, the file is decoded in the background and the texture is Ready once it can be sampled.
+        // Size and formats are valid from then on. Loading or unloading again waits for a decode in progress.
+        virtual void loadAsync(const std::string & filename, const bool storeBuffer = false) = 0;
+
         virtual void unload() = 0;
 
+        virtual Status getStatus() const = 0;
+
+        // Reason of the last failed asynchronous load.
+        virtual std::string getError() const = 0;
+
         virtual const uint8_t * getBuffer() const = 0;
 
         virtual size_t getBufferSize() const = 0;
 
         virtual PixelFormat getPixelFormat() const = 0;
 
+        // Format the pixels are stored in by the renderer, negotiated with the device. RGB is always expanded to RGBA.
+        virtual PixelFormat getStorageFormat() const = 0;
+
         virtual Vector2ui32 getSize() const = 0;
 
     private:
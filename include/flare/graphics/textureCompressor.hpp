@@ -0,0 +1,113 @@
+/*
+* MIT License
+*
+* Copyright(c) 2018 Jimmie Bergmann
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*/
+
+#ifndef FLARE_GRAPHICS_TEXTURE_COMPRESSOR_HPP
+#define FLARE_GRAPHICS_TEXTURE_COMPRESSOR_HPP
+
+#include "flare/build.hpp"
+#include "flare/graphics/texture.hpp"
+#include "flare/graphics/mipmapGenerator.hpp"
+#include <string>
+#include <vector>
+
+namespace Flare
+{
+
+    class JobSystem;
+
+    // Encodes RGB or RGBA images into block compressed mip chains at import time.
+    // The chain is generated with the mipmap generator and every 4x4 block is encoded on the job system.
+    // BC1 is opaque color, BC3 color and alpha, BC5 two channels for normal maps and BC7 color and alpha.
+    // BC7 is only encoded in mode 6, a single subset with 7 bit endpoints. It has no partitions, so blocks with several
+    // distinct colors lose more than in BC3, prefer BC3 where quality matters until more modes are encoded.
+    // Compressed chains are cached on disk, keyed by the source pixels and the settings.
+    class FLARE_API TextureCompressor
+    {
+
+    public:
+
+        // Fast uses bounding box endpoints, Normal fits endpoints along the principal axis and
+        // High refines them further and searches all endpoint modes. Quality does not add BC7 modes, see above.
+        enum class Quality
+        {
+            Fast,
+            Normal,
+            High
+        };
+
+        struct FLARE_API Settings
+        {
+            Settings();
+
+            Texture::PixelFormat        format;
+            Quality                     quality;
+
+            // The chain always goes down to 1x1, the max level count is ignored. Disable gamma correction for normal maps.
+            MipmapGenerator::Settings   mipmaps;
+
+            // Compressed chains are read from and written to this directory, nothing is cached if empty.
+            std::string                 cacheDirectory;
+        };
+
+        struct Result
+        {
+            uint32_t    levelCount;
+
+            // Peak signal to noise ratio in dB of all levels against the uncompressed chain, over the encoded channels.
+            double      psnr;
+            bool        cached;
+        };
+
+        TextureCompressor(JobSystem * jobSystem = nullptr);
+
+        static bool isCompressed(const Texture::PixelFormat pixelFormat);
+
+        // Bytes per 4x4 block of compressed formats, bytes per pixel of the others.
+        static size_t getBlockSize(const Texture::PixelFormat pixelFormat);
+
+        // Layout of a mip chain in the given format, returns the size of the whole chain in bytes.
+        static size_t getLevels(const Vector2ui32 & size, const uint32_t levelCount, const Texture::PixelFormat pixelFormat,
+                                std::vector<MipmapGenerator::Level> & levels);
+
+        // Size of the buffer passed to Texture::load, the first level of uncompressed formats and the whole chain of compressed formats.
+        static size_t getBufferSize(const Vector2ui32 & size, const Texture::PixelFormat pixelFormat);
+
+        Result compress(const uint8_t * source, const Vector2ui32 & size, const Texture::PixelFormat sourceFormat,
+                        std::vector<uint8_t> & output, const Settings & settings = Settings()) const;
+
+        // Decodes a single level into tightly packed RGBA. All BC7 modes are decoded, a reserved mode block throws.
+        static void decompress(const uint8_t * blocks, const Vector2ui32 & size, const Texture::PixelFormat pixelFormat, uint8_t * output);
+
+    private:
+
+        TextureCompressor(const TextureCompressor &) = delete;
+
+        JobSystem * m_pJobSystem;
+
+    };
+
+}
+
+#endif
\ No newline at end of file
@@ -31,14 +31,18 @@
 #if defined(FLARE_VULKAN)
 
 #include "flare/graphics/renderer.hpp"
-#include <thread>
-#include <mutex>
-#include <queue>
 #include <atomic>
+#include <memory>
+#include <vector>
 
 namespace Flare
 {
 
+    // Deferred destruction of render objects.
+    // Objects added during a frame are moved to that frame's retire list, owned by the frame context,
+    // and deleted after the frame's in-flight fence has signaled, at most maxBatchSize per frame.
+    // add() is lock-free and may be called from any thread, the other methods from the render thread only.
+    // Pending objects are linked through nodes from a fixed pool, a node is only allocated if the pool is empty.
     class FLARE_API VulkanCleaner
     {
 
@@ -47,18 +51,35 @@ namespace Flare
         VulkanCleaner();
         ~VulkanCleaner();
 
-        void start(float refreshTime, float maxTime);
+        void start(const size_t maxBatchSize, const uint32_t nodeCount);
         void stop();
         void add(RenderObject * ptr);
+        void nextFrame(std::vector<RenderObject *> & retired);
+        void flush(std::vector<RenderObject *> & retired);
 
     private:
 
-        std::atomic<bool>           m_running;
-        std::thread                 m_thread;
-        std::mutex                  m_mutex;
-        std::queue<RenderObject *>  m_objects;
-        float                       m_refreshTime;
-        float                       m_maxTime;
+        // Link of the pending list, pooled nodes are found on the free list by their index plus one.
+        struct RetiredObject
+        {
+            RenderObject *          pObject;
+            RetiredObject *         pNext;
+            std::atomic<uint32_t>   nextFree;
+            uint32_t                index;
+        };
+
+        RetiredObject * acquireNode();
+        void releaseNode(RetiredObject * node);
+        void takePending(std::vector<RenderObject *> & objects);
+        void releaseObjects(const size_t maxCount);
+
+        std::atomic<bool>                           m_running;
+        std::atomic<RetiredObject *>                m_pPending;
+        std::unique_ptr<RetiredObject[]>            m_nodes;
+        uint32_t                                    m_nodeCount;
+        std::atomic<uint64_t>                       m_freeNodes;
+        std::vector<RenderObject *>                 m_released;
+        size_t                                      m_maxBatchSize;
 
     };
 
@@ -0,0 +1,107 @@
+/*
+* MIT License
+*
+* Copyright(c) 2018 Jimmie Bergmann
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*/
+
+#ifndef FLARE_GRAPHICS_VULKAN_DESCRIPTOR_TABLE_HPP
+#define FLARE_GRAPHICS_VULKAN_DESCRIPTOR_TABLE_HPP
+
+#include "flare/build.hpp"
+
+#if defined(FLARE_VULKAN)
+
+#include "vulkan/vulkan.h"
+#include <mutex>
+#include <vector>
+
+namespace Flare
+{
+
+    // Global bindless descriptor set of all textures and storage buffers.
+    // Resources are added once and keep their index until removed, shaders index the arrays with values from push constants,
+    // so the set is bound once per command buffer instead of per draw.
+    // Built on descriptor indexing, descriptors are written while the set is bound to command buffers in flight.
+    // Removed indices must no longer be used by any frame in flight. All public methods are thread safe.
+    class FLARE_API VulkanDescriptorTable
+    {
+
+    public:
+
+        static const uint32_t InvalidIndex = 0xFFFFFFFF;
+        static const uint32_t TextureBinding = 0;
+        static const uint32_t BufferBinding = 1;
+
+        VulkanDescriptorTable();
+        ~VulkanDescriptorTable();
+
+        void load(VkPhysicalDevice physicalDevice, VkDevice logicalDevice, const uint32_t maxTextures, const uint32_t maxBuffers);
+        void unload();
+        bool isLoaded() const;
+
+        // Sampled as combined image sampler, with the table's linear repeating sampler.
+        uint32_t addTexture(VkImageView imageView);
+        uint32_t addBuffer(VkBuffer buffer, const VkDeviceSize offset, const VkDeviceSize range);
+
+        // Points an index at another image, keeping the index. Both images must stay valid while frames in flight may sample them.
+        void updateTexture(const uint32_t index, VkImageView imageView);
+        void removeTexture(const uint32_t index);
+        void removeBuffer(const uint32_t index);
+
+        VkDescriptorSetLayout getLayout() const;
+        VkDescriptorSet getDescriptorSet() const;
+        uint32_t getTextureCount() const;
+        uint32_t getBufferCount() const;
+
+    private:
+
+        VulkanDescriptorTable(const VulkanDescriptorTable &) = delete;
+
+        struct Slots
+        {
+            uint32_t                capacity;
+            uint32_t                next;
+            uint32_t                count;
+            std::vector<uint32_t>   free;
+        };
+
+        void writeTexture(const uint32_t index, VkImageView imageView);
+
+        static uint32_t allocateSlot(Slots & slots);
+        static void freeSlot(Slots & slots, const uint32_t index);
+
+        VkDevice                m_logicalDevice;
+        VkDescriptorSetLayout   m_layout;
+        VkDescriptorPool        m_pool;
+        VkDescriptorSet         m_descriptorSet;
+        VkSampler               m_sampler;
+        Slots                   m_textures;
+        Slots                   m_buffers;
+        mutable std::mutex      m_mutex;
+
+    };
+
+}
+
+#endif
+
+#endif
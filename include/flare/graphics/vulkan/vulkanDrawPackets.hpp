@@ -0,0 +1,152 @@
+/*
+* MIT License
+*
+* Copyright(c) 2018 Jimmie Bergmann
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*/
+
+#ifndef FLARE_GRAPHICS_VULKAN_DRAW_PACKETS_HPP
+#define FLARE_GRAPHICS_VULKAN_DRAW_PACKETS_HPP
+
+#include "flare/build.hpp"
+
+#if defined(FLARE_VULKAN)
+
+#include "flare/math/vector.hpp"
+#include "vulkan/vulkan.h"
+#include "vulkanMemoryAllocator.hpp"
+#include <mutex>
+#include <vector>
+
+namespace Flare
+{
+
+    class JobSystem;
+    class VulkanDescriptorTable;
+    class VulkanFrame;
+    class VulkanUploader;
+
+    // Meshes merged into one shared vertex and index buffer, drawn with indirect multi-draw.
+    // The vertex buffer is registered in the descriptor table and read by vertex pulling, so all packets share one pipeline
+    // without vertex input state. Instances are culled against the view frustum on the CPU every frame,
+    // the visible ones are compacted into an array of VkDrawIndexedIndirectCommand in frame memory.
+    // The compaction is written so it can be moved to a compute pass later, reading the same instance layout.
+    // Meshes may be added from any thread, everything else is called from the render thread.
+    class FLARE_API VulkanDrawPackets
+    {
+
+    public:
+
+        static const uint32_t InvalidMesh = 0xFFFFFFFF;
+
+        struct Mesh
+        {
+            uint32_t    firstIndex;
+            uint32_t    indexCount;
+            int32_t     vertexOffset;
+            Vector4f    bounds;
+        };
+
+        // Bounds are a world space sphere, center in xyz and radius in w.
+        // The first instance is passed on to the shader, usually indexing per instance data.
+        struct Instance
+        {
+            Vector4f    bounds;
+            uint32_t    mesh;
+            uint32_t    firstInstance;
+        };
+
+        struct Statistics
+        {
+            size_t      instances;
+            size_t      visibleInstances;
+            size_t      culledInstances;
+            size_t      indirectCalls;
+        };
+
+        VulkanDrawPackets();
+        ~VulkanDrawPackets();
+
+        // Multi-draw and first instance of indirect draws are used if enabled in the device features.
+        void load(VkDevice logicalDevice, const VkPhysicalDeviceFeatures & features, VulkanMemoryAllocator & memoryAllocator,
+                  VulkanUploader & uploader, VulkanDescriptorTable & descriptorTable, const uint32_t graphicsFamily,
+                  const uint32_t vertexStride, const uint32_t maxVertices, const uint32_t maxIndices);
+        void unload();
+
+        // Vertices are tightly packed with the stride given to load(), bounds are an object space sphere.
+        uint32_t addMesh(const void * vertices, const uint32_t vertexCount, const uint32_t * indices, const uint32_t indexCount,
+                         const Vector4f & bounds);
+        Mesh getMesh(const uint32_t mesh) const;
+
+        // Instances are kept between frames until cleared. Throws if the instance's mesh has not been added.
+        void clear();
+        void add(const Instance & instance);
+        void setFrustum(const Vector4f planes[6]);
+
+        // Culls and compacts the instances into frame memory, called after the frame has been reset.
+        void build(VulkanFrame & frame, JobSystem & jobSystem);
+        void record(VkCommandBuffer commandBuffer);
+
+        uint32_t getVertexBufferIndex() const;
+        size_t getInstanceCount() const;
+        const Statistics & getStatistics() const;
+
+    private:
+
+        VulkanDrawPackets(const VulkanDrawPackets &) = delete;
+
+        static const size_t CullChunkSize = 1024;
+
+        bool isVisible(const Vector4f & bounds) const;
+
+        VkDevice                    m_logicalDevice;
+        VulkanMemoryAllocator *     m_pMemoryAllocator;
+        VulkanUploader *            m_pUploader;
+        VulkanDescriptorTable *     m_pDescriptorTable;
+        bool                        m_multiDrawIndirect;
+        bool                        m_drawIndirectFirstInstance;
+        uint32_t                    m_vertexStride;
+        uint32_t                    m_maxVertices;
+        uint32_t                    m_maxIndices;
+        VkBuffer                    m_vertexBuffer;
+        VkBuffer                    m_indexBuffer;
+        VulkanMemoryAllocator::Allocation m_vertexMemory;
+        VulkanMemoryAllocator::Allocation m_indexMemory;
+        uint32_t                    m_vertexBufferIndex;
+        uint32_t                    m_vertexCount;
+        uint32_t                    m_indexCount;
+        std::vector<Mesh>           m_meshes;
+        mutable std::mutex          m_meshMutex;
+        std::vector<Instance>       m_instances;
+        Vector4f                    m_frustum[6];
+        std::vector<uint32_t>       m_chunkOffsets;
+        std::vector<VkDrawIndexedIndirectCommand> m_commands;
+        VkBuffer                    m_indirectBuffer;
+        VkDeviceSize                m_indirectOffset;
+        Statistics                  m_statistics;
+
+    };
+
+}
+
+#endif
+
+#endif
@@ -0,0 +1,120 @@
+/*
+* MIT License
+*
+* Copyright(c) 2018 Jimmie Bergmann
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*/
+
+#ifndef FLARE_GRAPHICS_VULKAN_FRAME_HPP
+#define FLARE_GRAPHICS_VULKAN_FRAME_HPP
+
+#include "flare/build.hpp"
+
+#if defined(FLARE_VULKAN)
+
+#include "flare/graphics/renderer.hpp"
+#include "vulkan/vulkan.h"
+#include "vulkanMemoryAllocator.hpp"
+#include <vector>
+
+namespace Flare
+{
+
+    // Resources of a single frame in flight.
+    // Nothing owned by a frame may be touched by the host before wait() has returned,
+    // after which reset() recycles the command pools, descriptor pool and uniform ring in one go.
+    // Secondary command buffers are allocated from one pool per worker, so workers record without locking.
+    class FLARE_API VulkanFrame
+    {
+
+    public:
+
+        VulkanFrame();
+        ~VulkanFrame();
+
+        void load(VkPhysicalDevice physicalDevice, VkDevice logicalDevice, VulkanMemoryAllocator & memoryAllocator,
+                  const uint32_t queueFamily, const VkDeviceSize uniformBufferSize, const size_t workerCount);
+        void unload();
+
+        void wait();
+        void reset();
+
+        void * allocateUniform(const VkDeviceSize size, VkDeviceSize & offset);
+
+        // Indirect draw commands of the frame, written from the start of the buffer.
+        // The buffer grows to the largest size reserved so far, only while the frame is not in flight.
+        void * reserveIndirect(const VkDeviceSize size, VkBuffer & buffer);
+        VkCommandBuffer allocateSecondaryCommandBuffer(const size_t workerIndex);
+
+        VkCommandPool getCommandPool() const;
+        VkCommandBuffer getCommandBuffer() const;
+        VkSemaphore getImageAvailableSemaphore() const;
+        VkSemaphore getRenderFinishedSemaphore() const;
+        VkFence getInFlightFence() const;
+        VkDescriptorPool getDescriptorPool() const;
+        VkBuffer getUniformBuffer() const;
+        std::vector<RenderObject *> & getRetired();
+        std::vector<VkSemaphore> & getUploadSemaphores();
+
+    private:
+
+        VulkanFrame(const VulkanFrame &) = delete;
+
+        struct alignas(64) WorkerCommands
+        {
+            WorkerCommands();
+
+            VkCommandPool                   commandPool;
+            std::vector<VkCommandBuffer>    commandBuffers;
+            size_t                          usedCount;
+        };
+
+        void loadCreateUniformBuffer(VkPhysicalDevice physicalDevice, const VkDeviceSize size);
+        void unloadIndirectBuffer();
+
+        VkDevice                    m_logicalDevice;
+        VulkanMemoryAllocator *     m_pMemoryAllocator;
+        VkCommandPool               m_commandPool;
+        VkCommandBuffer             m_commandBuffer;
+        VkSemaphore                 m_imageAvailableSemaphore;
+        VkSemaphore                 m_renderFinishedSemaphore;
+        VkFence                     m_inFlightFence;
+        VkDescriptorPool            m_descriptorPool;
+        VkBuffer                    m_uniformBuffer;
+        VulkanMemoryAllocator::Allocation m_uniformMemory;
+        uint8_t *                   m_pUniformData;
+        VkDeviceSize                m_uniformSize;
+        VkDeviceSize                m_uniformOffset;
+        VkDeviceSize                m_uniformAlignment;
+        VkBuffer                    m_indirectBuffer;
+        VulkanMemoryAllocator::Allocation m_indirectMemory;
+        VkDeviceSize                m_indirectSize;
+        std::vector<WorkerCommands> m_workerCommands;
+        std::vector<RenderObject *> m_retired;
+        std::vector<VkSemaphore>    m_uploadSemaphores;
+
+    };
+
+}
+
+#endif
+
+#endif
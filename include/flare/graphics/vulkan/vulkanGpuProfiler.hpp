@@ -0,0 +1,109 @@
+/*
+* MIT License
+*
+* Copyright(c) 2018 Jimmie Bergmann
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*/
+
+#ifndef FLARE_GRAPHICS_VULKAN_GPU_PROFILER_HPP
+#define FLARE_GRAPHICS_VULKAN_GPU_PROFILER_HPP
+
+#include "flare/graphics/renderer.hpp"
+
+#if defined(FLARE_VULKAN)
+
+#include "vulkan/vulkan.h"
+#include <string>
+#include <vector>
+
+namespace Flare
+{
+
+    // Timestamp queries around named, nested scopes of a frame's command buffer.
+    // Every frame in flight owns a query pool, the results of a frame are read back when its slot is reused,
+    // after the frame fence has signaled, so reading them never stalls.
+    // Not thread safe, scopes are written from the thread recording the primary command buffer.
+    class FLARE_API VulkanGpuProfiler
+    {
+
+    public:
+
+        VulkanGpuProfiler();
+        ~VulkanGpuProfiler();
+
+        void load(VkPhysicalDevice physicalDevice, VkDevice logicalDevice, const uint32_t queueFamily,
+                  const size_t frameCount, const uint32_t maxScopes);
+        void unload();
+
+        // Must be called after the frame has been waited for, outside of any render pass.
+        void beginFrame(VkCommandBuffer commandBuffer, const size_t frameIndex);
+
+        void beginScope(VkCommandBuffer commandBuffer, const std::string & name);
+        void endScope(VkCommandBuffer commandBuffer);
+
+        bool getLatestProfile(GpuFrameProfile & profile) const;
+        bool isEnabled() const;
+
+    private:
+
+        VulkanGpuProfiler(const VulkanGpuProfiler &) = delete;
+
+        static const uint32_t InvalidScope = 0xFFFFFFFF;
+
+        struct Scope
+        {
+            std::string name;
+            uint32_t    parent;
+        };
+
+        struct FrameQueries
+        {
+            FrameQueries();
+
+            VkQueryPool             queryPool;
+            std::vector<Scope>      scopes;
+            std::vector<uint32_t>   stack;
+            uint64_t                frame;
+        };
+
+        void resolve(FrameQueries & frameQueries);
+        GpuProfileScope buildScope(const FrameQueries & frameQueries, const uint32_t index,
+                                   const std::vector<std::vector<uint32_t> > & children,
+                                   const std::vector<uint64_t> & timestamps, const uint64_t frameStart) const;
+        double toMilliseconds(const uint64_t begin, const uint64_t end) const;
+
+        VkDevice                    m_logicalDevice;
+        uint32_t                    m_maxScopes;
+        uint64_t                    m_timestampMask;
+        double                      m_timestampPeriod;
+        uint64_t                    m_frameCounter;
+        FrameQueries *              m_pCurrentFrame;
+        std::vector<FrameQueries>   m_frames;
+        GpuFrameProfile             m_latestProfile;
+        bool                        m_hasProfile;
+
+    };
+
+}
+
+#endif
+
+#endif
@@ -0,0 +1,132 @@
+/*
+* MIT License
+*
+* Copyright(c) 2018 Jimmie Bergmann
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*/
+
+#ifndef FLARE_GRAPHICS_VULKAN_MEMORY_ALLOCATOR_HPP
+#define FLARE_GRAPHICS_VULKAN_MEMORY_ALLOCATOR_HPP
+
+#include "flare/graphics/renderer.hpp"
+
+#if defined(FLARE_VULKAN)
+
+#include "vulkan/vulkan.h"
+#include "flare/system/tlsfAllocator.hpp"
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace Flare
+{
+
+    // Sub-allocates device memory from large pages, one set of pages per memory type and resource type.
+    // Linear resources (buffers) and optimal resources (optimal tiling images) never share a page,
+    // which keeps neighbouring allocations apart by at least bufferImageGranularity.
+    // Requests larger than half a page get a dedicated allocation.
+    // Host visible pages are persistently mapped. All public methods are thread safe.
+    class FLARE_API VulkanMemoryAllocator
+    {
+
+    public:
+
+        enum class ResourceType
+        {
+            Linear,
+            Optimal
+        };
+
+        struct Allocation
+        {
+            Allocation();
+
+            VkDeviceMemory  memory;
+            VkDeviceSize    offset;
+            VkDeviceSize    size;
+            uint8_t *       pMappedData;
+            uint32_t        pool;
+            uint32_t        page;
+            uint32_t        block;
+        };
+
+        struct Statistics
+        {
+            VkDeviceSize    reservedSize;
+            VkDeviceSize    usedSize;
+            size_t          pageCount;
+            size_t          allocationCount;
+            size_t          dedicatedAllocationCount;
+        };
+
+        VulkanMemoryAllocator();
+        ~VulkanMemoryAllocator();
+
+        void load(VkPhysicalDevice physicalDevice, VkDevice logicalDevice, const VkDeviceSize pageSize, RenderMemoryAllocator & memory);
+        void unload();
+
+        Allocation allocate(const VkMemoryRequirements & requirements, const VkMemoryPropertyFlags properties, const ResourceType resourceType);
+        Allocation allocate(VkBuffer buffer, const VkMemoryPropertyFlags properties);
+        Allocation allocate(VkImage image, const VkMemoryPropertyFlags properties);
+        void free(Allocation & allocation);
+
+        Statistics getStatistics() const;
+
+    private:
+
+        VulkanMemoryAllocator(const VulkanMemoryAllocator &) = delete;
+
+        struct Page
+        {
+            VkDeviceMemory  memory;
+            uint8_t *       pMappedData;
+            TlsfAllocator   allocator;
+        };
+
+        struct Pool
+        {
+            std::vector<std::unique_ptr<Page>> pages;
+            std::vector<uint32_t>              freePages;
+        };
+
+        bool allocateFromPool(const uint32_t poolIndex, const VkMemoryRequirements & requirements, Allocation & allocation);
+        bool allocateDedicated(const uint32_t memoryType, const VkMemoryRequirements & requirements, Allocation & allocation);
+        bool allocateMemory(const uint32_t memoryType, const VkDeviceSize size, VkDeviceMemory & memory, uint8_t * & pMappedData);
+        void freeMemory(const VkDeviceSize size, VkDeviceMemory memory);
+        void freePage(Pool & pool, const uint32_t pageIndex);
+
+        mutable std::mutex                  m_mutex;
+        VkDevice                            m_logicalDevice;
+        VkPhysicalDeviceMemoryProperties    m_memoryProperties;
+        VkDeviceSize                        m_pageSize;
+        RenderMemoryAllocator *             m_pMemory;
+        std::vector<Pool>                   m_pools;
+        std::unordered_map<VkDeviceMemory, VkDeviceSize> m_dedicated;
+        Statistics                          m_statistics;
+
+    };
+
+}
+
+#endif
+
+#endif
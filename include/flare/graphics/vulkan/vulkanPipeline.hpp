@@ -0,0 +1,133 @@
+/*
+* MIT License
+*
+* Copyright(c) 2018 Jimmie Bergmann
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*/
+
+#ifndef FLARE_GRAPHICS_VULKAN_PIPELINE_HPP
+#define FLARE_GRAPHICS_VULKAN_PIPELINE_HPP
+
+#include "flare/graphics/pipeline.hpp"
+
+#if defined(FLARE_VULKAN)
+
+#include "vulkan/vulkan.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace Flare
+{
+
+    class VulkanRenderer;
+    class VulkanPipeline;
+
+    // Dedicated thread building pipelines one at a time, owned by the renderer.
+    // Builds stay off the job system, so frame loop waits and parallel loops never pick up a long compile.
+    // Queued builds are finished before stop() returns.
+    class FLARE_API VulkanPipelineBuilder
+    {
+
+    public:
+
+        VulkanPipelineBuilder();
+        ~VulkanPipelineBuilder();
+
+        void start();
+        void stop();
+
+        // Returns false if the builder is not running.
+        bool add(VulkanPipeline * pipeline);
+
+    private:
+
+        VulkanPipelineBuilder(const VulkanPipelineBuilder &) = delete;
+
+        void run();
+
+        std::thread                     m_thread;
+        std::mutex                      m_mutex;
+        std::condition_variable         m_condition;
+        std::deque<VulkanPipeline *>    m_queue;
+        bool                            m_running;
+
+    };
+
+    // Graphics pipeline built on the renderer's pipeline builder, for the main pass of the render graph.
+    // load() and rebuild() never block, a request made during a build is queued and only the newest one is kept.
+    // A finished build is swapped in by the render thread, the replaced pipeline is retired through the cleaner.
+    class FLARE_API VulkanPipeline : public Pipeline
+    {
+
+    public:
+
+        ~VulkanPipeline();
+
+        virtual void load(const std::string & vertexShader, const std::string & fragmentShader);
+        virtual void unload();
+        virtual void wait();
+        virtual Status getStatus() const;
+        virtual std::string getError() const;
+
+        // Pipeline to draw with, null until the first build is ready. Render thread only.
+        VkPipeline update();
+
+    private:
+
+        VulkanPipeline(VulkanRenderer & renderer);
+        VulkanPipeline(const VulkanPipeline &) = delete;
+
+        void rebuild();
+        void request();
+        void build();
+        VkPipeline createPipeline(const std::string & vertexShader, const std::string & fragmentShader,
+                                  const VkRenderPass renderPass, const uint32_t subpass);
+        VkShaderModule createShaderModule(const std::string & filename);
+        void retire(const VkPipeline pipeline);
+
+        VulkanRenderer &        m_vulkanRenderer;
+        std::string             m_vertexShader;
+        std::string             m_fragmentShader;
+        VkRenderPass            m_renderPass;
+        uint32_t                m_subpass;
+        VkPipeline              m_pipeline;
+        VkPipeline              m_pendingPipeline;
+        std::atomic<Status>     m_status;
+        bool                    m_building;
+        uint64_t                m_revision;
+        std::string             m_error;
+        mutable std::mutex      m_mutex;
+        std::condition_variable m_condition;
+
+        friend class VulkanRenderer;
+        friend class VulkanPipelineBuilder;
+
+    };
+
+}
+
+#endif
+
+#endif
@@ -0,0 +1,166 @@
+/*
+* MIT License
+*
+* Copyright(c) 2018 Jimmie Bergmann
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*/
+
+#ifndef FLARE_GRAPHICS_VULKAN_RENDER_GRAPH_HPP
+#define FLARE_GRAPHICS_VULKAN_RENDER_GRAPH_HPP
+
+#include "flare/graphics/renderGraph.hpp"
+
+#if defined(FLARE_VULKAN)
+
+#include "vulkan/vulkan.h"
+#include "vulkanMemoryAllocator.hpp"
+#include "vulkanGpuProfiler.hpp"
+#include <vector>
+
+namespace Flare
+{
+
+    class VulkanRenderGraph;
+
+    class FLARE_API VulkanRenderGraphContext : public RenderGraphContext
+    {
+
+    public:
+
+        virtual Vector2ui32 getExtent() const;
+
+        VkCommandBuffer getCommandBuffer() const;
+        VkRenderPass getRenderPass() const;
+        uint32_t getSubpass() const;
+        VkFramebuffer getFramebuffer() const;
+        uint32_t getImageIndex() const;
+        VkImageView getImageView(const RenderGraphResource resource) const;
+
+        // Called from Subpass::prepare, the subpass is then recorded from these instead of calling Subpass::execute.
+        void setSecondaryCommandBuffers(const std::vector<VkCommandBuffer> & commandBuffers);
+
+    private:
+
+        VulkanRenderGraphContext(const VulkanRenderGraph & graph, VkCommandBuffer commandBuffer, const uint32_t imageIndex);
+        VulkanRenderGraphContext(const VulkanRenderGraphContext &) = delete;
+
+        const VulkanRenderGraph &       m_graph;
+        VkCommandBuffer                 m_commandBuffer;
+        VkRenderPass                    m_renderPass;
+        uint32_t                        m_subpass;
+        VkFramebuffer                   m_framebuffer;
+        VkExtent2D                      m_extent;
+        uint32_t                        m_imageIndex;
+        std::vector<VkCommandBuffer> *  m_pSecondaryCommandBuffers;
+
+        friend class VulkanRenderGraph;
+
+    };
+
+    // Vulkan objects of a compiled render graph.
+    // Every batch becomes a render pass with one subpass per pass, dependencies within a batch become subpass dependencies,
+    // all others are recorded as a single pipeline barrier in front of the render pass.
+    // Transient attachments are placed in one memory allocation, resources with disjoint lifetimes share memory.
+    class FLARE_API VulkanRenderGraph
+    {
+
+    public:
+
+        VulkanRenderGraph();
+        ~VulkanRenderGraph();
+
+        void load(VkDevice logicalDevice, VulkanMemoryAllocator & memoryAllocator, const RenderGraph & graph,
+                  const VkFormat backbufferFormat, const VkExtent2D extent,
+                  const std::vector<VkImage> & backbufferImages, const std::vector<VkImageView> & backbufferViews,
+                  const VkImageLayout backbufferLayout);
+        void unload();
+
+        void record(VkCommandBuffer commandBuffer, const uint32_t imageIndex, VulkanGpuProfiler & profiler);
+
+        VkRenderPass getRenderPass(const uint32_t pass) const;
+        uint32_t getSubpass(const uint32_t pass) const;
+        VkDeviceSize getTransientMemorySize() const;
+
+    private:
+
+        VulkanRenderGraph(const VulkanRenderGraph &) = delete;
+
+        struct Image
+        {
+            VkImage                 image;
+            VkImageView             imageView;
+            VkFormat                format;
+            VkImageAspectFlags      aspect;
+            VkMemoryRequirements    requirements;
+            VkDeviceSize            offset;
+        };
+
+        struct ImageBarrier
+        {
+            RenderGraphResource     resource;
+            VkImageLayout           oldLayout;
+            VkImageLayout           newLayout;
+            VkPipelineStageFlags    srcStage;
+            VkAccessFlags           srcAccess;
+            VkPipelineStageFlags    dstStage;
+            VkAccessFlags           dstAccess;
+        };
+
+        struct RenderPass
+        {
+            VkRenderPass                renderPass;
+            std::vector<VkFramebuffer>  framebuffers;
+            std::vector<VkClearValue>   clearValues;
+            std::vector<ImageBarrier>   barriers;
+            VkExtent2D                  extent;
+            std::string                 name;
+        };
+
+        VkExtent2D getExtent(const RenderGraphResource resource) const;
+        void loadCreateImages();
+        void loadAliasMemory();
+        void loadCreateRenderPass(const uint32_t batch);
+        VkImageLayout getLayout(const RenderGraphResource resource, const RenderGraphAccess access) const;
+        bool isDepth(const RenderGraphResource resource) const;
+
+        VkDevice                    m_logicalDevice;
+        VulkanMemoryAllocator *     m_pMemoryAllocator;
+        const RenderGraph *         m_pGraph;
+        VkFormat                    m_backbufferFormat;
+        VkExtent2D                  m_extent;
+        std::vector<VkImage>        m_backbufferImages;
+        std::vector<VkImageView>    m_backbufferViews;
+        VkImageLayout               m_backbufferLayout;
+        std::vector<Image>          m_images;
+        VulkanMemoryAllocator::Allocation m_memory;
+        VkDeviceSize                m_memorySize;
+        std::vector<RenderPass>     m_renderPasses;
+        std::vector<uint32_t>       m_subpasses;
+
+        friend class VulkanRenderGraphContext;
+
+    };
+
+}
+
+#endif
+
+#endif
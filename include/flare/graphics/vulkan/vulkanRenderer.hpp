@@ -27,6 +27,8 @@
 #define FLARE_GRAPHICS_RENDERERS_VULKAN_RENDERER_HPP
 
 #include "flare/graphics/renderer.hpp"
+#include "flare/graphics/renderQueue.hpp"
+#include "flare/graphics/texture.hpp"
 
 #if defined(FLARE_VULKAN)
 
@@ -35,8 +37,23 @@
 #include "vulkan/vulkan_win32.h"
 #endif
 #include "vulkanCleaner.hpp"
+#include "vulkanDescriptorTable.hpp"
+#include "vulkanDrawPackets.hpp"
+#include "vulkanFrame.hpp"
+#include "vulkanGpuProfiler.hpp"
+#include "vulkanMemoryAllocator.hpp"
+#include "vulkanPipeline.hpp"
+#include "vulkanRenderGraph.hpp"
+#include "vulkanTextureStreamer.hpp"
+#include "vulkanUploader.hpp"
+#include "flare/system/jobSystem.hpp"
 #include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <set>
+#include <unordered_map>
 #include <vector>
 #include <optional>
 
@@ -61,8 +78,41 @@ namespace Flare
 
         virtual const RenderMemoryAllocator & memory() const;
 
+        virtual bool getGpuProfile(GpuFrameProfile & profile) const;
+
         virtual std::shared_ptr<Texture> createTexture();
         virtual std::shared_ptr<Pipeline> createPipeline();
+        virtual void setPipeline(const std::shared_ptr<Pipeline> & pipeline);
+
+        virtual void readFrame(std::vector<uint8_t> & pixels, Vector2ui32 & size);
+
+        virtual void waitForInput();
+        virtual const RenderLatency & getLatency() const;
+
+        virtual const DrawStatistics & getDrawStatistics() const;
+
+        virtual FramePacer & getFramePacer();
+
+        virtual Multipass & getMultipass();
+
+        // Bindless table of all textures and buffers, only loaded if the device supports descriptor indexing.
+        VulkanDescriptorTable & getDescriptorTable();
+
+        // Meshes drawn with indirect multi-draw by the main pipeline, requires the descriptor table for vertex pulling.
+        VulkanDrawPackets & getDrawPackets();
+
+        // Mip residency of loaded textures, disabled until a budget is set.
+        VulkanTextureStreamer & getTextureStreamer();
+
+        // Draw of the main pipeline recorded in the next frame, may be called from any thread.
+        // Indices are descriptor table indices pushed as constants, depth orders draws of the same state front to back.
+        void draw(const uint32_t vertexCount, const uint32_t instanceCount, const uint32_t textureIndex, const uint32_t bufferIndex,
+                  VkBuffer vertexBuffer = VK_NULL_HANDLE, const float depth = 0.0f);
+
+        // Format textures of the given pixel format are stored in, negotiated with the device at load.
+        Texture::PixelFormat getTextureFormat(const Texture::PixelFormat pixelFormat) const;
+
+        static uint32_t findMemoryType(VkPhysicalDevice physicalDevice, const uint32_t typeFilter, const VkMemoryPropertyFlags properties);
 
     private:
 
@@ -71,18 +121,79 @@ namespace Flare
         struct VulkanGraphicDevice
         {
             VulkanGraphicDevice();
-            bool isSuitable() const;
+            bool isSuitable(const bool headless) const;
 
             VkPhysicalDevice                physicalDevice;
             VkDevice                        logicalDevice;
             std::optional<uint32_t>         graphicsFamily;
             std::optional<uint32_t>         presentFamily;
+            std::optional<uint32_t>         transferFamily;
             bool                            hasDeviceExtensionSupport;
+            bool                            hasDescriptorIndexing;
+            VkPhysicalDeviceFeatures        enabledFeatures;
             VkSurfaceCapabilitiesKHR        surfaceCapabilities;
             std::vector<VkSurfaceFormatKHR> surfaceFormats;
             std::vector<VkPresentModeKHR>   presentModes;
         };
 
+        // Built-in pass drawing the draw list into the backbuffer.
+        class MainSubpass : public Subpass
+        {
+
+        public:
+
+            MainSubpass(VulkanRenderer & renderer);
+
+            virtual void load(Renderer & renderer);
+            virtual void setup(RenderGraphBuilder & builder);
+            virtual void prepare(RenderGraphContext & context);
+            virtual void execute(RenderGraphContext & context);
+
+        private:
+
+            VulkanRenderer & m_renderer;
+
+        };
+
+        // Swap chain resources replaced on recreation, destroyed by the cleaner once no frame in flight uses them.
+        class RetiredSwapChain : public RenderObject
+        {
+
+        public:
+
+            RetiredSwapChain(VkDevice logicalDevice, VulkanMemoryAllocator & memoryAllocator);
+            ~RetiredSwapChain();
+
+            VkDevice                            logicalDevice;
+            VulkanMemoryAllocator &             memoryAllocator;
+            VkSwapchainKHR                      swapChain;
+            std::vector<VkImage>                offscreenImages;
+            std::vector<VulkanMemoryAllocator::Allocation> offscreenMemory;
+            std::vector<VkImageView>            imageViews;
+            std::unique_ptr<VulkanRenderGraph>  renderGraph;
+
+        };
+
+        // Push constants of a draw, indices into the descriptor table.
+        struct DrawConstants
+        {
+            uint32_t    textureIndex;
+            uint32_t    bufferIndex;
+        };
+
+        // Depth is normalized view depth, only used for ordering draws of the same state front to back.
+        struct DrawCommand
+        {
+            VkPipeline      pipeline;
+            uint32_t        vertexCount;
+            uint32_t        instanceCount;
+            uint32_t        firstVertex;
+            uint32_t        firstInstance;
+            DrawConstants   constants;
+            VkBuffer        vertexBuffer;
+            float           depth;
+        };
+
         #if defined(FLARE_PLATFORM_WINDOWS)
         void getHWndHInstance(HWND & hWnd, HINSTANCE & hInstance);
         #endif
@@ -96,24 +207,36 @@ namespace Flare
         void loadCreateSurface();
         void loadQuerySwapChainSupport(VulkanGraphicDevice & graphicDevice, VkPhysicalDevice physicalDevice);
         void loadGraphicDevice(VulkanGraphicDevice & graphicDevice, VkPhysicalDevice physicalDevice);
+        const std::vector<const char *> & getDeviceExtensions() const;
         void loadScorePhysicalDevice(VkPhysicalDevice physicalDevice, uint32_t & score);
         void loadPickPhysicalDevice();
         void loadCreateLogicalDevice();
+        void loadNegotiateTextureFormats();
+        void loadCreatePipelineCache();
         void loadChooseSwapSurfaceFormat();
         void loadChooseSwapPresentMode();
         void loadChooseSwapExtent();
-        void loadCreateSwapChain();
+        void loadCreateSwapChain(VkSwapchainKHR oldSwapChain);
+        void loadCreateOffscreenImages();
         void loadCreateImageViews();
-        void loadCreateRenderPass();
+        void loadCreateRenderGraph();
+        void loadCreatePipelineLayout();
         void loadCreateGraphicsPipeline();
-        void loadCreateShaderModule(const std::vector<char> & code, VkShaderModule & shaderModule) const;
-        void loadCreateFramebuffers();
-        void loadCreateCommandPool();
-        void loadCreateCommandBuffers();
+        void loadCreateFrames();
         void loadDrawFrame();
-        void loadCreateSyncObjects();
+        void loadDecodedTextures();
+        void loadUpdateDrawCommands();
+        void loadSortDrawCommands();
+        void recordCommandBuffer(VulkanFrame & frame, const uint32_t imageIndex);
+        void recordSecondaryCommandBuffers(VulkanFrame & frame, const VulkanRenderGraphContext & context, std::vector<VkCommandBuffer> & commandBuffers);
+        void recordDrawCommands(VkCommandBuffer commandBuffer, const Vector2ui32 & extent, const size_t begin, const size_t end,
+                                DrawStatistics & statistics) const;
+        void recordDrawPackets(VkCommandBuffer commandBuffer, DrawStatistics & statistics);
 
         void unloadSwapChain();
+        void retireSwapChain(RetiredSwapChain & retired);
+        void unloadPipelineCache();
+        void unloadReadback();
         void recreateSwapChain();
 
         // Vulkan structures.
@@ -123,28 +246,70 @@ namespace Flare
         VulkanGraphicDevice         m_graphicDevice;
         VkQueue                     m_graphicQueue;
         VkQueue                     m_presentQueue;
+        VkQueue                     m_transferQueue;
+        std::mutex                  m_queueMutex;
         VkSwapchainKHR              m_swapChain;
+        bool                        m_swapChainOutdated;
         VkExtent2D                  m_swapChainExtent;
         VkSurfaceFormatKHR          m_swapChainSurfaceFormat;
         VkPresentModeKHR            m_swapChainPresentMode;
         std::vector<VkImage>        m_swapChainImages;
         std::vector<VkImageView>    m_swapChainImageViews;
+        std::vector<VulkanMemoryAllocator::Allocation> m_offscreenMemory;
+        uint32_t                    m_lastImageIndex;
+        bool                        m_hasRenderedImage;
+        VkCommandPool               m_readbackCommandPool;
+        VkCommandBuffer             m_readbackCommandBuffer;
+        VkFence                     m_readbackFence;
+        VkPipelineCache             m_pipelineCache;
+        Multipass                   m_multipass;
+        MainSubpass                 m_mainSubpass;
+        uint64_t                    m_multipassRevision;
+        RenderGraph                 m_renderGraph;
+        std::unique_ptr<VulkanRenderGraph> m_vulkanRenderGraph;
         VkRenderPass                m_renderPass;
+        uint32_t                    m_subpass;
         VkPipelineLayout            m_pipelineLayout;
-        VkPipeline                  m_graphicsPipeline;
-        std::vector<VkFramebuffer>  m_swapChainFramebuffers;
-        VkCommandPool               m_commandPool;
-        std::vector<VkCommandBuffer> m_commandBuffers;
-        std::vector<VkSemaphore>    m_imageAvailableSemaphores;
-        std::vector<VkSemaphore>    m_renderFinishedSemaphores;
-        std::vector<VkFence>        m_inFlightFences;
+        std::shared_ptr<VulkanPipeline> m_fallbackPipeline;
+        std::shared_ptr<VulkanPipeline> m_pipeline;
+        VkPipeline                  m_packetPipeline;
+        std::vector<std::unique_ptr<VulkanFrame>> m_frames;
+        std::vector<VkFence>        m_imagesInFlight;
         size_t                      m_currentFrame;
+        std::mutex                  m_decodedTextureMutex;
+        std::vector<VulkanTexture *> m_decodedTextures;
+        std::mutex                  m_submittedDrawMutex;
+        std::vector<DrawCommand>    m_submittedDraws;
+        std::vector<DrawCommand>    m_drawCommands;
+        std::vector<DrawCommand>    m_sortedDrawCommands;
+        RenderQueue                 m_renderQueue;
+        std::unordered_map<VkPipeline, uint32_t> m_sortPipelineIds;
+        std::map<std::pair<VkBuffer, uint32_t>, uint32_t> m_sortMeshIds;
+        std::chrono::steady_clock::time_point m_inputTime;
+        bool                        m_hasInputTime;
+        RenderLatency               m_latency;
+        DrawStatistics              m_drawStatistics;
 
         RenderMemoryAllocator   m_memory;
+        VulkanMemoryAllocator   m_memoryAllocator;
         VulkanCleaner           m_cleaner;
+        VulkanPipelineBuilder   m_pipelineBuilder;
+        VulkanDescriptorTable   m_descriptorTable;
+        VulkanUploader          m_uploader;
+        VulkanDrawPackets       m_drawPackets;
+        VulkanTextureStreamer   m_textureStreamer;
+        VulkanGpuProfiler       m_gpuProfiler;
+        FramePacer              m_framePacer;
         RendererSettings        m_settings;
+        JobSystem *             m_pJobSystem;
+        std::unique_ptr<JobSystem> m_ownedJobSystem;
+        Texture::PixelFormat    m_textureFormats[6];
         bool                    m_loaded;
 
+        friend class VulkanTexture;
+        friend class VulkanTextureStreamer;
+        friend class VulkanPipeline;
+
     };
 
 }
@@ -30,6 +30,16 @@
 
 #if defined(FLARE_VULKAN)
 
+#include "flare/graphics/mipmapGenerator.hpp"
+#include "flare/system/jobSystem.hpp"
+#include "vulkan/vulkan.h"
+#include "vulkanMemoryAllocator.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+
 namespace Flare
 {
 
@@ -49,26 +59,100 @@ namespace Flare
 
         virtual void load(const std::string & filename, const bool storeBuffer = false);
 
+        // Decodes and writes the mip chain on the job system, the image is created and uploaded by the render thread.
+        virtual void loadAsync(const std::string & filename, const bool storeBuffer = false);
+
         virtual void unload();
 
+        virtual Status getStatus() const;
+
+        virtual std::string getError() const;
+
         virtual const uint8_t * getBuffer() const;
 
         virtual size_t getBufferSize() const;
 
         virtual PixelFormat getPixelFormat() const;
 
+        virtual PixelFormat getStorageFormat() const;
+
         virtual Vector2ui32 getSize() const;
 
+        // Index in the renderer's descriptor table, pushed by draws sampling the texture.
+        // Stays the same until the texture is unloaded, also when the resident levels of a streamed texture change.
+        uint32_t getDescriptorIndex() const;
+
+        // Loaded textures are streamed while the renderer's streamer is enabled, see VulkanTextureStreamer.
+        bool isStreamed() const;
+        uint32_t getResidentLevel() const;
+
     private:
 
-        VulkanTexture(RenderMemoryAllocator & allocator);
+        VulkanTexture(VulkanRenderer & renderer, RenderMemoryAllocator & allocator);
         VulkanTexture(const VulkanTexture &) = delete;
 
-        Vector2ui32 m_size;
-        PixelFormat m_pixelFormat;
-        uint8_t *   m_pBuffer;
+        // Image, view, memory and descriptor replaced by a change of residency, destroyed by the cleaner.
+        class RetiredImage : public RenderObject
+        {
+
+        public:
+
+            RetiredImage(VulkanRenderer & renderer);
+            ~RetiredImage();
+
+            VulkanRenderer &    renderer;
+            VkImage             image;
+            VulkanMemoryAllocator::Allocation memory;
+            VkImageView         imageView;
+            uint32_t            descriptorIndex;
+
+        };
+
+        static VkFormat getImageFormat(const PixelFormat pixelFormat);
+
+        void loadCreateImage();
+        void loadWriteChain(const uint8_t * pixels, uint8_t * chain, const std::vector<MipmapGenerator::Level> & levels) const;
+        void loadUploadChain(const uint8_t * chain, const std::vector<MipmapGenerator::Level> & levels);
+        void loadDecodeFile(const std::string & filename, const bool storeBuffer);
+        void loadDecodedChain();
+        void loadResidentLevel(const uint32_t level, const uint64_t replaceFrame);
+        void loadReplacedImage();
+        void unloadImage();
+
+        VulkanRenderer &    m_renderer;
+        Vector2ui32         m_size;
+        PixelFormat         m_pixelFormat;
+        PixelFormat         m_storageFormat;
+        uint8_t *           m_pBuffer;
+        uint32_t            m_mipLevels;
+        VkImage             m_image;
+        VulkanMemoryAllocator::Allocation m_memory;
+        VkImageView         m_imageView;
+        uint32_t            m_descriptorIndex;
+
+        // Streaming state, the first resident level is 0 for textures not streamed.
+        std::vector<uint8_t> m_streamChain;
+        std::vector<MipmapGenerator::Level> m_streamLevels;
+        uint32_t            m_residentLevel;
+        uint32_t            m_baseLevel;
+        uint32_t            m_wantedLevel;
+        uint64_t            m_lastRequestFrame;
+        std::atomic<uint32_t> m_requestedLevel;
+        RetiredImage *      m_pReplacedImage;
+        uint64_t            m_replaceFrame;
+
+        // Asynchronous load, a decoded chain waits in the renderer's queue until the render thread uploads it.
+        std::atomic<Status> m_status;
+        std::string         m_error;
+        mutable std::mutex  m_decodeMutex;
+        std::condition_variable m_decodeCondition;
+        bool                m_decoding;
+        Job *               m_pDecodeJob;
+        std::vector<uint8_t> m_decodedChain;
+        std::vector<MipmapGenerator::Level> m_decodedLevels;
 
         friend class VulkanRenderer;
+        friend class VulkanTextureStreamer;
 
     };
 
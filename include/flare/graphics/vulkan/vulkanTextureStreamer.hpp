@@ -0,0 +1,117 @@
+/*
+* MIT License
+*
+* Copyright(c) 2018 Jimmie Bergmann
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*/
+
+#ifndef FLARE_GRAPHICS_VULKAN_TEXTURE_STREAMER_HPP
+#define FLARE_GRAPHICS_VULKAN_TEXTURE_STREAMER_HPP
+
+#include "flare/build.hpp"
+
+#if defined(FLARE_VULKAN)
+
+#include <mutex>
+#include <vector>
+
+namespace Flare
+{
+
+    class VulkanTexture;
+
+    // Mip residency of streamed textures, kept within a device memory budget.
+    // Streamed textures keep their full mip chain in host memory and start with only the levels up to the base size resident.
+    // Draws report the screen space footprint of the textures they sample, once per frame update() turns the footprints
+    // into wanted levels, evicts levels of the least recently used textures while over budget
+    // and loads the levels of the most recently used ones, up to the upload limit per frame.
+    // Changing residency recreates the image of a texture. Its descriptor keeps the index and is pointed at the new image
+    // once the frame uploading it has finished.
+    // Streaming is disabled while the budget is 0, textures loaded meanwhile keep their full chain resident.
+    // requestFootprint() may be called from any thread, everything else is called from the render thread.
+    class FLARE_API VulkanTextureStreamer
+    {
+
+    public:
+
+        static const uint32_t NoRequest = 0xFFFFFFFF;
+
+        struct Statistics
+        {
+            size_t      textures;
+            size_t      residentBytes;
+            size_t      wantedBytes;
+            size_t      uploadedBytes;
+            size_t      loadedLevels;
+            size_t      evictedLevels;
+        };
+
+        VulkanTextureStreamer();
+        ~VulkanTextureStreamer();
+
+        // Base size is the largest side of the levels always resident, textures not requested for idle frames fall back to them.
+        void load(const uint32_t baseSize, const size_t uploadLimit, const uint64_t idleFrames, const uint64_t framesInFlight);
+        void unload();
+
+        void setBudget(const size_t bytes);
+        size_t getBudget() const;
+        bool isEnabled() const;
+
+        // Screen size is the number of pixels the largest side of the texture covers, see getScreenSize().
+        void requestFootprint(VulkanTexture & texture, const float screenSize);
+
+        // Projected diameter in pixels of a bounding sphere, with the vertical field of view in radians.
+        static float getScreenSize(const float radius, const float distance, const float verticalFov, const uint32_t viewportHeight);
+
+        void update();
+        const Statistics & getStatistics() const;
+
+    private:
+
+        VulkanTextureStreamer(const VulkanTextureStreamer &) = delete;
+
+        static size_t getResidentSize(const VulkanTexture & texture, const uint32_t firstLevel);
+
+        // Called by textures, added once their base levels are resident.
+        uint32_t getBaseLevel(const VulkanTexture & texture) const;
+        void add(VulkanTexture * texture);
+        void remove(VulkanTexture * texture);
+
+        size_t                          m_budget;
+        uint32_t                        m_baseSize;
+        size_t                          m_uploadLimit;
+        uint64_t                        m_idleFrames;
+        uint64_t                        m_framesInFlight;
+        uint64_t                        m_frame;
+        std::vector<VulkanTexture *>    m_textures;
+        std::vector<VulkanTexture *>    m_order;
+        std::mutex                      m_mutex;
+        Statistics                      m_statistics;
+
+        friend class VulkanTexture;
+
+    };
+
+}
+
+#endif
+
+#endif
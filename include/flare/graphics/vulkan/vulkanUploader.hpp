@@ -0,0 +1,124 @@
+/*
+* MIT License
+*
+* Copyright(c) 2018 Jimmie Bergmann
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*/
+
+#ifndef FLARE_GRAPHICS_VULKAN_UPLOADER_HPP
+#define FLARE_GRAPHICS_VULKAN_UPLOADER_HPP
+
+#include "flare/build.hpp"
+
+#if defined(FLARE_VULKAN)
+
+#include "vulkan/vulkan.h"
+#include <vector>
+#include <deque>
+#include <set>
+#include <mutex>
+
+namespace Flare
+{
+
+    // Uploads of buffer and image data through a persistently mapped staging ring buffer.
+    // Copies are batched into a single command buffer, submitted once per frame on the transfer queue.
+    // Each submission signals a semaphore that the frame's graphics submission waits on,
+    // the semaphores are owned by the frame until its fence has signaled and then handed back with releaseSemaphores().
+    // Staging memory is reused once the copies reading it have finished, tracked with one fence per submission.
+    // All public methods are thread safe, queue submissions are guarded by the queue mutex shared with the renderer.
+    class FLARE_API VulkanUploader
+    {
+
+    public:
+
+        struct Allocation
+        {
+            void *          pData;
+            VkDeviceSize    offset;
+            VkDeviceSize    size;
+            uint64_t        position;
+        };
+
+        VulkanUploader();
+        ~VulkanUploader();
+
+        void load(VkPhysicalDevice physicalDevice, VkDevice logicalDevice, const uint32_t queueFamily, VkQueue queue,
+                  std::mutex & queueMutex, const VkDeviceSize size);
+        void unload();
+
+        // Staging memory is written by the caller and must be passed to exactly one of the copy methods, or cancelled.
+        Allocation allocate(const VkDeviceSize size, const VkDeviceSize alignment = 16);
+        void cancel(const Allocation & allocation);
+        void copyToBuffer(const Allocation & allocation, VkBuffer buffer, const VkDeviceSize bufferOffset);
+        void copyToImage(const Allocation & allocation, VkImage image, const VkBufferImageCopy * regions, const uint32_t regionCount, const uint32_t mipLevels);
+
+        void uploadBuffer(VkBuffer buffer, const VkDeviceSize bufferOffset, const void * data, const VkDeviceSize size);
+
+        void submit(std::vector<VkSemaphore> & signalSemaphores);
+        void releaseSemaphores(std::vector<VkSemaphore> & semaphores);
+
+        uint32_t getQueueFamily() const;
+
+    private:
+
+        VulkanUploader(const VulkanUploader &) = delete;
+
+        struct Batch
+        {
+            VkCommandPool   commandPool;
+            VkCommandBuffer commandBuffer;
+            VkFence         fence;
+            uint64_t        end;
+        };
+
+        VkCommandBuffer getCommandBuffer();
+        void submitBatch();
+        void reclaimBatches(const bool wait);
+        VkSemaphore getSemaphore();
+
+        std::mutex                  m_mutex;
+        VkDevice                    m_logicalDevice;
+        uint32_t                    m_queueFamily;
+        VkQueue                     m_queue;
+        std::mutex *                m_pQueueMutex;
+        VkBuffer                    m_buffer;
+        VkDeviceMemory              m_memory;
+        uint8_t *                   m_pData;
+        VkDeviceSize                m_size;
+        uint64_t                    m_head;
+        uint64_t                    m_tail;
+        std::multiset<uint64_t>     m_openAllocations;
+        std::vector<Batch>          m_batches;
+        std::vector<size_t>         m_freeBatches;
+        std::deque<size_t>          m_submittedBatches;
+        size_t                      m_currentBatch;
+        std::vector<VkSemaphore>    m_semaphores;
+        std::vector<VkSemaphore>    m_freeSemaphores;
+        std::vector<VkSemaphore>    m_signaledSemaphores;
+
+    };
+
+}
+
+#endif
+
+#endif
@@ -0,0 +1,106 @@
+/*
+* MIT License
+*
+* Copyright(c) 2018 Jimmie Bergmann
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*/
+
+#ifndef FLARE_SYSTEM_FRAME_PACER_HPP
+#define FLARE_SYSTEM_FRAME_PACER_HPP
+
+#include "flare/build.hpp"
+#include <chrono>
+#include <vector>
+
+namespace Flare
+{
+
+    // Limits the frame rate by waiting for evenly spaced frame deadlines and measures the resulting frame times.
+    // Waiting sleeps while the deadline is far away and spins the final stretch, which is sized by the
+    // oversleep observed so far. Frames more than one interval late restart the cadence instead of being caught up.
+    // Used by a single thread, typically right before presenting.
+    class FLARE_API FramePacer
+    {
+
+    public:
+
+        typedef std::chrono::steady_clock Clock;
+
+        static const size_t HistogramBucketCount = 256;
+        static constexpr double HistogramBucketWidth = 0.25;
+
+        // Frame times in milliseconds, the last histogram bucket also counts all longer frames.
+        struct Statistics
+        {
+            uint64_t                frameCount;
+            double                  averageFrameTime;
+            double                  minFrameTime;
+            double                  maxFrameTime;
+            double                  standardDeviation;
+            std::vector<uint64_t>   histogram;
+        };
+
+        FramePacer();
+        ~FramePacer();
+
+        // Zero disables the limit, frame times are measured either way.
+        void setTargetFrameRate(const float fps);
+        float getTargetFrameRate() const;
+
+        void wait();
+
+        // Restarts the cadence and clears the statistics, e.g. after a pause.
+        void reset();
+
+        double getLastFrameTime() const;
+        double getPercentile(const double percentile) const;
+        Statistics getStatistics() const;
+
+    private:
+
+        FramePacer(const FramePacer &) = delete;
+
+        void waitUntil(const Clock::time_point & deadline);
+        void sleep(const Clock::duration & duration);
+        void record(const Clock::time_point & time);
+
+        float                   m_targetFrameRate;
+        Clock::duration         m_interval;
+        Clock::time_point       m_deadline;
+        Clock::time_point       m_lastFrame;
+        bool                    m_started;
+        Clock::duration         m_sleepError;
+        uint64_t                m_frameCount;
+        double                  m_lastFrameTime;
+        double                  m_frameTimeSum;
+        double                  m_frameTimeSquareSum;
+        double                  m_minFrameTime;
+        double                  m_maxFrameTime;
+        std::vector<uint64_t>   m_histogram;
+    #if defined(FLARE_PLATFORM_WINDOWS)
+        HANDLE                  m_timer;
+    #endif
+
+    };
+
+}
+
+#endif
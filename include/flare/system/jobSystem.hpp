@@ -0,0 +1,174 @@
+/*
+* MIT License
+*
+* Copyright(c) 2018 Jimmie Bergmann
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*/
+
+#ifndef FLARE_SYSTEM_JOB_SYSTEM_HPP
+#define FLARE_SYSTEM_JOB_SYSTEM_HPP
+
+#include "flare/build.hpp"
+#include "flare/system/semaphore.hpp"
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <deque>
+#include <exception>
+#include <vector>
+#include <memory>
+#include <type_traits>
+#include <new>
+#include <cstring>
+
+#define FLARE_JOB_SYSTEM_MAX_JOBS 4096
+
+namespace Flare
+{
+
+    class JobSystem;
+
+    // Unit of work executed by the job system.
+    // A job is finished when its function and all of its child jobs have finished.
+    // Exceptions thrown by a job or its children are rethrown by JobSystem::wait.
+    class FLARE_API alignas(64) Job
+    {
+
+    public:
+
+        Job();
+
+        bool isFinished() const;
+
+    private:
+
+        Job(const Job &) = delete;
+
+        static const size_t DataSize = 96;
+
+        alignas(16) unsigned char   m_data[DataSize];
+        void(*m_pFunction)(Job &);
+        Job *                       m_pParent;
+        std::atomic<int32_t>        m_unfinishedJobs;
+        std::exception_ptr          m_exception;
+
+        friend class JobSystem;
+
+    };
+
+    // Work-stealing job system.
+    // Each worker owns a deque it pushes and pops jobs from, idle workers steal from the others.
+    // The thread constructing the job system is worker 0 and executes jobs while waiting.
+    // Jobs are allocated from a ring of FLARE_JOB_SYSTEM_MAX_JOBS jobs per thread, slots of unfinished jobs are never reused.
+    // A finished job must not be referenced after that many newer jobs have been created on the same thread.
+    class FLARE_API JobSystem
+    {
+
+    public:
+
+        JobSystem(const size_t workerCount = 0);
+        ~JobSystem();
+
+        template<typename Func>
+        Job * createJob(Func && function);
+        template<typename Func>
+        Job * createChildJob(Job * parent, Func && function);
+
+        void run(Job * job);
+        void wait(const Job * job);
+
+        template<typename Func>
+        void parallelFor(const size_t begin, const size_t end, const size_t grainSize, Func && function);
+
+        size_t getWorkerCount() const;
+        size_t getWorkerIndex() const;
+
+    private:
+
+        JobSystem(const JobSystem &) = delete;
+
+        class JobDeque
+        {
+
+        public:
+
+            JobDeque();
+
+            bool push(Job * job);
+            Job * pop();
+            Job * steal();
+
+        private:
+
+            std::atomic<int64_t>    m_top;
+            std::atomic<int64_t>    m_bottom;
+            std::atomic<Job *>      m_jobs[FLARE_JOB_SYSTEM_MAX_JOBS];
+
+        };
+
+        struct alignas(64) Worker
+        {
+            Worker();
+
+            JobDeque                m_deque;
+            std::unique_ptr<Job[]>  m_jobs;
+            size_t                  m_jobIndex;
+            uint32_t                m_random;
+            std::thread             m_thread;
+        };
+
+        template<typename Func>
+        static void invokeJob(Job & job);
+        template<typename Func>
+        static void invokeHeapJob(Job & job);
+        template<typename Func>
+        struct ParallelForJob;
+
+        template<typename Func>
+        Job * setJobFunction(Job * job, Func && function);
+        static void setException(Job & job, std::exception_ptr exception);
+
+        Job * allocateJob(Job * parent);
+        Job * getJob(Worker & worker);
+        void execute(Job * job);
+        void finish(Job * job);
+        void wakeWorkers();
+        void workerLoop(const size_t index);
+        bool isWorkerThread() const;
+
+        std::atomic<bool>                       m_running;
+        std::thread::id                         m_mainThreadId;
+        std::vector<std::unique_ptr<Worker>>    m_workers;
+        std::unique_ptr<Job[]>                  m_sharedJobs;
+        std::atomic<size_t>                     m_sharedJobIndex;
+        std::mutex                              m_sharedMutex;
+        std::deque<Job *>                       m_sharedQueue;
+        std::atomic<size_t>                     m_sharedQueueSize;
+        std::atomic<int32_t>                    m_sleepingWorkers;
+        CountingSemaphore                       m_wakeSemaphore;
+
+    };
+
+}
+
+#include "jobSystem.inl"
+
+#endif
@@ -0,0 +1,161 @@
+/*
+* MIT License
+*
+* Copyright(c) 2018 Jimmie Bergmann
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*/
+
+namespace Flare
+{
+
+    // Job system.
+    template<typename Func>
+    inline Job * JobSystem::createJob(Func && function)
+    {
+        return setJobFunction(allocateJob(nullptr), std::forward<Func>(function));
+    }
+
+    template<typename Func>
+    inline Job * JobSystem::createChildJob(Job * parent, Func && function)
+    {
+        return setJobFunction(allocateJob(parent), std::forward<Func>(function));
+    }
+
+    template<typename Func>
+    struct JobSystem::ParallelForJob
+    {
+        void operator()(Job & job) const
+        {
+            size_t first = begin;
+            size_t last = end;
+
+            // Hand off the upper half of the range until the rest fits the grain size.
+            while (last - first > grainSize)
+            {
+                const size_t middle = first + (last - first) / 2;
+                pSystem->run(pSystem->createChildJob(&job, ParallelForJob<Func>{ pSystem, pFunction, middle, last, grainSize }));
+                last = middle;
+            }
+
+            (*pFunction)(first, last);
+        }
+
+        JobSystem * pSystem;
+        Func *      pFunction;
+        size_t      begin;
+        size_t      end;
+        size_t      grainSize;
+    };
+
+    template<typename Func>
+    inline void JobSystem::parallelFor(const size_t begin, const size_t end, const size_t grainSize, Func && function)
+    {
+        if (begin >= end)
+        {
+            return;
+        }
+
+        // Default grain size gives each worker a few ranges to balance load with.
+        size_t grain = grainSize;
+        if (grain == 0)
+        {
+            grain = (end - begin) / (m_workers.size() * 4);
+            grain = grain ? grain : 1;
+        }
+
+        // Bound the number of ranges, a single loop never fills more than a part of the job rings.
+        const size_t maxRanges = FLARE_JOB_SYSTEM_MAX_JOBS / 4;
+        const size_t minGrain = (end - begin + maxRanges - 1) / maxRanges;
+        grain = grain > minGrain ? grain : minGrain;
+
+        typedef typename std::remove_reference<Func>::type Function;
+        Job * job = createJob(ParallelForJob<Function>{ this, &function, begin, end, grain });
+        run(job);
+        wait(job);
+    }
+
+    template<typename Func>
+    inline void JobSystem::invokeJob(Job & job)
+    {
+        Func * function = std::launder(reinterpret_cast<Func *>(job.m_data));
+        try
+        {
+            if constexpr (std::is_invocable<Func &, Job &>::value)
+            {
+                (*function)(job);
+            }
+            else
+            {
+                (*function)();
+            }
+        }
+        catch (...)
+        {
+            setException(job, std::current_exception());
+        }
+        function->~Func();
+    }
+
+    template<typename Func>
+    inline void JobSystem::invokeHeapJob(Job & job)
+    {
+        Func * function = nullptr;
+        std::memcpy(&function, job.m_data, sizeof(function));
+        try
+        {
+            if constexpr (std::is_invocable<Func &, Job &>::value)
+            {
+                (*function)(job);
+            }
+            else
+            {
+                (*function)();
+            }
+        }
+        catch (...)
+        {
+            setException(job, std::current_exception());
+        }
+        delete function;
+    }
+
+    template<typename Func>
+    inline Job * JobSystem::setJobFunction(Job * job, Func && function)
+    {
+        typedef typename std::decay<Func>::type Function;
+
+        // Small functions are stored in the job itself, larger ones on the heap.
+        if constexpr (sizeof(Function) <= Job::DataSize && alignof(Function) <= 16)
+        {
+            new (job->m_data) Function(std::forward<Func>(function));
+            job->m_pFunction = &invokeJob<Function>;
+        }
+        else
+        {
+            Function * heapFunction = new Function(std::forward<Func>(function));
+            std::memcpy(job->m_data, &heapFunction, sizeof(heapFunction));
+            job->m_pFunction = &invokeHeapJob<Function>;
+        }
+
+        return job;
+    }
+
+}
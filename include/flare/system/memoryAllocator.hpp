@@ -27,10 +27,12 @@
 #define FLARE_SYSTEM_MEMORY_ALLOCATOR_HPP
 
 #include "flare/build.hpp"
+#include <atomic>
 
 namespace Flare
 {
 
+    // Memory usage per object type. Counters are atomic, objects may update their usage from any thread.
     template<typename Type, size_t N>
     class FLARE_API RamMemoryAllocator
     {
@@ -60,9 +62,21 @@ namespace Flare
 
             }
 
+            int64_t getVramUsage() const
+            {
+                return m_vramUsage;
+            }
+
+            void setVramUsage(const size_t usage)
+            {
+                m_allocator.updateVramUsage<type>(m_vramUsage, usage);
+                m_vramUsage = usage;
+            }
+
             Object(RamMemoryAllocator<Type, N> & allocator) :
                 m_allocator(allocator),
-                m_ramUsage(0)
+                m_ramUsage(0),
+                m_vramUsage(0)
             { }
 
         private:
@@ -71,14 +85,21 @@ namespace Flare
 
             RamMemoryAllocator<Type, N> & m_allocator;
             int64_t m_ramUsage;
+            int64_t m_vramUsage;
 
         };
 
         RamMemoryAllocator() :
-            m_ramUsage{0},
-            m_totalRamUsage(0)
-
-        { }
+            m_totalRamUsage(0),
+            m_totalVramUsage(0),
+            m_reservedVramUsage(0)
+        {
+            for (size_t i = 0; i < N; i++)
+            {
+                m_ramUsage[i] = 0;
+                m_vramUsage[i] = 0;
+            }
+        }
 
         template<Type type>
         void updateRamUsage(const int64_t prevUsage, const int64_t newUsage)
@@ -88,12 +109,54 @@ namespace Flare
             m_ramUsage[static_cast<size_t>(type)] += diff;
         }
 
+        template<Type type>
+        void updateVramUsage(const int64_t prevUsage, const int64_t newUsage)
+        {
+            const int64_t diff = newUsage - prevUsage;
+            m_totalVramUsage += diff;
+            m_vramUsage[static_cast<size_t>(type)] += diff;
+        }
+
+        // Device memory reserved by the renderer, used or not.
+        void updateReservedVramUsage(const int64_t diff)
+        {
+            m_reservedVramUsage += diff;
+        }
+
+        int64_t getRamUsage(const Type type) const
+        {
+            return m_ramUsage[static_cast<size_t>(type)];
+        }
+
+        int64_t getTotalRamUsage() const
+        {
+            return m_totalRamUsage;
+        }
+
+        int64_t getVramUsage(const Type type) const
+        {
+            return m_vramUsage[static_cast<size_t>(type)];
+        }
+
+        int64_t getTotalVramUsage() const
+        {
+            return m_totalVramUsage;
+        }
+
+        int64_t getReservedVramUsage() const
+        {
+            return m_reservedVramUsage;
+        }
+
     private:
 
         RamMemoryAllocator(const RamMemoryAllocator &) = delete;
 
-        int64_t m_ramUsage[N];
-        int64_t m_totalRamUsage;
+        std::atomic<int64_t> m_ramUsage[N];
+        std::atomic<int64_t> m_totalRamUsage;
+        std::atomic<int64_t> m_vramUsage[N];
+        std::atomic<int64_t> m_totalVramUsage;
+        std::atomic<int64_t> m_reservedVramUsage;
 
     };
 
@@ -27,12 +27,88 @@
 #define FLARE_SYSTEM_SEMAPHORE_HPP
 
 #include "flare/build.hpp"
+#include <atomic>
+#include <chrono>
+#if defined(FLARE_PLATFORM_LINUX)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <climits>
+#include <ctime>
+#else
 #include <mutex>
 #include <condition_variable>
+#endif
 
 namespace Flare
 {
 
+    namespace Priv
+    {
+
+        // Blocking part of the semaphores, only used when a waiter actually has to sleep.
+        // Backed by a futex on Linux and by a mutex and condition variable elsewhere.
+        class FLARE_API SemaphoreSignal
+        {
+
+        public:
+
+            SemaphoreSignal();
+
+            void wait();
+            bool tryWait();
+            bool waitUntil(const std::chrono::steady_clock::time_point & time);
+            void signal(const int count);
+
+        private:
+
+            SemaphoreSignal(const SemaphoreSignal &) = delete;
+
+        #if defined(FLARE_PLATFORM_LINUX)
+            std::atomic<int>        m_value;
+        #else
+            int                     m_value;
+            std::mutex              m_mutex;
+            std::condition_variable m_condition;
+        #endif
+
+        };
+
+    }
+
+    // Counting semaphore with a lock-free fast path.
+    // A negative count is the number of threads blocked in acquire.
+    class FLARE_API CountingSemaphore
+    {
+
+    public:
+
+        CountingSemaphore(const int initialCount = 0);
+
+        void acquire();
+        bool tryAcquire();
+        template<typename Rep, typename Period>
+        bool tryAcquireFor(const std::chrono::duration<Rep, Period> & duration);
+        template<typename Clock, typename Duration>
+        bool tryAcquireUntil(const std::chrono::time_point<Clock, Duration> & time);
+
+        void release(const int count = 1);
+        int releaseWaiting();
+
+        int getCount() const;
+
+    private:
+
+        CountingSemaphore(const CountingSemaphore &) = delete;
+
+        bool spinAcquire();
+        bool acquireUntil(const std::chrono::steady_clock::time_point & time);
+
+        std::atomic<int>        m_count;
+        Priv::SemaphoreSignal   m_signal;
+
+    };
+
     // Implementation of weak semaphore.
     class FLARE_API Semaphore
     {
@@ -44,14 +120,14 @@ namespace Flare
 
         void wait();
         bool tryWait();
+        template<typename Rep, typename Period>
+        bool waitFor(const std::chrono::duration<Rep, Period> & duration);
         void notifyAll();
         void notifyOne();
 
     private:
 
-        int                     m_value;
-        std::mutex              m_mutex;
-        std::condition_variable m_condition;
+        CountingSemaphore m_semaphore;
 
     };
 
@@ -26,51 +26,289 @@
 namespace Flare
 {
 
-    inline Semaphore::Semaphore() :
-        m_value(0)
+    namespace Priv
     {
 
+        // Semaphore signal.
+    #if defined(FLARE_PLATFORM_LINUX)
+
+        inline SemaphoreSignal::SemaphoreSignal() :
+            m_value(0)
+        { }
+
+        inline void SemaphoreSignal::wait()
+        {
+            while (!tryWait())
+            {
+                syscall(SYS_futex, reinterpret_cast<int *>(&m_value), FUTEX_WAIT_PRIVATE, 0, nullptr, nullptr, 0);
+            }
+        }
+
+        inline bool SemaphoreSignal::tryWait()
+        {
+            int value = m_value.load(std::memory_order_relaxed);
+            while (value > 0)
+            {
+                if (m_value.compare_exchange_weak(value, value - 1, std::memory_order_acquire, std::memory_order_relaxed))
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        inline bool SemaphoreSignal::waitUntil(const std::chrono::steady_clock::time_point & time)
+        {
+            while (!tryWait())
+            {
+                const auto remaining = time - std::chrono::steady_clock::now();
+                if (remaining <= std::chrono::steady_clock::duration::zero())
+                {
+                    return false;
+                }
+
+                const auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(remaining).count();
+                timespec timeout;
+                timeout.tv_sec = static_cast<time_t>(nanoseconds / 1000000000LL);
+                timeout.tv_nsec = static_cast<long>(nanoseconds % 1000000000LL);
+                syscall(SYS_futex, reinterpret_cast<int *>(&m_value), FUTEX_WAIT_PRIVATE, 0, &timeout, nullptr, 0);
+            }
+            return true;
+        }
+
+        inline void SemaphoreSignal::signal(const int count)
+        {
+            m_value.fetch_add(count, std::memory_order_release);
+            syscall(SYS_futex, reinterpret_cast<int *>(&m_value), FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0);
+        }
+
+    #else
+
+        inline SemaphoreSignal::SemaphoreSignal() :
+            m_value(0)
+        { }
+
+        inline void SemaphoreSignal::wait()
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            while (!m_value)
+            {
+                m_condition.wait(lock);
+            }
+            --m_value;
+        }
+
+        inline bool SemaphoreSignal::tryWait()
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (m_value)
+            {
+                --m_value;
+                return true;
+            }
+
+            return false;
+        }
+
+        inline bool SemaphoreSignal::waitUntil(const std::chrono::steady_clock::time_point & time)
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            while (!m_value)
+            {
+                if (m_condition.wait_until(lock, time) == std::cv_status::timeout && !m_value)
+                {
+                    return false;
+                }
+            }
+            --m_value;
+            return true;
+        }
+
+        inline void SemaphoreSignal::signal(const int count)
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_value += count;
+            if (count == 1)
+            {
+                m_condition.notify_one();
+            }
+            else
+            {
+                m_condition.notify_all();
+            }
+        }
+
+    #endif
+
     }
 
-    inline Semaphore::~Semaphore()
+
+    // Counting semaphore.
+    inline CountingSemaphore::CountingSemaphore(const int initialCount) :
+        m_count(initialCount)
+    { }
+
+    inline void CountingSemaphore::acquire()
     {
+        if (spinAcquire())
+        {
+            return;
+        }
 
+        // Register as waiter, block if nothing was released in the meantime.
+        if (m_count.fetch_sub(1, std::memory_order_acquire) <= 0)
+        {
+            m_signal.wait();
+        }
     }
 
-    inline void Semaphore::wait()
+    inline bool CountingSemaphore::tryAcquire()
     {
-        std::unique_lock<std::mutex> lock(m_mutex);
-        while (!m_value)
+        int count = m_count.load(std::memory_order_relaxed);
+        while (count > 0)
         {
-            m_condition.wait(lock);
+            if (m_count.compare_exchange_weak(count, count - 1, std::memory_order_acquire, std::memory_order_relaxed))
+            {
+                return true;
+            }
         }
-        --m_value;
+        return false;
     }
 
-    inline bool Semaphore::tryWait()
+    template<typename Rep, typename Period>
+    inline bool CountingSemaphore::tryAcquireFor(const std::chrono::duration<Rep, Period> & duration)
     {
-        std::unique_lock<std::mutex> lock(m_mutex);
-        if (m_value)
+        return acquireUntil(std::chrono::steady_clock::now() +
+                            std::chrono::duration_cast<std::chrono::steady_clock::duration>(duration));
+    }
+
+    template<typename Clock, typename Duration>
+    inline bool CountingSemaphore::tryAcquireUntil(const std::chrono::time_point<Clock, Duration> & time)
+    {
+        return acquireUntil(std::chrono::steady_clock::now() +
+                            std::chrono::duration_cast<std::chrono::steady_clock::duration>(time - Clock::now()));
+    }
+
+    inline void CountingSemaphore::release(const int count)
+    {
+        if (count <= 0)
         {
-            --m_value;
-            return true;
+            return;
         }
 
+        // Only wake as many threads as are actually blocked.
+        const int prevCount = m_count.fetch_add(count, std::memory_order_release);
+        const int waiting = prevCount < 0 ? -prevCount : 0;
+        const int wake = waiting < count ? waiting : count;
+        if (wake > 0)
+        {
+            m_signal.signal(wake);
+        }
+    }
+
+    inline int CountingSemaphore::releaseWaiting()
+    {
+        int count = m_count.load(std::memory_order_relaxed);
+        while (count < 0)
+        {
+            if (m_count.compare_exchange_weak(count, 0, std::memory_order_release, std::memory_order_relaxed))
+            {
+                m_signal.signal(-count);
+                return -count;
+            }
+        }
+        return 0;
+    }
+
+    inline int CountingSemaphore::getCount() const
+    {
+        const int count = m_count.load(std::memory_order_relaxed);
+        return count > 0 ? count : 0;
+    }
+
+    inline bool CountingSemaphore::spinAcquire()
+    {
+        // Short spin before registering as waiter, wakeups are often just around the corner.
+        for (size_t i = 0; i < 1000; i++)
+        {
+            if (tryAcquire())
+            {
+                return true;
+            }
+            std::atomic_signal_fence(std::memory_order_acquire);
+        }
         return false;
     }
 
+    inline bool CountingSemaphore::acquireUntil(const std::chrono::steady_clock::time_point & time)
+    {
+        if (spinAcquire())
+        {
+            return true;
+        }
+
+        if (m_count.fetch_sub(1, std::memory_order_acquire) > 0)
+        {
+            return true;
+        }
+        if (m_signal.waitUntil(time))
+        {
+            return true;
+        }
+
+        // Timed out. Unregister as waiter, unless a release already accounted for us,
+        // in which case the pending signal has to be consumed.
+        while (true)
+        {
+            int count = m_count.load(std::memory_order_acquire);
+            if (count >= 0 && m_signal.tryWait())
+            {
+                return true;
+            }
+            if (count < 0 && m_count.compare_exchange_strong(count, count + 1, std::memory_order_relaxed))
+            {
+                return false;
+            }
+        }
+    }
+
+
+    // Semaphore.
+    inline Semaphore::Semaphore() :
+        m_semaphore(0)
+    {
+
+    }
+
+    inline Semaphore::~Semaphore()
+    {
+
+    }
+
+    inline void Semaphore::wait()
+    {
+        m_semaphore.acquire();
+    }
+
+    inline bool Semaphore::tryWait()
+    {
+        return m_semaphore.tryAcquire();
+    }
+
+    template<typename Rep, typename Period>
+    inline bool Semaphore::waitFor(const std::chrono::duration<Rep, Period> & duration)
+    {
+        return m_semaphore.tryAcquireFor(duration);
+    }
+
     inline void Semaphore::notifyAll()
     {
-        std::unique_lock<std::mutex> lock(m_mutex);
-        m_value = 0;
-        m_condition.notify_all();
+        m_semaphore.releaseWaiting();
     }
 
     inline void Semaphore::notifyOne()
     {
-        std::unique_lock<std::mutex> lock(m_mutex);
-        ++m_value;
-        m_condition.notify_one();
+        m_semaphore.release(1);
     }
 
 }
@@ -0,0 +1,97 @@
+/*
+* MIT License
+*
+* Copyright(c) 2018 Jimmie Bergmann
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*/
+
+#ifndef FLARE_SYSTEM_TLSF_ALLOCATOR_HPP
+#define FLARE_SYSTEM_TLSF_ALLOCATOR_HPP
+
+#include "flare/build.hpp"
+#include <vector>
+
+namespace Flare
+{
+
+    // Two-level segregated fit allocator of offsets within a range of a given size.
+    // Allocation and free are O(1), free blocks are merged with their physical neighbours.
+    // Block bookkeeping is kept apart from the managed range, so it can manage device memory.
+    class FLARE_API TlsfAllocator
+    {
+
+    public:
+
+        static const uint32_t InvalidBlock = 0xFFFFFFFF;
+
+        TlsfAllocator(const uint64_t size = 0);
+
+        void reset(const uint64_t size);
+
+        bool allocate(const uint64_t size, const uint64_t alignment, uint64_t & offset, uint32_t & block);
+        void free(const uint32_t block);
+
+        uint64_t getSize() const;
+        uint64_t getUsedSize() const;
+        size_t getAllocationCount() const;
+        bool isEmpty() const;
+
+    private:
+
+        static const uint32_t SecondLevelLog2 = 4;
+        static const uint32_t SecondLevelCount = 1 << SecondLevelLog2;
+        static const uint32_t FirstLevelCount = 48;
+        static const uint64_t MinBlockSize = 1 << SecondLevelLog2;
+
+        struct Block
+        {
+            uint64_t offset;
+            uint64_t size;
+            uint32_t prevPhysical;
+            uint32_t nextPhysical;
+            uint32_t prevFree;
+            uint32_t nextFree;
+            bool     free;
+        };
+
+        static void mapping(const uint64_t size, uint32_t & firstLevel, uint32_t & secondLevel);
+        uint32_t findFreeBlock(const uint64_t size);
+        uint32_t createBlock();
+        void destroyBlock(const uint32_t block);
+        void insertFreeBlock(const uint32_t block);
+        void removeFreeBlock(const uint32_t block);
+        uint32_t splitBlock(const uint32_t block, const uint64_t size);
+        void mergeBlocks(const uint32_t block, const uint32_t next);
+
+        uint64_t                m_size;
+        uint64_t                m_usedSize;
+        size_t                  m_allocationCount;
+        std::vector<Block>      m_blocks;
+        std::vector<uint32_t>   m_unusedBlocks;
+        uint64_t                m_firstLevelBitmap;
+        uint32_t                m_secondLevelBitmaps[FirstLevelCount];
+        uint32_t                m_freeLists[FirstLevelCount][SecondLevelCount];
+
+    };
+
+}
+
+#endif
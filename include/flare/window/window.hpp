@@ -37,6 +37,9 @@ namespace Flare
     
 #if defined(FLARE_PLATFORM_WINDOWS)
     typedef Priv::Win32Window Window;
+#else
+    // No window implementation on this platform, only headless rendering is available.
+    class Window;
 #endif
 
 }
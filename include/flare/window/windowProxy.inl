@@ -63,6 +63,14 @@ namespace Flare
         m_hInstance = hInstance;
     }
 
+#else
+
+    inline WindowProxy::WindowProxy()
+    { }
+
+    inline WindowProxy::WindowProxy(const Window &)
+    { }
+
 #endif    
 
 }
\ No newline at end of file
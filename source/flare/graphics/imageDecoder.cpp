@@ -0,0 +1,1193 @@
+/*
+* MIT License
+*
+* Copyright(c) 2018 Jimmie Bergmann
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*/
+
+#include "flare/graphics/imageDecoder.hpp"
+#include "flare/graphics/mipmapGenerator.hpp"
+#include "flare/graphics/pixelConverter.hpp"
+#include "flare/graphics/textureCompressor.hpp"
+#include "flare/system/jobSystem.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace Flare
+{
+
+    static const size_t g_pixelsPerJob = 64 * 1024;
+
+    static const uint8_t g_pngSignature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    static const uint8_t g_ktx2Identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+    static uint16_t readUint16(const uint8_t * data)
+    {
+        return static_cast<uint16_t>(data[0] | (data[1] << 8));
+    }
+
+    static uint32_t readUint32(const uint8_t * data)
+    {
+        return static_cast<uint32_t>(data[0]) | (static_cast<uint32_t>(data[1]) << 8) |
+               (static_cast<uint32_t>(data[2]) << 16) | (static_cast<uint32_t>(data[3]) << 24);
+    }
+
+    static uint64_t readUint64(const uint8_t * data)
+    {
+        return static_cast<uint64_t>(readUint32(data)) | (static_cast<uint64_t>(readUint32(data + 4)) << 32);
+    }
+
+    static uint32_t readUint32BigEndian(const uint8_t * data)
+    {
+        return (static_cast<uint32_t>(data[0]) << 24) | (static_cast<uint32_t>(data[1]) << 16) |
+               (static_cast<uint32_t>(data[2]) << 8) | static_cast<uint32_t>(data[3]);
+    }
+
+    template<typename Func>
+    static void forEachRow(JobSystem * jobSystem, const uint32_t rowCount, const uint32_t width, Func && function)
+    {
+        const size_t rowsPerJob = std::max<size_t>(g_pixelsPerJob / std::max<uint32_t>(width, 1), 1);
+        if (!jobSystem || rowCount <= rowsPerJob)
+        {
+            function(0, rowCount);
+            return;
+        }
+
+        jobSystem->parallelFor(0, rowCount, rowsPerJob, [&function](const size_t first, const size_t last)
+        {
+            function(static_cast<uint32_t>(first), static_cast<uint32_t>(last));
+        });
+    }
+
+
+    // Inflate, RFC 1951. Output is pulled in pieces of any size, only the 32 KiB window is kept.
+    struct InflateSpan
+    {
+        const uint8_t * pData;
+        size_t          size;
+    };
+
+    class InflateStream
+    {
+
+    public:
+
+        InflateStream(const std::vector<InflateSpan> & spans) :
+            m_spans(spans),
+            m_span(0),
+            m_position(0),
+            m_bits(0),
+            m_bitCount(0),
+            m_window(WindowSize),
+            m_written(0),
+            m_final(false),
+            m_block(Block::None),
+            m_storedRemaining(0),
+            m_copyLength(0),
+            m_copyDistance(0)
+        { }
+
+        // Zlib header, RFC 1950. The trailing checksum is not verified.
+        void readZlibHeader()
+        {
+            const uint32_t method = getBits(8);
+            const uint32_t flags = getBits(8);
+            if ((method & 0x0F) != 8 || ((method << 8) | flags) % 31 != 0 || (flags & 0x20))
+            {
+                throw std::runtime_error("Invalid zlib header.");
+            }
+        }
+
+        void read(uint8_t * output, size_t count)
+        {
+            while (count)
+            {
+                if (m_copyLength)
+                {
+                    const size_t length = std::min<size_t>(count, m_copyLength);
+                    for (size_t i = 0; i < length; i++)
+                    {
+                        output[i] = m_window[(m_written - m_copyDistance) & WindowMask];
+                        m_window[m_written++ & WindowMask] = output[i];
+                    }
+                    output += length;
+                    count -= length;
+                    m_copyLength -= static_cast<uint32_t>(length);
+                }
+                else if (m_block == Block::Stored)
+                {
+                    if (!m_storedRemaining)
+                    {
+                        m_block = Block::None;
+                        continue;
+                    }
+                    *output = static_cast<uint8_t>(getBits(8));
+                    m_window[m_written++ & WindowMask] = *output++;
+                    count--;
+                    m_storedRemaining--;
+                }
+                else if (m_block == Block::Huffman)
+                {
+                    readSymbol(output, count);
+                }
+                else if (m_final)
+                {
+                    throw std::runtime_error("Compressed image data ended early.");
+                }
+                else
+                {
+                    readBlockHeader();
+                }
+            }
+        }
+
+    private:
+
+        static const size_t WindowSize = 32768;
+        static const size_t WindowMask = WindowSize - 1;
+        static const uint32_t FastBits = 9;
+
+        enum class Block
+        {
+            None,
+            Stored,
+            Huffman
+        };
+
+        // Canonical Huffman code, codes up to FastBits long are looked up directly.
+        struct Huffman
+        {
+            uint16_t    fast[1 << FastBits];
+            uint32_t    firstCode[16];
+            uint32_t    maxCode[17];
+            uint32_t    firstSymbol[16];
+            uint8_t     sizes[288];
+            uint16_t    values[288];
+        };
+
+        static uint32_t reverseBits(const uint32_t value, const uint32_t count)
+        {
+            uint32_t result = 0;
+            for (uint32_t i = 0; i < count; i++)
+            {
+                result = (result << 1) | ((value >> i) & 1);
+            }
+            return result;
+        }
+
+        static void buildHuffman(Huffman & huffman, const uint8_t * lengths, const uint32_t count)
+        {
+            uint32_t counts[16] = {};
+            for (uint32_t i = 0; i < count; i++)
+            {
+                counts[lengths[i]]++;
+            }
+            counts[0] = 0;
+
+            std::memset(huffman.fast, 0, sizeof(huffman.fast));
+            std::memset(huffman.sizes, 0, sizeof(huffman.sizes));
+
+            uint32_t nextCode[16];
+            uint32_t code = 0;
+            uint32_t symbol = 0;
+            for (uint32_t i = 1; i < 16; i++)
+            {
+                nextCode[i] = code;
+                huffman.firstCode[i] = code;
+                huffman.firstSymbol[i] = symbol;
+                code += counts[i];
+                if (counts[i] && code - 1 >= (1u << i))
+                {
+                    throw std::runtime_error("Invalid Huffman code lengths.");
+                }
+                huffman.maxCode[i] = code << (16 - i);
+                code <<= 1;
+                symbol += counts[i];
+            }
+            huffman.maxCode[16] = 0x10000;
+
+            for (uint32_t i = 0; i < count; i++)
+            {
+                const uint32_t size = lengths[i];
+                if (!size)
+                {
+                    continue;
+                }
+
+                const uint32_t index = nextCode[size] - huffman.firstCode[size] + huffman.firstSymbol[size];
+                huffman.sizes[index] = static_cast<uint8_t>(size);
+                huffman.values[index] = static_cast<uint16_t>(i);
+                if (size <= FastBits)
+                {
+                    for (uint32_t j = reverseBits(nextCode[size], size); j < (1u << FastBits); j += 1u << size)
+                    {
+                        huffman.fast[j] = static_cast<uint16_t>((size << 9) | i);
+                    }
+                }
+                nextCode[size]++;
+            }
+        }
+
+        void refill()
+        {
+            while (m_bitCount <= 56)
+            {
+                while (m_span < m_spans.size() && m_position >= m_spans[m_span].size)
+                {
+                    m_span++;
+                    m_position = 0;
+                }
+                if (m_span >= m_spans.size())
+                {
+                    return;
+                }
+                m_bits |= static_cast<uint64_t>(m_spans[m_span].pData[m_position++]) << m_bitCount;
+                m_bitCount += 8;
+            }
+        }
+
+        void consume(const uint32_t count)
+        {
+            if (count > m_bitCount)
+            {
+                throw std::runtime_error("Compressed image data is truncated.");
+            }
+            m_bits >>= count;
+            m_bitCount -= count;
+        }
+
+        uint32_t getBits(const uint32_t count)
+        {
+            if (m_bitCount < count)
+            {
+                refill();
+            }
+            const uint32_t value = static_cast<uint32_t>(m_bits & ((1ull << count) - 1));
+            consume(count);
+            return value;
+        }
+
+        uint32_t decode(const Huffman & huffman)
+        {
+            if (m_bitCount < 16)
+            {
+                refill();
+            }
+
+            const uint32_t fast = huffman.fast[m_bits & ((1u << FastBits) - 1)];
+            if (fast)
+            {
+                consume(fast >> 9);
+                return fast & 0x1FF;
+            }
+
+            const uint32_t code = reverseBits(static_cast<uint32_t>(m_bits & 0xFFFF), 16);
+            uint32_t size = FastBits + 1;
+            while (size < 16 && code >= huffman.maxCode[size])
+            {
+                size++;
+            }
+            if (size >= 16)
+            {
+                throw std::runtime_error("Invalid Huffman code.");
+            }
+
+            const uint32_t index = (code >> (16 - size)) - huffman.firstCode[size] + huffman.firstSymbol[size];
+            if (index >= 288 || huffman.sizes[index] != size)
+            {
+                throw std::runtime_error("Invalid Huffman code.");
+            }
+            consume(size);
+            return huffman.values[index];
+        }
+
+        void readBlockHeader()
+        {
+            static const uint8_t codeLengthOrder[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+            m_final = getBits(1) != 0;
+            const uint32_t type = getBits(2);
+            if (type == 0)
+            {
+                // Stored blocks start at the next byte.
+                consume(m_bitCount % 8);
+                const uint32_t length = getBits(16);
+                if ((length ^ 0xFFFF) != getBits(16))
+                {
+                    throw std::runtime_error("Invalid stored block length.");
+                }
+                m_storedRemaining = length;
+                m_block = Block::Stored;
+                return;
+            }
+
+            uint8_t lengths[288 + 32] = {};
+            if (type == 1)
+            {
+                std::memset(lengths, 8, 144);
+                std::memset(lengths + 144, 9, 112);
+                std::memset(lengths + 256, 7, 24);
+                std::memset(lengths + 280, 8, 8);
+                std::memset(lengths + 288, 5, 30);
+                buildHuffman(m_literals, lengths, 288);
+                buildHuffman(m_distances, lengths + 288, 30);
+            }
+            else if (type == 2)
+            {
+                const uint32_t literalCount = getBits(5) + 257;
+                const uint32_t distanceCount = getBits(5) + 1;
+                const uint32_t codeLengthCount = getBits(4) + 4;
+
+                uint8_t codeLengths[19] = {};
+                for (uint32_t i = 0; i < codeLengthCount; i++)
+                {
+                    codeLengths[codeLengthOrder[i]] = static_cast<uint8_t>(getBits(3));
+                }
+                Huffman codeLengthHuffman;
+                buildHuffman(codeLengthHuffman, codeLengths, 19);
+
+                const uint32_t total = literalCount + distanceCount;
+                uint32_t count = 0;
+                while (count < total)
+                {
+                    const uint32_t symbol = decode(codeLengthHuffman);
+                    if (symbol < 16)
+                    {
+                        lengths[count++] = static_cast<uint8_t>(symbol);
+                        continue;
+                    }
+
+                    uint32_t repeat = 0;
+                    uint8_t value = 0;
+                    if (symbol == 16)
+                    {
+                        if (count == 0)
+                        {
+                            throw std::runtime_error("Invalid code length repeat.");
+                        }
+                        repeat = getBits(2) + 3;
+                        value = lengths[count - 1];
+                    }
+                    else if (symbol == 17)
+                    {
+                        repeat = getBits(3) + 3;
+                    }
+                    else
+                    {
+                        repeat = getBits(7) + 11;
+                    }
+                    if (count + repeat > total)
+                    {
+                        throw std::runtime_error("Invalid code length repeat.");
+                    }
+                    std::memset(lengths + count, value, repeat);
+                    count += repeat;
+                }
+
+                buildHuffman(m_literals, lengths, literalCount);
+                buildHuffman(m_distances, lengths + literalCount, distanceCount);
+            }
+            else
+            {
+                throw std::runtime_error("Invalid compressed block type.");
+            }
+            m_block = Block::Huffman;
+        }
+
+        void readSymbol(uint8_t *& output, size_t & count)
+        {
+            static const uint16_t lengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                                     35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+            static const uint8_t lengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                                     3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+            static const uint16_t distanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+                                                       257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+            static const uint8_t distanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+                                                       7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+            const uint32_t symbol = decode(m_literals);
+            if (symbol < 256)
+            {
+                *output = static_cast<uint8_t>(symbol);
+                m_window[m_written++ & WindowMask] = *output++;
+                count--;
+                return;
+            }
+            if (symbol == 256)
+            {
+                m_block = Block::None;
+                return;
+            }
+
+            const uint32_t lengthSymbol = symbol - 257;
+            if (lengthSymbol >= 29)
+            {
+                throw std::runtime_error("Invalid length symbol.");
+            }
+            m_copyLength = lengthBase[lengthSymbol] + getBits(lengthExtra[lengthSymbol]);
+
+            const uint32_t distanceSymbol = decode(m_distances);
+            if (distanceSymbol >= 30)
+            {
+                throw std::runtime_error("Invalid distance symbol.");
+            }
+            m_copyDistance = distanceBase[distanceSymbol] + getBits(distanceExtra[distanceSymbol]);
+            if (m_copyDistance > m_written)
+            {
+                throw std::runtime_error("Invalid distance, before the start of the data.");
+            }
+        }
+
+        const std::vector<InflateSpan> & m_spans;
+        size_t                  m_span;
+        size_t                  m_position;
+        uint64_t                m_bits;
+        uint32_t                m_bitCount;
+        std::vector<uint8_t>    m_window;
+        uint64_t                m_written;
+        bool                    m_final;
+        Block                   m_block;
+        uint32_t                m_storedRemaining;
+        uint32_t                m_copyLength;
+        uint32_t                m_copyDistance;
+        Huffman                 m_literals;
+        Huffman                 m_distances;
+
+    };
+
+
+    // PNG, non-interlaced images of all color types and bit depths.
+    struct PngImage
+    {
+        uint32_t                    width;
+        uint32_t                    height;
+        uint8_t                     bitDepth;
+        uint8_t                     colorType;
+        uint8_t                     palette[256][4];
+        uint32_t                    paletteSize;
+        bool                        hasColorKey;
+        uint16_t                    colorKey[3];
+        std::vector<InflateSpan>    data;
+    };
+
+    static bool isPng(const uint8_t * data, const size_t size)
+    {
+        return size >= 8 && std::memcmp(data, g_pngSignature, 8) == 0;
+    }
+
+    static void readPng(const uint8_t * data, const size_t size, PngImage & image)
+    {
+        image.width = 0;
+        image.height = 0;
+        image.paletteSize = 0;
+        image.hasColorKey = false;
+        image.data.clear();
+
+        uint8_t interlace = 0;
+        bool hasHeader = false;
+        size_t position = 8;
+        while (position + 12 <= size)
+        {
+            const uint32_t length = readUint32BigEndian(data + position);
+            const uint8_t * pType = data + position + 4;
+            const uint8_t * pChunk = data + position + 8;
+            if (length > size - position - 12)
+            {
+                throw std::runtime_error("PNG chunk exceeds the end of the file.");
+            }
+
+            if (std::memcmp(pType, "IHDR", 4) == 0 && length >= 13)
+            {
+                image.width = readUint32BigEndian(pChunk);
+                image.height = readUint32BigEndian(pChunk + 4);
+                image.bitDepth = pChunk[8];
+                image.colorType = pChunk[9];
+                interlace = pChunk[12];
+                hasHeader = true;
+            }
+            else if (std::memcmp(pType, "PLTE", 4) == 0)
+            {
+                image.paletteSize = std::min<uint32_t>(length / 3, 256);
+                for (uint32_t i = 0; i < image.paletteSize; i++)
+                {
+                    image.palette[i][0] = pChunk[i * 3 + 0];
+                    image.palette[i][1] = pChunk[i * 3 + 1];
+                    image.palette[i][2] = pChunk[i * 3 + 2];
+                    image.palette[i][3] = 255;
+                }
+            }
+            else if (std::memcmp(pType, "tRNS", 4) == 0)
+            {
+                if (image.colorType == 3)
+                {
+                    for (uint32_t i = 0; i < std::min(length, image.paletteSize); i++)
+                    {
+                        image.palette[i][3] = pChunk[i];
+                    }
+                }
+                else if ((image.colorType == 0 && length >= 2) || (image.colorType == 2 && length >= 6))
+                {
+                    image.hasColorKey = true;
+                    for (uint32_t i = 0; i < length / 2 && i < 3; i++)
+                    {
+                        image.colorKey[i] = static_cast<uint16_t>((pChunk[i * 2] << 8) | pChunk[i * 2 + 1]);
+                    }
+                }
+            }
+            else if (std::memcmp(pType, "IDAT", 4) == 0)
+            {
+                image.data.push_back(InflateSpan{ pChunk, length });
+            }
+            else if (std::memcmp(pType, "IEND", 4) == 0)
+            {
+                break;
+            }
+            position += 12 + static_cast<size_t>(length);
+        }
+
+        if (!hasHeader || image.width == 0 || image.height == 0)
+        {
+            throw std::runtime_error("PNG image has no valid header.");
+        }
+        if (interlace)
+        {
+            throw std::runtime_error("Interlaced PNG images are not supported.");
+        }
+
+        const uint8_t depth = image.bitDepth;
+        bool valid = false;
+        switch (image.colorType)
+        {
+            case 0: valid = depth == 1 || depth == 2 || depth == 4 || depth == 8 || depth == 16; break;
+            case 3: valid = (depth == 1 || depth == 2 || depth == 4 || depth == 8) && image.paletteSize > 0; break;
+            case 2: case 4: case 6: valid = depth == 8 || depth == 16; break;
+            default: break;
+        }
+        if (!valid)
+        {
+            throw std::runtime_error("Unsupported PNG color type or bit depth.");
+        }
+    }
+
+    static uint32_t getPngChannels(const uint8_t colorType)
+    {
+        switch (colorType)
+        {
+            case 2: return 3;
+            case 4: return 2;
+            case 6: return 4;
+            default: return 1;
+        }
+    }
+
+    static void unfilterPngRow(const uint8_t filter, uint8_t * row, const uint8_t * previous, const size_t size, const size_t stride)
+    {
+        switch (filter)
+        {
+            case 0:
+                break;
+            case 1:
+                for (size_t i = stride; i < size; i++)
+                {
+                    row[i] = static_cast<uint8_t>(row[i] + row[i - stride]);
+                }
+                break;
+            case 2:
+                for (size_t i = 0; i < size; i++)
+                {
+                    row[i] = static_cast<uint8_t>(row[i] + previous[i]);
+                }
+                break;
+            case 3:
+                for (size_t i = 0; i < stride; i++)
+                {
+                    row[i] = static_cast<uint8_t>(row[i] + previous[i] / 2);
+                }
+                for (size_t i = stride; i < size; i++)
+                {
+                    row[i] = static_cast<uint8_t>(row[i] + (row[i - stride] + previous[i]) / 2);
+                }
+                break;
+            case 4:
+                for (size_t i = 0; i < stride; i++)
+                {
+                    row[i] = static_cast<uint8_t>(row[i] + previous[i]);
+                }
+                for (size_t i = stride; i < size; i++)
+                {
+                    const int a = row[i - stride];
+                    const int b = previous[i];
+                    const int c = previous[i - stride];
+                    const int p = a + b - c;
+                    const int pa = std::abs(p - a);
+                    const int pb = std::abs(p - b);
+                    const int pc = std::abs(p - c);
+                    const int predictor = (pa <= pb && pa <= pc) ? a : (pb <= pc ? b : c);
+                    row[i] = static_cast<uint8_t>(row[i] + predictor);
+                }
+                break;
+            default:
+                throw std::runtime_error("Invalid PNG row filter.");
+        }
+    }
+
+    static uint32_t getPngSample(const uint8_t * row, const size_t index, const uint8_t bitDepth)
+    {
+        switch (bitDepth)
+        {
+            case 8:
+                return row[index];
+            case 16:
+                return static_cast<uint32_t>((row[index * 2] << 8) | row[index * 2 + 1]);
+            default:
+            {
+                const size_t bit = index * bitDepth;
+                return (row[bit / 8] >> (8 - bitDepth - bit % 8)) & ((1u << bitDepth) - 1);
+            }
+        }
+    }
+
+    static void convertPngRow(const PngImage & image, const uint8_t * row, uint8_t * output)
+    {
+        const uint32_t width = image.width;
+        const uint8_t depth = image.bitDepth;
+
+        // Common 8 bit layouts without transparency keys.
+        if (depth == 8 && !image.hasColorKey)
+        {
+            if (image.colorType == 6)
+            {
+                std::memcpy(output, row, static_cast<size_t>(width) * 4);
+                return;
+            }
+            if (image.colorType == 2)
+            {
+                PixelConverter::rgbToRgba(row, output, width);
+                return;
+            }
+        }
+
+        const uint32_t channels = getPngChannels(image.colorType);
+        const uint32_t maxValue = (1u << depth) - 1;
+        for (uint32_t x = 0; x < width; x++, output += 4)
+        {
+            if (image.colorType == 3)
+            {
+                const uint32_t index = getPngSample(row, x, depth);
+                if (index >= image.paletteSize)
+                {
+                    throw std::runtime_error("PNG palette index out of range.");
+                }
+                std::memcpy(output, image.palette[index], 4);
+                continue;
+            }
+
+            uint32_t samples[4];
+            for (uint32_t c = 0; c < channels; c++)
+            {
+                samples[c] = getPngSample(row, static_cast<size_t>(x) * channels + c, depth);
+            }
+
+            bool keyed = image.hasColorKey;
+            const uint32_t colorChannels = (image.colorType == 2 || image.colorType == 6) ? 3 : 1;
+            for (uint32_t c = 0; c < colorChannels && keyed; c++)
+            {
+                keyed = samples[c] == image.colorKey[c];
+            }
+
+            uint8_t values[4];
+            for (uint32_t c = 0; c < channels; c++)
+            {
+                values[c] = static_cast<uint8_t>(depth == 16 ? samples[c] >> 8 : samples[c] * 255 / maxValue);
+            }
+
+            switch (image.colorType)
+            {
+                case 0:
+                    output[0] = output[1] = output[2] = values[0];
+                    output[3] = keyed ? 0 : 255;
+                    break;
+                case 2:
+                    output[0] = values[0];
+                    output[1] = values[1];
+                    output[2] = values[2];
+                    output[3] = keyed ? 0 : 255;
+                    break;
+                case 4:
+                    output[0] = output[1] = output[2] = values[0];
+                    output[3] = values[1];
+                    break;
+                default:
+                    std::memcpy(output, values, 4);
+                    break;
+            }
+        }
+    }
+
+    static void decodePng(const uint8_t * data, const size_t size, uint8_t * output)
+    {
+        PngImage image;
+        readPng(data, size, image);
+
+        const size_t bitsPerPixel = static_cast<size_t>(getPngChannels(image.colorType)) * image.bitDepth;
+        const size_t rowSize = (image.width * bitsPerPixel + 7) / 8;
+        const size_t stride = std::max<size_t>(bitsPerPixel / 8, 1);
+
+        // Rows are inflated into a pair of scratch rows, filters refer to the previous unfiltered row.
+        std::vector<uint8_t> rows(rowSize * 2, 0);
+        uint8_t * pRow = rows.data();
+        uint8_t * pPrevious = rows.data() + rowSize;
+
+        InflateStream stream(image.data);
+        stream.readZlibHeader();
+        for (uint32_t y = 0; y < image.height; y++)
+        {
+            uint8_t filter;
+            stream.read(&filter, 1);
+            stream.read(pRow, rowSize);
+            unfilterPngRow(filter, pRow, pPrevious, rowSize, stride);
+            convertPngRow(image, pRow, output + static_cast<size_t>(y) * image.width * 4);
+            std::swap(pRow, pPrevious);
+        }
+    }
+
+
+    // TGA, true color and grayscale images, optionally run length encoded.
+    struct TgaImage
+    {
+        uint32_t    width;
+        uint32_t    height;
+        uint32_t    bytesPerPixel;
+        bool        runLength;
+        bool        topDown;
+        size_t      dataOffset;
+    };
+
+    static bool isTga(const uint8_t * data, const size_t size)
+    {
+        // No signature, only the header is checked.
+        return size >= 18 && data[1] == 0 && (data[2] == 2 || data[2] == 3 || data[2] == 10 || data[2] == 11) &&
+               (data[16] == 8 || data[16] == 24 || data[16] == 32);
+    }
+
+    static void readTga(const uint8_t * data, const size_t size, TgaImage & image)
+    {
+        const uint8_t imageType = data[2];
+        image.width = readUint16(data + 12);
+        image.height = readUint16(data + 14);
+        image.bytesPerPixel = data[16] / 8;
+        image.runLength = imageType >= 9;
+        image.topDown = (data[17] & 0x20) != 0;
+        image.dataOffset = 18 + static_cast<size_t>(data[0]);
+
+        const bool grayscale = imageType == 3 || imageType == 11;
+        if (image.width == 0 || image.height == 0 || grayscale != (image.bytesPerPixel == 1))
+        {
+            throw std::runtime_error("Unsupported TGA image.");
+        }
+        if (image.dataOffset > size ||
+            (!image.runLength && (size - image.dataOffset) / image.bytesPerPixel / image.width < image.height))
+        {
+            throw std::runtime_error("TGA image data is truncated.");
+        }
+    }
+
+    static inline void convertTgaPixel(const uint8_t * source, const uint32_t bytesPerPixel, uint8_t * output)
+    {
+        if (bytesPerPixel == 1)
+        {
+            output[0] = output[1] = output[2] = source[0];
+            output[3] = 255;
+            return;
+        }
+        output[0] = source[2];
+        output[1] = source[1];
+        output[2] = source[0];
+        output[3] = bytesPerPixel == 4 ? source[3] : 255;
+    }
+
+    static void decodeTga(const uint8_t * data, const size_t size, JobSystem * jobSystem, uint8_t * output)
+    {
+        TgaImage image;
+        readTga(data, size, image);
+
+        const size_t rowSize = static_cast<size_t>(image.width) * 4;
+        auto getRow = [&](const uint32_t y)
+        {
+            return output + (image.topDown ? y : image.height - 1 - y) * rowSize;
+        };
+
+        if (!image.runLength)
+        {
+            forEachRow(jobSystem, image.height, image.width, [&](const uint32_t first, const uint32_t last)
+            {
+                for (uint32_t y = first; y < last; y++)
+                {
+                    const uint8_t * pSource = data + image.dataOffset + static_cast<size_t>(y) * image.width * image.bytesPerPixel;
+                    uint8_t * pDest = getRow(y);
+                    switch (image.bytesPerPixel)
+                    {
+                        case 1: PixelConverter::grayToRgba(pSource, pDest, image.width); break;
+                        case 3: PixelConverter::bgrToRgba(pSource, pDest, image.width); break;
+                        default: PixelConverter::bgraToRgba(pSource, pDest, image.width); break;
+                    }
+                }
+            });
+            return;
+        }
+
+        // Packets may cross rows.
+        const uint8_t * pSource = data + image.dataOffset;
+        const uint8_t * pEnd = data + size;
+        uint32_t x = 0;
+        uint32_t y = 0;
+        uint8_t * pDest = getRow(0);
+        while (y < image.height)
+        {
+            if (pSource >= pEnd)
+            {
+                throw std::runtime_error("TGA image data is truncated.");
+            }
+            const uint8_t header = *pSource++;
+            const uint32_t count = (header & 0x7F) + 1;
+            const bool repeat = (header & 0x80) != 0;
+            if (static_cast<size_t>(pEnd - pSource) < (repeat ? 1 : count) * image.bytesPerPixel)
+            {
+                throw std::runtime_error("TGA image data is truncated.");
+            }
+
+            for (uint32_t i = 0; i < count && y < image.height; i++)
+            {
+                convertTgaPixel(pSource, image.bytesPerPixel, pDest);
+                pDest += 4;
+                if (!repeat)
+                {
+                    pSource += image.bytesPerPixel;
+                }
+                if (++x == image.width)
+                {
+                    x = 0;
+                    if (++y < image.height)
+                    {
+                        pDest = getRow(y);
+                    }
+                }
+            }
+            if (repeat)
+            {
+                pSource += image.bytesPerPixel;
+            }
+        }
+    }
+
+
+    // Passed through containers, DDS and KTX2 files of BC and 8 bit RGBA formats.
+    struct ContainerImage
+    {
+        Vector2ui32             size;
+        Texture::PixelFormat    pixelFormat;
+        uint32_t                levelCount;
+
+        // Swaps red and blue of uncompressed data.
+        bool                    bgra;
+
+        // Offset of each level in the file, DDS levels are tightly packed after the first.
+        std::vector<uint64_t>   levelOffsets;
+    };
+
+    static bool isDds(const uint8_t * data, const size_t size)
+    {
+        return size >= 128 && std::memcmp(data, "DDS ", 4) == 0;
+    }
+
+    static bool isKtx2(const uint8_t * data, const size_t size)
+    {
+        return size >= 80 && std::memcmp(data, g_ktx2Identifier, 12) == 0;
+    }
+
+    static void validateContainer(ContainerImage & image, const size_t size)
+    {
+        if (image.size.x == 0 || image.size.y == 0)
+        {
+            throw std::runtime_error("Image has no pixels.");
+        }
+
+        std::vector<MipmapGenerator::Level> levels;
+        if (TextureCompressor::isCompressed(image.pixelFormat))
+        {
+            if (image.levelCount != MipmapGenerator::getLevelCount(image.size))
+            {
+                throw std::runtime_error("Block compressed images must contain the whole mip chain.");
+            }
+            TextureCompressor::getLevels(image.size, image.levelCount, image.pixelFormat, levels);
+        }
+        else
+        {
+            TextureCompressor::getLevels(image.size, 1, image.pixelFormat, levels);
+        }
+
+        for (size_t i = 0; i < levels.size(); i++)
+        {
+            if (image.levelOffsets[i] > size || size - image.levelOffsets[i] < levels[i].byteSize)
+            {
+                throw std::runtime_error("Image data is truncated.");
+            }
+        }
+    }
+
+    static void readDds(const uint8_t * data, const size_t size, ContainerImage & image)
+    {
+        const uint8_t * pHeader = data + 4;
+        const uint8_t * pPixelFormat = pHeader + 72;
+        if (readUint32(pHeader) != 124)
+        {
+            throw std::runtime_error("Invalid DDS header.");
+        }
+
+        image.size = { readUint32(pHeader + 12), readUint32(pHeader + 8) };
+        image.levelCount = std::max<uint32_t>(readUint32(pHeader + 24), 1);
+        image.bgra = false;
+
+        const uint32_t flags = readUint32(pPixelFormat + 4);
+        const uint8_t * pFourCC = pPixelFormat + 8;
+        size_t dataOffset = 128;
+        bool supported = true;
+        if (std::memcmp(pFourCC, "DX10", 4) == 0)
+        {
+            if (size < 148)
+            {
+                throw std::runtime_error("Invalid DDS header.");
+            }
+            dataOffset = 148;
+
+            // DXGI formats, sRGB variants hold the same blocks.
+            switch (readUint32(data + 128))
+            {
+                case 28: case 29: image.pixelFormat = Texture::PixelFormat::RGBA; break;
+                case 87: case 91: image.pixelFormat = Texture::PixelFormat::RGBA; image.bgra = true; break;
+                case 71: case 72: image.pixelFormat = Texture::PixelFormat::BC1; break;
+                case 77: case 78: image.pixelFormat = Texture::PixelFormat::BC3; break;
+                case 83: image.pixelFormat = Texture::PixelFormat::BC5; break;
+                case 98: case 99: image.pixelFormat = Texture::PixelFormat::BC7; break;
+                default: supported = false; break;
+            }
+        }
+        else if (std::memcmp(pFourCC, "DXT1", 4) == 0)
+        {
+            image.pixelFormat = Texture::PixelFormat::BC1;
+        }
+        else if (std::memcmp(pFourCC, "DXT5", 4) == 0)
+        {
+            image.pixelFormat = Texture::PixelFormat::BC3;
+        }
+        else if (std::memcmp(pFourCC, "ATI2", 4) == 0 || std::memcmp(pFourCC, "BC5U", 4) == 0)
+        {
+            image.pixelFormat = Texture::PixelFormat::BC5;
+        }
+        else if ((flags & 0x40) && readUint32(pPixelFormat + 12) == 32 && readUint32(pPixelFormat + 28) == 0xFF000000)
+        {
+            // Uncompressed with alpha, by channel masks.
+            image.pixelFormat = Texture::PixelFormat::RGBA;
+            image.bgra = readUint32(pPixelFormat + 16) == 0x00FF0000;
+            supported = image.bgra || readUint32(pPixelFormat + 16) == 0x000000FF;
+        }
+        else
+        {
+            supported = false;
+        }
+        if (!supported)
+        {
+            throw std::runtime_error("Unsupported DDS pixel format.");
+        }
+
+        std::vector<MipmapGenerator::Level> levels;
+        TextureCompressor::getLevels(image.size, image.levelCount, image.pixelFormat, levels);
+        image.levelOffsets.clear();
+        for (const auto & level : levels)
+        {
+            image.levelOffsets.push_back(dataOffset + level.offset);
+        }
+        validateContainer(image, size);
+    }
+
+    static void readKtx2(const uint8_t * data, const size_t size, ContainerImage & image)
+    {
+        // Vulkan formats, sRGB variants hold the same blocks.
+        image.bgra = false;
+        switch (readUint32(data + 12))
+        {
+            case 37: case 43: image.pixelFormat = Texture::PixelFormat::RGBA; break;
+            case 44: case 50: image.pixelFormat = Texture::PixelFormat::RGBA; image.bgra = true; break;
+            case 131: case 132: case 133: case 134: image.pixelFormat = Texture::PixelFormat::BC1; break;
+            case 137: case 138: image.pixelFormat = Texture::PixelFormat::BC3; break;
+            case 141: image.pixelFormat = Texture::PixelFormat::BC5; break;
+            case 145: case 146: image.pixelFormat = Texture::PixelFormat::BC7; break;
+            default: throw std::runtime_error("Unsupported KTX2 pixel format.");
+        }
+
+        if (readUint32(data + 44) != 0)
+        {
+            throw std::runtime_error("Supercompressed KTX2 images are not supported.");
+        }
+
+        // Level data starts with the first face of the first layer.
+        image.size = { readUint32(data + 20), readUint32(data + 24) };
+        image.levelCount = std::max<uint32_t>(readUint32(data + 40), 1);
+        if (size < 80 + static_cast<size_t>(image.levelCount) * 24)
+        {
+            throw std::runtime_error("Invalid KTX2 level index.");
+        }
+
+        image.levelOffsets.resize(image.levelCount);
+        for (uint32_t i = 0; i < image.levelCount; i++)
+        {
+            image.levelOffsets[i] = readUint64(data + 80 + static_cast<size_t>(i) * 24);
+        }
+        validateContainer(image, size);
+    }
+
+    static void decodeContainer(const uint8_t * data, const ContainerImage & image, JobSystem * jobSystem, uint8_t * output)
+    {
+        std::vector<MipmapGenerator::Level> levels;
+        if (TextureCompressor::isCompressed(image.pixelFormat))
+        {
+            TextureCompressor::getLevels(image.size, image.levelCount, image.pixelFormat, levels);
+            for (size_t i = 0; i < levels.size(); i++)
+            {
+                std::memcpy(output + levels[i].offset, data + image.levelOffsets[i], levels[i].byteSize);
+            }
+            return;
+        }
+
+        const uint8_t * pSource = data + image.levelOffsets[0];
+        forEachRow(jobSystem, image.size.y, image.size.x, [&](const uint32_t first, const uint32_t last)
+        {
+            const size_t offset = static_cast<size_t>(first) * image.size.x * 4;
+            const size_t rowsSize = static_cast<size_t>(last - first) * image.size.x * 4;
+            if (!image.bgra)
+            {
+                std::memcpy(output + offset, pSource + offset, rowsSize);
+                return;
+            }
+            PixelConverter::bgraToRgba(pSource + offset, output + offset, rowsSize / 4);
+        });
+    }
+
+
+    ImageDecoder::ImageDecoder(JobSystem * jobSystem) :
+        m_pJobSystem(jobSystem)
+    { }
+
+    void ImageDecoder::readFile(const std::string & filename, std::vector<uint8_t> & data)
+    {
+        std::ifstream file(filename, std::ios::binary | std::ios::ate);
+        if (!file.is_open())
+        {
+            throw std::runtime_error("Failed to open image file: " + filename);
+        }
+
+        const std::streamsize size = file.tellg();
+        file.seekg(0, std::ios::beg);
+        data.resize(static_cast<size_t>(size));
+        if (!file.read(reinterpret_cast<char *>(data.data()), size))
+        {
+            throw std::runtime_error("Failed to read image file: " + filename);
+        }
+    }
+
+    ImageDecoder::Info ImageDecoder::readInfo(const uint8_t * data, const size_t size)
+    {
+        Info info;
+        info.pixelFormat = Texture::PixelFormat::RGBA;
+
+        if (isPng(data, size))
+        {
+            PngImage image;
+            readPng(data, size, image);
+            info.format = Format::Png;
+            info.size = { image.width, image.height };
+        }
+        else if (isDds(data, size))
+        {
+            ContainerImage image;
+            readDds(data, size, image);
+            info.format = Format::Dds;
+            info.size = image.size;
+            info.pixelFormat = image.pixelFormat;
+        }
+        else if (isKtx2(data, size))
+        {
+            ContainerImage image;
+            readKtx2(data, size, image);
+            info.format = Format::Ktx2;
+            info.size = image.size;
+            info.pixelFormat = image.pixelFormat;
+        }
+        else if (isTga(data, size))
+        {
+            TgaImage image;
+            readTga(data, size, image);
+            info.format = Format::Tga;
+            info.size = { image.width, image.height };
+        }
+        else
+        {
+            throw std::runtime_error("Unknown image format.");
+        }
+        return info;
+    }
+
+    size_t ImageDecoder::getOutputSize(const Info & info)
+    {
+        return TextureCompressor::getBufferSize(info.size, info.pixelFormat);
+    }
+
+    void ImageDecoder::decode(const uint8_t * data, const size_t size, const Info & info, uint8_t * output) const
+    {
+        switch (info.format)
+        {
+            case Format::Png:
+                decodePng(data, size, output);
+                break;
+            case Format::Tga:
+                decodeTga(data, size, m_pJobSystem, output);
+                break;
+            case Format::Dds:
+            {
+                ContainerImage image;
+                readDds(data, size, image);
+                decodeContainer(data, image, m_pJobSystem, output);
+                break;
+            }
+            case Format::Ktx2:
+            {
+                ContainerImage image;
+                readKtx2(data, size, image);
+                decodeContainer(data, image, m_pJobSystem, output);
+                break;
+            }
+        }
+    }
+
+}
\ No newline at end of file
@@ -0,0 +1,542 @@
+/*
+* MIT License
+*
+* Copyright(c) 2018 Jimmie Bergmann
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*/
+
+#include "flare/graphics/mipmapGenerator.hpp"
+#include "flare/graphics/pixelConverter.hpp"
+#include "flare/system/jobSystem.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define FLARE_MIPMAP_GENERATOR_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace Flare
+{
+
+    // Pixels per job when splitting rows across workers.
+    static const size_t g_pixelsPerJob = 16 * 1024;
+
+    // Kaiser windowed sinc, radius in destination pixels.
+    static const float g_kaiserRadius = 3.0f;
+    static const float g_kaiserAlpha = 4.0f;
+
+    static const size_t g_linearToSrgbSize = 4096;
+    static const size_t g_coverageBins = 4096;
+    static const size_t g_coverageIterations = 16;
+
+    struct GammaTables
+    {
+        GammaTables()
+        {
+            for (size_t i = 0; i < 256; i++)
+            {
+                const float value = static_cast<float>(i) / 255.0f;
+                srgbToLinear[i] = value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+            }
+            for (size_t i = 0; i < g_linearToSrgbSize; i++)
+            {
+                const float value = static_cast<float>(i) / static_cast<float>(g_linearToSrgbSize - 1);
+                const float srgb = value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+                linearToSrgb[i] = static_cast<uint8_t>(std::min(std::max(srgb, 0.0f), 1.0f) * 255.0f + 0.5f);
+            }
+        }
+
+        float   srgbToLinear[256];
+        uint8_t linearToSrgb[g_linearToSrgbSize];
+    };
+
+    static const GammaTables & getGammaTables()
+    {
+        static const GammaTables tables;
+        return tables;
+    }
+
+    // RGBA float image, the intermediate format of all levels.
+    struct FloatImage
+    {
+        Vector2ui32         size;
+        std::vector<float>  pixels;
+
+        void resize(const Vector2ui32 & newSize)
+        {
+            size = newSize;
+            pixels.resize(static_cast<size_t>(size.x) * size.y * 4);
+        }
+
+        float * getRow(const uint32_t y)
+        {
+            return pixels.data() + static_cast<size_t>(y) * size.x * 4;
+        }
+
+        const float * getRow(const uint32_t y) const
+        {
+            return pixels.data() + static_cast<size_t>(y) * size.x * 4;
+        }
+    };
+
+    // Rows of the level being filtered. The float image of the previous level, or the 8 bit source converted
+    // row by row, so the largest level never exists as a float image.
+    struct SourceImage
+    {
+        Vector2ui32         size;
+        const FloatImage *  pImage;
+        const uint8_t *     pBytes;
+        size_t              channels;
+        bool                gammaCorrect;
+
+        const float * getRow(const uint32_t y, float * scratch) const
+        {
+            if (pImage)
+            {
+                return pImage->getRow(y);
+            }
+
+            const float * srgbToLinear = getGammaTables().srgbToLinear;
+            const uint8_t * pSource = pBytes + static_cast<size_t>(y) * size.x * channels;
+            float * pDest = scratch;
+            for (uint32_t x = 0; x < size.x; x++, pSource += channels, pDest += 4)
+            {
+                for (size_t c = 0; c < 3; c++)
+                {
+                    pDest[c] = gammaCorrect ? srgbToLinear[pSource[c]] : static_cast<float>(pSource[c]) * (1.0f / 255.0f);
+                }
+                pDest[3] = channels == 4 ? static_cast<float>(pSource[3]) * (1.0f / 255.0f) : 1.0f;
+            }
+            return scratch;
+        }
+    };
+
+    // Filter taps of one axis, the same number of taps for every destination pixel with source indices clamped to the edge.
+    struct Kernel
+    {
+        size_t              tapCount;
+        std::vector<int>    indices;
+        std::vector<float>  weights;
+    };
+
+    static double besselI0(const double x)
+    {
+        double sum = 1.0;
+        double term = 1.0;
+        const double halfX = x * 0.5;
+        for (int k = 1; k < 32; k++)
+        {
+            term *= (halfX / k) * (halfX / k);
+            sum += term;
+            if (term < sum * 1e-12)
+            {
+                break;
+            }
+        }
+        return sum;
+    }
+
+    static double kaiserSinc(const double x)
+    {
+        const double t = x / g_kaiserRadius;
+        if (t <= -1.0 || t >= 1.0)
+        {
+            return 0.0;
+        }
+
+        const double pi = 3.14159265358979323846;
+        const double sinc = std::abs(x) < 1e-6 ? 1.0 : std::sin(pi * x) / (pi * x);
+        return sinc * besselI0(g_kaiserAlpha * std::sqrt(1.0 - t * t)) / besselI0(g_kaiserAlpha);
+    }
+
+    static void createKernel(const uint32_t sourceSize, const uint32_t destinationSize, const MipmapGenerator::Filter filter, Kernel & kernel)
+    {
+        const double scale = static_cast<double>(sourceSize) / static_cast<double>(destinationSize);
+        const double support = filter == MipmapGenerator::Filter::Kaiser ? g_kaiserRadius * scale : scale * 0.5;
+        const int halfTaps = static_cast<int>(std::ceil(support));
+
+        kernel.tapCount = static_cast<size_t>(halfTaps) * 2 + 1;
+        kernel.indices.resize(kernel.tapCount * destinationSize);
+        kernel.weights.resize(kernel.tapCount * destinationSize);
+
+        for (uint32_t x = 0; x < destinationSize; x++)
+        {
+            const double center = (static_cast<double>(x) + 0.5) * scale;
+            const int first = static_cast<int>(std::floor(center)) - halfTaps;
+            int * pIndices = kernel.indices.data() + x * kernel.tapCount;
+            float * pWeights = kernel.weights.data() + x * kernel.tapCount;
+
+            double sum = 0.0;
+            double weights[64];
+            for (size_t i = 0; i < kernel.tapCount; i++)
+            {
+                const int source = first + static_cast<int>(i);
+                const double distance = (static_cast<double>(source) + 0.5 - center) / scale;
+                double weight = 0.0;
+                if (filter == MipmapGenerator::Filter::Kaiser)
+                {
+                    weight = kaiserSinc(distance);
+                }
+                else
+                {
+                    // Box coverage of the source pixel by the destination pixel.
+                    const double left = std::max(static_cast<double>(source), center - support);
+                    const double right = std::min(static_cast<double>(source) + 1.0, center + support);
+                    weight = std::max(right - left, 0.0);
+                }
+                weights[i] = weight;
+                sum += weight;
+                pIndices[i] = std::min(std::max(source, 0), static_cast<int>(sourceSize) - 1);
+            }
+            for (size_t i = 0; i < kernel.tapCount; i++)
+            {
+                pWeights[i] = static_cast<float>(weights[i] / sum);
+            }
+        }
+    }
+
+    template<typename Func>
+    static void forEachRow(JobSystem * jobSystem, const uint32_t rowCount, const uint32_t width, Func && function)
+    {
+        const size_t rowsPerJob = std::max<size_t>(g_pixelsPerJob / std::max<uint32_t>(width, 1), 1);
+        if (!jobSystem || rowCount <= rowsPerJob)
+        {
+            function(0, rowCount);
+            return;
+        }
+
+        jobSystem->parallelFor(0, rowCount, rowsPerJob, [&function](const size_t first, const size_t last)
+        {
+            function(static_cast<uint32_t>(first), static_cast<uint32_t>(last));
+        });
+    }
+
+    // Weighted sum of source pixels, indexed by the kernel taps with the given pixel stride.
+    static inline void filterPixel(const float * source, const size_t stride, const int * indices, const float * weights,
+                                   const size_t tapCount, float * destination)
+    {
+    #if defined(FLARE_MIPMAP_GENERATOR_SSE2)
+        __m128 sum = _mm_setzero_ps();
+        for (size_t i = 0; i < tapCount; i++)
+        {
+            const __m128 pixel = _mm_loadu_ps(source + static_cast<size_t>(indices[i]) * stride);
+            sum = _mm_add_ps(sum, _mm_mul_ps(pixel, _mm_set1_ps(weights[i])));
+        }
+        _mm_storeu_ps(destination, sum);
+    #else
+        float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        for (size_t i = 0; i < tapCount; i++)
+        {
+            const float * pixel = source + static_cast<size_t>(indices[i]) * stride;
+            for (size_t c = 0; c < 4; c++)
+            {
+                sum[c] += pixel[c] * weights[i];
+            }
+        }
+        std::memcpy(destination, sum, sizeof(sum));
+    #endif
+    }
+
+    static void downsample(JobSystem * jobSystem, const SourceImage & source, FloatImage & destination, FloatImage & temporary,
+                           const MipmapGenerator::Filter filter)
+    {
+        const Vector2ui32 sourceSize = source.size;
+        const Vector2ui32 size = destination.size;
+
+        // The 2x2 box of even sizes has fixed weights, everything else goes through the separable kernels.
+        if (filter == MipmapGenerator::Filter::Box && sourceSize.x == size.x * 2 && sourceSize.y == size.y * 2)
+        {
+            forEachRow(jobSystem, size.y, size.x, [&](const uint32_t first, const uint32_t last)
+            {
+                std::vector<float> scratch(source.pImage ? 0 : static_cast<size_t>(sourceSize.x) * 8);
+                for (uint32_t y = first; y < last; y++)
+                {
+                    const float * pRow0 = source.getRow(y * 2, scratch.data());
+                    const float * pRow1 = source.getRow(y * 2 + 1, scratch.data() + static_cast<size_t>(sourceSize.x) * 4);
+                    float * pDest = destination.getRow(y);
+                    for (uint32_t x = 0; x < size.x; x++, pRow0 += 8, pRow1 += 8, pDest += 4)
+                    {
+                    #if defined(FLARE_MIPMAP_GENERATOR_SSE2)
+                        const __m128 sum = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(pRow0), _mm_loadu_ps(pRow0 + 4)),
+                                                      _mm_add_ps(_mm_loadu_ps(pRow1), _mm_loadu_ps(pRow1 + 4)));
+                        _mm_storeu_ps(pDest, _mm_mul_ps(sum, _mm_set1_ps(0.25f)));
+                    #else
+                        for (size_t c = 0; c < 4; c++)
+                        {
+                            pDest[c] = (pRow0[c] + pRow0[c + 4] + pRow1[c] + pRow1[c + 4]) * 0.25f;
+                        }
+                    #endif
+                    }
+                }
+            });
+            return;
+        }
+
+        Kernel horizontal;
+        Kernel vertical;
+        createKernel(sourceSize.x, size.x, filter, horizontal);
+        createKernel(sourceSize.y, size.y, filter, vertical);
+
+        temporary.resize({ size.x, sourceSize.y });
+        forEachRow(jobSystem, sourceSize.y, size.x, [&](const uint32_t first, const uint32_t last)
+        {
+            std::vector<float> scratch(source.pImage ? 0 : static_cast<size_t>(sourceSize.x) * 4);
+            for (uint32_t y = first; y < last; y++)
+            {
+                const float * pSource = source.getRow(y, scratch.data());
+                float * pDest = temporary.getRow(y);
+                for (uint32_t x = 0; x < size.x; x++)
+                {
+                    filterPixel(pSource, 4, horizontal.indices.data() + x * horizontal.tapCount,
+                                horizontal.weights.data() + x * horizontal.tapCount, horizontal.tapCount, pDest + x * 4);
+                }
+            }
+        });
+
+        // Negative lobes of the Kaiser filter may overshoot, clamped so the error does not grow with every level.
+        const size_t stride = static_cast<size_t>(size.x) * 4;
+        forEachRow(jobSystem, size.y, size.x, [&](const uint32_t first, const uint32_t last)
+        {
+            for (uint32_t y = first; y < last; y++)
+            {
+                const int * pIndices = vertical.indices.data() + y * vertical.tapCount;
+                const float * pWeights = vertical.weights.data() + y * vertical.tapCount;
+                float * pDest = destination.getRow(y);
+                for (uint32_t x = 0; x < size.x; x++, pDest += 4)
+                {
+                    filterPixel(temporary.pixels.data() + x * 4, stride, pIndices, pWeights, vertical.tapCount, pDest);
+                #if defined(FLARE_MIPMAP_GENERATOR_SSE2)
+                    _mm_storeu_ps(pDest, _mm_min_ps(_mm_max_ps(_mm_loadu_ps(pDest), _mm_setzero_ps()), _mm_set1_ps(1.0f)));
+                #else
+                    for (size_t c = 0; c < 4; c++)
+                    {
+                        pDest[c] = std::min(std::max(pDest[c], 0.0f), 1.0f);
+                    }
+                #endif
+                }
+            }
+        });
+    }
+
+    static void createCoverageHistogram(const FloatImage & image, std::vector<size_t> & histogram)
+    {
+        histogram.assign(g_coverageBins, 0);
+        const size_t pixelCount = static_cast<size_t>(image.size.x) * image.size.y;
+        for (size_t i = 0; i < pixelCount; i++)
+        {
+            const float alpha = std::min(std::max(image.pixels[i * 4 + 3], 0.0f), 1.0f);
+            histogram[static_cast<size_t>(alpha * static_cast<float>(g_coverageBins - 1) + 0.5f)]++;
+        }
+    }
+
+    static void createCoverageHistogram(const uint8_t * source, const size_t pixelCount, std::vector<size_t> & histogram)
+    {
+        histogram.assign(g_coverageBins, 0);
+        for (size_t i = 0; i < pixelCount; i++)
+        {
+            histogram[(static_cast<size_t>(source[i * 4 + 3]) * (g_coverageBins - 1) + 127) / 255]++;
+        }
+    }
+
+    static float getCoverage(const std::vector<size_t> & histogram, const float scale, const float reference)
+    {
+        size_t passed = 0;
+        size_t total = 0;
+        for (size_t i = 0; i < histogram.size(); i++)
+        {
+            const float alpha = static_cast<float>(i) / static_cast<float>(g_coverageBins - 1);
+            passed += alpha * scale > reference ? histogram[i] : 0;
+            total += histogram[i];
+        }
+        return total ? static_cast<float>(passed) / static_cast<float>(total) : 0.0f;
+    }
+
+    static float findAlphaScale(const std::vector<size_t> & histogram, const float targetCoverage, const float reference)
+    {
+        // Coverage grows with the scale, binary search the smallest scale reaching the target.
+        float low = 0.0f;
+        float high = 4.0f;
+        for (size_t i = 0; i < g_coverageIterations; i++)
+        {
+            const float middle = (low + high) * 0.5f;
+            if (getCoverage(histogram, middle, reference) < targetCoverage)
+            {
+                low = middle;
+            }
+            else
+            {
+                high = middle;
+            }
+        }
+        return high;
+    }
+
+    static void writeLevel(JobSystem * jobSystem, const FloatImage & image, uint8_t * output, const bool gammaCorrect, const float alphaScale)
+    {
+        const GammaTables & tables = getGammaTables();
+        const float colorScale = gammaCorrect ? static_cast<float>(g_linearToSrgbSize - 1) : 255.0f;
+
+        forEachRow(jobSystem, image.size.y, image.size.x, [&](const uint32_t first, const uint32_t last)
+        {
+            for (uint32_t y = first; y < last; y++)
+            {
+                const float * pSource = image.getRow(y);
+                uint8_t * pDest = output + static_cast<size_t>(y) * image.size.x * 4;
+                for (uint32_t x = 0; x < image.size.x; x++, pSource += 4, pDest += 4)
+                {
+                    int32_t values[4];
+                #if defined(FLARE_MIPMAP_GENERATOR_SSE2)
+                    const __m128 scale = _mm_set_ps(alphaScale * 255.0f, colorScale, colorScale, colorScale);
+                    const __m128 limit = _mm_set_ps(255.0f, colorScale, colorScale, colorScale);
+                    const __m128 scaled = _mm_mul_ps(_mm_loadu_ps(pSource), scale);
+                    const __m128 clamped = _mm_min_ps(_mm_max_ps(scaled, _mm_setzero_ps()), limit);
+                    _mm_storeu_si128(reinterpret_cast<__m128i *>(values), _mm_cvtps_epi32(clamped));
+                #else
+                    for (size_t c = 0; c < 3; c++)
+                    {
+                        values[c] = static_cast<int32_t>(std::min(std::max(pSource[c] * colorScale, 0.0f), colorScale) + 0.5f);
+                    }
+                    values[3] = static_cast<int32_t>(std::min(std::max(pSource[3] * alphaScale * 255.0f, 0.0f), 255.0f) + 0.5f);
+                #endif
+                    for (size_t c = 0; c < 3; c++)
+                    {
+                        pDest[c] = gammaCorrect ? tables.linearToSrgb[values[c]] : static_cast<uint8_t>(values[c]);
+                    }
+                    pDest[3] = static_cast<uint8_t>(values[3]);
+                }
+            }
+        });
+    }
+
+    MipmapGenerator::Settings::Settings() :
+        filter(Filter::Box),
+        gammaCorrect(true),
+        preserveAlphaCoverage(false),
+        alphaReference(0.5f),
+        maxLevels(0)
+    { }
+
+    MipmapGenerator::MipmapGenerator(JobSystem * jobSystem) :
+        m_pJobSystem(jobSystem)
+    { }
+
+    uint32_t MipmapGenerator::getLevelCount(const Vector2ui32 & size, const uint32_t maxLevels)
+    {
+        uint32_t levelCount = 1;
+        for (uint32_t largest = std::max(size.x, size.y); largest > 1; largest >>= 1)
+        {
+            levelCount++;
+        }
+        return maxLevels ? std::min(levelCount, maxLevels) : levelCount;
+    }
+
+    size_t MipmapGenerator::getLevels(const Vector2ui32 & size, const uint32_t levelCount, std::vector<Level> & levels)
+    {
+        levels.resize(levelCount);
+
+        size_t offset = 0;
+        Vector2ui32 levelSize = size;
+        for (auto & level : levels)
+        {
+            level.size = levelSize;
+            level.offset = offset;
+            level.byteSize = static_cast<size_t>(levelSize.x) * levelSize.y * 4;
+            offset += level.byteSize;
+            levelSize = { std::max<uint32_t>(levelSize.x / 2, 1), std::max<uint32_t>(levelSize.y / 2, 1) };
+        }
+        return offset;
+    }
+
+    void MipmapGenerator::generate(const uint8_t * source, const Vector2ui32 & size, const Texture::PixelFormat pixelFormat,
+                                   uint8_t * output, const std::vector<Level> & levels, const Settings & settings) const
+    {
+        if (levels.empty() || levels[0].size.x != size.x || levels[0].size.y != size.y)
+        {
+            throw std::runtime_error("Mipmap levels do not match the source image.");
+        }
+        if (pixelFormat != Texture::PixelFormat::RGB && pixelFormat != Texture::PixelFormat::RGBA)
+        {
+            throw std::runtime_error("Mipmaps can only be generated from uncompressed images.");
+        }
+
+        const size_t channels = pixelFormat == Texture::PixelFormat::RGBA ? 4 : 3;
+
+        // The first level is the source itself, expanded to RGBA. RGBA sources may already be in place.
+        uint8_t * pFirstLevel = output + levels[0].offset;
+        forEachRow(m_pJobSystem, size.y, size.x, [&](const uint32_t first, const uint32_t last)
+        {
+            const size_t pixelCount = static_cast<size_t>(last - first) * size.x;
+            const uint8_t * pSource = source + static_cast<size_t>(first) * size.x * channels;
+            uint8_t * pDest = pFirstLevel + static_cast<size_t>(first) * size.x * 4;
+            if (channels == 4)
+            {
+                if (pDest != pSource)
+                {
+                    std::memcpy(pDest, pSource, pixelCount * 4);
+                }
+                return;
+            }
+            PixelConverter::rgbToRgba(pSource, pDest, pixelCount);
+        });
+
+        const bool preserveCoverage = settings.preserveAlphaCoverage && channels == 4;
+        std::vector<size_t> histogram;
+        float targetCoverage = 0.0f;
+        if (preserveCoverage)
+        {
+            createCoverageHistogram(source, static_cast<size_t>(size.x) * size.y, histogram);
+            targetCoverage = getCoverage(histogram, 1.0f, settings.alphaReference);
+        }
+
+        // Levels depend on the previous one, the work within each level is split into row tiles.
+        FloatImage current;
+        FloatImage next;
+        FloatImage temporary;
+        for (size_t i = 1; i < levels.size(); i++)
+        {
+            const SourceImage previous = { levels[i - 1].size, i > 1 ? &current : nullptr, source, channels, settings.gammaCorrect };
+            next.resize(levels[i].size);
+            downsample(m_pJobSystem, previous, next, temporary, settings.filter);
+
+            // The unscaled level is kept for filtering the next one, only the output is scaled.
+            float alphaScale = 1.0f;
+            if (preserveCoverage)
+            {
+                createCoverageHistogram(next, histogram);
+                alphaScale = findAlphaScale(histogram, targetCoverage, settings.alphaReference);
+            }
+
+            writeLevel(m_pJobSystem, next, output + levels[i].offset, settings.gammaCorrect, alphaScale);
+            std::swap(current, next);
+        }
+    }
+
+    void MipmapGenerator::generate(const uint8_t * source, const Vector2ui32 & size, const Texture::PixelFormat pixelFormat,
+                                   std::vector<uint8_t> & output, std::vector<Level> & levels, const Settings & settings) const
+    {
+        output.resize(getLevels(size, getLevelCount(size, settings.maxLevels), levels));
+        generate(source, size, pixelFormat, output.data(), levels, settings);
+    }
+
+}
\ No newline at end of file
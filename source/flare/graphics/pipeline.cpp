@@ -32,4 +32,7 @@ namespace Flare
         m_renderer(renderer)
     { }
 
+    Pipeline::~Pipeline()
+    { }
+
 }
\ No newline at end of file
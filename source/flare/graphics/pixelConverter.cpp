@@ -0,0 +1,234 @@
+/*
+* MIT License
+*
+* Copyright(c) 2018 Jimmie Bergmann
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*/
+
+#include "flare/graphics/pixelConverter.hpp"
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define FLARE_PIXEL_CONVERTER_SSE2
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define FLARE_PIXEL_CONVERTER_SSSE3_TARGET
+#else
+#include <cpuid.h>
+#define FLARE_PIXEL_CONVERTER_SSSE3_TARGET __attribute__((target("ssse3")))
+#endif
+#endif
+
+namespace Flare
+{
+
+    static inline uint32_t load32(const uint8_t * source)
+    {
+        uint32_t value;
+        std::memcpy(&value, source, 4);
+        return value;
+    }
+
+    static inline uint32_t swapRedBlue(const uint32_t pixel)
+    {
+        return (pixel & 0xFF00FF00) | ((pixel & 0xFF) << 16) | ((pixel >> 16) & 0xFF);
+    }
+
+    // Four pixels from three 32 bit words, little endian.
+    template<bool Swap>
+    static void expandWords(const uint8_t *& source, uint8_t *& output, size_t & pixelCount)
+    {
+        for (; pixelCount >= 4; pixelCount -= 4, source += 12, output += 16)
+        {
+            const uint32_t word0 = load32(source);
+            const uint32_t word1 = load32(source + 4);
+            const uint32_t word2 = load32(source + 8);
+            uint32_t pixels[4] =
+            {
+                word0 | 0xFF000000,
+                (word0 >> 24) | (word1 << 8) | 0xFF000000,
+                (word1 >> 16) | (word2 << 16) | 0xFF000000,
+                (word2 >> 8) | 0xFF000000
+            };
+            if (Swap)
+            {
+                for (auto & pixel : pixels)
+                {
+                    pixel = swapRedBlue(pixel);
+                }
+            }
+            std::memcpy(output, pixels, 16);
+        }
+    }
+
+    template<bool Swap>
+    static void expandRemaining(const uint8_t * source, uint8_t * output, const size_t pixelCount)
+    {
+        for (size_t i = 0; i < pixelCount; i++, source += 3, output += 4)
+        {
+            output[0] = source[Swap ? 2 : 0];
+            output[1] = source[1];
+            output[2] = source[Swap ? 0 : 2];
+            output[3] = 255;
+        }
+    }
+
+#if defined(FLARE_PIXEL_CONVERTER_SSE2)
+
+    static bool detectSsse3()
+    {
+    #if defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 1);
+        return (info[2] & (1 << 9)) != 0;
+    #else
+        unsigned int eax, ebx, ecx, edx;
+        return __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & (1 << 9)) != 0;
+    #endif
+    }
+
+    static const bool g_hasSsse3 = detectSsse3();
+
+    // Sixteen 3 byte pixels, shuffled from 48 bytes in four steps of 12 bytes.
+    FLARE_PIXEL_CONVERTER_SSSE3_TARGET
+    static void expandSsse3(const uint8_t *& source, uint8_t *& output, size_t & pixelCount, const __m128i shuffle)
+    {
+        const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xFF000000));
+        for (; pixelCount >= 16; pixelCount -= 16, source += 48, output += 64)
+        {
+            const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(source));
+            const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(source + 16));
+            const __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i *>(source + 32));
+
+            __m128i * pOutput = reinterpret_cast<__m128i *>(output);
+            _mm_storeu_si128(pOutput + 0, _mm_or_si128(_mm_shuffle_epi8(a, shuffle), alpha));
+            _mm_storeu_si128(pOutput + 1, _mm_or_si128(_mm_shuffle_epi8(_mm_alignr_epi8(b, a, 12), shuffle), alpha));
+            _mm_storeu_si128(pOutput + 2, _mm_or_si128(_mm_shuffle_epi8(_mm_alignr_epi8(c, b, 8), shuffle), alpha));
+            _mm_storeu_si128(pOutput + 3, _mm_or_si128(_mm_shuffle_epi8(_mm_srli_si128(c, 4), shuffle), alpha));
+        }
+    }
+
+    FLARE_PIXEL_CONVERTER_SSSE3_TARGET
+    static void swizzleSsse3(const uint8_t *& source, uint8_t *& output, size_t & pixelCount)
+    {
+        const __m128i shuffle = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+        for (; pixelCount >= 4; pixelCount -= 4, source += 16, output += 16)
+        {
+            const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i *>(source));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(output), _mm_shuffle_epi8(pixels, shuffle));
+        }
+    }
+
+#endif
+
+    void PixelConverter::rgbToRgba(const uint8_t * source, uint8_t * output, const size_t pixelCount)
+    {
+        size_t remaining = pixelCount;
+    #if defined(FLARE_PIXEL_CONVERTER_SSE2)
+        if (g_hasSsse3)
+        {
+            expandSsse3(source, output, remaining, _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1));
+        }
+    #endif
+        expandWords<false>(source, output, remaining);
+        expandRemaining<false>(source, output, remaining);
+    }
+
+    void PixelConverter::bgrToRgba(const uint8_t * source, uint8_t * output, const size_t pixelCount)
+    {
+        size_t remaining = pixelCount;
+    #if defined(FLARE_PIXEL_CONVERTER_SSE2)
+        if (g_hasSsse3)
+        {
+            expandSsse3(source, output, remaining, _mm_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1));
+        }
+    #endif
+        expandWords<true>(source, output, remaining);
+        expandRemaining<true>(source, output, remaining);
+    }
+
+    void PixelConverter::bgraToRgba(const uint8_t * source, uint8_t * output, const size_t pixelCount)
+    {
+        size_t remaining = pixelCount;
+    #if defined(FLARE_PIXEL_CONVERTER_SSE2)
+        if (g_hasSsse3)
+        {
+            swizzleSsse3(source, output, remaining);
+        }
+        else
+        {
+            // Red and blue moved within each 32 bit pixel.
+            const __m128i redBlue = _mm_set1_epi32(0x00FF00FF);
+            for (; remaining >= 4; remaining -= 4, source += 16, output += 16)
+            {
+                const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i *>(source));
+                const __m128i swapped = _mm_and_si128(pixels, redBlue);
+                const __m128i result = _mm_or_si128(_mm_andnot_si128(redBlue, pixels),
+                                                    _mm_or_si128(_mm_slli_epi32(swapped, 16), _mm_srli_epi32(swapped, 16)));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(output), result);
+            }
+        }
+    #endif
+        for (; remaining > 0; remaining--, source += 4, output += 4)
+        {
+            const uint32_t pixel = swapRedBlue(load32(source));
+            std::memcpy(output, &pixel, 4);
+        }
+    }
+
+    void PixelConverter::grayToRgba(const uint8_t * source, uint8_t * output, const size_t pixelCount)
+    {
+        size_t remaining = pixelCount;
+    #if defined(FLARE_PIXEL_CONVERTER_SSE2)
+        // Gray interleaved with itself and with opaque alpha, then the pairs interleaved.
+        const __m128i alpha = _mm_set1_epi8(-1);
+        for (; remaining >= 16; remaining -= 16, source += 16, output += 64)
+        {
+            const __m128i gray = _mm_loadu_si128(reinterpret_cast<const __m128i *>(source));
+            const __m128i grayGray[2] = { _mm_unpacklo_epi8(gray, gray), _mm_unpackhi_epi8(gray, gray) };
+            const __m128i grayAlpha[2] = { _mm_unpacklo_epi8(gray, alpha), _mm_unpackhi_epi8(gray, alpha) };
+
+            __m128i * pOutput = reinterpret_cast<__m128i *>(output);
+            _mm_storeu_si128(pOutput + 0, _mm_unpacklo_epi16(grayGray[0], grayAlpha[0]));
+            _mm_storeu_si128(pOutput + 1, _mm_unpackhi_epi16(grayGray[0], grayAlpha[0]));
+            _mm_storeu_si128(pOutput + 2, _mm_unpacklo_epi16(grayGray[1], grayAlpha[1]));
+            _mm_storeu_si128(pOutput + 3, _mm_unpackhi_epi16(grayGray[1], grayAlpha[1]));
+        }
+    #endif
+        for (; remaining > 0; remaining--, source++, output += 4)
+        {
+            output[0] = output[1] = output[2] = source[0];
+            output[3] = 255;
+        }
+    }
+
+    bool PixelConverter::hasSsse3()
+    {
+    #if defined(FLARE_PIXEL_CONVERTER_SSE2)
+        return g_hasSsse3;
+    #else
+        return false;
+    #endif
+    }
+
+}
\ No newline at end of file
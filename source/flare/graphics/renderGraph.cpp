@@ -0,0 +1,420 @@
+/*
+* MIT License
+*
+* Copyright(c) 2018 Jimmie Bergmann
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*/
+
+#include "flare/graphics/renderGraph.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+namespace Flare
+{
+
+    static bool isAttachment(const RenderGraphAccess access)
+    {
+        return access != RenderGraphAccess::Sampled;
+    }
+
+    // Accesses in the same layout class need no barrier between two reads.
+    static bool isSameLayout(const RenderGraphAccess first, const RenderGraphAccess second)
+    {
+        const bool firstShaderRead = first == RenderGraphAccess::InputAttachment || first == RenderGraphAccess::Sampled;
+        const bool secondShaderRead = second == RenderGraphAccess::InputAttachment || second == RenderGraphAccess::Sampled;
+        return first == second || (firstShaderRead && secondShaderRead);
+    }
+
+
+    // Render graph builder.
+    void RenderGraphBuilder::setName(const std::string & name)
+    {
+        m_graph.m_passes[m_pass].name = name;
+    }
+
+    void RenderGraphBuilder::setSideEffects()
+    {
+        m_graph.m_passes[m_pass].sideEffects = true;
+    }
+
+    RenderGraphResource RenderGraphBuilder::create(const std::string & name, const RenderGraphResourceDesc & desc)
+    {
+        if (find(name) != InvalidResource)
+        {
+            throw std::runtime_error("Render graph resource \"" + name + "\" already exists.");
+        }
+        if (desc.format == RenderGraphFormat::Backbuffer)
+        {
+            throw std::runtime_error("Render graph resource \"" + name + "\" cannot have the backbuffer format.");
+        }
+
+        m_graph.m_resources.push_back({ name, desc, false, RenderGraph::InvalidIndex, RenderGraph::InvalidIndex });
+        return static_cast<RenderGraphResource>(m_graph.m_resources.size() - 1);
+    }
+
+    RenderGraphResource RenderGraphBuilder::find(const std::string & name) const
+    {
+        for (size_t i = 0; i < m_graph.m_resources.size(); i++)
+        {
+            if (m_graph.m_resources[i].name == name)
+            {
+                return static_cast<RenderGraphResource>(i);
+            }
+        }
+        return InvalidResource;
+    }
+
+    RenderGraphResource RenderGraphBuilder::getBackbuffer() const
+    {
+        return m_graph.m_backbuffer;
+    }
+
+    void RenderGraphBuilder::read(const RenderGraphResource resource, const RenderGraphAccess access)
+    {
+        if (resource >= m_graph.m_resources.size())
+        {
+            throw std::runtime_error("Reading invalid render graph resource.");
+        }
+
+        // Reading an attachment that is also written, e.g. for blending, is a single access.
+        std::vector<RenderGraph::Access> & accesses = m_graph.m_passes[m_pass].accesses;
+        for (auto & current : accesses)
+        {
+            if (current.resource == resource)
+            {
+                if (current.access != access)
+                {
+                    throw std::runtime_error("Render graph resource is accessed in different ways by the same pass.");
+                }
+                current.read = true;
+                return;
+            }
+        }
+
+        accesses.push_back({ resource, access, true, false });
+    }
+
+    void RenderGraphBuilder::write(const RenderGraphResource resource, const RenderGraphAccess access)
+    {
+        if (resource >= m_graph.m_resources.size())
+        {
+            throw std::runtime_error("Writing invalid render graph resource.");
+        }
+        if (access != RenderGraphAccess::ColorAttachment && access != RenderGraphAccess::DepthAttachment)
+        {
+            throw std::runtime_error("Render graph resources can only be written as attachments.");
+        }
+
+        std::vector<RenderGraph::Access> & accesses = m_graph.m_passes[m_pass].accesses;
+        for (auto & current : accesses)
+        {
+            if (current.resource == resource)
+            {
+                if (current.access != access)
+                {
+                    throw std::runtime_error("Render graph resource is accessed in different ways by the same pass.");
+                }
+                current.write = true;
+                return;
+            }
+        }
+
+        accesses.push_back({ resource, access, false, true });
+    }
+
+    RenderGraphBuilder::RenderGraphBuilder(RenderGraph & graph, const uint32_t pass) :
+        m_graph(graph),
+        m_pass(pass)
+    { }
+
+
+    // Render graph context.
+    RenderGraphContext::~RenderGraphContext()
+    { }
+
+
+    // Render graph.
+    RenderGraph::RenderGraph() :
+        m_backbuffer(RenderGraphBuilder::InvalidResource)
+    { }
+
+    void RenderGraph::clear()
+    {
+        m_passes.clear();
+        m_resources.clear();
+        m_batches.clear();
+        m_backbuffer = RenderGraphBuilder::InvalidResource;
+    }
+
+    void RenderGraph::setup(Multipass & multipass)
+    {
+        clear();
+
+        RenderGraphResourceDesc backbufferDesc = { RenderGraphFormat::Backbuffer, { 0, 0 } };
+        m_resources.push_back({ "Backbuffer", backbufferDesc, true, InvalidIndex, InvalidIndex });
+        m_backbuffer = 0;
+
+        setupSubpass(&multipass);
+    }
+
+    void RenderGraph::compile()
+    {
+        cullPasses();
+        mergePasses();
+        computeBarriers();
+        computeLifetimes();
+    }
+
+    const std::vector<RenderGraph::Pass> & RenderGraph::getPasses() const
+    {
+        return m_passes;
+    }
+
+    const std::vector<RenderGraph::Resource> & RenderGraph::getResources() const
+    {
+        return m_resources;
+    }
+
+    const std::vector<RenderGraph::Batch> & RenderGraph::getBatches() const
+    {
+        return m_batches;
+    }
+
+    RenderGraphResource RenderGraph::getBackbuffer() const
+    {
+        return m_backbuffer;
+    }
+
+    uint32_t RenderGraph::findPass(const Subpass * subpass) const
+    {
+        for (size_t i = 0; i < m_passes.size(); i++)
+        {
+            if (m_passes[i].subpass == subpass)
+            {
+                return static_cast<uint32_t>(i);
+            }
+        }
+        return InvalidIndex;
+    }
+
+    bool RenderGraph::canAlias(const RenderGraphResource first, const RenderGraphResource second) const
+    {
+        const Resource & a = m_resources[first];
+        const Resource & b = m_resources[second];
+        if (a.imported || b.imported || a.firstBatch == InvalidIndex || b.firstBatch == InvalidIndex)
+        {
+            return false;
+        }
+
+        return a.lastBatch < b.firstBatch || b.lastBatch < a.firstBatch;
+    }
+
+    void RenderGraph::setupSubpass(Subpass * subpass)
+    {
+        if (auto multipass = dynamic_cast<Multipass *>(subpass))
+        {
+            for (auto it = multipass->firstSubpass(); it != multipass->lastSubpass(); ++it)
+            {
+                setupSubpass(*it);
+            }
+            return;
+        }
+
+        const uint32_t index = static_cast<uint32_t>(m_passes.size());
+        m_passes.push_back({ subpass, "Subpass", {}, {}, false, false, InvalidIndex });
+
+        RenderGraphBuilder builder(*this, index);
+        subpass->setup(builder);
+    }
+
+    void RenderGraph::cullPasses()
+    {
+        // Walk backwards, a pass is needed if it has side effects or writes something a later needed pass reads.
+        std::vector<bool> needed(m_resources.size(), false);
+        needed[m_backbuffer] = true;
+
+        for (size_t i = m_passes.size(); i-- > 0;)
+        {
+            Pass & pass = m_passes[i];
+
+            bool live = pass.sideEffects;
+            for (auto & access : pass.accesses)
+            {
+                live = live || (access.write && needed[access.resource]);
+            }
+
+            pass.culled = !live;
+            if (!live)
+            {
+                continue;
+            }
+
+            // Attachment writes replace the previous contents, unless the pass reads them too.
+            for (auto & access : pass.accesses)
+            {
+                if (access.read)
+                {
+                    needed[access.resource] = true;
+                }
+                else if (access.resource != m_backbuffer)
+                {
+                    needed[access.resource] = false;
+                }
+            }
+        }
+    }
+
+    void RenderGraph::mergePasses()
+    {
+        m_batches.clear();
+        for (uint32_t i = 0; i < m_passes.size(); i++)
+        {
+            Pass & pass = m_passes[i];
+            if (pass.culled)
+            {
+                continue;
+            }
+
+            if (!m_batches.size() || !canMerge(m_batches.back(), pass))
+            {
+                m_batches.push_back(Batch());
+            }
+
+            pass.batch = static_cast<uint32_t>(m_batches.size() - 1);
+            m_batches.back().passes.push_back(i);
+        }
+    }
+
+    void RenderGraph::computeBarriers()
+    {
+        struct State
+        {
+            RenderGraphAccess   access;
+            bool                write;
+            uint32_t            pass;
+        };
+        std::vector<State> states(m_resources.size(), State{ RenderGraphAccess::Sampled, false, InvalidIndex });
+
+        for (uint32_t i = 0; i < m_passes.size(); i++)
+        {
+            Pass & pass = m_passes[i];
+            pass.barriers.clear();
+            if (pass.culled)
+            {
+                continue;
+            }
+
+            for (auto & access : pass.accesses)
+            {
+                State & state = states[access.resource];
+                const bool discard = state.pass == InvalidIndex;
+
+                // Reads following reads in the same layout need no synchronization.
+                if (discard || state.write || access.write || !isSameLayout(state.access, access.access))
+                {
+                    pass.barriers.push_back({ access.resource, state.access, state.write, access.access, access.read, access.write, discard, state.pass });
+                }
+
+                state = { access.access, access.write, i };
+            }
+        }
+    }
+
+    void RenderGraph::computeLifetimes()
+    {
+        for (auto & resource : m_resources)
+        {
+            resource.firstBatch = InvalidIndex;
+            resource.lastBatch = InvalidIndex;
+        }
+
+        // Lifetimes cover whole batches, every attachment of a render pass is bound for all of its subpasses.
+        for (auto & pass : m_passes)
+        {
+            if (pass.culled)
+            {
+                continue;
+            }
+
+            for (auto & access : pass.accesses)
+            {
+                Resource & resource = m_resources[access.resource];
+                resource.firstBatch = std::min(resource.firstBatch, pass.batch);
+                resource.lastBatch = resource.lastBatch == InvalidIndex ? pass.batch : std::max(resource.lastBatch, pass.batch);
+            }
+        }
+    }
+
+    bool RenderGraph::canMerge(const Batch & batch, const Pass & pass) const
+    {
+        bool hasSize = false;
+        Vector2ui32 size(0, 0);
+
+        auto matchSize = [&](const RenderGraphResource resource)
+        {
+            const Vector2ui32 resourceSize = m_resources[resource].desc.size;
+            if (!hasSize)
+            {
+                size = resourceSize;
+                hasSize = true;
+            }
+            return size.x == resourceSize.x && size.y == resourceSize.y;
+        };
+
+        for (auto passIndex : batch.passes)
+        {
+            for (auto & access : m_passes[passIndex].accesses)
+            {
+                if (isAttachment(access.access))
+                {
+                    matchSize(access.resource);
+                }
+            }
+        }
+
+        for (auto & access : pass.accesses)
+        {
+            if (isAttachment(access.access) && !matchSize(access.resource))
+            {
+                return false;
+            }
+
+            // Data produced within a render pass may only be read back pixel locally, as input attachment.
+            for (auto passIndex : batch.passes)
+            {
+                for (auto & previous : m_passes[passIndex].accesses)
+                {
+                    if (previous.resource != access.resource)
+                    {
+                        continue;
+                    }
+                    if (access.access == RenderGraphAccess::Sampled || previous.access == RenderGraphAccess::Sampled)
+                    {
+                        return false;
+                    }
+                }
+            }
+        }
+
+        return true;
+    }
+
+}
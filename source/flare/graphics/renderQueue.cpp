@@ -0,0 +1,143 @@
+/*
+* MIT License
+*
+* Copyright(c) 2018 Jimmie Bergmann
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*/
+
+#include "flare/graphics/renderQueue.hpp"
+#include <algorithm>
+
+namespace Flare
+{
+
+    // Below this size an insertion sort is cheaper than building the histograms.
+    static const size_t g_insertionSortThreshold = 64;
+
+    uint64_t RenderQueue::createKey(const uint32_t pass, const uint32_t pipeline, const uint32_t material, const uint32_t mesh, const float depth)
+    {
+        const float clampedDepth = std::min(std::max(depth, 0.0f), 1.0f);
+        const uint64_t quantizedDepth = static_cast<uint64_t>(clampedDepth * 65535.0f + 0.5f);
+
+        return (static_cast<uint64_t>(pass & (MaxPasses - 1)) << 60) |
+               (static_cast<uint64_t>(pipeline & (MaxPipelines - 1)) << 48) |
+               (static_cast<uint64_t>(material & (MaxMaterials - 1)) << 32) |
+               (static_cast<uint64_t>(mesh & (MaxMeshes - 1)) << 16) |
+               quantizedDepth;
+    }
+
+    RenderQueue::RenderQueue()
+    { }
+
+    void RenderQueue::clear()
+    {
+        m_items.clear();
+    }
+
+    void RenderQueue::reserve(const size_t count)
+    {
+        m_items.reserve(count);
+        m_scratch.reserve(count);
+    }
+
+    void RenderQueue::push(const uint64_t key, const uint32_t index)
+    {
+        m_items.push_back(Item{ key, index });
+    }
+
+    void RenderQueue::sort()
+    {
+        const size_t count = m_items.size();
+        if (count <= g_insertionSortThreshold)
+        {
+            for (size_t i = 1; i < count; i++)
+            {
+                const Item item = m_items[i];
+                size_t j = i;
+                for (; j > 0 && m_items[j - 1].key > item.key; j--)
+                {
+                    m_items[j] = m_items[j - 1];
+                }
+                m_items[j] = item;
+            }
+            return;
+        }
+
+        // All eight byte histograms in a single pass over the keys.
+        size_t histograms[8][256] = {};
+        for (const auto & item : m_items)
+        {
+            uint64_t key = item.key;
+            for (size_t digit = 0; digit < 8; digit++)
+            {
+                histograms[digit][key & 0xFF]++;
+                key >>= 8;
+            }
+        }
+
+        m_scratch.resize(count);
+        Item * pSource = m_items.data();
+        Item * pDestination = m_scratch.data();
+
+        for (size_t digit = 0; digit < 8; digit++)
+        {
+            size_t * histogram = histograms[digit];
+
+            // Bytes equal in every key, usually the pass and high pipeline bits, leave the order as it is.
+            const size_t shift = digit * 8;
+            if (histogram[(pSource[0].key >> shift) & 0xFF] == count)
+            {
+                continue;
+            }
+
+            size_t offset = 0;
+            for (size_t i = 0; i < 256; i++)
+            {
+                const size_t bucketSize = histogram[i];
+                histogram[i] = offset;
+                offset += bucketSize;
+            }
+
+            for (size_t i = 0; i < count; i++)
+            {
+                const Item & item = pSource[i];
+                pDestination[histogram[(item.key >> shift) & 0xFF]++] = item;
+            }
+            std::swap(pSource, pDestination);
+        }
+
+        if (pSource != m_items.data())
+        {
+            m_items.swap(m_scratch);
+        }
+    }
+
+    size_t RenderQueue::getSize() const
+    {
+        return m_items.size();
+    }
+
+    const std::vector<RenderQueue::Item> & RenderQueue::getItems() const
+    {
+        return m_items;
+    }
+
+}
\ No newline at end of file
@@ -38,7 +38,15 @@ namespace Flare
         m_debug(false),
 #endif
         m_frameRate(0),
-        m_pWindow(nullptr)
+        m_maxFramesInFlight(2),
+        m_pWindow(nullptr),
+        m_pJobSystem(nullptr),
+        m_gpuProfiling(false),
+        m_headless(false),
+        m_headlessSize(1280, 720),
+        m_presentMode(PresentMode::Mailbox),
+        m_swapChainImageCount(0),
+        m_lowLatency(false)
     {
         for (int i = 1; i < argc; i++)
         {
@@ -54,8 +62,17 @@ namespace Flare
 #endif
         m_arguments(settings.m_arguments),
         m_frameRate(settings.m_frameRate),
+        m_maxFramesInFlight(settings.m_maxFramesInFlight),
         m_pWindow(settings.m_pWindow),
-        m_windowProxy(settings.m_windowProxy)
+        m_windowProxy(settings.m_windowProxy),
+        m_pJobSystem(settings.m_pJobSystem),
+        m_pipelineCacheFile(settings.m_pipelineCacheFile),
+        m_gpuProfiling(settings.m_gpuProfiling),
+        m_headless(settings.m_headless),
+        m_headlessSize(settings.m_headlessSize),
+        m_presentMode(settings.m_presentMode),
+        m_swapChainImageCount(settings.m_swapChainImageCount),
+        m_lowLatency(settings.m_lowLatency)
     { }
 
     void RendererSettings::setArguments(const int argc, const char ** argv)
@@ -103,6 +120,16 @@ namespace Flare
         return m_frameRate;
     }
 
+    void RendererSettings::setMaxFramesInFlight(const size_t count)
+    {
+        m_maxFramesInFlight = count;
+    }
+
+    size_t RendererSettings::getMaxFramesInFlight() const
+    {
+        return m_maxFramesInFlight;
+    }
+
     void RendererSettings::setWindow(Window * window)
     {
         m_pWindow = window;
@@ -123,6 +150,124 @@ namespace Flare
         return m_windowProxy;
     }
 
+    void RendererSettings::setJobSystem(JobSystem * jobSystem)
+    {
+        m_pJobSystem = jobSystem;
+    }
+
+    JobSystem * RendererSettings::getJobSystem() const
+    {
+        return m_pJobSystem;
+    }
+
+    void RendererSettings::setPipelineCacheFile(const std::string & filename)
+    {
+        m_pipelineCacheFile = filename;
+    }
+
+    const std::string & RendererSettings::getPipelineCacheFile() const
+    {
+        return m_pipelineCacheFile;
+    }
+
+    void RendererSettings::setGpuProfiling(const bool flag)
+    {
+        m_gpuProfiling = flag;
+    }
+
+    bool RendererSettings::getGpuProfiling() const
+    {
+        return m_gpuProfiling;
+    }
+
+    void RendererSettings::setHeadless(const bool flag)
+    {
+        m_headless = flag;
+    }
+
+    bool RendererSettings::getHeadless() const
+    {
+        return m_headless;
+    }
+
+    void RendererSettings::setHeadlessSize(const Vector2ui32 & size)
+    {
+        m_headlessSize = size;
+    }
+
+    const Vector2ui32 & RendererSettings::getHeadlessSize() const
+    {
+        return m_headlessSize;
+    }
+
+    void RendererSettings::setPresentMode(const PresentMode presentMode)
+    {
+        m_presentMode = presentMode;
+    }
+
+    PresentMode RendererSettings::getPresentMode() const
+    {
+        return m_presentMode;
+    }
+
+    void RendererSettings::setSwapChainImageCount(const uint32_t count)
+    {
+        m_swapChainImageCount = count;
+    }
+
+    uint32_t RendererSettings::getSwapChainImageCount() const
+    {
+        return m_swapChainImageCount;
+    }
+
+    void RendererSettings::setLowLatency(const bool flag)
+    {
+        m_lowLatency = flag;
+    }
+
+    bool RendererSettings::getLowLatency() const
+    {
+        return m_lowLatency;
+    }
+
+    // Render latency.
+    RenderLatency::RenderLatency() :
+        frameCount(0),
+        lastLatency(0.0),
+        averageLatency(0.0),
+        maxLatency(0.0)
+    { }
+
+    void RenderLatency::record(const double latency)
+    {
+        frameCount++;
+        lastLatency = latency;
+        averageLatency += (latency - averageLatency) / static_cast<double>(frameCount);
+        maxLatency = latency > maxLatency ? latency : maxLatency;
+    }
+
+    // Draw statistics
+    DrawStatistics::DrawStatistics() :
+        draws(0),
+        pipelineBinds(0),
+        pipelineBindsAvoided(0),
+        constantPushes(0),
+        constantPushesAvoided(0),
+        vertexBufferBinds(0),
+        vertexBufferBindsAvoided(0)
+    { }
+
+    void DrawStatistics::add(const DrawStatistics & statistics)
+    {
+        draws += statistics.draws;
+        pipelineBinds += statistics.pipelineBinds;
+        pipelineBindsAvoided += statistics.pipelineBindsAvoided;
+        constantPushes += statistics.constantPushes;
+        constantPushesAvoided += statistics.constantPushesAvoided;
+        vertexBufferBinds += statistics.vertexBufferBinds;
+        vertexBufferBindsAvoided += statistics.vertexBufferBindsAvoided;
+    }
+
     // Render object
     RenderObject::~RenderObject()
     {
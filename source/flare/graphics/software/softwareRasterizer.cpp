@@ -0,0 +1,791 @@
+/*
+* MIT License
+*
+* Copyright(c) 2018 Jimmie Bergmann
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*/
+
+#include "flare/graphics/software/softwareRasterizer.hpp"
+#include "flare/system/jobSystem.hpp"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define FLARE_SOFTWARE_RASTERIZER_SSE2
+#include <emmintrin.h>
+#endif
+
+#define FLARE_SUBPIXEL_BITS 4
+#define FLARE_SUBPIXEL_SIZE (1 << FLARE_SUBPIXEL_BITS)
+#define FLARE_GUARD_BAND_PIXELS 8192.0f
+
+namespace Flare
+{
+
+    static uint32_t packUnorm(const float value)
+    {
+        return static_cast<uint32_t>(std::min(std::max(value, 0.0f), 1.0f) * 255.0f + 0.5f);
+    }
+
+    static uint32_t packColor(const float r, const float g, const float b, const float a)
+    {
+        return packUnorm(r) | (packUnorm(g) << 8) | (packUnorm(b) << 16) | (packUnorm(a) << 24);
+    }
+
+    // Alpha marks pixels covered by geometry.
+    static uint32_t packNormal(const float x, const float y, const float z)
+    {
+        return packUnorm(x * 0.5f + 0.5f) | (packUnorm(y * 0.5f + 0.5f) << 8) | (packUnorm(z * 0.5f + 0.5f) << 16) | 0xFF000000;
+    }
+
+    static float unpackUnorm(const uint32_t value, const uint32_t shift)
+    {
+        return static_cast<float>((value >> shift) & 0xFF) / 255.0f;
+    }
+
+    // Coverage of four horizontally adjacent pixels by the three edges of a triangle.
+    class EdgeLanes
+    {
+
+    public:
+
+        EdgeLanes(const int32_t * pSteps)
+        {
+            for (size_t i = 0; i < 3; i++)
+            {
+            #if defined(FLARE_SOFTWARE_RASTERIZER_SSE2)
+                m_steps[i] = _mm_set_epi32(pSteps[i] * 3, pSteps[i] * 2, pSteps[i], 0);
+            #else
+                m_steps[i] = pSteps[i];
+            #endif
+            }
+        }
+
+        // Pixels are covered if no edge function is negative.
+        uint32_t getCoverage(const int32_t * pEdges) const
+        {
+        #if defined(FLARE_SOFTWARE_RASTERIZER_SSE2)
+            const __m128i edge0 = _mm_add_epi32(_mm_set1_epi32(pEdges[0]), m_steps[0]);
+            const __m128i edge1 = _mm_add_epi32(_mm_set1_epi32(pEdges[1]), m_steps[1]);
+            const __m128i edge2 = _mm_add_epi32(_mm_set1_epi32(pEdges[2]), m_steps[2]);
+            const __m128i outside = _mm_or_si128(_mm_or_si128(edge0, edge1), edge2);
+            return ~static_cast<uint32_t>(_mm_movemask_ps(_mm_castsi128_ps(outside))) & 0xF;
+        #else
+            uint32_t coverage = 0;
+            for (int32_t lane = 0; lane < 4; lane++)
+            {
+                const int32_t outside = (pEdges[0] + m_steps[0] * lane) | (pEdges[1] + m_steps[1] * lane) | (pEdges[2] + m_steps[2] * lane);
+                coverage |= outside >= 0 ? (1 << lane) : 0;
+            }
+            return coverage;
+        #endif
+        }
+
+    private:
+
+    #if defined(FLARE_SOFTWARE_RASTERIZER_SSE2)
+        __m128i m_steps[3];
+    #else
+        int32_t m_steps[3];
+    #endif
+
+    };
+
+    // Depth tests four pixels with less and writes the passing depths, returns the passing pixels.
+    static uint32_t testDepth(const float origin, const float dx, const float dy, const float x, const float y,
+                              float * pDepth, const uint32_t mask)
+    {
+        const float rowDepth = origin + dy * y;
+
+    #if defined(FLARE_SOFTWARE_RASTERIZER_SSE2)
+        const __m128 laneX = _mm_add_ps(_mm_set1_ps(x), _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f));
+        const __m128 depth = _mm_add_ps(_mm_set1_ps(rowDepth), _mm_mul_ps(_mm_set1_ps(dx), laneX));
+        const __m128 stored = _mm_loadu_ps(pDepth);
+        const uint32_t passed = static_cast<uint32_t>(_mm_movemask_ps(_mm_cmplt_ps(depth, stored))) & mask;
+        if (!passed)
+        {
+            return 0;
+        }
+
+        const __m128i bits = _mm_set_epi32(8, 4, 2, 1);
+        const __m128 select = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32(static_cast<int32_t>(passed)), bits), bits));
+        _mm_storeu_ps(pDepth, _mm_or_ps(_mm_and_ps(select, depth), _mm_andnot_ps(select, stored)));
+        return passed;
+    #else
+        uint32_t passed = 0;
+        for (uint32_t lane = 0; lane < 4; lane++)
+        {
+            const float depth = rowDepth + dx * (x + static_cast<float>(lane));
+            if ((mask & (1 << lane)) && depth < pDepth[lane])
+            {
+                pDepth[lane] = depth;
+                passed |= 1 << lane;
+            }
+        }
+        return passed;
+    #endif
+    }
+
+
+    // Software rasterizer.
+    SoftwareRasterizer::SoftwareRasterizer() :
+        m_size(0, 0),
+        m_stride(0),
+        m_paddedHeight(0),
+        m_tileCountX(0),
+        m_tileCountY(0),
+        m_backFaceCulling(true),
+        m_clearAlbedo(0xFF000000),
+        m_clearDepth(1.0f),
+        m_statistics{}
+    { }
+
+    void SoftwareRasterizer::resize(const Vector2ui32 & size)
+    {
+        if (size.x > MaxSize || size.y > MaxSize)
+        {
+            throw std::runtime_error("Software rasterizer size exceeds the maximum size.");
+        }
+
+        m_vertices.clear();
+        m_size = size;
+        m_stride = (size.x + TileSize - 1) / TileSize * TileSize;
+        m_paddedHeight = (size.y + TileSize - 1) / TileSize * TileSize;
+        m_tileCountX = m_stride / TileSize;
+        m_tileCountY = m_paddedHeight / TileSize;
+
+        const size_t pixelCount = static_cast<size_t>(m_stride) * m_paddedHeight;
+        m_albedo.assign(pixelCount, 0);
+        m_normal.assign(pixelCount, 0);
+        m_depth.assign(pixelCount, 0.0f);
+        m_blockDepth.assign(pixelCount / (BlockSize * BlockSize), 0.0f);
+        m_color.assign(static_cast<size_t>(size.x) * size.y, 0);
+
+        m_tiles.clear();
+        m_tiles.resize(static_cast<size_t>(m_tileCountX) * m_tileCountY);
+        clear(Vector4f(0.0f, 0.0f, 0.0f, 1.0f), 1.0f);
+    }
+
+    void SoftwareRasterizer::clear(const Vector4f & color, const float depth)
+    {
+        m_clearAlbedo = packColor(color.x, color.y, color.z, color.w);
+        m_clearDepth = depth;
+        for (auto & tile : m_tiles)
+        {
+            tile.triangles.clear();
+            tile.clear = true;
+        }
+        m_vertices.clear();
+
+        std::lock_guard<std::mutex> lock(m_statisticsMutex);
+        m_statistics = Statistics{};
+    }
+
+    void SoftwareRasterizer::setBackFaceCulling(const bool flag)
+    {
+        m_backFaceCulling = flag;
+    }
+
+    void SoftwareRasterizer::draw(const SoftwareVertex * pVertices, const size_t vertexCount)
+    {
+        m_vertices.insert(m_vertices.end(), pVertices, pVertices + (vertexCount / 3 * 3));
+
+        std::lock_guard<std::mutex> lock(m_statisticsMutex);
+        m_statistics.draws++;
+    }
+
+    void SoftwareRasterizer::flush(JobSystem & jobSystem)
+    {
+        const size_t triangleCount = m_size.x && m_size.y ? m_vertices.size() / 3 : 0;
+        const size_t chunkCount = (triangleCount + TriangleChunkSize - 1) / TriangleChunkSize;
+        if (m_chunks.size() < chunkCount)
+        {
+            m_chunks.resize(chunkCount);
+        }
+
+        // Set up chunks in parallel, binning them in order keeps the draw order within every tile.
+        jobSystem.parallelFor(0, chunkCount, 1, [this, triangleCount](const size_t first, const size_t last)
+        {
+            for (size_t i = first; i < last; i++)
+            {
+                setupTriangles(m_chunks[i], i * TriangleChunkSize, std::min((i + 1) * TriangleChunkSize, triangleCount));
+            }
+        });
+        binTriangles(chunkCount);
+
+        // Tiles without triangles still need their pending clear.
+        jobSystem.parallelFor(0, m_tiles.size(), 1, [this](const size_t first, const size_t last)
+        {
+            for (size_t i = first; i < last; i++)
+            {
+                rasterizeTile(static_cast<uint32_t>(i % m_tileCountX), static_cast<uint32_t>(i / m_tileCountX));
+            }
+        });
+
+        std::lock_guard<std::mutex> lock(m_statisticsMutex);
+        m_statistics.triangles += triangleCount;
+        for (size_t i = 0; i < chunkCount; i++)
+        {
+            m_statistics.culledTriangles += m_chunks[i].culledTriangles;
+            m_statistics.clippedTriangles += m_chunks[i].clippedTriangles;
+        }
+        m_vertices.clear();
+    }
+
+    void SoftwareRasterizer::resolve(JobSystem & jobSystem, const SoftwareLighting & lighting)
+    {
+        const float directionLength = lighting.direction.length();
+        const Vector3f direction = directionLength > 0.0f ? lighting.direction / directionLength : Vector3f(0.0f, 0.0f, 0.0f);
+
+        jobSystem.parallelFor(0, m_size.y, 0, [this, &lighting, &direction](const size_t first, const size_t last)
+        {
+            for (size_t y = first; y < last; y++)
+            {
+                const uint32_t * pAlbedo = &m_albedo[y * m_stride];
+                const uint32_t * pNormal = &m_normal[y * m_stride];
+                uint32_t * pColor = &m_color[y * m_size.x];
+
+                for (size_t x = 0; x < m_size.x; x++)
+                {
+                    const uint32_t albedo = pAlbedo[x];
+                    const uint32_t normal = pNormal[x];
+                    if (!(normal >> 24))
+                    {
+                        pColor[x] = albedo;
+                        continue;
+                    }
+
+                    const Vector3f surfaceNormal(unpackUnorm(normal, 0) * 2.0f - 1.0f,
+                                                 unpackUnorm(normal, 8) * 2.0f - 1.0f,
+                                                 unpackUnorm(normal, 16) * 2.0f - 1.0f);
+                    const float diffuse = std::max(-surfaceNormal.dot(direction), 0.0f);
+                    const Vector3f light = lighting.ambient + lighting.color * diffuse;
+
+                    pColor[x] = packColor(unpackUnorm(albedo, 0) * light.x, unpackUnorm(albedo, 8) * light.y,
+                                          unpackUnorm(albedo, 16) * light.z, unpackUnorm(albedo, 24));
+                }
+            }
+        });
+    }
+
+    const Vector2ui32 & SoftwareRasterizer::getSize() const
+    {
+        return m_size;
+    }
+
+    SoftwareRasterizer::Statistics SoftwareRasterizer::getStatistics() const
+    {
+        std::lock_guard<std::mutex> lock(m_statisticsMutex);
+        return m_statistics;
+    }
+
+    const std::vector<uint32_t> & SoftwareRasterizer::getColorBuffer() const
+    {
+        return m_color;
+    }
+
+    uint32_t SoftwareRasterizer::getStride() const
+    {
+        return m_stride;
+    }
+
+    const std::vector<uint32_t> & SoftwareRasterizer::getAlbedoBuffer() const
+    {
+        return m_albedo;
+    }
+
+    const std::vector<uint32_t> & SoftwareRasterizer::getNormalBuffer() const
+    {
+        return m_normal;
+    }
+
+    const std::vector<float> & SoftwareRasterizer::getDepthBuffer() const
+    {
+        return m_depth;
+    }
+
+    void SoftwareRasterizer::setupTriangles(TriangleChunk & chunk, const size_t first, const size_t last)
+    {
+        chunk.triangles.clear();
+        chunk.culledTriangles = 0;
+        chunk.clippedTriangles = 0;
+
+        for (size_t i = first; i < last; i++)
+        {
+            ClipVertex vertices[3];
+            for (size_t j = 0; j < 3; j++)
+            {
+                const SoftwareVertex & vertex = m_vertices[i * 3 + j];
+                ClipVertex & clipVertex = vertices[j];
+                for (size_t k = 0; k < 4; k++)
+                {
+                    clipVertex.position[k] = vertex.position.v[k];
+                    clipVertex.attributes[k] = vertex.color.v[k];
+                }
+                for (size_t k = 0; k < 3; k++)
+                {
+                    clipVertex.attributes[4 + k] = vertex.normal.v[k];
+                }
+            }
+
+            clipTriangle(chunk, vertices);
+        }
+    }
+
+    void SoftwareRasterizer::clipTriangle(TriangleChunk & chunk, const ClipVertex * pVertices)
+    {
+        // Near and far plane, followed by a guard band around the viewport. Triangles within the guard band
+        // are never clipped, it only bounds the fixed-point range of the edge functions.
+        const float guardX = 1.0f + 2.0f * FLARE_GUARD_BAND_PIXELS / static_cast<float>(m_size.x);
+        const float guardY = 1.0f + 2.0f * FLARE_GUARD_BAND_PIXELS / static_cast<float>(m_size.y);
+        const float clipPlanes[6][4] =
+        {
+            { 0.0f, 0.0f, 1.0f, 0.0f }, { 0.0f, 0.0f, -1.0f, 1.0f },
+            { 1.0f, 0.0f, 0.0f, guardX }, { -1.0f, 0.0f, 0.0f, guardX },
+            { 0.0f, 1.0f, 0.0f, guardY }, { 0.0f, -1.0f, 0.0f, guardY }
+        };
+
+        uint32_t viewportOutside = 0xFFFFFFFF;
+        uint32_t clipOutside = 0;
+        for (size_t i = 0; i < 3; i++)
+        {
+            const float * p = pVertices[i].position;
+            const uint32_t outside =
+                (p[2] < 0.0f ? 1 : 0) | (p[2] > p[3] ? 2 : 0) |
+                (p[0] < -p[3] ? 4 : 0) | (p[0] > p[3] ? 8 : 0) | (p[1] < -p[3] ? 16 : 0) | (p[1] > p[3] ? 32 : 0);
+            viewportOutside &= outside;
+
+            for (size_t j = 0; j < 6; j++)
+            {
+                const float * plane = clipPlanes[j];
+                clipOutside |= (plane[0] * p[0] + plane[1] * p[1] + plane[2] * p[2] + plane[3] * p[3]) < 0.0f ? (1 << j) : 0;
+            }
+        }
+
+        // All vertices outside the same plane of the view volume.
+        if (viewportOutside)
+        {
+            chunk.culledTriangles++;
+            return;
+        }
+        if (!clipOutside)
+        {
+            setupTriangle(chunk, pVertices[0], pVertices[1], pVertices[2]);
+            return;
+        }
+
+        // Sutherland-Hodgman against the crossed planes, every plane adds at most one vertex.
+        ClipVertex polygons[2][9];
+        size_t vertexCount = 3;
+        std::copy(pVertices, pVertices + 3, polygons[0]);
+        size_t current = 0;
+
+        for (size_t i = 0; i < 6 && vertexCount >= 3; i++)
+        {
+            if (!(clipOutside & (1 << i)))
+            {
+                continue;
+            }
+
+            const float * plane = clipPlanes[i];
+            const ClipVertex * pInput = polygons[current];
+            ClipVertex * pOutput = polygons[current ^ 1];
+            size_t outputCount = 0;
+
+            for (size_t j = 0; j < vertexCount; j++)
+            {
+                const ClipVertex & from = pInput[j];
+                const ClipVertex & to = pInput[(j + 1) % vertexCount];
+                const float fromDistance = plane[0] * from.position[0] + plane[1] * from.position[1] + plane[2] * from.position[2] + plane[3] * from.position[3];
+                const float toDistance = plane[0] * to.position[0] + plane[1] * to.position[1] + plane[2] * to.position[2] + plane[3] * to.position[3];
+
+                if (fromDistance >= 0.0f)
+                {
+                    pOutput[outputCount++] = from;
+                }
+                if ((fromDistance >= 0.0f) != (toDistance >= 0.0f))
+                {
+                    const float t = fromDistance / (fromDistance - toDistance);
+                    ClipVertex & vertex = pOutput[outputCount++];
+                    for (size_t k = 0; k < 4; k++)
+                    {
+                        vertex.position[k] = from.position[k] + (to.position[k] - from.position[k]) * t;
+                    }
+                    for (size_t k = 0; k < AttributeCount; k++)
+                    {
+                        vertex.attributes[k] = from.attributes[k] + (to.attributes[k] - from.attributes[k]) * t;
+                    }
+                }
+            }
+
+            vertexCount = outputCount;
+            current ^= 1;
+        }
+
+        chunk.clippedTriangles++;
+        for (size_t i = 2; i < vertexCount; i++)
+        {
+            setupTriangle(chunk, polygons[current][0], polygons[current][i - 1], polygons[current][i]);
+        }
+    }
+
+    void SoftwareRasterizer::setupTriangle(TriangleChunk & chunk, const ClipVertex & vertex0, const ClipVertex & vertex1, const ClipVertex & vertex2)
+    {
+        const ClipVertex * pVertices[3] = { &vertex0, &vertex1, &vertex2 };
+        float invW[3];
+        int32_t x[3];
+        int32_t y[3];
+
+        // Snap to fixed-point framebuffer coordinates.
+        for (size_t i = 0; i < 3; i++)
+        {
+            const float * p = pVertices[i]->position;
+            invW[i] = 1.0f / p[3];
+            const float screenX = (p[0] * invW[i] * 0.5f + 0.5f) * static_cast<float>(m_size.x);
+            const float screenY = (p[1] * invW[i] * 0.5f + 0.5f) * static_cast<float>(m_size.y);
+            x[i] = static_cast<int32_t>(std::floor(screenX * FLARE_SUBPIXEL_SIZE + 0.5f));
+            y[i] = static_cast<int32_t>(std::floor(screenY * FLARE_SUBPIXEL_SIZE + 0.5f));
+        }
+
+        // Positive area is clockwise with y pointing down.
+        const int64_t area = static_cast<int64_t>(x[1] - x[0]) * (y[2] - y[0]) - static_cast<int64_t>(x[2] - x[0]) * (y[1] - y[0]);
+        if (area == 0 || (area < 0 && m_backFaceCulling))
+        {
+            chunk.culledTriangles++;
+            return;
+        }
+        if (area < 0)
+        {
+            std::swap(pVertices[1], pVertices[2]);
+            std::swap(invW[1], invW[2]);
+            std::swap(x[1], x[2]);
+            std::swap(y[1], y[2]);
+        }
+
+        // Pixels with their centers inside the bounds, clamped to the viewport.
+        Triangle triangle;
+        const int32_t halfPixel = FLARE_SUBPIXEL_SIZE / 2;
+        triangle.minX = std::max((std::min(std::min(x[0], x[1]), x[2]) - halfPixel + FLARE_SUBPIXEL_SIZE - 1) >> FLARE_SUBPIXEL_BITS, 0);
+        triangle.minY = std::max((std::min(std::min(y[0], y[1]), y[2]) - halfPixel + FLARE_SUBPIXEL_SIZE - 1) >> FLARE_SUBPIXEL_BITS, 0);
+        triangle.maxX = std::min((std::max(std::max(x[0], x[1]), x[2]) - halfPixel) >> FLARE_SUBPIXEL_BITS, static_cast<int32_t>(m_size.x) - 1);
+        triangle.maxY = std::min((std::max(std::max(y[0], y[1]), y[2]) - halfPixel) >> FLARE_SUBPIXEL_BITS, static_cast<int32_t>(m_size.y) - 1);
+        if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+        {
+            chunk.culledTriangles++;
+            return;
+        }
+
+        // Edge functions at pixel centers, positive inside. Pixel centers exactly on an edge belong to
+        // the triangle if it is a top or left edge, the bias turns the test into >= 0 for all edges.
+        static const size_t edgeVertices[3][2] = { { 1, 2 }, { 2, 0 }, { 0, 1 } };
+        for (size_t i = 0; i < 3; i++)
+        {
+            const size_t from = edgeVertices[i][0];
+            const size_t to = edgeVertices[i][1];
+            const int64_t a = static_cast<int64_t>(y[from]) - y[to];
+            const int64_t b = static_cast<int64_t>(x[to]) - x[from];
+            const bool topLeft = a > 0 || (a == 0 && b > 0);
+
+            triangle.edgeOrigin[i] = a * (halfPixel - x[from]) + b * (halfPixel - y[from]) - (topLeft ? 0 : 1);
+            triangle.edgeDx[i] = static_cast<int32_t>(a * FLARE_SUBPIXEL_SIZE);
+            triangle.edgeDy[i] = static_cast<int32_t>(b * FLARE_SUBPIXEL_SIZE);
+        }
+
+        // Interpolation planes of depth, 1/w and attributes/w, the latter two give perspective correct attributes.
+        const float x0 = static_cast<float>(x[0]) / FLARE_SUBPIXEL_SIZE;
+        const float y0 = static_cast<float>(y[0]) / FLARE_SUBPIXEL_SIZE;
+        const float dx1 = static_cast<float>(x[1]) / FLARE_SUBPIXEL_SIZE - x0;
+        const float dy1 = static_cast<float>(y[1]) / FLARE_SUBPIXEL_SIZE - y0;
+        const float dx2 = static_cast<float>(x[2]) / FLARE_SUBPIXEL_SIZE - x0;
+        const float dy2 = static_cast<float>(y[2]) / FLARE_SUBPIXEL_SIZE - y0;
+        const float invDeterminant = 1.0f / (dx1 * dy2 - dx2 * dy1);
+
+        auto createPlane = [dx1, dy1, dx2, dy2, invDeterminant](const float value0, const float value1, const float value2)
+        {
+            Plane plane;
+            plane.origin = value0;
+            plane.dx = ((value1 - value0) * dy2 - (value2 - value0) * dy1) * invDeterminant;
+            plane.dy = ((value2 - value0) * dx1 - (value1 - value0) * dx2) * invDeterminant;
+            return plane;
+        };
+
+        float depth[3];
+        for (size_t i = 0; i < 3; i++)
+        {
+            depth[i] = pVertices[i]->position[2] * invW[i];
+        }
+
+        triangle.originX = x0;
+        triangle.originY = y0;
+        triangle.minDepth = std::max(std::min(std::min(depth[0], depth[1]), depth[2]), 0.0f);
+        triangle.depth = createPlane(depth[0], depth[1], depth[2]);
+        triangle.invW = createPlane(invW[0], invW[1], invW[2]);
+        for (size_t i = 0; i < AttributeCount; i++)
+        {
+            triangle.attributes[i] = createPlane(pVertices[0]->attributes[i] * invW[0],
+                                                 pVertices[1]->attributes[i] * invW[1],
+                                                 pVertices[2]->attributes[i] * invW[2]);
+        }
+
+        chunk.triangles.push_back(triangle);
+    }
+
+    void SoftwareRasterizer::binTriangles(const size_t chunkCount)
+    {
+        uint64_t binnedTriangles = 0;
+
+        for (size_t i = 0; i < chunkCount; i++)
+        {
+            for (const auto & triangle : m_chunks[i].triangles)
+            {
+                const uint32_t minTileX = static_cast<uint32_t>(triangle.minX) / TileSize;
+                const uint32_t minTileY = static_cast<uint32_t>(triangle.minY) / TileSize;
+                const uint32_t maxTileX = static_cast<uint32_t>(triangle.maxX) / TileSize;
+                const uint32_t maxTileY = static_cast<uint32_t>(triangle.maxY) / TileSize;
+
+                for (uint32_t tileY = minTileY; tileY <= maxTileY; tileY++)
+                {
+                    for (uint32_t tileX = minTileX; tileX <= maxTileX; tileX++)
+                    {
+                        m_tiles[tileY * m_tileCountX + tileX].triangles.push_back(&triangle);
+                    }
+                }
+                binnedTriangles += (maxTileX - minTileX + 1) * (maxTileY - minTileY + 1);
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(m_statisticsMutex);
+        m_statistics.binnedTriangles += binnedTriangles;
+    }
+
+    void SoftwareRasterizer::clearTile(const uint32_t tileX, const uint32_t tileY)
+    {
+        // Padding outside of the viewport gets a depth no pixel passes, it neither receives pixels
+        // nor holds back the maximum depth of its blocks.
+        const uint32_t tileWidth = TileSize;
+        const uint32_t visibleWidth = std::min(m_size.x - std::min(m_size.x, tileX * TileSize), tileWidth);
+        for (uint32_t y = tileY * TileSize; y < (tileY + 1) * TileSize; y++)
+        {
+            const size_t index = static_cast<size_t>(y) * m_stride + tileX * TileSize;
+            const size_t visibleEnd = index + (y < m_size.y ? visibleWidth : 0);
+            std::fill(m_albedo.begin() + index, m_albedo.begin() + index + TileSize, m_clearAlbedo);
+            std::fill(m_normal.begin() + index, m_normal.begin() + index + TileSize, 0);
+            std::fill(m_depth.begin() + index, m_depth.begin() + visibleEnd, m_clearDepth);
+            std::fill(m_depth.begin() + visibleEnd, m_depth.begin() + index + TileSize, 0.0f);
+        }
+
+        const uint32_t blocksPerRow = m_stride / BlockSize;
+        Tile & tile = m_tiles[tileY * m_tileCountX + tileX];
+        tile.maxDepth = 0.0f;
+        for (uint32_t y = tileY * TileSize; y < (tileY + 1) * TileSize; y += BlockSize)
+        {
+            for (uint32_t x = tileX * TileSize; x < (tileX + 1) * TileSize; x += BlockSize)
+            {
+                const float blockDepth = computeBlockDepth(x, y);
+                m_blockDepth[static_cast<size_t>(y / BlockSize) * blocksPerRow + x / BlockSize] = blockDepth;
+                tile.maxDepth = std::max(tile.maxDepth, blockDepth);
+            }
+        }
+        tile.clear = false;
+    }
+
+    void SoftwareRasterizer::rasterizeTile(const uint32_t tileX, const uint32_t tileY)
+    {
+        Tile & tile = m_tiles[tileY * m_tileCountX + tileX];
+        if (tile.clear)
+        {
+            clearTile(tileX, tileY);
+        }
+        if (tile.triangles.empty())
+        {
+            return;
+        }
+
+        const int32_t tileMinX = static_cast<int32_t>(tileX * TileSize);
+        const int32_t tileMinY = static_cast<int32_t>(tileY * TileSize);
+        const uint32_t blocksPerRow = m_stride / BlockSize;
+        const int32_t blockMask = ~static_cast<int32_t>(BlockSize - 1);
+        const int64_t blockReach = BlockSize - 1;
+        Statistics statistics = {};
+
+        for (const Triangle * pTriangle : tile.triangles)
+        {
+            const Triangle & triangle = *pTriangle;
+            if (triangle.minDepth >= tile.maxDepth)
+            {
+                statistics.rejectedTiles++;
+                continue;
+            }
+
+            const int32_t minX = std::max(triangle.minX, tileMinX) & blockMask;
+            const int32_t minY = std::max(triangle.minY, tileMinY) & blockMask;
+            const int32_t maxX = std::min(triangle.maxX, tileMinX + static_cast<int32_t>(TileSize) - 1);
+            const int32_t maxY = std::min(triangle.maxY, tileMinY + static_cast<int32_t>(TileSize) - 1);
+            bool written = false;
+
+            for (int32_t blockY = minY; blockY <= maxY; blockY += BlockSize)
+            {
+                for (int32_t blockX = minX; blockX <= maxX; blockX += BlockSize)
+                {
+                    // Classify the block against every edge by its extreme corners.
+                    int32_t edges[3];
+                    bool full = true;
+                    bool outside = false;
+                    for (size_t i = 0; i < 3 && !outside; i++)
+                    {
+                        const int64_t dx = triangle.edgeDx[i];
+                        const int64_t dy = triangle.edgeDy[i];
+                        const int64_t value = triangle.edgeOrigin[i] + dx * blockX + dy * blockY;
+                        const int64_t maxValue = value + blockReach * (std::max<int64_t>(dx, 0) + std::max<int64_t>(dy, 0));
+                        const int64_t minValue = value + blockReach * (std::min<int64_t>(dx, 0) + std::min<int64_t>(dy, 0));
+
+                        outside = maxValue < 0;
+                        if (minValue >= 0)
+                        {
+                            // Inside over the whole block, any positive value that cannot overflow within it will do.
+                            edges[i] = 1 << 29;
+                        }
+                        else
+                        {
+                            edges[i] = static_cast<int32_t>(value);
+                            full = false;
+                        }
+                    }
+                    if (outside)
+                    {
+                        continue;
+                    }
+
+                    float & blockDepth = m_blockDepth[static_cast<size_t>(blockY / BlockSize) * blocksPerRow + blockX / BlockSize];
+                    if (triangle.minDepth >= blockDepth)
+                    {
+                        statistics.rejectedBlocks++;
+                        continue;
+                    }
+
+                    statistics.rasterizedBlocks++;
+                    if (rasterizeBlock(triangle, blockX, blockY, edges, full))
+                    {
+                        blockDepth = computeBlockDepth(blockX, blockY);
+                        written = true;
+                    }
+                }
+            }
+
+            if (written)
+            {
+                tile.maxDepth = 0.0f;
+                for (uint32_t y = tileY * TileSize / BlockSize; y < (tileY + 1) * TileSize / BlockSize; y++)
+                {
+                    const float * pBlockDepth = &m_blockDepth[static_cast<size_t>(y) * blocksPerRow + tileX * TileSize / BlockSize];
+                    tile.maxDepth = std::max(tile.maxDepth, *std::max_element(pBlockDepth, pBlockDepth + TileSize / BlockSize));
+                }
+            }
+        }
+        tile.triangles.clear();
+
+        std::lock_guard<std::mutex> lock(m_statisticsMutex);
+        m_statistics.rasterizedBlocks += statistics.rasterizedBlocks;
+        m_statistics.rejectedBlocks += statistics.rejectedBlocks;
+        m_statistics.rejectedTiles += statistics.rejectedTiles;
+    }
+
+    bool SoftwareRasterizer::rasterizeBlock(const Triangle & triangle, const uint32_t blockX, const uint32_t blockY, const int32_t * pEdges, const bool full)
+    {
+        const EdgeLanes lanes(triangle.edgeDx);
+        int32_t rowEdges[3] = { pEdges[0], pEdges[1], pEdges[2] };
+        bool written = false;
+
+        for (uint32_t y = blockY; y < blockY + BlockSize; y++)
+        {
+            const float centerY = static_cast<float>(y) + 0.5f - triangle.originY;
+
+            for (uint32_t x = blockX; x < blockX + BlockSize; x += 4)
+            {
+                uint32_t mask = 0xF;
+                if (!full)
+                {
+                    const int32_t offset = static_cast<int32_t>(x - blockX);
+                    const int32_t edges[3] =
+                    {
+                        rowEdges[0] + offset * triangle.edgeDx[0],
+                        rowEdges[1] + offset * triangle.edgeDx[1],
+                        rowEdges[2] + offset * triangle.edgeDx[2]
+                    };
+                    mask = lanes.getCoverage(edges);
+                    if (!mask)
+                    {
+                        continue;
+                    }
+                }
+
+                const size_t index = static_cast<size_t>(y) * m_stride + x;
+                const float centerX = static_cast<float>(x) + 0.5f - triangle.originX;
+                mask = testDepth(triangle.depth.origin, triangle.depth.dx, triangle.depth.dy, centerX, centerY, &m_depth[index], mask);
+                if (!mask)
+                {
+                    continue;
+                }
+                written = true;
+
+                for (uint32_t lane = 0; lane < 4; lane++)
+                {
+                    if (!(mask & (1 << lane)))
+                    {
+                        continue;
+                    }
+
+                    const float laneX = centerX + static_cast<float>(lane);
+                    const float w = 1.0f / (triangle.invW.origin + triangle.invW.dy * centerY + triangle.invW.dx * laneX);
+                    float attributes[AttributeCount];
+                    for (size_t i = 0; i < AttributeCount; i++)
+                    {
+                        const Plane & plane = triangle.attributes[i];
+                        attributes[i] = (plane.origin + plane.dy * centerY + plane.dx * laneX) * w;
+                    }
+
+                    m_albedo[index + lane] = packColor(attributes[0], attributes[1], attributes[2], attributes[3]);
+                    m_normal[index + lane] = packNormal(attributes[4], attributes[5], attributes[6]);
+                }
+            }
+
+            for (size_t i = 0; i < 3; i++)
+            {
+                rowEdges[i] += triangle.edgeDy[i];
+            }
+        }
+
+        return written;
+    }
+
+    float SoftwareRasterizer::computeBlockDepth(const uint32_t blockX, const uint32_t blockY) const
+    {
+        float maxDepth = 0.0f;
+        for (uint32_t y = blockY; y < blockY + BlockSize; y++)
+        {
+            const float * pDepth = &m_depth[static_cast<size_t>(y) * m_stride + blockX];
+            maxDepth = std::max(maxDepth, *std::max_element(pDepth, pDepth + BlockSize));
+        }
+        return maxDepth;
+    }
+
+}
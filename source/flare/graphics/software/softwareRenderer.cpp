@@ -0,0 +1,453 @@
+/*
+* MIT License
+*
+* Copyright(c) 2018 Jimmie Bergmann
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*/
+
+#include "flare/graphics/software/softwareRenderer.hpp"
+#include "flare/graphics/software/softwareTexture.hpp"
+#include "flare/graphics/pipeline.hpp"
+#include "flare/graphics/pixelConverter.hpp"
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+
+#define CHECK_LOADED \
+    if(!m_loaded) { throw std::runtime_error("Renderer has not been loaded."); }\
+
+namespace Flare
+{
+
+    typedef std::chrono::high_resolution_clock ProfileClock;
+
+    static GpuProfileScope createProfileScope(const std::string & name, const ProfileClock::time_point & frameStart,
+                                              const ProfileClock::time_point & start, const ProfileClock::time_point & end)
+    {
+        GpuProfileScope scope;
+        scope.name = name;
+        scope.start = std::chrono::duration<double, std::milli>(start - frameStart).count();
+        scope.duration = std::chrono::duration<double, std::milli>(end - start).count();
+        return scope;
+    }
+
+
+    // Pipeline returned by createPipeline, shaders are not supported so every load fails.
+    class SoftwarePipeline : public Pipeline
+    {
+
+    public:
+
+        SoftwarePipeline(Renderer & renderer) :
+            Pipeline(renderer)
+        { }
+
+        virtual void load(const std::string &, const std::string &)
+        { }
+
+        virtual void unload()
+        { }
+
+        virtual void wait()
+        { }
+
+        virtual Status getStatus() const
+        {
+            return Status::Failed;
+        }
+
+        virtual std::string getError() const
+        {
+            return "Pipelines are not supported by the software renderer.";
+        }
+
+    };
+
+
+    // Software render graph context.
+    Vector2ui32 SoftwareRenderGraphContext::getExtent() const
+    {
+        return m_rasterizer.getSize();
+    }
+
+    SoftwareRasterizer & SoftwareRenderGraphContext::getRasterizer() const
+    {
+        return m_rasterizer;
+    }
+
+    JobSystem & SoftwareRenderGraphContext::getJobSystem() const
+    {
+        return m_jobSystem;
+    }
+
+    SoftwareRenderGraphContext::SoftwareRenderGraphContext(SoftwareRasterizer & rasterizer, JobSystem & jobSystem) :
+        m_rasterizer(rasterizer),
+        m_jobSystem(jobSystem)
+    { }
+
+
+    // Main subpass.
+    SoftwareRenderer::MainSubpass::MainSubpass(SoftwareRenderer & renderer) :
+        m_renderer(renderer)
+    { }
+
+    void SoftwareRenderer::MainSubpass::load(Renderer &)
+    { }
+
+    void SoftwareRenderer::MainSubpass::setup(RenderGraphBuilder & builder)
+    {
+        builder.setName("Main pass");
+        builder.write(builder.getBackbuffer(), RenderGraphAccess::ColorAttachment);
+    }
+
+    void SoftwareRenderer::MainSubpass::execute(RenderGraphContext & context)
+    {
+        SoftwareRenderGraphContext & softwareContext = static_cast<SoftwareRenderGraphContext &>(context);
+        softwareContext.getRasterizer().draw(m_renderer.m_drawVertices.data(), m_renderer.m_drawVertices.size());
+    }
+
+
+    // Software renderer.
+    SoftwareRenderer::SoftwareRenderer() :
+        m_mainSubpass(*this),
+        m_multipassRevision(0),
+        m_lighting{ Vector3f(1.0f, 1.0f, 1.0f), Vector3f(0.0f, 0.0f, 1.0f), Vector3f(0.0f, 0.0f, 0.0f) },
+        m_frame(0),
+        m_profile{ 0, {} },
+        m_hasProfile(false),
+        m_hasInputTime(false),
+        m_pJobSystem(nullptr),
+        m_loaded(false)
+    {
+        m_multipass.addSubpass(&m_mainSubpass);
+    }
+
+    SoftwareRenderer::SoftwareRenderer(const RendererSettings & settings) :
+        SoftwareRenderer()
+    {
+        load(settings);
+    }
+
+    SoftwareRenderer::~SoftwareRenderer()
+    {
+        unload();
+    }
+
+    void SoftwareRenderer::load(const RendererSettings & settings)
+    {
+        if (m_loaded)
+        {
+            unload();
+        }
+
+        m_settings = settings;
+
+        m_pJobSystem = m_settings.getJobSystem();
+        if (!m_pJobSystem)
+        {
+            m_ownedJobSystem = std::make_unique<JobSystem>();
+            m_pJobSystem = m_ownedJobSystem.get();
+        }
+
+        m_framePacer.setTargetFrameRate(m_settings.getMaxFrameRate());
+        m_framePacer.reset();
+        m_latency = RenderLatency();
+        m_drawStatistics = DrawStatistics();
+        m_hasInputTime = false;
+
+        m_rasterizer.resize(loadGetSize());
+        loadCreateRenderGraph();
+
+        // Same triangle as the built-in shaders of the Vulkan renderer.
+        SoftwareVertex vertex;
+        vertex.normal = Vector3f(0.0f, 0.0f, 0.0f);
+        m_drawVertices.clear();
+        vertex.position = Vector4f(0.0f, -0.5f, 0.0f, 1.0f);
+        vertex.color = Vector4f(1.0f, 0.0f, 0.0f, 1.0f);
+        m_drawVertices.push_back(vertex);
+        vertex.position = Vector4f(0.5f, 0.5f, 0.0f, 1.0f);
+        vertex.color = Vector4f(0.0f, 1.0f, 0.0f, 1.0f);
+        m_drawVertices.push_back(vertex);
+        vertex.position = Vector4f(-0.5f, 0.5f, 0.0f, 1.0f);
+        vertex.color = Vector4f(0.0f, 0.0f, 1.0f, 1.0f);
+        m_drawVertices.push_back(vertex);
+
+        m_loaded = true;
+    }
+
+    void SoftwareRenderer::unload()
+    {
+        m_loaded = false;
+
+        m_drawVertices.clear();
+        m_presentBuffer.clear();
+        m_rasterizer.resize(Vector2ui32(0, 0));
+        m_renderGraph.clear();
+
+        {
+            std::lock_guard<std::mutex> lock(m_profileMutex);
+            m_hasProfile = false;
+        }
+
+        m_pJobSystem = nullptr;
+        m_ownedJobSystem.reset();
+    }
+
+    void SoftwareRenderer::render()
+    {
+        CHECK_LOADED;
+
+        if (m_multipass.getRevision() != m_multipassRevision)
+        {
+            loadCreateRenderGraph();
+        }
+
+        if (!m_hasInputTime)
+        {
+            waitForInput();
+        }
+
+        const ProfileClock::time_point frameStart = ProfileClock::now();
+        GpuProfileScope frameScope;
+
+        m_rasterizer.clear(Vector4f(0.0f, 0.0f, 0.0f, 1.0f), 1.0f);
+        SoftwareRenderGraphContext context(m_rasterizer, *m_pJobSystem);
+
+        // Batches are rasterized one at a time, draws of all passes within a batch are binned together.
+        const std::vector<RenderGraph::Pass> & passes = m_renderGraph.getPasses();
+        for (auto & batch : m_renderGraph.getBatches())
+        {
+            const ProfileClock::time_point batchStart = ProfileClock::now();
+            std::string name;
+            for (auto passIndex : batch.passes)
+            {
+                passes[passIndex].subpass->prepare(context);
+                name += (name.empty() ? "" : " + ") + passes[passIndex].name;
+            }
+            for (auto passIndex : batch.passes)
+            {
+                passes[passIndex].subpass->execute(context);
+            }
+
+            const ProfileClock::time_point rasterizeStart = ProfileClock::now();
+            m_rasterizer.flush(*m_pJobSystem);
+            const ProfileClock::time_point batchEnd = ProfileClock::now();
+
+            frameScope.children.push_back(createProfileScope(name, frameStart, batchStart, batchEnd));
+            frameScope.children.back().children.push_back(createProfileScope("Rasterize", frameStart, rasterizeStart, batchEnd));
+        }
+
+        // Every draw is a single call into the rasterizer, there is no pipeline, descriptor or vertex buffer state to bind.
+        m_drawStatistics = DrawStatistics();
+        m_drawStatistics.draws = m_rasterizer.getStatistics().draws;
+
+        const ProfileClock::time_point resolveStart = ProfileClock::now();
+        m_rasterizer.resolve(*m_pJobSystem, m_lighting);
+        const ProfileClock::time_point resolveEnd = ProfileClock::now();
+        frameScope.children.push_back(createProfileScope("Resolve", frameStart, resolveStart, resolveEnd));
+
+        m_framePacer.wait();
+        const ProfileClock::time_point presentStart = ProfileClock::now();
+
+        if (!m_settings.getHeadless())
+        {
+            present();
+            frameScope.children.push_back(createProfileScope("Present", frameStart, presentStart, ProfileClock::now()));
+        }
+        m_latency.record(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_inputTime).count());
+        m_hasInputTime = false;
+
+        if (m_settings.getGpuProfiling())
+        {
+            GpuProfileScope scope = createProfileScope("Frame", frameStart, frameStart, ProfileClock::now());
+            scope.children = std::move(frameScope.children);
+
+            std::lock_guard<std::mutex> lock(m_profileMutex);
+            m_profile.frame = m_frame;
+            m_profile.scopes.assign(1, std::move(scope));
+            m_hasProfile = true;
+        }
+        m_frame++;
+    }
+
+    void SoftwareRenderer::resize(const Vector2ui32 & size)
+    {
+        CHECK_LOADED;
+
+        m_rasterizer.resize(size);
+    }
+
+    const RenderMemoryAllocator & SoftwareRenderer::memory() const
+    {
+        return m_memory;
+    }
+
+    bool SoftwareRenderer::getGpuProfile(GpuFrameProfile & profile) const
+    {
+        std::lock_guard<std::mutex> lock(m_profileMutex);
+        if (!m_hasProfile)
+        {
+            return false;
+        }
+
+        profile = m_profile;
+        return true;
+    }
+
+    std::shared_ptr<Texture> SoftwareRenderer::createTexture()
+    {
+        CHECK_LOADED;
+
+        return std::shared_ptr<SoftwareTexture>(new SoftwareTexture(m_memory));
+    }
+
+    std::shared_ptr<Pipeline> SoftwareRenderer::createPipeline()
+    {
+        CHECK_LOADED;
+
+        return std::make_shared<SoftwarePipeline>(*this);
+    }
+
+    void SoftwareRenderer::setPipeline(const std::shared_ptr<Pipeline> &)
+    {
+        CHECK_LOADED;
+
+        // Shaders are not supported, the built-in pass is always drawn.
+    }
+
+    void SoftwareRenderer::readFrame(std::vector<uint8_t> & pixels, Vector2ui32 & size)
+    {
+        CHECK_LOADED;
+
+        // Rendering is synchronous, the color buffer holds the finished frame.
+        const std::vector<uint32_t> & color = m_rasterizer.getColorBuffer();
+        size = m_rasterizer.getSize();
+        pixels.resize(color.size() * 4);
+        std::memcpy(pixels.data(), color.data(), pixels.size());
+    }
+
+    void SoftwareRenderer::waitForInput()
+    {
+        CHECK_LOADED;
+
+        // Frames are finished within render, there is never a frame to wait for.
+        m_inputTime = std::chrono::steady_clock::now();
+        m_hasInputTime = true;
+    }
+
+    const RenderLatency & SoftwareRenderer::getLatency() const
+    {
+        return m_latency;
+    }
+
+    const DrawStatistics & SoftwareRenderer::getDrawStatistics() const
+    {
+        return m_drawStatistics;
+    }
+
+    FramePacer & SoftwareRenderer::getFramePacer()
+    {
+        return m_framePacer;
+    }
+
+    Multipass & SoftwareRenderer::getMultipass()
+    {
+        return m_multipass;
+    }
+
+    void SoftwareRenderer::setLighting(const SoftwareLighting & lighting)
+    {
+        m_lighting = lighting;
+    }
+
+    const SoftwareLighting & SoftwareRenderer::getLighting() const
+    {
+        return m_lighting;
+    }
+
+    const SoftwareRasterizer & SoftwareRenderer::getRasterizer() const
+    {
+        return m_rasterizer;
+    }
+
+    Vector2ui32 SoftwareRenderer::loadGetSize() const
+    {
+        if (m_settings.getHeadless())
+        {
+            return m_settings.getHeadlessSize();
+        }
+
+    #if defined(FLARE_PLATFORM_WINDOWS)
+        const Window * pWindow = m_settings.getWindow();
+        if (pWindow)
+        {
+            return pWindow->getSize();
+        }
+
+        RECT rect;
+        const HWND hWnd = m_settings.getWindowProxy().getHWnd();
+        if (hWnd && GetClientRect(hWnd, &rect))
+        {
+            return Vector2ui32(static_cast<uint32_t>(rect.right - rect.left), static_cast<uint32_t>(rect.bottom - rect.top));
+        }
+    #endif
+
+        return m_settings.getHeadlessSize();
+    }
+
+    void SoftwareRenderer::loadCreateRenderGraph()
+    {
+        m_multipassRevision = m_multipass.getRevision();
+        m_renderGraph.setup(m_multipass);
+        m_renderGraph.compile();
+    }
+
+    void SoftwareRenderer::present()
+    {
+    #if defined(FLARE_PLATFORM_WINDOWS)
+        const Window * pWindow = m_settings.getWindow();
+        const HWND hWnd = pWindow ? pWindow->getHWnd() : m_settings.getWindowProxy().getHWnd();
+        const Vector2ui32 & size = m_rasterizer.getSize();
+        if (!hWnd || size.x == 0 || size.y == 0)
+        {
+            return;
+        }
+
+        // GDI expects BGRA, swapping red and blue is the same swizzle in both directions.
+        const std::vector<uint32_t> & color = m_rasterizer.getColorBuffer();
+        m_presentBuffer.resize(color.size());
+        PixelConverter::bgraToRgba(reinterpret_cast<const uint8_t *>(color.data()), reinterpret_cast<uint8_t *>(m_presentBuffer.data()), color.size());
+
+        BITMAPINFO bitmapInfo = {};
+        bitmapInfo.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+        bitmapInfo.bmiHeader.biWidth = static_cast<LONG>(size.x);
+        bitmapInfo.bmiHeader.biHeight = -static_cast<LONG>(size.y);
+        bitmapInfo.bmiHeader.biPlanes = 1;
+        bitmapInfo.bmiHeader.biBitCount = 32;
+        bitmapInfo.bmiHeader.biCompression = BI_RGB;
+
+        HDC hDC = GetDC(hWnd);
+        SetDIBitsToDevice(hDC, 0, 0, size.x, size.y, 0, 0, 0, size.y, m_presentBuffer.data(), &bitmapInfo, DIB_RGB_COLORS);
+        ReleaseDC(hWnd, hDC);
+    #endif
+    }
+
+}
@@ -0,0 +1,207 @@
+/*
+* MIT License
+*
+* Copyright(c) 2018 Jimmie Bergmann
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*/
+
+#include "flare/graphics/software/softwareTexture.hpp"
+#include "flare/graphics/imageDecoder.hpp"
+#include "flare/graphics/pixelConverter.hpp"
+#include "flare/graphics/textureCompressor.hpp"
+#include <cstring>
+#include <stdexcept>
+
+namespace Flare
+{
+
+    SoftwareTexture::~SoftwareTexture()
+    {
+        unload();
+        setRamUsage(0);
+    }
+
+    void SoftwareTexture::load(const uint8_t * buffer,
+                               const Vector2ui32 & size,
+                               const PixelFormat & pixelFormat,
+                               const bool storeBuffer)
+    {
+        unload();
+
+        m_size = size;
+        m_pixelFormat = pixelFormat;
+
+        if (m_size.x == 0 || m_size.y == 0)
+        {
+            return;
+        }
+
+        const size_t pixelCount = static_cast<size_t>(m_size.x) * m_size.y;
+        const size_t bufferSize = TextureCompressor::getBufferSize(m_size, m_pixelFormat);
+        size_t ramUsage = sizeof(SoftwareTexture) + pixelCount * 4;
+
+        if (buffer && storeBuffer)
+        {
+            m_pBuffer = new uint8_t[bufferSize];
+            std::memcpy(m_pBuffer, buffer, bufferSize);
+            ramUsage += bufferSize;
+        }
+
+        m_pixels.assign(pixelCount * 4, 0);
+        setRamUsage(ramUsage);
+        m_status = Status::Ready;
+
+        if (!buffer)
+        {
+            return;
+        }
+
+        if (m_pixelFormat == PixelFormat::RGBA)
+        {
+            std::memcpy(m_pixels.data(), buffer, bufferSize);
+        }
+        else if (TextureCompressor::isCompressed(m_pixelFormat))
+        {
+            // Only the first level of the chain is sampled.
+            TextureCompressor::decompress(buffer, m_size, m_pixelFormat, m_pixels.data());
+        }
+        else
+        {
+            PixelConverter::rgbToRgba(buffer, m_pixels.data(), pixelCount);
+        }
+    }
+
+    void SoftwareTexture::load(const std::string & filename, const bool storeBuffer)
+    {
+        std::vector<uint8_t> file;
+        ImageDecoder::readFile(filename, file);
+        const ImageDecoder::Info info = ImageDecoder::readInfo(file.data(), file.size());
+
+        ImageDecoder decoder;
+        if (info.pixelFormat != PixelFormat::RGBA)
+        {
+            std::vector<uint8_t> buffer(ImageDecoder::getOutputSize(info));
+            decoder.decode(file.data(), file.size(), info, buffer.data());
+            load(buffer.data(), info.size, info.pixelFormat, storeBuffer);
+            return;
+        }
+
+        // Decoded straight into the sampled pixels.
+        unload();
+
+        m_size = info.size;
+        m_pixelFormat = info.pixelFormat;
+
+        const size_t bufferSize = ImageDecoder::getOutputSize(info);
+        m_pixels.resize(bufferSize);
+        decoder.decode(file.data(), file.size(), info, m_pixels.data());
+
+        size_t ramUsage = sizeof(SoftwareTexture) + bufferSize;
+        if (storeBuffer)
+        {
+            m_pBuffer = new uint8_t[bufferSize];
+            std::memcpy(m_pBuffer, m_pixels.data(), bufferSize);
+            ramUsage += bufferSize;
+        }
+        setRamUsage(ramUsage);
+        m_status = Status::Ready;
+    }
+
+    void SoftwareTexture::loadAsync(const std::string & filename, const bool storeBuffer)
+    {
+        try
+        {
+            load(filename, storeBuffer);
+        }
+        catch (const std::exception & e)
+        {
+            m_error = e.what();
+            m_status = Status::Failed;
+        }
+    }
+
+    void SoftwareTexture::unload()
+    {
+        m_status = Status::Unloaded;
+        m_pixels.clear();
+        m_pixels.shrink_to_fit();
+
+        delete[] m_pBuffer;
+        m_pBuffer = nullptr;
+        setRamUsage(sizeof(SoftwareTexture));
+    }
+
+    const uint8_t * SoftwareTexture::getBuffer() const
+    {
+        return m_pBuffer;
+    }
+
+    size_t SoftwareTexture::getBufferSize() const
+    {
+        if (!m_pBuffer)
+        {
+            return 0;
+        }
+
+        return TextureCompressor::getBufferSize(m_size, m_pixelFormat);
+    }
+
+    SoftwareTexture::PixelFormat SoftwareTexture::getPixelFormat() const
+    {
+        return m_pixelFormat;
+    }
+
+    SoftwareTexture::PixelFormat SoftwareTexture::getStorageFormat() const
+    {
+        return PixelFormat::RGBA;
+    }
+
+    Vector2ui32 SoftwareTexture::getSize() const
+    {
+        return m_size;
+    }
+
+    Texture::Status SoftwareTexture::getStatus() const
+    {
+        return m_status;
+    }
+
+    std::string SoftwareTexture::getError() const
+    {
+        return m_error;
+    }
+
+    const std::vector<uint8_t> & SoftwareTexture::getPixels() const
+    {
+        return m_pixels;
+    }
+
+    SoftwareTexture::SoftwareTexture(RenderMemoryAllocator & allocator) :
+        Texture(allocator),
+        m_size(0, 0),
+        m_pixelFormat(PixelFormat::RGBA),
+        m_pBuffer(nullptr),
+        m_status(Status::Unloaded)
+    {
+        setRamUsage(sizeof(SoftwareTexture));
+    }
+
+}
@@ -24,6 +24,8 @@
 */
 
 #include "flare/graphics/subpass.hpp"
+#include <algorithm>
+#include <atomic>
 
 namespace Flare
 {
@@ -32,8 +34,32 @@ namespace Flare
     Subpass::~Subpass()
     { }
 
+    void Subpass::prepare(RenderGraphContext &)
+    { }
+
 
     // Multipass.
+    // Revisions are drawn from one counter, so the newest change anywhere in a tree of multipasses is the largest.
+    static std::atomic<uint64_t> g_multipassRevision(0);
+
+    Multipass::Multipass() :
+        m_revision(++g_multipassRevision)
+    { }
+
+    void Multipass::load(Renderer & renderer)
+    {
+        for (auto subpass : m_subpasses)
+        {
+            subpass->load(renderer);
+        }
+    }
+
+    void Multipass::setup(RenderGraphBuilder &)
+    { }
+
+    void Multipass::execute(RenderGraphContext &)
+    { }
+
     std::vector<Subpass *>::const_iterator Multipass::addSubpass(Subpass * subpass)
     {
         auto it = std::find(m_subpasses.begin(), m_subpasses.end(), subpass);
@@ -42,6 +68,7 @@ namespace Flare
             return it;
         }
 
+        m_revision = ++g_multipassRevision;
         return m_subpasses.insert(m_subpasses.end(), subpass);
     }
 
@@ -53,6 +80,7 @@ namespace Flare
             return it;
         }
 
+        m_revision = ++g_multipassRevision;
         return m_subpasses.insert(position, subpass);
     }
 
@@ -64,6 +92,7 @@ namespace Flare
             return it;
         }
 
+        m_revision = ++g_multipassRevision;
         return m_subpasses.erase(it);
     }
 
@@ -77,4 +106,17 @@ namespace Flare
         return m_subpasses.end();
     }
 
-}
\ No newline at end of file
+    uint64_t Multipass::getRevision() const
+    {
+        uint64_t revision = m_revision;
+        for (auto subpass : m_subpasses)
+        {
+            if (auto multipass = dynamic_cast<const Multipass *>(subpass))
+            {
+                revision = std::max(revision, multipass->getRevision());
+            }
+        }
+        return revision;
+    }
+
+}
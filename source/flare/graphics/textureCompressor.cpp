@@ -0,0 +1,1411 @@
+/*
+* MIT License
+*
+* Copyright(c) 2018 Jimmie Bergmann
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*/
+
+#include "flare/graphics/textureCompressor.hpp"
+#include "flare/system/jobSystem.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+#define FLARE_TEXTURE_CACHE_MAGIC 0x43424C46 // "FLBC"
+#define FLARE_TEXTURE_CACHE_VERSION 1
+
+// Header written in front of cached compressed chains.
+struct TextureCacheFileHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key;
+    uint32_t format;
+    uint32_t width;
+    uint32_t height;
+    uint32_t levelCount;
+    double   psnr;
+    uint64_t dataSize;
+    uint64_t dataHash;
+};
+
+namespace Flare
+{
+
+    static const uint64_t g_hashOffset = 14695981039346656037ULL;
+
+    // FNV-1a, continued from a previous hash.
+    static uint64_t hashData(uint64_t hash, const void * data, const size_t size)
+    {
+        const uint8_t * bytes = static_cast<const uint8_t *>(data);
+        for (size_t i = 0; i < size; i++)
+        {
+            hash ^= bytes[i];
+            hash *= 1099511628211ULL;
+        }
+        return hash;
+    }
+
+    template<typename T>
+    static uint64_t hashValue(const uint64_t hash, const T & value)
+    {
+        return hashData(hash, &value, sizeof(value));
+    }
+
+    // 4x4 pixels of a block, edge pixels are repeated for blocks crossing the border of the level.
+    struct BlockPixels
+    {
+        uint8_t rgba[16][4];
+    };
+
+    static void loadBlock(const uint8_t * level, const Vector2ui32 & size, const uint32_t blockX, const uint32_t blockY, BlockPixels & block)
+    {
+        for (uint32_t y = 0; y < 4; y++)
+        {
+            const uint32_t sourceY = std::min(blockY * 4 + y, size.y - 1);
+            for (uint32_t x = 0; x < 4; x++)
+            {
+                const uint32_t sourceX = std::min(blockX * 4 + x, size.x - 1);
+                std::memcpy(block.rgba[y * 4 + x], level + (static_cast<size_t>(sourceY) * size.x + sourceX) * 4, 4);
+            }
+        }
+    }
+
+    // Initial endpoints of the first N channels. The bounding box for fast encoding,
+    // otherwise the extent of the pixels along their principal axis.
+    template<size_t N>
+    static void fitEndpoints(const float pixels[16][4], const TextureCompressor::Quality quality, float endpoint0[4], float endpoint1[4])
+    {
+        float mean[N] = {};
+        float minimum[N];
+        float maximum[N];
+        for (size_t c = 0; c < N; c++)
+        {
+            minimum[c] = maximum[c] = pixels[0][c];
+        }
+        for (size_t i = 0; i < 16; i++)
+        {
+            for (size_t c = 0; c < N; c++)
+            {
+                mean[c] += pixels[i][c] / 16.0f;
+                minimum[c] = std::min(minimum[c], pixels[i][c]);
+                maximum[c] = std::max(maximum[c], pixels[i][c]);
+            }
+        }
+
+        float covariance[N][N] = {};
+        for (size_t i = 0; i < 16; i++)
+        {
+            for (size_t a = 0; a < N; a++)
+            {
+                for (size_t b = 0; b < N; b++)
+                {
+                    covariance[a][b] += (pixels[i][a] - mean[a]) * (pixels[i][b] - mean[b]);
+                }
+            }
+        }
+
+        if (quality == TextureCompressor::Quality::Fast)
+        {
+            // Flip the box diagonal of channels correlating negatively with the widest channel, then inset against outliers.
+            size_t widest = 0;
+            for (size_t c = 1; c < N; c++)
+            {
+                widest = (maximum[c] - minimum[c]) > (maximum[widest] - minimum[widest]) ? c : widest;
+            }
+            for (size_t c = 0; c < N; c++)
+            {
+                const float inset = (maximum[c] - minimum[c]) / 16.0f;
+                endpoint0[c] = minimum[c] + inset;
+                endpoint1[c] = maximum[c] - inset;
+                if (covariance[widest][c] < 0.0f)
+                {
+                    std::swap(endpoint0[c], endpoint1[c]);
+                }
+            }
+            return;
+        }
+
+        // Power iteration, starting from the box diagonal.
+        float axis[N];
+        for (size_t c = 0; c < N; c++)
+        {
+            axis[c] = maximum[c] - minimum[c];
+        }
+        for (size_t iteration = 0; iteration < 8; iteration++)
+        {
+            float next[N] = {};
+            float length = 0.0f;
+            for (size_t a = 0; a < N; a++)
+            {
+                for (size_t b = 0; b < N; b++)
+                {
+                    next[a] += covariance[a][b] * axis[b];
+                }
+                length = std::max(length, std::abs(next[a]));
+            }
+            if (length <= 0.0f)
+            {
+                break;
+            }
+            for (size_t c = 0; c < N; c++)
+            {
+                axis[c] = next[c] / length;
+            }
+        }
+
+        float lengthSquared = 0.0f;
+        for (size_t c = 0; c < N; c++)
+        {
+            lengthSquared += axis[c] * axis[c];
+        }
+        if (lengthSquared <= 0.0f)
+        {
+            for (size_t c = 0; c < N; c++)
+            {
+                endpoint0[c] = endpoint1[c] = mean[c];
+            }
+            return;
+        }
+
+        float minimumProjection = 0.0f;
+        float maximumProjection = 0.0f;
+        for (size_t i = 0; i < 16; i++)
+        {
+            float projection = 0.0f;
+            for (size_t c = 0; c < N; c++)
+            {
+                projection += (pixels[i][c] - mean[c]) * axis[c];
+            }
+            minimumProjection = std::min(minimumProjection, projection);
+            maximumProjection = std::max(maximumProjection, projection);
+        }
+        for (size_t c = 0; c < N; c++)
+        {
+            endpoint0[c] = std::min(std::max(mean[c] + axis[c] * minimumProjection / lengthSquared, 0.0f), 255.0f);
+            endpoint1[c] = std::min(std::max(mean[c] + axis[c] * maximumProjection / lengthSquared, 0.0f), 255.0f);
+        }
+    }
+
+    // Least squares endpoints for the given interpolation weights of the second endpoint.
+    template<size_t N>
+    static bool refineEndpoints(const float pixels[16][4], const float weights[16], float endpoint0[4], float endpoint1[4])
+    {
+        float alpha2 = 0.0f;
+        float beta2 = 0.0f;
+        float alphaBeta = 0.0f;
+        float alphaX[N] = {};
+        float betaX[N] = {};
+        for (size_t i = 0; i < 16; i++)
+        {
+            const float beta = weights[i];
+            const float alpha = 1.0f - beta;
+            alpha2 += alpha * alpha;
+            beta2 += beta * beta;
+            alphaBeta += alpha * beta;
+            for (size_t c = 0; c < N; c++)
+            {
+                alphaX[c] += alpha * pixels[i][c];
+                betaX[c] += beta * pixels[i][c];
+            }
+        }
+
+        const float determinant = alpha2 * beta2 - alphaBeta * alphaBeta;
+        if (std::abs(determinant) < 1e-6f)
+        {
+            return false;
+        }
+
+        const float inverse = 1.0f / determinant;
+        for (size_t c = 0; c < N; c++)
+        {
+            endpoint0[c] = std::min(std::max((alphaX[c] * beta2 - betaX[c] * alphaBeta) * inverse, 0.0f), 255.0f);
+            endpoint1[c] = std::min(std::max((betaX[c] * alpha2 - alphaX[c] * alphaBeta) * inverse, 0.0f), 255.0f);
+        }
+        return true;
+    }
+
+    static size_t getRefinements(const TextureCompressor::Quality quality)
+    {
+        return quality == TextureCompressor::Quality::Fast ? 0 : (quality == TextureCompressor::Quality::Normal ? 1 : 3);
+    }
+
+    static void toFloat(const BlockPixels & block, float pixels[16][4])
+    {
+        for (size_t i = 0; i < 16; i++)
+        {
+            for (size_t c = 0; c < 4; c++)
+            {
+                pixels[i][c] = static_cast<float>(block.rgba[i][c]);
+            }
+        }
+    }
+
+
+    // BC1 color, also the color part of BC3.
+    static uint16_t packColor565(const float color[4])
+    {
+        const uint32_t r = static_cast<uint32_t>(color[0] * 31.0f / 255.0f + 0.5f);
+        const uint32_t g = static_cast<uint32_t>(color[1] * 63.0f / 255.0f + 0.5f);
+        const uint32_t b = static_cast<uint32_t>(color[2] * 31.0f / 255.0f + 0.5f);
+        return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+    }
+
+    static void unpackColor565(const uint16_t color, uint8_t output[4])
+    {
+        const uint32_t r = (color >> 11) & 0x1F;
+        const uint32_t g = (color >> 5) & 0x3F;
+        const uint32_t b = color & 0x1F;
+        output[0] = static_cast<uint8_t>((r << 3) | (r >> 2));
+        output[1] = static_cast<uint8_t>((g << 2) | (g >> 4));
+        output[2] = static_cast<uint8_t>((b << 3) | (b >> 2));
+        output[3] = 255;
+    }
+
+    static void getColorPalette(const uint16_t color0, const uint16_t color1, const bool alwaysFourColors, uint8_t palette[4][4])
+    {
+        unpackColor565(color0, palette[0]);
+        unpackColor565(color1, palette[1]);
+        if (alwaysFourColors || color0 > color1)
+        {
+            for (size_t c = 0; c < 3; c++)
+            {
+                palette[2][c] = static_cast<uint8_t>((2 * palette[0][c] + palette[1][c]) / 3);
+                palette[3][c] = static_cast<uint8_t>((palette[0][c] + 2 * palette[1][c]) / 3);
+            }
+            palette[2][3] = palette[3][3] = 255;
+        }
+        else
+        {
+            for (size_t c = 0; c < 3; c++)
+            {
+                palette[2][c] = static_cast<uint8_t>((palette[0][c] + palette[1][c]) / 2);
+                palette[3][c] = 0;
+            }
+            palette[2][3] = 255;
+            palette[3][3] = 0;
+        }
+    }
+
+    static uint32_t evaluateColorBlock(const BlockPixels & block, const float endpoint0[4], const float endpoint1[4],
+                                       uint16_t & color0, uint16_t & color1, uint32_t & indices)
+    {
+        // The first color must be the larger one for four color mode, equal colors have a single palette entry.
+        color0 = packColor565(endpoint0);
+        color1 = packColor565(endpoint1);
+        if (color0 < color1)
+        {
+            std::swap(color0, color1);
+        }
+
+        uint8_t palette[4][4];
+        getColorPalette(color0, color1, true, palette);
+        const size_t paletteSize = color0 == color1 ? 1 : 4;
+
+        uint32_t error = 0;
+        indices = 0;
+        for (size_t i = 0; i < 16; i++)
+        {
+            uint32_t bestError = std::numeric_limits<uint32_t>::max();
+            uint32_t bestIndex = 0;
+            for (size_t p = 0; p < paletteSize; p++)
+            {
+                uint32_t distance = 0;
+                for (size_t c = 0; c < 3; c++)
+                {
+                    const int32_t difference = static_cast<int32_t>(block.rgba[i][c]) - palette[p][c];
+                    distance += static_cast<uint32_t>(difference * difference);
+                }
+                if (distance < bestError)
+                {
+                    bestError = distance;
+                    bestIndex = static_cast<uint32_t>(p);
+                }
+            }
+            indices |= bestIndex << (i * 2);
+            error += bestError;
+        }
+        return error;
+    }
+
+    static void encodeColorBlock(const BlockPixels & block, const TextureCompressor::Quality quality, uint8_t * output)
+    {
+        static const float indexWeights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+
+        float pixels[16][4];
+        toFloat(block, pixels);
+
+        float endpoint0[4];
+        float endpoint1[4];
+        fitEndpoints<3>(pixels, quality, endpoint0, endpoint1);
+
+        uint16_t color0;
+        uint16_t color1;
+        uint32_t indices;
+        uint32_t error = evaluateColorBlock(block, endpoint0, endpoint1, color0, color1, indices);
+
+        for (size_t iteration = 0; iteration < getRefinements(quality) && error > 0; iteration++)
+        {
+            // Weights are relative to the stored colors, which may have been swapped.
+            uint8_t first[4];
+            uint8_t second[4];
+            unpackColor565(color0, first);
+            unpackColor565(color1, second);
+
+            float weights[16];
+            for (size_t i = 0; i < 16; i++)
+            {
+                weights[i] = indexWeights[(indices >> (i * 2)) & 0x3];
+            }
+            if (!refineEndpoints<3>(pixels, weights, endpoint0, endpoint1))
+            {
+                break;
+            }
+
+            uint16_t refinedColor0;
+            uint16_t refinedColor1;
+            uint32_t refinedIndices;
+            const uint32_t refinedError = evaluateColorBlock(block, endpoint0, endpoint1, refinedColor0, refinedColor1, refinedIndices);
+            if (refinedError >= error)
+            {
+                break;
+            }
+            color0 = refinedColor0;
+            color1 = refinedColor1;
+            indices = refinedIndices;
+            error = refinedError;
+        }
+
+        output[0] = static_cast<uint8_t>(color0);
+        output[1] = static_cast<uint8_t>(color0 >> 8);
+        output[2] = static_cast<uint8_t>(color1);
+        output[3] = static_cast<uint8_t>(color1 >> 8);
+        std::memcpy(output + 4, &indices, 4);
+    }
+
+    static void decodeColorBlock(const uint8_t * input, const bool alwaysFourColors, uint8_t output[16][4])
+    {
+        const uint16_t color0 = static_cast<uint16_t>(input[0] | (input[1] << 8));
+        const uint16_t color1 = static_cast<uint16_t>(input[2] | (input[3] << 8));
+        uint32_t indices;
+        std::memcpy(&indices, input + 4, 4);
+
+        uint8_t palette[4][4];
+        getColorPalette(color0, color1, alwaysFourColors, palette);
+        for (size_t i = 0; i < 16; i++)
+        {
+            std::memcpy(output[i], palette[(indices >> (i * 2)) & 0x3], 4);
+        }
+    }
+
+
+    // BC4 single channel, the alpha of BC3 and both channels of BC5.
+    static void getChannelPalette(const uint8_t value0, const uint8_t value1, uint8_t palette[8])
+    {
+        palette[0] = value0;
+        palette[1] = value1;
+        if (value0 > value1)
+        {
+            for (uint32_t i = 1; i < 7; i++)
+            {
+                palette[i + 1] = static_cast<uint8_t>(((7 - i) * value0 + i * value1 + 3) / 7);
+            }
+        }
+        else
+        {
+            for (uint32_t i = 1; i < 5; i++)
+            {
+                palette[i + 1] = static_cast<uint8_t>(((5 - i) * value0 + i * value1 + 2) / 5);
+            }
+            palette[6] = 0;
+            palette[7] = 255;
+        }
+    }
+
+    static uint32_t evaluateChannelBlock(const uint8_t values[16], const uint8_t value0, const uint8_t value1, uint64_t & indices)
+    {
+        uint8_t palette[8];
+        getChannelPalette(value0, value1, palette);
+
+        uint32_t error = 0;
+        indices = 0;
+        for (size_t i = 0; i < 16; i++)
+        {
+            uint32_t bestError = std::numeric_limits<uint32_t>::max();
+            uint64_t bestIndex = 0;
+            for (size_t p = 0; p < 8; p++)
+            {
+                const int32_t difference = static_cast<int32_t>(values[i]) - palette[p];
+                const uint32_t distance = static_cast<uint32_t>(difference * difference);
+                if (distance < bestError)
+                {
+                    bestError = distance;
+                    bestIndex = p;
+                }
+            }
+            indices |= bestIndex << (i * 3);
+            error += bestError;
+        }
+        return error;
+    }
+
+    static void encodeChannelBlock(const uint8_t values[16], const TextureCompressor::Quality quality, uint8_t * output)
+    {
+        uint8_t minimum = values[0];
+        uint8_t maximum = values[0];
+        uint8_t innerMinimum = 255;
+        uint8_t innerMaximum = 0;
+        for (size_t i = 0; i < 16; i++)
+        {
+            minimum = std::min(minimum, values[i]);
+            maximum = std::max(maximum, values[i]);
+            if (values[i] != 0 && values[i] != 255)
+            {
+                innerMinimum = std::min(innerMinimum, values[i]);
+                innerMaximum = std::max(innerMaximum, values[i]);
+            }
+        }
+
+        // Eight interpolated values between the extremes.
+        uint8_t value0 = maximum;
+        uint8_t value1 = minimum;
+        uint64_t indices;
+        uint32_t error = evaluateChannelBlock(values, value0, value1, indices);
+
+        // Six values with explicit 0 and 255, better for blocks mixing the extremes with a narrow range.
+        if (quality != TextureCompressor::Quality::Fast && innerMinimum <= innerMaximum && error > 0)
+        {
+            uint64_t sixIndices;
+            const uint32_t sixError = evaluateChannelBlock(values, innerMinimum, innerMaximum, sixIndices);
+            if (sixError < error)
+            {
+                value0 = innerMinimum;
+                value1 = innerMaximum;
+                indices = sixIndices;
+                error = sixError;
+            }
+        }
+
+        // Small nudges of the eight value endpoints, rounding of the interpolation often favors a neighbour.
+        if (quality == TextureCompressor::Quality::High && error > 0 && maximum > minimum)
+        {
+            for (int d0 = -2; d0 <= 0; d0++)
+            {
+                for (int d1 = 0; d1 <= 2; d1++)
+                {
+                    const int candidate0 = maximum + d0;
+                    const int candidate1 = minimum + d1;
+                    if (candidate0 <= candidate1)
+                    {
+                        continue;
+                    }
+                    uint64_t candidateIndices;
+                    const uint32_t candidateError = evaluateChannelBlock(values, static_cast<uint8_t>(candidate0), static_cast<uint8_t>(candidate1), candidateIndices);
+                    if (candidateError < error)
+                    {
+                        value0 = static_cast<uint8_t>(candidate0);
+                        value1 = static_cast<uint8_t>(candidate1);
+                        indices = candidateIndices;
+                        error = candidateError;
+                    }
+                }
+            }
+        }
+
+        output[0] = value0;
+        output[1] = value1;
+        for (size_t i = 0; i < 6; i++)
+        {
+            output[2 + i] = static_cast<uint8_t>(indices >> (i * 8));
+        }
+    }
+
+    static void decodeChannelBlock(const uint8_t * input, uint8_t output[16][4], const size_t channel)
+    {
+        uint8_t palette[8];
+        getChannelPalette(input[0], input[1], palette);
+
+        uint64_t indices = 0;
+        for (size_t i = 0; i < 6; i++)
+        {
+            indices |= static_cast<uint64_t>(input[2 + i]) << (i * 8);
+        }
+        for (size_t i = 0; i < 16; i++)
+        {
+            output[i][channel] = palette[(indices >> (i * 3)) & 0x7];
+        }
+    }
+
+
+    // BC7 interpolation weights for 2, 3 and 4 bit indices. The encoder only writes mode 6, a single subset of RGBA
+    // endpoints with 7 bits and a p-bit each, and 4 bit indices. The decoder handles all eight modes.
+    static const uint32_t g_bc7Weights2[4] = { 0, 21, 43, 64 };
+    static const uint32_t g_bc7Weights3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+    static const uint32_t g_bc7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+    // Subset of every pixel for the 64 partitions of the two and three subset modes.
+    static const uint8_t g_bc7Partitions2[64][16] =
+    {
+        { 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1 }, { 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1 },
+        { 0, 1, 1, 1, 0, 1, 1, 1, 0, 1, 1, 1, 0, 1, 1, 1 }, { 0, 0, 0, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 1, 1, 1 },
+        { 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 1, 1 }, { 0, 0, 1, 1, 0, 1, 1, 1, 0, 1, 1, 1, 1, 1, 1, 1 },
+        { 0, 0, 0, 1, 0, 0, 1, 1, 0, 1, 1, 1, 1, 1, 1, 1 }, { 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 1, 0, 1, 1, 1 },
+        { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 1 }, { 0, 0, 1, 1, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1 },
+        { 0, 0, 0, 0, 0, 0, 0, 1, 0, 1, 1, 1, 1, 1, 1, 1 }, { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 1, 1, 1 },
+        { 0, 0, 0, 1, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1 }, { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1 },
+        { 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1 }, { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1 },
+        { 0, 0, 0, 0, 1, 0, 0, 0, 1, 1, 1, 0, 1, 1, 1, 1 }, { 0, 1, 1, 1, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0 },
+        { 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 1, 1, 1, 0 }, { 0, 1, 1, 1, 0, 0, 1, 1, 0, 0, 0, 1, 0, 0, 0, 0 },
+        { 0, 0, 1, 1, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0 }, { 0, 0, 0, 0, 1, 0, 0, 0, 1, 1, 0, 0, 1, 1, 1, 0 },
+        { 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 1, 1, 0, 0 }, { 0, 1, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 0, 1 },
+        { 0, 0, 1, 1, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 0 }, { 0, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1, 1, 0, 0 },
+        { 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0 }, { 0, 0, 1, 1, 0, 1, 1, 0, 0, 1, 1, 0, 1, 1, 0, 0 },
+        { 0, 0, 0, 1, 0, 1, 1, 1, 1, 1, 1, 0, 1, 0, 0, 0 }, { 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0 },
+        { 0, 1, 1, 1, 0, 0, 0, 1, 1, 0, 0, 0, 1, 1, 1, 0 }, { 0, 0, 1, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 1, 0, 0 },
+        { 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1 }, { 0, 0, 0, 0, 1, 1, 1, 1, 0, 0, 0, 0, 1, 1, 1, 1 },
+        { 0, 1, 0, 1, 1, 0, 1, 0, 0, 1, 0, 1, 1, 0, 1, 0 }, { 0, 0, 1, 1, 0, 0, 1, 1, 1, 1, 0, 0, 1, 1, 0, 0 },
+        { 0, 0, 1, 1, 1, 1, 0, 0, 0, 0, 1, 1, 1, 1, 0, 0 }, { 0, 1, 0, 1, 0, 1, 0, 1, 1, 0, 1, 0, 1, 0, 1, 0 },
+        { 0, 1, 1, 0, 1, 0, 0, 1, 0, 1, 1, 0, 1, 0, 0, 1 }, { 0, 1, 0, 1, 1, 0, 1, 0, 1, 0, 1, 0, 0, 1, 0, 1 },
+        { 0, 1, 1, 1, 0, 0, 1, 1, 1, 1, 0, 0, 1, 1, 1, 0 }, { 0, 0, 0, 1, 0, 0, 1, 1, 1, 1, 0, 0, 1, 0, 0, 0 },
+        { 0, 0, 1, 1, 0, 0, 1, 0, 0, 1, 0, 0, 1, 1, 0, 0 }, { 0, 0, 1, 1, 1, 0, 1, 1, 1, 1, 0, 1, 1, 1, 0, 0 },
+        { 0, 1, 1, 0, 1, 0, 0, 1, 1, 0, 0, 1, 0, 1, 1, 0 }, { 0, 0, 1, 1, 1, 1, 0, 0, 1, 1, 0, 0, 0, 0, 1, 1 },
+        { 0, 1, 1, 0, 0, 1, 1, 0, 1, 0, 0, 1, 1, 0, 0, 1 }, { 0, 0, 0, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 0, 0, 0 },
+        { 0, 1, 0, 0, 1, 1, 1, 0, 0, 1, 0, 0, 0, 0, 0, 0 }, { 0, 0, 1, 0, 0, 1, 1, 1, 0, 0, 1, 0, 0, 0, 0, 0 },
+        { 0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 1, 1, 0, 0, 1, 0 }, { 0, 0, 0, 0, 0, 1, 0, 0, 1, 1, 1, 0, 0, 1, 0, 0 },
+        { 0, 1, 1, 0, 1, 1, 0, 0, 1, 0, 0, 1, 0, 0, 1, 1 }, { 0, 0, 1, 1, 0, 1, 1, 0, 1, 1, 0, 0, 1, 0, 0, 1 },
+        { 0, 1, 1, 0, 0, 0, 1, 1, 1, 0, 0, 1, 1, 1, 0, 0 }, { 0, 0, 1, 1, 1, 0, 0, 1, 1, 1, 0, 0, 0, 1, 1, 0 },
+        { 0, 1, 1, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 0, 0, 1 }, { 0, 1, 1, 0, 0, 0, 1, 1, 0, 0, 1, 1, 1, 0, 0, 1 },
+        { 0, 1, 1, 1, 1, 1, 1, 0, 1, 0, 0, 0, 0, 0, 0, 1 }, { 0, 0, 0, 1, 1, 0, 0, 0, 1, 1, 1, 0, 0, 1, 1, 1 },
+        { 0, 0, 0, 0, 1, 1, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1 }, { 0, 0, 1, 1, 0, 0, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0 },
+        { 0, 0, 1, 0, 0, 0, 1, 0, 1, 1, 1, 0, 1, 1, 1, 0 }, { 0, 1, 0, 0, 0, 1, 0, 0, 0, 1, 1, 1, 0, 1, 1, 1 }
+    };
+
+    static const uint8_t g_bc7Partitions3[64][16] =
+    {
+        { 0, 0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 1, 2, 2, 2, 2 }, { 0, 0, 0, 1, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 2, 1 },
+        { 0, 0, 0, 0, 2, 0, 0, 1, 2, 2, 1, 1, 2, 2, 1, 1 }, { 0, 2, 2, 2, 0, 0, 2, 2, 0, 0, 1, 1, 0, 1, 1, 1 },
+        { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2 }, { 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 2, 2, 0, 0, 2, 2 },
+        { 0, 0, 2, 2, 0, 0, 2, 2, 1, 1, 1, 1, 1, 1, 1, 1 }, { 0, 0, 1, 1, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1 },
+        { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2 }, { 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 2, 2 },
+        { 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 2, 2, 2, 2 }, { 0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2 },
+        { 0, 1, 1, 2, 0, 1, 1, 2, 0, 1, 1, 2, 0, 1, 1, 2 }, { 0, 1, 2, 2, 0, 1, 2, 2, 0, 1, 2, 2, 0, 1, 2, 2 },
+        { 0, 0, 1, 1, 0, 1, 1, 2, 1, 1, 2, 2, 1, 2, 2, 2 }, { 0, 0, 1, 1, 2, 0, 0, 1, 2, 2, 0, 0, 2, 2, 2, 0 },
+        { 0, 0, 0, 1, 0, 0, 1, 1, 0, 1, 1, 2, 1, 1, 2, 2 }, { 0, 1, 1, 1, 0, 0, 1, 1, 2, 0, 0, 1, 2, 2, 0, 0 },
+        { 0, 0, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1, 2, 2 }, { 0, 0, 2, 2, 0, 0, 2, 2, 0, 0, 2, 2, 1, 1, 1, 1 },
+        { 0, 1, 1, 1, 0, 1, 1, 1, 0, 2, 2, 2, 0, 2, 2, 2 }, { 0, 0, 0, 1, 0, 0, 0, 1, 2, 2, 2, 1, 2, 2, 2, 1 },
+        { 0, 0, 0, 0, 0, 0, 1, 1, 0, 1, 2, 2, 0, 1, 2, 2 }, { 0, 0, 0, 0, 1, 1, 0, 0, 2, 2, 1, 0, 2, 2, 1, 0 },
+        { 0, 1, 2, 2, 0, 1, 2, 2, 0, 0, 1, 1, 0, 0, 0, 0 }, { 0, 0, 1, 2, 0, 0, 1, 2, 1, 1, 2, 2, 2, 2, 2, 2 },
+        { 0, 1, 1, 0, 1, 2, 2, 1, 1, 2, 2, 1, 0, 1, 1, 0 }, { 0, 0, 0, 0, 0, 1, 1, 0, 1, 2, 2, 1, 1, 2, 2, 1 },
+        { 0, 0, 2, 2, 1, 1, 0, 2, 1, 1, 0, 2, 0, 0, 2, 2 }, { 0, 1, 1, 0, 0, 1, 1, 0, 2, 0, 0, 2, 2, 2, 2, 2 },
+        { 0, 0, 1, 1, 0, 1, 2, 2, 0, 1, 2, 2, 0, 0, 1, 1 }, { 0, 0, 0, 0, 2, 0, 0, 0, 2, 2, 1, 1, 2, 2, 2, 1 },
+        { 0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 2, 2, 2 }, { 0, 2, 2, 2, 0, 0, 2, 2, 0, 0, 1, 2, 0, 0, 1, 1 },
+        { 0, 0, 1, 1, 0, 0, 1, 2, 0, 0, 2, 2, 0, 2, 2, 2 }, { 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0 },
+        { 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 0, 0, 0, 0 }, { 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0 },
+        { 0, 1, 2, 0, 2, 0, 1, 2, 1, 2, 0, 1, 0, 1, 2, 0 }, { 0, 0, 1, 1, 2, 2, 0, 0, 1, 1, 2, 2, 0, 0, 1, 1 },
+        { 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 0, 0, 0, 0, 1, 1 }, { 0, 1, 0, 1, 0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2 },
+        { 0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 2, 1, 2, 1, 2, 1 }, { 0, 0, 2, 2, 1, 1, 2, 2, 0, 0, 2, 2, 1, 1, 2, 2 },
+        { 0, 0, 2, 2, 0, 0, 1, 1, 0, 0, 2, 2, 0, 0, 1, 1 }, { 0, 2, 2, 0, 1, 2, 2, 1, 0, 2, 2, 0, 1, 2, 2, 1 },
+        { 0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2, 0, 1, 0, 1 }, { 0, 0, 0, 0, 2, 1, 2, 1, 2, 1, 2, 1, 2, 1, 2, 1 },
+        { 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 2, 2, 2, 2 }, { 0, 2, 2, 2, 0, 1, 1, 1, 0, 2, 2, 2, 0, 1, 1, 1 },
+        { 0, 0, 0, 2, 1, 1, 1, 2, 0, 0, 0, 2, 1, 1, 1, 2 }, { 0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1, 2 },
+        { 0, 2, 2, 2, 0, 1, 1, 1, 0, 1, 1, 1, 0, 2, 2, 2 }, { 0, 0, 0, 2, 1, 1, 1, 2, 1, 1, 1, 2, 0, 0, 0, 2 },
+        { 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 2, 2 }, { 0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 1, 2 },
+        { 0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 2, 2, 2, 2, 2, 2 }, { 0, 0, 2, 2, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 2, 2 },
+        { 0, 0, 2, 2, 1, 1, 2, 2, 1, 1, 2, 2, 0, 0, 2, 2 }, { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2 },
+        { 0, 0, 0, 2, 0, 0, 0, 1, 0, 0, 0, 2, 0, 0, 0, 1 }, { 0, 2, 2, 2, 1, 2, 2, 2, 0, 2, 2, 2, 1, 2, 2, 2 },
+        { 0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2 }, { 0, 1, 1, 1, 2, 0, 1, 1, 2, 2, 0, 1, 2, 2, 2, 0 }
+    };
+
+    // Pixels whose index drops the most significant bit, the first subset always anchors at pixel 0.
+    static const uint8_t g_bc7Anchors2[64] =
+    {
+        15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+        15,  2,  8,  2,  2,  8,  8, 15,  2,  8,  2,  2,  8,  8,  2,  2,
+        15, 15,  6,  8,  2,  8, 15, 15,  2,  8,  2,  2,  2, 15, 15,  6,
+         6,  2,  6,  8, 15, 15,  2,  2, 15, 15, 15, 15, 15,  2,  2, 15
+    };
+
+    static const uint8_t g_bc7Anchors3[2][64] =
+    {
+        {
+             3,  3, 15, 15,  8,  3, 15, 15,  8,  8,  6,  6,  6,  5,  3,  3,
+             3,  3,  8, 15,  3,  3,  6, 10,  5,  8,  8,  6,  8,  5, 15, 15,
+             8, 15,  3,  5,  6, 10,  8, 15, 15,  3, 15,  5, 15, 15, 15, 15,
+             3, 15,  5,  5,  5,  8,  5, 10,  5, 10,  8, 13, 15, 12,  3,  3
+        },
+        {
+            15,  8,  8,  3, 15, 15,  3,  8, 15, 15, 15, 15, 15, 15, 15,  8,
+            15,  8, 15,  3, 15,  8, 15,  8,  3, 15,  6, 10, 15, 15, 10,  8,
+            15,  3, 15, 10, 10,  8,  9, 10,  6, 15,  8, 15,  3,  6,  6,  8,
+            15,  3, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,  3, 15, 15,  8
+        }
+    };
+
+    // Layout of the eight modes, the bits of every field in the order they are stored.
+    struct Bc7Mode
+    {
+        uint32_t subsetCount;
+        uint32_t partitionBits;
+        uint32_t rotationBits;
+        uint32_t indexSelectionBits;
+        uint32_t colorBits;
+        uint32_t alphaBits;
+        uint32_t endpointPBits;
+        uint32_t sharedPBits;
+        uint32_t indexBits;
+        uint32_t secondaryIndexBits;
+    };
+
+    static const Bc7Mode g_bc7Modes[8] =
+    {
+        { 3, 4, 0, 0, 4, 0, 1, 0, 3, 0 },
+        { 2, 6, 0, 0, 6, 0, 0, 1, 3, 0 },
+        { 3, 6, 0, 0, 5, 0, 0, 0, 2, 0 },
+        { 2, 6, 0, 0, 7, 0, 1, 0, 2, 0 },
+        { 1, 0, 2, 1, 5, 6, 0, 0, 2, 3 },
+        { 1, 0, 2, 0, 7, 8, 0, 0, 2, 2 },
+        { 1, 0, 0, 0, 7, 7, 1, 0, 4, 0 },
+        { 2, 6, 0, 0, 5, 5, 1, 0, 2, 0 }
+    };
+
+    class BitWriter
+    {
+
+    public:
+
+        BitWriter() :
+            m_bits{ 0, 0 },
+            m_position(0)
+        { }
+
+        void write(const uint64_t value, const uint32_t count)
+        {
+            for (uint32_t i = 0; i < count; i++, m_position++)
+            {
+                m_bits[m_position / 64] |= ((value >> i) & 1) << (m_position % 64);
+            }
+        }
+
+        void store(uint8_t * output) const
+        {
+            for (size_t i = 0; i < 16; i++)
+            {
+                output[i] = static_cast<uint8_t>(m_bits[i / 8] >> ((i % 8) * 8));
+            }
+        }
+
+    private:
+
+        uint64_t m_bits[2];
+        uint32_t m_position;
+
+    };
+
+    class BitReader
+    {
+
+    public:
+
+        BitReader(const uint8_t * input) :
+            m_bits{ 0, 0 },
+            m_position(0)
+        {
+            for (size_t i = 0; i < 16; i++)
+            {
+                m_bits[i / 8] |= static_cast<uint64_t>(input[i]) << ((i % 8) * 8);
+            }
+        }
+
+        uint32_t read(const uint32_t count)
+        {
+            uint32_t value = 0;
+            for (uint32_t i = 0; i < count; i++, m_position++)
+            {
+                value |= static_cast<uint32_t>((m_bits[m_position / 64] >> (m_position % 64)) & 1) << i;
+            }
+            return value;
+        }
+
+    private:
+
+        uint64_t m_bits[2];
+        uint32_t m_position;
+
+    };
+
+    struct Bc7Endpoints
+    {
+        uint8_t quantized[2][4];
+        uint8_t pBits[2];
+    };
+
+    static uint8_t quantizeBc7Value(const float value, const uint8_t pBit)
+    {
+        const int quantized = static_cast<int>((value - pBit) / 2.0f + 0.5f);
+        return static_cast<uint8_t>(std::min(std::max(quantized, 0), 127));
+    }
+
+    static void getBc7Palette(const Bc7Endpoints & endpoints, uint8_t palette[16][4])
+    {
+        uint8_t expanded[2][4];
+        for (size_t e = 0; e < 2; e++)
+        {
+            for (size_t c = 0; c < 4; c++)
+            {
+                expanded[e][c] = static_cast<uint8_t>((endpoints.quantized[e][c] << 1) | endpoints.pBits[e]);
+            }
+        }
+        for (size_t i = 0; i < 16; i++)
+        {
+            for (size_t c = 0; c < 4; c++)
+            {
+                palette[i][c] = static_cast<uint8_t>(((64 - g_bc7Weights[i]) * expanded[0][c] + g_bc7Weights[i] * expanded[1][c] + 32) >> 6);
+            }
+        }
+    }
+
+    static uint32_t evaluateBc7Block(const BlockPixels & block, const float endpoint0[4], const float endpoint1[4],
+                                     const uint8_t pBit0, const uint8_t pBit1, Bc7Endpoints & endpoints, uint8_t indices[16])
+    {
+        endpoints.pBits[0] = pBit0;
+        endpoints.pBits[1] = pBit1;
+        for (size_t c = 0; c < 4; c++)
+        {
+            endpoints.quantized[0][c] = quantizeBc7Value(endpoint0[c], pBit0);
+            endpoints.quantized[1][c] = quantizeBc7Value(endpoint1[c], pBit1);
+        }
+
+        uint8_t palette[16][4];
+        getBc7Palette(endpoints, palette);
+
+        uint32_t error = 0;
+        for (size_t i = 0; i < 16; i++)
+        {
+            uint32_t bestError = std::numeric_limits<uint32_t>::max();
+            for (size_t p = 0; p < 16; p++)
+            {
+                uint32_t distance = 0;
+                for (size_t c = 0; c < 4; c++)
+                {
+                    const int32_t difference = static_cast<int32_t>(block.rgba[i][c]) - palette[p][c];
+                    distance += static_cast<uint32_t>(difference * difference);
+                }
+                if (distance < bestError)
+                {
+                    bestError = distance;
+                    indices[i] = static_cast<uint8_t>(p);
+                }
+            }
+            error += bestError;
+        }
+        return error;
+    }
+
+    static uint8_t chooseBc7PBit(const float endpoint[4])
+    {
+        float errors[2] = { 0.0f, 0.0f };
+        for (uint8_t pBit = 0; pBit < 2; pBit++)
+        {
+            for (size_t c = 0; c < 4; c++)
+            {
+                const float difference = static_cast<float>((quantizeBc7Value(endpoint[c], pBit) << 1) | pBit) - endpoint[c];
+                errors[pBit] += difference * difference;
+            }
+        }
+        return errors[1] < errors[0] ? 1 : 0;
+    }
+
+    static uint32_t evaluateBc7Candidates(const BlockPixels & block, const TextureCompressor::Quality quality,
+                                          const float endpoint0[4], const float endpoint1[4], Bc7Endpoints & endpoints, uint8_t indices[16])
+    {
+        if (quality != TextureCompressor::Quality::High)
+        {
+            return evaluateBc7Block(block, endpoint0, endpoint1, chooseBc7PBit(endpoint0), chooseBc7PBit(endpoint1), endpoints, indices);
+        }
+
+        uint32_t bestError = std::numeric_limits<uint32_t>::max();
+        for (uint8_t pBits = 0; pBits < 4; pBits++)
+        {
+            Bc7Endpoints candidate;
+            uint8_t candidateIndices[16];
+            const uint32_t error = evaluateBc7Block(block, endpoint0, endpoint1, pBits & 1, pBits >> 1, candidate, candidateIndices);
+            if (error < bestError)
+            {
+                bestError = error;
+                endpoints = candidate;
+                std::memcpy(indices, candidateIndices, 16);
+            }
+        }
+        return bestError;
+    }
+
+    static void encodeBc7Block(const BlockPixels & block, const TextureCompressor::Quality quality, uint8_t * output)
+    {
+        float pixels[16][4];
+        toFloat(block, pixels);
+
+        float endpoint0[4];
+        float endpoint1[4];
+        fitEndpoints<4>(pixels, quality, endpoint0, endpoint1);
+
+        Bc7Endpoints endpoints;
+        uint8_t indices[16];
+        uint32_t error = evaluateBc7Candidates(block, quality, endpoint0, endpoint1, endpoints, indices);
+
+        for (size_t iteration = 0; iteration < getRefinements(quality) && error > 0; iteration++)
+        {
+            float weights[16];
+            for (size_t i = 0; i < 16; i++)
+            {
+                weights[i] = static_cast<float>(g_bc7Weights[indices[i]]) / 64.0f;
+            }
+            if (!refineEndpoints<4>(pixels, weights, endpoint0, endpoint1))
+            {
+                break;
+            }
+
+            Bc7Endpoints refinedEndpoints;
+            uint8_t refinedIndices[16];
+            const uint32_t refinedError = evaluateBc7Candidates(block, quality, endpoint0, endpoint1, refinedEndpoints, refinedIndices);
+            if (refinedError >= error)
+            {
+                break;
+            }
+            endpoints = refinedEndpoints;
+            std::memcpy(indices, refinedIndices, 16);
+            error = refinedError;
+        }
+
+        // The most significant index bit of the first pixel is implicitly zero, swap the endpoints if it is set.
+        if (indices[0] & 0x8)
+        {
+            std::swap(endpoints.quantized[0], endpoints.quantized[1]);
+            std::swap(endpoints.pBits[0], endpoints.pBits[1]);
+            for (size_t i = 0; i < 16; i++)
+            {
+                indices[i] = static_cast<uint8_t>(15 - indices[i]);
+            }
+        }
+
+        BitWriter writer;
+        writer.write(1 << 6, 7);
+        for (size_t c = 0; c < 4; c++)
+        {
+            writer.write(endpoints.quantized[0][c], 7);
+            writer.write(endpoints.quantized[1][c], 7);
+        }
+        writer.write(endpoints.pBits[0], 1);
+        writer.write(endpoints.pBits[1], 1);
+        writer.write(indices[0], 3);
+        for (size_t i = 1; i < 16; i++)
+        {
+            writer.write(indices[i], 4);
+        }
+        writer.store(output);
+    }
+
+    static uint8_t expandBc7Value(uint32_t value, const uint32_t bits)
+    {
+        value <<= 8 - bits;
+        return static_cast<uint8_t>(value | (value >> bits));
+    }
+
+    static uint8_t interpolateBc7Value(const uint8_t value0, const uint8_t value1, const uint32_t index, const uint32_t indexBits)
+    {
+        const uint32_t weight = indexBits == 2 ? g_bc7Weights2[index] : (indexBits == 3 ? g_bc7Weights3[index] : g_bc7Weights[index]);
+        return static_cast<uint8_t>(((64 - weight) * value0 + weight * value1 + 32) >> 6);
+    }
+
+    static void decodeBc7Block(const uint8_t * input, uint8_t output[16][4])
+    {
+        // The mode is the position of the lowest set bit, a zero first byte is reserved and not a valid block.
+        uint32_t modeIndex = 0;
+        while (modeIndex < 8 && !(input[0] & (1 << modeIndex)))
+        {
+            modeIndex++;
+        }
+        if (modeIndex == 8)
+        {
+            throw std::runtime_error("Cannot decode BC7 block with the reserved mode.");
+        }
+
+        const Bc7Mode & mode = g_bc7Modes[modeIndex];
+        BitReader reader(input);
+        reader.read(modeIndex + 1);
+        const uint32_t partition = reader.read(mode.partitionBits);
+        const uint32_t rotation = reader.read(mode.rotationBits);
+        const uint32_t indexSelection = reader.read(mode.indexSelectionBits);
+
+        uint32_t endpoints[3][2][4];
+        for (uint32_t c = 0; c < 4; c++)
+        {
+            const uint32_t bits = c < 3 ? mode.colorBits : mode.alphaBits;
+            for (uint32_t s = 0; s < mode.subsetCount; s++)
+            {
+                for (uint32_t e = 0; e < 2; e++)
+                {
+                    endpoints[s][e][c] = reader.read(bits);
+                }
+            }
+        }
+
+        uint32_t pBits[3][2] = {};
+        for (uint32_t s = 0; s < mode.subsetCount; s++)
+        {
+            if (mode.endpointPBits)
+            {
+                pBits[s][0] = reader.read(1);
+                pBits[s][1] = reader.read(1);
+            }
+            else if (mode.sharedPBits)
+            {
+                pBits[s][0] = pBits[s][1] = reader.read(1);
+            }
+        }
+
+        uint8_t expanded[3][2][4];
+        const uint32_t pBitCount = mode.endpointPBits | mode.sharedPBits;
+        for (uint32_t s = 0; s < mode.subsetCount; s++)
+        {
+            for (uint32_t e = 0; e < 2; e++)
+            {
+                for (uint32_t c = 0; c < 4; c++)
+                {
+                    const uint32_t bits = c < 3 ? mode.colorBits : mode.alphaBits;
+                    expanded[s][e][c] = bits == 0 ? 255 :
+                        expandBc7Value((endpoints[s][e][c] << pBitCount) | pBits[s][e], bits + pBitCount);
+                }
+            }
+        }
+
+        uint8_t subsets[16];
+        uint32_t anchors[3] = { 0, 0, 0 };
+        for (size_t i = 0; i < 16; i++)
+        {
+            subsets[i] = mode.subsetCount == 1 ? 0 :
+                (mode.subsetCount == 2 ? g_bc7Partitions2[partition][i] : g_bc7Partitions3[partition][i]);
+        }
+        if (mode.subsetCount == 2)
+        {
+            anchors[1] = g_bc7Anchors2[partition];
+        }
+        else if (mode.subsetCount == 3)
+        {
+            anchors[1] = g_bc7Anchors3[0][partition];
+            anchors[2] = g_bc7Anchors3[1][partition];
+        }
+
+        uint32_t indices[16];
+        for (size_t i = 0; i < 16; i++)
+        {
+            const bool anchor = static_cast<uint32_t>(i) == anchors[subsets[i]];
+            indices[i] = reader.read(anchor ? mode.indexBits - 1 : mode.indexBits);
+        }
+
+        // Modes 4 and 5 carry a second index set, the index selection bit swaps which set is used for color.
+        uint32_t secondaryIndices[16] = {};
+        for (size_t i = 0; mode.secondaryIndexBits && i < 16; i++)
+        {
+            secondaryIndices[i] = reader.read(i == 0 ? mode.secondaryIndexBits - 1 : mode.secondaryIndexBits);
+        }
+
+        for (size_t i = 0; i < 16; i++)
+        {
+            const uint8_t (& pair)[2][4] = expanded[subsets[i]];
+            uint32_t colorIndex = indices[i];
+            uint32_t colorBits = mode.indexBits;
+            uint32_t alphaIndex = indices[i];
+            uint32_t alphaBits = mode.indexBits;
+            if (mode.secondaryIndexBits)
+            {
+                alphaIndex = secondaryIndices[i];
+                alphaBits = mode.secondaryIndexBits;
+                if (indexSelection)
+                {
+                    std::swap(colorIndex, alphaIndex);
+                    std::swap(colorBits, alphaBits);
+                }
+            }
+
+            for (size_t c = 0; c < 3; c++)
+            {
+                output[i][c] = interpolateBc7Value(pair[0][c], pair[1][c], colorIndex, colorBits);
+            }
+            output[i][3] = interpolateBc7Value(pair[0][3], pair[1][3], alphaIndex, alphaBits);
+
+            // Rotation swaps alpha with red, green or blue after interpolation.
+            if (rotation)
+            {
+                std::swap(output[i][3], output[i][rotation - 1]);
+            }
+        }
+    }
+
+
+    static void encodeBlock(const BlockPixels & block, const Texture::PixelFormat pixelFormat, const TextureCompressor::Quality quality,
+                            uint8_t * output)
+    {
+        uint8_t channel[16];
+        switch (pixelFormat)
+        {
+            case Texture::PixelFormat::BC1:
+                encodeColorBlock(block, quality, output);
+                break;
+            case Texture::PixelFormat::BC3:
+                for (size_t i = 0; i < 16; i++)
+                {
+                    channel[i] = block.rgba[i][3];
+                }
+                encodeChannelBlock(channel, quality, output);
+                encodeColorBlock(block, quality, output + 8);
+                break;
+            case Texture::PixelFormat::BC5:
+                for (size_t c = 0; c < 2; c++)
+                {
+                    for (size_t i = 0; i < 16; i++)
+                    {
+                        channel[i] = block.rgba[i][c];
+                    }
+                    encodeChannelBlock(channel, quality, output + c * 8);
+                }
+                break;
+            case Texture::PixelFormat::BC7:
+                encodeBc7Block(block, quality, output);
+                break;
+            default:
+                break;
+        }
+    }
+
+    static void decodeBlock(const uint8_t * input, const Texture::PixelFormat pixelFormat, uint8_t output[16][4])
+    {
+        switch (pixelFormat)
+        {
+            case Texture::PixelFormat::BC1:
+                decodeColorBlock(input, false, output);
+                break;
+            case Texture::PixelFormat::BC3:
+                decodeColorBlock(input + 8, true, output);
+                decodeChannelBlock(input, output, 3);
+                break;
+            case Texture::PixelFormat::BC5:
+                for (size_t i = 0; i < 16; i++)
+                {
+                    output[i][2] = 0;
+                    output[i][3] = 255;
+                }
+                decodeChannelBlock(input, output, 0);
+                decodeChannelBlock(input + 8, output, 1);
+                break;
+            case Texture::PixelFormat::BC7:
+                decodeBc7Block(input, output);
+                break;
+            default:
+                break;
+        }
+    }
+
+    static size_t getEncodedChannels(const Texture::PixelFormat pixelFormat)
+    {
+        switch (pixelFormat)
+        {
+            case Texture::PixelFormat::BC1: return 3;
+            case Texture::PixelFormat::BC5: return 2;
+            default: return 4;
+        }
+    }
+
+
+    TextureCompressor::Settings::Settings() :
+        format(Texture::PixelFormat::BC7),
+        quality(Quality::Normal),
+        mipmaps(),
+        cacheDirectory()
+    { }
+
+    TextureCompressor::TextureCompressor(JobSystem * jobSystem) :
+        m_pJobSystem(jobSystem)
+    { }
+
+    bool TextureCompressor::isCompressed(const Texture::PixelFormat pixelFormat)
+    {
+        return pixelFormat != Texture::PixelFormat::RGB && pixelFormat != Texture::PixelFormat::RGBA;
+    }
+
+    size_t TextureCompressor::getBlockSize(const Texture::PixelFormat pixelFormat)
+    {
+        switch (pixelFormat)
+        {
+            case Texture::PixelFormat::RGB: return 3;
+            case Texture::PixelFormat::RGBA: return 4;
+            case Texture::PixelFormat::BC1: return 8;
+            default: return 16;
+        }
+    }
+
+    size_t TextureCompressor::getLevels(const Vector2ui32 & size, const uint32_t levelCount, const Texture::PixelFormat pixelFormat,
+                                        std::vector<MipmapGenerator::Level> & levels)
+    {
+        MipmapGenerator::getLevels(size, levelCount, levels);
+
+        const bool compressed = isCompressed(pixelFormat);
+        const size_t blockSize = getBlockSize(pixelFormat);
+        size_t offset = 0;
+        for (auto & level : levels)
+        {
+            const size_t width = compressed ? (level.size.x + 3) / 4 : level.size.x;
+            const size_t height = compressed ? (level.size.y + 3) / 4 : level.size.y;
+            level.offset = offset;
+            level.byteSize = width * height * blockSize;
+            offset += level.byteSize;
+        }
+        return offset;
+    }
+
+    size_t TextureCompressor::getBufferSize(const Vector2ui32 & size, const Texture::PixelFormat pixelFormat)
+    {
+        std::vector<MipmapGenerator::Level> levels;
+        const uint32_t levelCount = isCompressed(pixelFormat) ? MipmapGenerator::getLevelCount(size) : 1;
+        return getLevels(size, levelCount, pixelFormat, levels);
+    }
+
+    TextureCompressor::Result TextureCompressor::compress(const uint8_t * source, const Vector2ui32 & size, const Texture::PixelFormat sourceFormat,
+                                                          std::vector<uint8_t> & output, const Settings & settings) const
+    {
+        if (!isCompressed(settings.format) || isCompressed(sourceFormat))
+        {
+            throw std::runtime_error("Texture compression needs an uncompressed source and a block compressed format.");
+        }
+        if (size.x == 0 || size.y == 0)
+        {
+            throw std::runtime_error("Cannot compress an empty texture.");
+        }
+
+        MipmapGenerator::Settings mipmapSettings = settings.mipmaps;
+        mipmapSettings.maxLevels = 0;
+
+        Result result;
+        result.levelCount = MipmapGenerator::getLevelCount(size);
+        result.psnr = 0.0;
+        result.cached = false;
+
+        // Everything affecting the output is part of the key.
+        const size_t sourceSize = static_cast<size_t>(size.x) * size.y * (sourceFormat == Texture::PixelFormat::RGBA ? 4 : 3);
+        uint64_t key = hashData(g_hashOffset, source, sourceSize);
+        key = hashValue(key, size.x);
+        key = hashValue(key, size.y);
+        key = hashValue(key, static_cast<uint32_t>(sourceFormat));
+        key = hashValue(key, static_cast<uint32_t>(settings.format));
+        key = hashValue(key, static_cast<uint32_t>(settings.quality));
+        key = hashValue(key, static_cast<uint32_t>(mipmapSettings.filter));
+        key = hashValue(key, mipmapSettings.gammaCorrect);
+        key = hashValue(key, mipmapSettings.preserveAlphaCoverage);
+        key = hashValue(key, mipmapSettings.alphaReference);
+
+        std::string filename;
+        if (!settings.cacheDirectory.empty())
+        {
+            std::ostringstream stream;
+            stream << settings.cacheDirectory << "/" << std::hex << std::setw(16) << std::setfill('0') << key << ".fbc";
+            filename = stream.str();
+
+            std::ifstream file(filename, std::ios::binary);
+            TextureCacheFileHeader header;
+            std::vector<MipmapGenerator::Level> cachedLevels;
+            if (file.is_open() &&
+                file.read(reinterpret_cast<char *>(&header), sizeof(header)) &&
+                header.magic == FLARE_TEXTURE_CACHE_MAGIC &&
+                header.version == FLARE_TEXTURE_CACHE_VERSION &&
+                header.key == key &&
+                header.format == static_cast<uint32_t>(settings.format) &&
+                header.width == size.x &&
+                header.height == size.y &&
+                header.levelCount == result.levelCount &&
+                header.dataSize == getLevels(size, result.levelCount, settings.format, cachedLevels))
+            {
+                // The size is checked against the chain layout first, a damaged header cannot cause a huge allocation.
+                output.resize(static_cast<size_t>(header.dataSize));
+                if (file.read(reinterpret_cast<char *>(output.data()), output.size()) &&
+                    hashData(g_hashOffset, output.data(), output.size()) == header.dataHash)
+                {
+                    result.psnr = header.psnr;
+                    result.cached = true;
+                    return result;
+                }
+            }
+        }
+
+        std::vector<uint8_t> chain;
+        std::vector<MipmapGenerator::Level> sourceLevels;
+        MipmapGenerator generator(m_pJobSystem);
+        generator.generate(source, size, sourceFormat, chain, sourceLevels, mipmapSettings);
+
+        std::vector<MipmapGenerator::Level> levels;
+        output.resize(getLevels(size, result.levelCount, settings.format, levels));
+
+        // One task per row of blocks in any level, each summing the squared error of its own blocks.
+        struct Task
+        {
+            uint32_t level;
+            uint32_t row;
+        };
+        std::vector<Task> tasks;
+        for (uint32_t level = 0; level < levels.size(); level++)
+        {
+            for (uint32_t row = 0; row < (levels[level].size.y + 3) / 4; row++)
+            {
+                tasks.push_back(Task{ level, row });
+            }
+        }
+
+        const size_t blockSize = getBlockSize(settings.format);
+        const size_t channels = getEncodedChannels(settings.format);
+        std::vector<double> errors(tasks.size(), 0.0);
+        auto encodeRows = [&](const size_t first, const size_t last)
+        {
+            BlockPixels block;
+            uint8_t decoded[16][4];
+            for (size_t t = first; t < last; t++)
+            {
+                const MipmapGenerator::Level & sourceLevel = sourceLevels[tasks[t].level];
+                const MipmapGenerator::Level & level = levels[tasks[t].level];
+                const uint32_t blocksX = (level.size.x + 3) / 4;
+                const uint32_t blockY = tasks[t].row;
+                uint8_t * pOutput = output.data() + level.offset + static_cast<size_t>(blockY) * blocksX * blockSize;
+
+                uint64_t error = 0;
+                for (uint32_t blockX = 0; blockX < blocksX; blockX++, pOutput += blockSize)
+                {
+                    loadBlock(chain.data() + sourceLevel.offset, level.size, blockX, blockY, block);
+                    encodeBlock(block, settings.format, settings.quality, pOutput);
+
+                    // Only pixels inside the level count, not the repeated edge pixels.
+                    decodeBlock(pOutput, settings.format, decoded);
+                    for (uint32_t y = 0; y < 4 && blockY * 4 + y < level.size.y; y++)
+                    {
+                        for (uint32_t x = 0; x < 4 && blockX * 4 + x < level.size.x; x++)
+                        {
+                            for (size_t c = 0; c < channels; c++)
+                            {
+                                const int32_t difference = static_cast<int32_t>(block.rgba[y * 4 + x][c]) - decoded[y * 4 + x][c];
+                                error += static_cast<uint64_t>(difference * difference);
+                            }
+                        }
+                    }
+                }
+                errors[t] = static_cast<double>(error);
+            }
+        };
+
+        if (m_pJobSystem)
+        {
+            m_pJobSystem->parallelFor(0, tasks.size(), 1, encodeRows);
+        }
+        else
+        {
+            encodeRows(0, tasks.size());
+        }
+
+        double totalError = 0.0;
+        for (const auto & error : errors)
+        {
+            totalError += error;
+        }
+        double sampleCount = 0.0;
+        for (const auto & level : levels)
+        {
+            sampleCount += static_cast<double>(level.size.x) * level.size.y * channels;
+        }
+        const double meanSquaredError = totalError / sampleCount;
+        result.psnr = meanSquaredError > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / meanSquaredError) : std::numeric_limits<double>::infinity();
+
+        if (!filename.empty())
+        {
+            TextureCacheFileHeader header;
+            header.magic = FLARE_TEXTURE_CACHE_MAGIC;
+            header.version = FLARE_TEXTURE_CACHE_VERSION;
+            header.key = key;
+            header.format = static_cast<uint32_t>(settings.format);
+            header.width = size.x;
+            header.height = size.y;
+            header.levelCount = result.levelCount;
+            header.psnr = result.psnr;
+            header.dataSize = output.size();
+            header.dataHash = hashData(g_hashOffset, output.data(), output.size());
+
+            // Write to a temporary file first, a crash while saving must not leave a broken cache entry behind.
+            const std::string tempFilename = filename + ".tmp";
+            std::ofstream file(tempFilename, std::ios::binary | std::ios::trunc);
+            if (file.is_open())
+            {
+                file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+                file.write(reinterpret_cast<const char *>(output.data()), output.size());
+                file.close();
+
+                if (file)
+                {
+                    std::remove(filename.c_str());
+                    std::rename(tempFilename.c_str(), filename.c_str());
+                }
+                else
+                {
+                    std::remove(tempFilename.c_str());
+                }
+            }
+        }
+
+        return result;
+    }
+
+    void TextureCompressor::decompress(const uint8_t * blocks, const Vector2ui32 & size, const Texture::PixelFormat pixelFormat, uint8_t * output)
+    {
+        if (!isCompressed(pixelFormat))
+        {
+            throw std::runtime_error("Only block compressed formats can be decompressed.");
+        }
+
+        const size_t blockSize = getBlockSize(pixelFormat);
+        const uint32_t blocksX = (size.x + 3) / 4;
+        const uint32_t blocksY = (size.y + 3) / 4;
+        uint8_t decoded[16][4];
+        for (uint32_t blockY = 0; blockY < blocksY; blockY++)
+        {
+            for (uint32_t blockX = 0; blockX < blocksX; blockX++, blocks += blockSize)
+            {
+                decodeBlock(blocks, pixelFormat, decoded);
+                for (uint32_t y = 0; y < 4 && blockY * 4 + y < size.y; y++)
+                {
+                    for (uint32_t x = 0; x < 4 && blockX * 4 + x < size.x; x++)
+                    {
+                        std::memcpy(output + (static_cast<size_t>(blockY * 4 + y) * size.x + blockX * 4 + x) * 4, decoded[y * 4 + x], 4);
+                    }
+                }
+            }
+        }
+    }
+
+}
\ No newline at end of file
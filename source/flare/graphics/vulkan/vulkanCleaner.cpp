@@ -27,107 +27,162 @@
 
 #if defined(FLARE_VULKAN)
 
-#include "flare/system/semaphore.hpp"
-#include <chrono>
+#include <stdexcept>
 
 namespace Flare
 {
 
     VulkanCleaner::VulkanCleaner() :
         m_running(false),
-        m_refreshTime(0.0f),
-        m_maxTime(0.0f)
+        m_pPending(nullptr),
+        m_nodeCount(0),
+        m_freeNodes(0),
+        m_maxBatchSize(0)
     {
     }
 
     VulkanCleaner::~VulkanCleaner()
+    {
+        stop();
+    }
+
+    void VulkanCleaner::start(const size_t maxBatchSize, const uint32_t nodeCount)
     {
         if (m_running)
         {
-            m_running = false;
-            m_thread.join();
+            throw std::runtime_error("Cannot start already running cleaner.");
         }
 
-        std::lock_guard<std::mutex> lock(m_mutex);
-        while (m_objects.size())
+        // The pool is kept when restarted, a late add() may still be returning nodes to it.
+        if (!m_nodes)
         {
-            auto object = m_objects.front();
-            m_objects.pop();
-            delete object;
+            m_nodes.reset(new RetiredObject[nodeCount]);
+            m_nodeCount = nodeCount;
+            for (uint32_t i = 0; i < nodeCount; i++)
+            {
+                m_nodes[i].index = i + 1;
+                m_nodes[i].nextFree.store(i + 1 < nodeCount ? i + 2 : 0, std::memory_order_relaxed);
+            }
+            m_freeNodes.store(nodeCount ? 1 : 0, std::memory_order_release);
         }
+
+        m_maxBatchSize = maxBatchSize;
+        m_running = true;
     }
 
-    void VulkanCleaner::start(float refreshTime, float maxTime)
+    void VulkanCleaner::stop()
     {
-        if (m_running)
+        // The device is expected to be idle and all frames flushed, everything can be deleted.
+        m_running = false;
+
+        takePending(m_released);
+
+        releaseObjects(0);
+    }
+
+    void VulkanCleaner::add(RenderObject * ptr)
+    {
+        // No frames in flight.
+        if (!m_running.load(std::memory_order_acquire))
         {
-            throw std::runtime_error("Cannot start already running cleaner.");
+            delete ptr;
+            return;
         }
 
-        m_refreshTime = refreshTime;
-        m_maxTime = maxTime;
-
-        Semaphore sem;
-        m_thread = std::thread([this, &sem]()
+        RetiredObject * node = acquireNode();
+        node->pObject = ptr;
+        node->pNext = m_pPending.load(std::memory_order_relaxed);
+        while (!m_pPending.compare_exchange_weak(node->pNext, node, std::memory_order_seq_cst, std::memory_order_relaxed))
         {
-            m_running = true;
-            sem.notifyOne();
+        }
 
-            while (m_running)
+        // Stopped meanwhile, the list may already have been drained by stop().
+        if (!m_running.load(std::memory_order_seq_cst))
+        {
+            std::vector<RenderObject *> objects;
+            takePending(objects);
+            for (auto object : objects)
             {
-                const auto startTime = std::chrono::high_resolution_clock::now();
-                std::chrono::duration<double> elapsedTime(0.0f);
-
-                while (1)
-                {
-                    std::lock_guard<std::mutex> lock(m_mutex);
-
-                    if (m_objects.size() == 0)
-                    {
-                        elapsedTime = std::chrono::high_resolution_clock::now() - startTime;
-                        break;
-                    }
-
-                    auto object = m_objects.front();
-                    m_objects.pop();
-
-                    delete object;
-                   
-                    elapsedTime = std::chrono::high_resolution_clock::now() - startTime;
-                    if (elapsedTime.count() >= m_maxTime)
-                    {
-                        break;
-                    }
-                }
-
-                const auto sleepTime = std::chrono::milliseconds(static_cast<long long>(m_refreshTime * 1000.0f)) - elapsedTime;
-                if (sleepTime.count() > 0)
-                {
-                    std::this_thread::sleep_for(sleepTime);
-                }
+                delete object;
             }
+        }
+    }
 
-            
-        });
+    void VulkanCleaner::nextFrame(std::vector<RenderObject *> & retired)
+    {
+        // Objects retired the last time this frame was in flight are no longer used by the device.
+        flush(retired);
 
-        sem.wait();
+        // Retire objects added since last frame, deleted when this frame's fence has signaled.
+        takePending(retired);
+
+        releaseObjects(m_maxBatchSize);
     }
 
-    void VulkanCleaner::stop()
+    void VulkanCleaner::flush(std::vector<RenderObject *> & retired)
+    {
+        m_released.insert(m_released.end(), retired.begin(), retired.end());
+        retired.clear();
+    }
+
+    VulkanCleaner::RetiredObject * VulkanCleaner::acquireNode()
     {
-        if (!m_running)
+        // The upper half of the head is bumped on every change, a node popped and pushed back meanwhile fails the exchange.
+        uint64_t head = m_freeNodes.load(std::memory_order_acquire);
+        while (static_cast<uint32_t>(head))
         {
+            RetiredObject * node = &m_nodes[static_cast<uint32_t>(head) - 1];
+            const uint64_t next = ((head >> 32) + 1) << 32 | node->nextFree.load(std::memory_order_relaxed);
+            if (m_freeNodes.compare_exchange_weak(head, next, std::memory_order_acquire, std::memory_order_acquire))
+            {
+                return node;
+            }
+        }
+
+        RetiredObject * node = new RetiredObject;
+        node->index = 0;
+        return node;
+    }
+
+    void VulkanCleaner::releaseNode(RetiredObject * node)
+    {
+        if (!node->index)
+        {
+            delete node;
             return;
         }
 
-        m_running = false;
-        m_thread.join();
+        uint64_t head = m_freeNodes.load(std::memory_order_relaxed);
+        uint64_t next = 0;
+        do
+        {
+            node->nextFree.store(static_cast<uint32_t>(head), std::memory_order_relaxed);
+            next = ((head >> 32) + 1) << 32 | node->index;
+        } while (!m_freeNodes.compare_exchange_weak(head, next, std::memory_order_release, std::memory_order_relaxed));
     }
 
-    void VulkanCleaner::add(RenderObject * ptr)
+    void VulkanCleaner::takePending(std::vector<RenderObject *> & objects)
     {
-        std::lock_guard<std::mutex> lock(m_mutex);
-        m_objects.push(ptr);
+        // The whole list is detached at once, so no other consumer can observe an object being deleted.
+        RetiredObject * node = m_pPending.exchange(nullptr, std::memory_order_seq_cst);
+        while (node)
+        {
+            RetiredObject * next = node->pNext;
+            objects.push_back(node->pObject);
+            releaseNode(node);
+            node = next;
+        }
+    }
+
+    void VulkanCleaner::releaseObjects(const size_t maxCount)
+    {
+        size_t count = 0;
+        while (m_released.size() && (maxCount == 0 || count < maxCount))
+        {
+            delete m_released.back();
+            m_released.pop_back();
+            ++count;
+        }
     }
 
 }
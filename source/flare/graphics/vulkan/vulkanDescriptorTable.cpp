@@ -0,0 +1,323 @@
+/*
+* MIT License
+*
+* Copyright(c) 2018 Jimmie Bergmann
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*/
+
+#include "flare/graphics/vulkan/vulkanDescriptorTable.hpp"
+
+#if defined(FLARE_VULKAN)
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace Flare
+{
+
+    VulkanDescriptorTable::VulkanDescriptorTable() :
+        m_logicalDevice(0),
+        m_layout(0),
+        m_pool(0),
+        m_descriptorSet(0),
+        m_sampler(0),
+        m_textures{ 0, 0, 0, {} },
+        m_buffers{ 0, 0, 0, {} }
+    {
+    }
+
+    VulkanDescriptorTable::~VulkanDescriptorTable()
+    {
+        unload();
+    }
+
+    void VulkanDescriptorTable::load(VkPhysicalDevice physicalDevice, VkDevice logicalDevice, const uint32_t maxTextures, const uint32_t maxBuffers)
+    {
+        unload();
+
+        m_logicalDevice = logicalDevice;
+
+        // Update after bind descriptors have their own, usually much higher, limits.
+        VkPhysicalDeviceDescriptorIndexingPropertiesEXT indexingProperties = {};
+        indexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT;
+        VkPhysicalDeviceProperties2 properties = {};
+        properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+        properties.pNext = &indexingProperties;
+        vkGetPhysicalDeviceProperties2(physicalDevice, &properties);
+
+        m_textures.capacity = std::min({ maxTextures, indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages,
+                                         indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages });
+        m_buffers.capacity = std::min({ maxBuffers, indexingProperties.maxDescriptorSetUpdateAfterBindStorageBuffers,
+                                        indexingProperties.maxPerStageDescriptorUpdateAfterBindStorageBuffers });
+
+        VkDescriptorSetLayoutBinding bindings[2] = {};
+        bindings[0].binding = TextureBinding;
+        bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        bindings[0].descriptorCount = m_textures.capacity;
+        bindings[0].stageFlags = VK_SHADER_STAGE_ALL_GRAPHICS | VK_SHADER_STAGE_COMPUTE_BIT;
+        bindings[1].binding = BufferBinding;
+        bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[1].descriptorCount = m_buffers.capacity;
+        bindings[1].stageFlags = VK_SHADER_STAGE_ALL_GRAPHICS | VK_SHADER_STAGE_COMPUTE_BIT;
+
+        // Unused slots are never written, descriptors of resources not used by pending command buffers may be updated.
+        const VkDescriptorBindingFlagsEXT flags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT |
+                                                  VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT |
+                                                  VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT;
+        const VkDescriptorBindingFlagsEXT bindingFlags[2] = { flags, flags };
+
+        VkDescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsInfo = {};
+        bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+        bindingFlagsInfo.bindingCount = 2;
+        bindingFlagsInfo.pBindingFlags = bindingFlags;
+
+        VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layoutInfo.pNext = &bindingFlagsInfo;
+        layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+        layoutInfo.bindingCount = 2;
+        layoutInfo.pBindings = bindings;
+
+        if (vkCreateDescriptorSetLayout(m_logicalDevice, &layoutInfo, nullptr, &m_layout) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to create descriptor table layout.");
+        }
+
+        VkDescriptorPoolSize poolSizes[2] = {};
+        poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        poolSizes[0].descriptorCount = m_textures.capacity;
+        poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        poolSizes[1].descriptorCount = m_buffers.capacity;
+
+        VkDescriptorPoolCreateInfo poolInfo = {};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+        poolInfo.maxSets = 1;
+        poolInfo.poolSizeCount = 2;
+        poolInfo.pPoolSizes = poolSizes;
+
+        if (vkCreateDescriptorPool(m_logicalDevice, &poolInfo, nullptr, &m_pool) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to create descriptor table pool.");
+        }
+
+        VkDescriptorSetAllocateInfo allocateInfo = {};
+        allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocateInfo.descriptorPool = m_pool;
+        allocateInfo.descriptorSetCount = 1;
+        allocateInfo.pSetLayouts = &m_layout;
+
+        if (vkAllocateDescriptorSets(m_logicalDevice, &allocateInfo, &m_descriptorSet) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to allocate descriptor table.");
+        }
+
+        VkSamplerCreateInfo samplerInfo = {};
+        samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+        samplerInfo.magFilter = VK_FILTER_LINEAR;
+        samplerInfo.minFilter = VK_FILTER_LINEAR;
+        samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+        samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+        samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+        samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+        samplerInfo.anisotropyEnable = VK_FALSE;
+        samplerInfo.maxAnisotropy = 1.0f;
+        samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+        samplerInfo.unnormalizedCoordinates = VK_FALSE;
+        samplerInfo.compareEnable = VK_FALSE;
+        samplerInfo.minLod = 0.0f;
+        samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+
+        if (vkCreateSampler(m_logicalDevice, &samplerInfo, nullptr, &m_sampler) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to create descriptor table sampler.");
+        }
+    }
+
+    void VulkanDescriptorTable::unload()
+    {
+        if (m_sampler)
+        {
+            vkDestroySampler(m_logicalDevice, m_sampler, nullptr);
+            m_sampler = 0;
+        }
+        if (m_pool)
+        {
+            vkDestroyDescriptorPool(m_logicalDevice, m_pool, nullptr);
+            m_pool = 0;
+        }
+        if (m_layout)
+        {
+            vkDestroyDescriptorSetLayout(m_logicalDevice, m_layout, nullptr);
+            m_layout = 0;
+        }
+        m_descriptorSet = 0;
+
+        m_textures = Slots{ 0, 0, 0, {} };
+        m_buffers = Slots{ 0, 0, 0, {} };
+    }
+
+    bool VulkanDescriptorTable::isLoaded() const
+    {
+        return m_descriptorSet != 0;
+    }
+
+    uint32_t VulkanDescriptorTable::addTexture(VkImageView imageView)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        const uint32_t index = allocateSlot(m_textures);
+        if (index == InvalidIndex)
+        {
+            return InvalidIndex;
+        }
+
+        writeTexture(index, imageView);
+        return index;
+    }
+
+    uint32_t VulkanDescriptorTable::addBuffer(VkBuffer buffer, const VkDeviceSize offset, const VkDeviceSize range)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        const uint32_t index = allocateSlot(m_buffers);
+        if (index == InvalidIndex)
+        {
+            return InvalidIndex;
+        }
+
+        VkDescriptorBufferInfo bufferInfo = {};
+        bufferInfo.buffer = buffer;
+        bufferInfo.offset = offset;
+        bufferInfo.range = range;
+
+        VkWriteDescriptorSet write = {};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = m_descriptorSet;
+        write.dstBinding = BufferBinding;
+        write.dstArrayElement = index;
+        write.descriptorCount = 1;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        write.pBufferInfo = &bufferInfo;
+
+        vkUpdateDescriptorSets(m_logicalDevice, 1, &write, 0, nullptr);
+        return index;
+    }
+
+    void VulkanDescriptorTable::updateTexture(const uint32_t index, VkImageView imageView)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (index < m_textures.next)
+        {
+            writeTexture(index, imageView);
+        }
+    }
+
+    void VulkanDescriptorTable::removeTexture(const uint32_t index)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        freeSlot(m_textures, index);
+    }
+
+    void VulkanDescriptorTable::removeBuffer(const uint32_t index)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        freeSlot(m_buffers, index);
+    }
+
+    VkDescriptorSetLayout VulkanDescriptorTable::getLayout() const
+    {
+        return m_layout;
+    }
+
+    VkDescriptorSet VulkanDescriptorTable::getDescriptorSet() const
+    {
+        return m_descriptorSet;
+    }
+
+    uint32_t VulkanDescriptorTable::getTextureCount() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_textures.count;
+    }
+
+    uint32_t VulkanDescriptorTable::getBufferCount() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_buffers.count;
+    }
+
+    void VulkanDescriptorTable::writeTexture(const uint32_t index, VkImageView imageView)
+    {
+        VkDescriptorImageInfo imageInfo = {};
+        imageInfo.sampler = m_sampler;
+        imageInfo.imageView = imageView;
+        imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+        VkWriteDescriptorSet write = {};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = m_descriptorSet;
+        write.dstBinding = TextureBinding;
+        write.dstArrayElement = index;
+        write.descriptorCount = 1;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        write.pImageInfo = &imageInfo;
+
+        // Updating the set is externally synchronized, even for different descriptors.
+        vkUpdateDescriptorSets(m_logicalDevice, 1, &write, 0, nullptr);
+    }
+
+    uint32_t VulkanDescriptorTable::allocateSlot(Slots & slots)
+    {
+        // Freed indices are reused first, keeping the used range of the arrays compact.
+        uint32_t index = InvalidIndex;
+        if (slots.free.size())
+        {
+            index = slots.free.back();
+            slots.free.pop_back();
+        }
+        else if (slots.next < slots.capacity)
+        {
+            index = slots.next++;
+        }
+        else
+        {
+            return InvalidIndex;
+        }
+
+        ++slots.count;
+        return index;
+    }
+
+    void VulkanDescriptorTable::freeSlot(Slots & slots, const uint32_t index)
+    {
+        if (index >= slots.next)
+        {
+            return;
+        }
+
+        slots.free.push_back(index);
+        --slots.count;
+    }
+
+}
+
+#endif
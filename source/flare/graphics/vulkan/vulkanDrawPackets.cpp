@@ -0,0 +1,360 @@
+/*
+* MIT License
+*
+* Copyright(c) 2018 Jimmie Bergmann
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*/
+
+#include "flare/graphics/vulkan/vulkanDrawPackets.hpp"
+
+#if defined(FLARE_VULKAN)
+
+#include "flare/graphics/vulkan/vulkanDescriptorTable.hpp"
+#include "flare/graphics/vulkan/vulkanFrame.hpp"
+#include "flare/graphics/vulkan/vulkanUploader.hpp"
+#include "flare/system/jobSystem.hpp"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace Flare
+{
+
+    VulkanDrawPackets::VulkanDrawPackets() :
+        m_logicalDevice(0),
+        m_pMemoryAllocator(nullptr),
+        m_pUploader(nullptr),
+        m_pDescriptorTable(nullptr),
+        m_multiDrawIndirect(false),
+        m_drawIndirectFirstInstance(false),
+        m_vertexStride(0),
+        m_maxVertices(0),
+        m_maxIndices(0),
+        m_vertexBuffer(0),
+        m_indexBuffer(0),
+        m_vertexBufferIndex(VulkanDescriptorTable::InvalidIndex),
+        m_vertexCount(0),
+        m_indexCount(0),
+        m_indirectBuffer(0),
+        m_indirectOffset(0),
+        m_statistics{ 0, 0, 0, 0 }
+    {
+        for (auto & plane : m_frustum)
+        {
+            plane = Vector4f(0.0f, 0.0f, 0.0f, 1.0f);
+        }
+    }
+
+    VulkanDrawPackets::~VulkanDrawPackets()
+    {
+        unload();
+    }
+
+    void VulkanDrawPackets::load(VkDevice logicalDevice, const VkPhysicalDeviceFeatures & features, VulkanMemoryAllocator & memoryAllocator,
+                                 VulkanUploader & uploader, VulkanDescriptorTable & descriptorTable, const uint32_t graphicsFamily,
+                                 const uint32_t vertexStride, const uint32_t maxVertices, const uint32_t maxIndices)
+    {
+        unload();
+
+        m_logicalDevice = logicalDevice;
+        m_pMemoryAllocator = &memoryAllocator;
+        m_pUploader = &uploader;
+        m_pDescriptorTable = &descriptorTable;
+        m_multiDrawIndirect = features.multiDrawIndirect == VK_TRUE;
+        m_drawIndirectFirstInstance = features.drawIndirectFirstInstance == VK_TRUE;
+        m_vertexStride = vertexStride;
+        m_maxVertices = maxVertices;
+        m_maxIndices = maxIndices;
+
+        // Written on the transfer queue and read on the graphics queue.
+        const uint32_t queueFamilies[] = { graphicsFamily, uploader.getQueueFamily() };
+        const bool concurrent = queueFamilies[0] != queueFamilies[1];
+
+        VkBufferCreateInfo bufferInfo = {};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.sharingMode = concurrent ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+        bufferInfo.queueFamilyIndexCount = concurrent ? 2 : 0;
+        bufferInfo.pQueueFamilyIndices = concurrent ? queueFamilies : nullptr;
+
+        bufferInfo.size = static_cast<VkDeviceSize>(m_vertexStride) * m_maxVertices;
+        bufferInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+        if (vkCreateBuffer(m_logicalDevice, &bufferInfo, nullptr, &m_vertexBuffer) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to create draw packet vertex buffer.");
+        }
+        m_vertexMemory = m_pMemoryAllocator->allocate(m_vertexBuffer, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+        bufferInfo.size = static_cast<VkDeviceSize>(sizeof(uint32_t)) * m_maxIndices;
+        bufferInfo.usage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+        if (vkCreateBuffer(m_logicalDevice, &bufferInfo, nullptr, &m_indexBuffer) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to create draw packet index buffer.");
+        }
+        m_indexMemory = m_pMemoryAllocator->allocate(m_indexBuffer, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+        m_vertexBufferIndex = m_pDescriptorTable->addBuffer(m_vertexBuffer, 0, VK_WHOLE_SIZE);
+    }
+
+    void VulkanDrawPackets::unload()
+    {
+        if (m_vertexBufferIndex != VulkanDescriptorTable::InvalidIndex)
+        {
+            m_pDescriptorTable->removeBuffer(m_vertexBufferIndex);
+            m_vertexBufferIndex = VulkanDescriptorTable::InvalidIndex;
+        }
+        if (m_vertexBuffer)
+        {
+            vkDestroyBuffer(m_logicalDevice, m_vertexBuffer, nullptr);
+            m_pMemoryAllocator->free(m_vertexMemory);
+            m_vertexBuffer = 0;
+        }
+        if (m_indexBuffer)
+        {
+            vkDestroyBuffer(m_logicalDevice, m_indexBuffer, nullptr);
+            m_pMemoryAllocator->free(m_indexMemory);
+            m_indexBuffer = 0;
+        }
+
+        m_vertexCount = 0;
+        m_indexCount = 0;
+        m_meshes.clear();
+        m_instances.clear();
+        m_commands.clear();
+        m_indirectBuffer = 0;
+        m_statistics = Statistics{ 0, 0, 0, 0 };
+    }
+
+    uint32_t VulkanDrawPackets::addMesh(const void * vertices, const uint32_t vertexCount, const uint32_t * indices, const uint32_t indexCount,
+                                        const Vector4f & bounds)
+    {
+        Mesh mesh;
+        uint32_t meshIndex = 0;
+        {
+            // Only the ranges are reserved under the lock, the uploads run concurrently.
+            std::lock_guard<std::mutex> lock(m_meshMutex);
+            if (!m_vertexBuffer)
+            {
+                throw std::runtime_error("Draw packets have not been loaded.");
+            }
+            if (vertexCount > m_maxVertices - m_vertexCount || indexCount > m_maxIndices - m_indexCount)
+            {
+                throw std::runtime_error("Draw packet buffers are full.");
+            }
+
+            mesh.firstIndex = m_indexCount;
+            mesh.indexCount = indexCount;
+            mesh.vertexOffset = static_cast<int32_t>(m_vertexCount);
+            mesh.bounds = bounds;
+            m_vertexCount += vertexCount;
+            m_indexCount += indexCount;
+            meshIndex = static_cast<uint32_t>(m_meshes.size());
+            m_meshes.push_back(mesh);
+        }
+
+        m_pUploader->uploadBuffer(m_vertexBuffer, static_cast<VkDeviceSize>(mesh.vertexOffset) * m_vertexStride,
+                                  vertices, static_cast<VkDeviceSize>(vertexCount) * m_vertexStride);
+        m_pUploader->uploadBuffer(m_indexBuffer, static_cast<VkDeviceSize>(mesh.firstIndex) * sizeof(uint32_t),
+                                  indices, static_cast<VkDeviceSize>(indexCount) * sizeof(uint32_t));
+
+        return meshIndex;
+    }
+
+    VulkanDrawPackets::Mesh VulkanDrawPackets::getMesh(const uint32_t mesh) const
+    {
+        std::lock_guard<std::mutex> lock(m_meshMutex);
+        return m_meshes.at(mesh);
+    }
+
+    void VulkanDrawPackets::clear()
+    {
+        m_instances.clear();
+    }
+
+    void VulkanDrawPackets::add(const Instance & instance)
+    {
+        // Meshes are only removed by unload, which clears the instances as well, so build() never sees a stale id.
+        {
+            std::lock_guard<std::mutex> lock(m_meshMutex);
+            if (instance.mesh >= m_meshes.size())
+            {
+                throw std::runtime_error("Draw packet instance refers to an invalid mesh.");
+            }
+        }
+        m_instances.push_back(instance);
+    }
+
+    void VulkanDrawPackets::setFrustum(const Vector4f planes[6])
+    {
+        for (size_t i = 0; i < 6; i++)
+        {
+            m_frustum[i] = planes[i];
+        }
+    }
+
+    void VulkanDrawPackets::build(VulkanFrame & frame, JobSystem & jobSystem)
+    {
+        m_indirectBuffer = 0;
+        m_statistics = Statistics{ m_instances.size(), 0, 0, 0 };
+        if (m_instances.empty() || !m_indexBuffer)
+        {
+            m_commands.clear();
+            return;
+        }
+
+        std::vector<Mesh> meshes;
+        {
+            std::lock_guard<std::mutex> lock(m_meshMutex);
+            meshes = m_meshes;
+        }
+
+        // Count visible instances per chunk, then write each chunk at its prefix sum. Keeps the instance order.
+        const size_t instanceCount = m_instances.size();
+        const size_t chunkSize = CullChunkSize;
+        const size_t chunkCount = (instanceCount + chunkSize - 1) / chunkSize;
+        m_chunkOffsets.assign(chunkCount + 1, 0);
+
+        jobSystem.parallelFor(0, chunkCount, 1, [&](const size_t first, const size_t last)
+        {
+            for (size_t chunk = first; chunk < last; chunk++)
+            {
+                const size_t end = std::min(instanceCount, (chunk + 1) * chunkSize);
+                uint32_t visible = 0;
+                for (size_t i = chunk * chunkSize; i < end; i++)
+                {
+                    visible += isVisible(m_instances[i].bounds) ? 1 : 0;
+                }
+                m_chunkOffsets[chunk + 1] = visible;
+            }
+        });
+
+        for (size_t chunk = 0; chunk < chunkCount; chunk++)
+        {
+            m_chunkOffsets[chunk + 1] += m_chunkOffsets[chunk];
+        }
+        const uint32_t visibleCount = m_chunkOffsets[chunkCount];
+        m_commands.resize(visibleCount);
+
+        jobSystem.parallelFor(0, chunkCount, 1, [&](const size_t first, const size_t last)
+        {
+            for (size_t chunk = first; chunk < last; chunk++)
+            {
+                const size_t end = std::min(instanceCount, (chunk + 1) * chunkSize);
+                VkDrawIndexedIndirectCommand * pCommand = m_commands.data() + m_chunkOffsets[chunk];
+                for (size_t i = chunk * chunkSize; i < end; i++)
+                {
+                    const Instance & instance = m_instances[i];
+                    if (!isVisible(instance.bounds))
+                    {
+                        continue;
+                    }
+
+                    const Mesh & mesh = meshes[instance.mesh];
+                    pCommand->indexCount = mesh.indexCount;
+                    pCommand->instanceCount = 1;
+                    pCommand->firstIndex = mesh.firstIndex;
+                    pCommand->vertexOffset = mesh.vertexOffset;
+                    pCommand->firstInstance = instance.firstInstance;
+                    ++pCommand;
+                }
+            }
+        });
+
+        m_statistics.visibleInstances = visibleCount;
+        m_statistics.culledInstances = instanceCount - visibleCount;
+        if (!visibleCount)
+        {
+            return;
+        }
+
+        // A single sequential copy into write combined frame memory. The frame's indirect buffer is sized for every instance,
+        // so it grows with the instance count rather than with how many happen to be visible.
+        void * pData = frame.reserveIndirect(sizeof(VkDrawIndexedIndirectCommand) * instanceCount, m_indirectBuffer);
+        std::memcpy(pData, m_commands.data(), sizeof(VkDrawIndexedIndirectCommand) * visibleCount);
+        m_indirectOffset = 0;
+    }
+
+    void VulkanDrawPackets::record(VkCommandBuffer commandBuffer)
+    {
+        m_statistics.indirectCalls = 0;
+        if (m_commands.empty() || !m_indirectBuffer)
+        {
+            return;
+        }
+
+        vkCmdBindIndexBuffer(commandBuffer, m_indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+
+        const uint32_t drawCount = static_cast<uint32_t>(m_commands.size());
+        const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+        if (!m_drawIndirectFirstInstance)
+        {
+            // Indirect draws would lose the first instance, draw directly from the compacted copy.
+            for (const auto & command : m_commands)
+            {
+                vkCmdDrawIndexed(commandBuffer, command.indexCount, command.instanceCount, command.firstIndex,
+                                 command.vertexOffset, command.firstInstance);
+            }
+        }
+        else if (m_multiDrawIndirect)
+        {
+            vkCmdDrawIndexedIndirect(commandBuffer, m_indirectBuffer, m_indirectOffset, drawCount, stride);
+            m_statistics.indirectCalls = 1;
+        }
+        else
+        {
+            for (uint32_t i = 0; i < drawCount; i++)
+            {
+                vkCmdDrawIndexedIndirect(commandBuffer, m_indirectBuffer, m_indirectOffset + static_cast<VkDeviceSize>(i) * stride, 1, stride);
+            }
+            m_statistics.indirectCalls = drawCount;
+        }
+    }
+
+    uint32_t VulkanDrawPackets::getVertexBufferIndex() const
+    {
+        return m_vertexBufferIndex;
+    }
+
+    size_t VulkanDrawPackets::getInstanceCount() const
+    {
+        return m_instances.size();
+    }
+
+    const VulkanDrawPackets::Statistics & VulkanDrawPackets::getStatistics() const
+    {
+        return m_statistics;
+    }
+
+    bool VulkanDrawPackets::isVisible(const Vector4f & bounds) const
+    {
+        // Planes point inwards, a sphere entirely behind any plane is outside.
+        for (const auto & plane : m_frustum)
+        {
+            if (plane.x * bounds.x + plane.y * bounds.y + plane.z * bounds.z + plane.w < -bounds.w)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+}
+
+#endif
\ No newline at end of file
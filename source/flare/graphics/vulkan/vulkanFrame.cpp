@@ -0,0 +1,404 @@
+/*
+* MIT License
+*
+* Copyright(c) 2018 Jimmie Bergmann
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*/
+
+#include "flare/graphics/vulkan/vulkanFrame.hpp"
+
+#if defined(FLARE_VULKAN)
+
+#include "flare/graphics/vulkan/vulkanRenderer.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+#define FLARE_FRAME_DESCRIPTOR_SETS 1024
+
+namespace Flare
+{
+
+    VulkanFrame::VulkanFrame() :
+        m_logicalDevice(0),
+        m_pMemoryAllocator(nullptr),
+        m_commandPool(0),
+        m_commandBuffer(0),
+        m_imageAvailableSemaphore(0),
+        m_renderFinishedSemaphore(0),
+        m_inFlightFence(0),
+        m_descriptorPool(0),
+        m_uniformBuffer(0),
+        m_pUniformData(nullptr),
+        m_uniformSize(0),
+        m_uniformOffset(0),
+        m_uniformAlignment(1),
+        m_indirectBuffer(0),
+        m_indirectSize(0)
+    {
+    }
+
+    VulkanFrame::~VulkanFrame()
+    {
+        unload();
+    }
+
+    VulkanFrame::WorkerCommands::WorkerCommands() :
+        commandPool(0),
+        usedCount(0)
+    { }
+
+    void VulkanFrame::load(VkPhysicalDevice physicalDevice, VkDevice logicalDevice, VulkanMemoryAllocator & memoryAllocator,
+                           const uint32_t queueFamily, const VkDeviceSize uniformBufferSize, const size_t workerCount)
+    {
+        unload();
+        m_logicalDevice = logicalDevice;
+        m_pMemoryAllocator = &memoryAllocator;
+
+        // Create command pool, reset as a whole once the frame has finished.
+        VkCommandPoolCreateInfo poolInfo = {};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.queueFamilyIndex = queueFamily;
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+        if (vkCreateCommandPool(m_logicalDevice, &poolInfo, nullptr, &m_commandPool) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to create frame command pool.");
+        }
+
+        VkCommandBufferAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = m_commandPool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = 1;
+        if (vkAllocateCommandBuffers(m_logicalDevice, &allocInfo, &m_commandBuffer) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to allocate frame command buffer.");
+        }
+
+        // Create worker command pools for secondary command buffers.
+        m_workerCommands.resize(workerCount);
+        for (auto & worker : m_workerCommands)
+        {
+            if (vkCreateCommandPool(m_logicalDevice, &poolInfo, nullptr, &worker.commandPool) != VK_SUCCESS)
+            {
+                throw std::runtime_error("Failed to create frame worker command pool.");
+            }
+        }
+
+        // Create synchronization objects.
+        VkSemaphoreCreateInfo semaphoreInfo = {};
+        semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+        VkFenceCreateInfo fenceInfo = {};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+        if (vkCreateSemaphore(m_logicalDevice, &semaphoreInfo, nullptr, &m_imageAvailableSemaphore) != VK_SUCCESS ||
+            vkCreateSemaphore(m_logicalDevice, &semaphoreInfo, nullptr, &m_renderFinishedSemaphore) != VK_SUCCESS ||
+            vkCreateFence(m_logicalDevice, &fenceInfo, nullptr, &m_inFlightFence) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to create synchronization objects for a frame.");
+        }
+
+        // Create descriptor pool.
+        VkDescriptorPoolSize poolSizes[3] = {};
+        poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        poolSizes[0].descriptorCount = FLARE_FRAME_DESCRIPTOR_SETS;
+        poolSizes[1].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        poolSizes[1].descriptorCount = FLARE_FRAME_DESCRIPTOR_SETS;
+        poolSizes[2].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        poolSizes[2].descriptorCount = FLARE_FRAME_DESCRIPTOR_SETS;
+
+        VkDescriptorPoolCreateInfo descriptorPoolInfo = {};
+        descriptorPoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        descriptorPoolInfo.poolSizeCount = 3;
+        descriptorPoolInfo.pPoolSizes = poolSizes;
+        descriptorPoolInfo.maxSets = FLARE_FRAME_DESCRIPTOR_SETS;
+
+        if (vkCreateDescriptorPool(m_logicalDevice, &descriptorPoolInfo, nullptr, &m_descriptorPool) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to create frame descriptor pool.");
+        }
+
+        loadCreateUniformBuffer(physicalDevice, uniformBufferSize);
+    }
+
+    void VulkanFrame::unload()
+    {
+        if (!m_logicalDevice)
+        {
+            return;
+        }
+
+        // Retired objects are normally flushed to the cleaner first. Called from the destructor, so leftovers are
+        // deleted once the frame has finished instead of throwing.
+        if (m_retired.size())
+        {
+            if (m_inFlightFence)
+            {
+                wait();
+            }
+            for (auto object : m_retired)
+            {
+                delete object;
+            }
+            m_retired.clear();
+        }
+
+        unloadIndirectBuffer();
+        if (m_uniformBuffer)
+        {
+            vkDestroyBuffer(m_logicalDevice, m_uniformBuffer, nullptr);
+            m_uniformBuffer = 0;
+        }
+        if (m_pMemoryAllocator)
+        {
+            m_pMemoryAllocator->free(m_uniformMemory);
+        }
+        m_pUniformData = nullptr;
+        if (m_descriptorPool)
+        {
+            vkDestroyDescriptorPool(m_logicalDevice, m_descriptorPool, nullptr);
+            m_descriptorPool = 0;
+        }
+        if (m_inFlightFence)
+        {
+            vkDestroyFence(m_logicalDevice, m_inFlightFence, nullptr);
+            m_inFlightFence = 0;
+        }
+        if (m_renderFinishedSemaphore)
+        {
+            vkDestroySemaphore(m_logicalDevice, m_renderFinishedSemaphore, nullptr);
+            m_renderFinishedSemaphore = 0;
+        }
+        if (m_imageAvailableSemaphore)
+        {
+            vkDestroySemaphore(m_logicalDevice, m_imageAvailableSemaphore, nullptr);
+            m_imageAvailableSemaphore = 0;
+        }
+        for (auto & worker : m_workerCommands)
+        {
+            if (worker.commandPool)
+            {
+                vkDestroyCommandPool(m_logicalDevice, worker.commandPool, nullptr);
+            }
+        }
+        m_workerCommands.clear();
+
+        if (m_commandPool)
+        {
+            // Command buffers are freed with the pool.
+            vkDestroyCommandPool(m_logicalDevice, m_commandPool, nullptr);
+            m_commandPool = 0;
+            m_commandBuffer = 0;
+        }
+
+        // Upload semaphores are owned by the uploader.
+        m_uploadSemaphores.clear();
+        m_uniformSize = 0;
+        m_uniformOffset = 0;
+        m_logicalDevice = 0;
+    }
+
+    void VulkanFrame::wait()
+    {
+        vkWaitForFences(m_logicalDevice, 1, &m_inFlightFence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+    }
+
+    void VulkanFrame::reset()
+    {
+        vkResetFences(m_logicalDevice, 1, &m_inFlightFence);
+        vkResetCommandPool(m_logicalDevice, m_commandPool, 0);
+        for (auto & worker : m_workerCommands)
+        {
+            vkResetCommandPool(m_logicalDevice, worker.commandPool, 0);
+            worker.usedCount = 0;
+        }
+        vkResetDescriptorPool(m_logicalDevice, m_descriptorPool, 0);
+        m_uniformOffset = 0;
+    }
+
+    void * VulkanFrame::allocateUniform(const VkDeviceSize size, VkDeviceSize & offset)
+    {
+        const VkDeviceSize alignedOffset = (m_uniformOffset + m_uniformAlignment - 1) & ~(m_uniformAlignment - 1);
+        if (alignedOffset + size > m_uniformSize)
+        {
+            throw std::runtime_error("Frame uniform buffer is full.");
+        }
+
+        offset = alignedOffset;
+        m_uniformOffset = alignedOffset + size;
+        return m_pUniformData + alignedOffset;
+    }
+
+    void * VulkanFrame::reserveIndirect(const VkDeviceSize size, VkBuffer & buffer)
+    {
+        // Grown geometrically, so a steadily increasing instance count does not recreate the buffer every frame.
+        if (size > m_indirectSize)
+        {
+            unloadIndirectBuffer();
+
+            const VkDeviceSize newSize = std::max(size, m_indirectSize * 2);
+            VkBufferCreateInfo bufferInfo = {};
+            bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+            bufferInfo.size = newSize;
+            bufferInfo.usage = VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
+            bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+            if (vkCreateBuffer(m_logicalDevice, &bufferInfo, nullptr, &m_indirectBuffer) != VK_SUCCESS)
+            {
+                m_indirectBuffer = 0;
+                throw std::runtime_error("Failed to create frame indirect buffer.");
+            }
+            try
+            {
+                m_indirectMemory = m_pMemoryAllocator->allocate(m_indirectBuffer,
+                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+            }
+            catch (...)
+            {
+                vkDestroyBuffer(m_logicalDevice, m_indirectBuffer, nullptr);
+                m_indirectBuffer = 0;
+                throw;
+            }
+            m_indirectSize = newSize;
+        }
+
+        buffer = m_indirectBuffer;
+        return m_indirectMemory.pMappedData;
+    }
+
+    VkCommandBuffer VulkanFrame::allocateSecondaryCommandBuffer(const size_t workerIndex)
+    {
+        if (workerIndex >= m_workerCommands.size())
+        {
+            throw std::runtime_error("Frame worker index out of range.");
+        }
+
+        // Command buffers are kept between frames and recycled by the pool reset.
+        WorkerCommands & worker = m_workerCommands[workerIndex];
+        if (worker.usedCount == worker.commandBuffers.size())
+        {
+            VkCommandBufferAllocateInfo allocInfo = {};
+            allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            allocInfo.commandPool = worker.commandPool;
+            allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+            allocInfo.commandBufferCount = 1;
+
+            VkCommandBuffer commandBuffer;
+            if (vkAllocateCommandBuffers(m_logicalDevice, &allocInfo, &commandBuffer) != VK_SUCCESS)
+            {
+                throw std::runtime_error("Failed to allocate secondary command buffer.");
+            }
+            worker.commandBuffers.push_back(commandBuffer);
+        }
+
+        return worker.commandBuffers[worker.usedCount++];
+    }
+
+    VkCommandPool VulkanFrame::getCommandPool() const
+    {
+        return m_commandPool;
+    }
+
+    VkCommandBuffer VulkanFrame::getCommandBuffer() const
+    {
+        return m_commandBuffer;
+    }
+
+    VkSemaphore VulkanFrame::getImageAvailableSemaphore() const
+    {
+        return m_imageAvailableSemaphore;
+    }
+
+    VkSemaphore VulkanFrame::getRenderFinishedSemaphore() const
+    {
+        return m_renderFinishedSemaphore;
+    }
+
+    VkFence VulkanFrame::getInFlightFence() const
+    {
+        return m_inFlightFence;
+    }
+
+    VkDescriptorPool VulkanFrame::getDescriptorPool() const
+    {
+        return m_descriptorPool;
+    }
+
+    VkBuffer VulkanFrame::getUniformBuffer() const
+    {
+        return m_uniformBuffer;
+    }
+
+    std::vector<RenderObject *> & VulkanFrame::getRetired()
+    {
+        return m_retired;
+    }
+
+    std::vector<VkSemaphore> & VulkanFrame::getUploadSemaphores()
+    {
+        return m_uploadSemaphores;
+    }
+
+    void VulkanFrame::loadCreateUniformBuffer(VkPhysicalDevice physicalDevice, const VkDeviceSize size)
+    {
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+        m_uniformAlignment = std::max<VkDeviceSize>(properties.limits.minUniformBufferOffsetAlignment, 1);
+        m_uniformSize = size;
+
+        VkBufferCreateInfo bufferInfo = {};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size = size;
+        bufferInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        if (vkCreateBuffer(m_logicalDevice, &bufferInfo, nullptr, &m_uniformBuffer) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to create frame uniform buffer.");
+        }
+
+        // Host coherent, written once by the host and read once by the device. Host visible pages are persistently mapped.
+        m_uniformMemory = m_pMemoryAllocator->allocate(m_uniformBuffer,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        m_pUniformData = m_uniformMemory.pMappedData;
+    }
+
+    void VulkanFrame::unloadIndirectBuffer()
+    {
+        if (m_indirectBuffer)
+        {
+            vkDestroyBuffer(m_logicalDevice, m_indirectBuffer, nullptr);
+            m_indirectBuffer = 0;
+        }
+        if (m_pMemoryAllocator)
+        {
+            m_pMemoryAllocator->free(m_indirectMemory);
+        }
+        m_indirectSize = 0;
+    }
+
+}
+
+#endif
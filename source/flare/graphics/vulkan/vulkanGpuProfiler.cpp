@@ -0,0 +1,255 @@
+/*
+* MIT License
+*
+* Copyright(c) 2018 Jimmie Bergmann
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*/
+
+#include "flare/graphics/vulkan/vulkanGpuProfiler.hpp"
+
+#if defined(FLARE_VULKAN)
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace Flare
+{
+
+    VulkanGpuProfiler::FrameQueries::FrameQueries() :
+        queryPool(0),
+        frame(0)
+    { }
+
+    VulkanGpuProfiler::VulkanGpuProfiler() :
+        m_logicalDevice(0),
+        m_maxScopes(0),
+        m_timestampMask(0),
+        m_timestampPeriod(0.0),
+        m_frameCounter(0),
+        m_pCurrentFrame(nullptr),
+        m_latestProfile{},
+        m_hasProfile(false)
+    {
+    }
+
+    VulkanGpuProfiler::~VulkanGpuProfiler()
+    {
+        unload();
+    }
+
+    void VulkanGpuProfiler::load(VkPhysicalDevice physicalDevice, VkDevice logicalDevice, const uint32_t queueFamily,
+                                 const size_t frameCount, const uint32_t maxScopes)
+    {
+        unload();
+
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+        uint32_t queueFamilyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+        std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+
+        // Stay disabled if the queue cannot write timestamps.
+        const uint32_t validBits = queueFamily < queueFamilyCount ? queueFamilies[queueFamily].timestampValidBits : 0;
+        if (!validBits || properties.limits.timestampPeriod <= 0.0f)
+        {
+            return;
+        }
+
+        m_logicalDevice = logicalDevice;
+        m_maxScopes = maxScopes;
+        m_timestampMask = validBits >= 64 ? ~uint64_t(0) : (uint64_t(1) << validBits) - 1;
+        m_timestampPeriod = static_cast<double>(properties.limits.timestampPeriod);
+        m_frameCounter = 0;
+
+        VkQueryPoolCreateInfo queryPoolInfo = {};
+        queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        queryPoolInfo.queryCount = maxScopes * 2;
+
+        m_frames.resize(frameCount);
+        for (auto & frameQueries : m_frames)
+        {
+            if (vkCreateQueryPool(m_logicalDevice, &queryPoolInfo, nullptr, &frameQueries.queryPool) != VK_SUCCESS)
+            {
+                throw std::runtime_error("Failed to create timestamp query pool.");
+            }
+            frameQueries.scopes.reserve(maxScopes);
+        }
+    }
+
+    void VulkanGpuProfiler::unload()
+    {
+        for (auto & frameQueries : m_frames)
+        {
+            if (frameQueries.queryPool)
+            {
+                vkDestroyQueryPool(m_logicalDevice, frameQueries.queryPool, nullptr);
+            }
+        }
+        m_frames.clear();
+
+        m_logicalDevice = 0;
+        m_pCurrentFrame = nullptr;
+        m_latestProfile = GpuFrameProfile{};
+        m_hasProfile = false;
+    }
+
+    void VulkanGpuProfiler::beginFrame(VkCommandBuffer commandBuffer, const size_t frameIndex)
+    {
+        if (!isEnabled())
+        {
+            return;
+        }
+
+        // The previous use of this slot has finished, its results are ready.
+        FrameQueries & frameQueries = m_frames[frameIndex];
+        resolve(frameQueries);
+
+        frameQueries.scopes.clear();
+        frameQueries.stack.clear();
+        frameQueries.frame = m_frameCounter++;
+        vkCmdResetQueryPool(commandBuffer, frameQueries.queryPool, 0, m_maxScopes * 2);
+
+        m_pCurrentFrame = &frameQueries;
+    }
+
+    void VulkanGpuProfiler::beginScope(VkCommandBuffer commandBuffer, const std::string & name)
+    {
+        if (!m_pCurrentFrame)
+        {
+            return;
+        }
+
+        // Scopes beyond the query pool size are dropped, but still have to be balanced.
+        std::vector<Scope> & scopes = m_pCurrentFrame->scopes;
+        if (scopes.size() == m_maxScopes)
+        {
+            m_pCurrentFrame->stack.push_back(InvalidScope);
+            return;
+        }
+
+        const uint32_t index = static_cast<uint32_t>(scopes.size());
+        const uint32_t parent = m_pCurrentFrame->stack.size() ? m_pCurrentFrame->stack.back() : InvalidScope;
+        scopes.push_back({ name, parent });
+        m_pCurrentFrame->stack.push_back(index);
+
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_pCurrentFrame->queryPool, index * 2);
+    }
+
+    void VulkanGpuProfiler::endScope(VkCommandBuffer commandBuffer)
+    {
+        if (!m_pCurrentFrame || !m_pCurrentFrame->stack.size())
+        {
+            return;
+        }
+
+        const uint32_t index = m_pCurrentFrame->stack.back();
+        m_pCurrentFrame->stack.pop_back();
+        if (index == InvalidScope)
+        {
+            return;
+        }
+
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_pCurrentFrame->queryPool, index * 2 + 1);
+    }
+
+    bool VulkanGpuProfiler::getLatestProfile(GpuFrameProfile & profile) const
+    {
+        if (!m_hasProfile)
+        {
+            return false;
+        }
+
+        profile = m_latestProfile;
+        return true;
+    }
+
+    bool VulkanGpuProfiler::isEnabled() const
+    {
+        return m_frames.size() != 0;
+    }
+
+    void VulkanGpuProfiler::resolve(FrameQueries & frameQueries)
+    {
+        // Open scopes were never ended, the frame is dropped.
+        const uint32_t scopeCount = static_cast<uint32_t>(frameQueries.scopes.size());
+        if (!scopeCount || frameQueries.stack.size())
+        {
+            return;
+        }
+
+        std::vector<uint64_t> timestamps(scopeCount * 2);
+        if (vkGetQueryPoolResults(m_logicalDevice, frameQueries.queryPool, 0, scopeCount * 2,
+                                  timestamps.size() * sizeof(uint64_t), timestamps.data(), sizeof(uint64_t),
+                                  VK_QUERY_RESULT_64_BIT) != VK_SUCCESS)
+        {
+            return;
+        }
+
+        std::vector<std::vector<uint32_t> > children(scopeCount);
+        std::vector<uint32_t> roots;
+        uint64_t frameStart = timestamps[0] & m_timestampMask;
+        for (uint32_t i = 0; i < scopeCount; i++)
+        {
+            const uint32_t parent = frameQueries.scopes[i].parent;
+            (parent == InvalidScope ? roots : children[parent]).push_back(i);
+            frameStart = std::min(frameStart, timestamps[i * 2] & m_timestampMask);
+        }
+
+        m_latestProfile.frame = frameQueries.frame;
+        m_latestProfile.scopes.clear();
+        for (auto root : roots)
+        {
+            m_latestProfile.scopes.push_back(buildScope(frameQueries, root, children, timestamps, frameStart));
+        }
+        m_hasProfile = true;
+    }
+
+    GpuProfileScope VulkanGpuProfiler::buildScope(const FrameQueries & frameQueries, const uint32_t index,
+                                                  const std::vector<std::vector<uint32_t> > & children,
+                                                  const std::vector<uint64_t> & timestamps, const uint64_t frameStart) const
+    {
+        const uint64_t begin = timestamps[index * 2] & m_timestampMask;
+        const uint64_t end = timestamps[index * 2 + 1] & m_timestampMask;
+
+        GpuProfileScope scope;
+        scope.name = frameQueries.scopes[index].name;
+        scope.start = toMilliseconds(frameStart, begin);
+        scope.duration = toMilliseconds(begin, end);
+        for (auto child : children[index])
+        {
+            scope.children.push_back(buildScope(frameQueries, child, children, timestamps, frameStart));
+        }
+        return scope;
+    }
+
+    double VulkanGpuProfiler::toMilliseconds(const uint64_t begin, const uint64_t end) const
+    {
+        // Timestamps wrap around at the number of valid bits.
+        const uint64_t ticks = (end - begin) & m_timestampMask;
+        return static_cast<double>(ticks) * m_timestampPeriod / 1000000.0;
+    }
+
+}
+
+#endif
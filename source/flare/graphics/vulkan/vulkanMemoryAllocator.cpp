@@ -0,0 +1,350 @@
+/*
+* MIT License
+*
+* Copyright(c) 2018 Jimmie Bergmann
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*/
+
+#include "flare/graphics/vulkan/vulkanMemoryAllocator.hpp"
+
+#if defined(FLARE_VULKAN)
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace Flare
+{
+
+    static const uint32_t g_resourceTypeCount = 2;
+
+    VulkanMemoryAllocator::Allocation::Allocation() :
+        memory(0),
+        offset(0),
+        size(0),
+        pMappedData(nullptr),
+        pool(0),
+        page(0),
+        block(TlsfAllocator::InvalidBlock)
+    {
+    }
+
+    VulkanMemoryAllocator::VulkanMemoryAllocator() :
+        m_logicalDevice(0),
+        m_memoryProperties{},
+        m_pageSize(0),
+        m_pMemory(nullptr),
+        m_statistics{}
+    {
+    }
+
+    VulkanMemoryAllocator::~VulkanMemoryAllocator()
+    {
+        unload();
+    }
+
+    void VulkanMemoryAllocator::load(VkPhysicalDevice physicalDevice, VkDevice logicalDevice, const VkDeviceSize pageSize, RenderMemoryAllocator & memory)
+    {
+        unload();
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        m_logicalDevice = logicalDevice;
+        m_pageSize = pageSize;
+        m_pMemory = &memory;
+        m_statistics = Statistics{};
+        vkGetPhysicalDeviceMemoryProperties(physicalDevice, &m_memoryProperties);
+        m_pools.resize(m_memoryProperties.memoryTypeCount * g_resourceTypeCount);
+    }
+
+    void VulkanMemoryAllocator::unload()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if (!m_logicalDevice)
+        {
+            return;
+        }
+
+        // Pages and dedicated allocations are released even if allocations leaked, the device is about to be destroyed.
+        for (const auto & dedicated : m_dedicated)
+        {
+            freeMemory(dedicated.second, dedicated.first);
+        }
+        m_dedicated.clear();
+
+        for (uint32_t i = 0; i < m_pools.size(); i++)
+        {
+            Pool & pool = m_pools[i];
+            for (uint32_t j = 0; j < pool.pages.size(); j++)
+            {
+                if (pool.pages[j])
+                {
+                    freePage(pool, j);
+                }
+            }
+        }
+
+        m_pools.clear();
+        m_logicalDevice = 0;
+        m_pMemory = nullptr;
+    }
+
+    VulkanMemoryAllocator::Allocation VulkanMemoryAllocator::allocate(const VkMemoryRequirements & requirements,
+                                                                      const VkMemoryPropertyFlags properties,
+                                                                      const ResourceType resourceType)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        Allocation allocation;
+        const bool dedicated = requirements.size > m_pageSize / 2;
+
+        // Try every matching memory type, the next may live in a heap with room left.
+        for (uint32_t i = 0; i < m_memoryProperties.memoryTypeCount; i++)
+        {
+            if (!(requirements.memoryTypeBits & (1 << i)) ||
+                (m_memoryProperties.memoryTypes[i].propertyFlags & properties) != properties)
+            {
+                continue;
+            }
+
+            if (dedicated)
+            {
+                if (allocateDedicated(i, requirements, allocation))
+                {
+                    return allocation;
+                }
+            }
+            else
+            {
+                const uint32_t poolIndex = i * g_resourceTypeCount + static_cast<uint32_t>(resourceType);
+                if (allocateFromPool(poolIndex, requirements, allocation))
+                {
+                    return allocation;
+                }
+            }
+        }
+
+        throw std::runtime_error("Failed to allocate device memory.");
+    }
+
+    VulkanMemoryAllocator::Allocation VulkanMemoryAllocator::allocate(VkBuffer buffer, const VkMemoryPropertyFlags properties)
+    {
+        VkMemoryRequirements requirements;
+        vkGetBufferMemoryRequirements(m_logicalDevice, buffer, &requirements);
+
+        Allocation allocation = allocate(requirements, properties, ResourceType::Linear);
+        if (vkBindBufferMemory(m_logicalDevice, buffer, allocation.memory, allocation.offset) != VK_SUCCESS)
+        {
+            free(allocation);
+            throw std::runtime_error("Failed to bind buffer memory.");
+        }
+
+        return allocation;
+    }
+
+    VulkanMemoryAllocator::Allocation VulkanMemoryAllocator::allocate(VkImage image, const VkMemoryPropertyFlags properties)
+    {
+        VkMemoryRequirements requirements;
+        vkGetImageMemoryRequirements(m_logicalDevice, image, &requirements);
+
+        Allocation allocation = allocate(requirements, properties, ResourceType::Optimal);
+        if (vkBindImageMemory(m_logicalDevice, image, allocation.memory, allocation.offset) != VK_SUCCESS)
+        {
+            free(allocation);
+            throw std::runtime_error("Failed to bind image memory.");
+        }
+
+        return allocation;
+    }
+
+    void VulkanMemoryAllocator::free(Allocation & allocation)
+    {
+        if (!allocation.memory)
+        {
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if (allocation.block == TlsfAllocator::InvalidBlock)
+        {
+            freeMemory(allocation.size, allocation.memory);
+            m_dedicated.erase(allocation.memory);
+            --m_statistics.dedicatedAllocationCount;
+        }
+        else
+        {
+            Pool & pool = m_pools[allocation.pool];
+            Page & page = *pool.pages[allocation.page];
+
+            page.allocator.free(allocation.block);
+
+            // Keep a single empty page per pool around, to avoid thrashing on allocate/free pairs.
+            if (page.allocator.isEmpty())
+            {
+                for (uint32_t i = 0; i < pool.pages.size(); i++)
+                {
+                    if (i != allocation.page && pool.pages[i] && pool.pages[i]->allocator.isEmpty())
+                    {
+                        freePage(pool, allocation.page);
+                        break;
+                    }
+                }
+            }
+        }
+
+        m_statistics.usedSize -= allocation.size;
+        --m_statistics.allocationCount;
+        allocation = Allocation();
+    }
+
+    VulkanMemoryAllocator::Statistics VulkanMemoryAllocator::getStatistics() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_statistics;
+    }
+
+    bool VulkanMemoryAllocator::allocateFromPool(const uint32_t poolIndex, const VkMemoryRequirements & requirements, Allocation & allocation)
+    {
+        Pool & pool = m_pools[poolIndex];
+
+        uint64_t offset = 0;
+        uint32_t block = TlsfAllocator::InvalidBlock;
+        uint32_t pageIndex = 0;
+
+        for (; pageIndex < pool.pages.size(); pageIndex++)
+        {
+            Page * pPage = pool.pages[pageIndex].get();
+            if (pPage && pPage->allocator.allocate(requirements.size, requirements.alignment, offset, block))
+            {
+                break;
+            }
+        }
+
+        // Create a new page.
+        if (pageIndex == pool.pages.size())
+        {
+            std::unique_ptr<Page> page(new Page);
+            if (!allocateMemory(poolIndex / g_resourceTypeCount, m_pageSize, page->memory, page->pMappedData))
+            {
+                return false;
+            }
+            page->allocator.reset(m_pageSize);
+            if (!page->allocator.allocate(requirements.size, requirements.alignment, offset, block))
+            {
+                freeMemory(m_pageSize, page->memory);
+                throw std::runtime_error("Failed to sub-allocate device memory from a new page.");
+            }
+
+            if (pool.freePages.size())
+            {
+                pageIndex = pool.freePages.back();
+                pool.freePages.pop_back();
+            }
+            pool.pages.resize(std::max<size_t>(pool.pages.size(), pageIndex + 1));
+            pool.pages[pageIndex] = std::move(page);
+            ++m_statistics.pageCount;
+        }
+
+        Page & page = *pool.pages[pageIndex];
+        allocation.memory = page.memory;
+        allocation.offset = offset;
+        allocation.size = requirements.size;
+        allocation.pMappedData = page.pMappedData ? page.pMappedData + offset : nullptr;
+        allocation.pool = poolIndex;
+        allocation.page = pageIndex;
+        allocation.block = block;
+
+        m_statistics.usedSize += requirements.size;
+        ++m_statistics.allocationCount;
+        return true;
+    }
+
+    bool VulkanMemoryAllocator::allocateDedicated(const uint32_t memoryType, const VkMemoryRequirements & requirements, Allocation & allocation)
+    {
+        if (!allocateMemory(memoryType, requirements.size, allocation.memory, allocation.pMappedData))
+        {
+            return false;
+        }
+
+        allocation.offset = 0;
+        allocation.size = requirements.size;
+        allocation.pool = memoryType * g_resourceTypeCount;
+        allocation.page = 0;
+        allocation.block = TlsfAllocator::InvalidBlock;
+        m_dedicated[allocation.memory] = requirements.size;
+
+        m_statistics.usedSize += requirements.size;
+        ++m_statistics.allocationCount;
+        ++m_statistics.dedicatedAllocationCount;
+        return true;
+    }
+
+    bool VulkanMemoryAllocator::allocateMemory(const uint32_t memoryType, const VkDeviceSize size, VkDeviceMemory & memory, uint8_t * & pMappedData)
+    {
+        VkMemoryAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = size;
+        allocInfo.memoryTypeIndex = memoryType;
+
+        if (vkAllocateMemory(m_logicalDevice, &allocInfo, nullptr, &memory) != VK_SUCCESS)
+        {
+            return false;
+        }
+
+        pMappedData = nullptr;
+        if (m_memoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+        {
+            void * pData = nullptr;
+            if (vkMapMemory(m_logicalDevice, memory, 0, VK_WHOLE_SIZE, 0, &pData) != VK_SUCCESS)
+            {
+                vkFreeMemory(m_logicalDevice, memory, nullptr);
+                memory = 0;
+                return false;
+            }
+            pMappedData = static_cast<uint8_t *>(pData);
+        }
+
+        m_statistics.reservedSize += size;
+        m_pMemory->updateReservedVramUsage(static_cast<int64_t>(size));
+        return true;
+    }
+
+    void VulkanMemoryAllocator::freeMemory(const VkDeviceSize size, VkDeviceMemory memory)
+    {
+        // Freeing mapped memory implicitly unmaps it.
+        vkFreeMemory(m_logicalDevice, memory, nullptr);
+
+        m_statistics.reservedSize -= size;
+        m_pMemory->updateReservedVramUsage(-static_cast<int64_t>(size));
+    }
+
+    void VulkanMemoryAllocator::freePage(Pool & pool, const uint32_t pageIndex)
+    {
+        freeMemory(m_pageSize, pool.pages[pageIndex]->memory);
+        pool.pages[pageIndex].reset();
+        pool.freePages.push_back(pageIndex);
+        --m_statistics.pageCount;
+    }
+
+}
+
+#endif
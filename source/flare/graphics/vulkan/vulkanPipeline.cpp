@@ -0,0 +1,484 @@
+/*
+* MIT License
+*
+* Copyright(c) 2018 Jimmie Bergmann
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*/
+
+#include "flare/graphics/vulkan/vulkanPipeline.hpp"
+
+#if defined(FLARE_VULKAN)
+
+#include "flare/graphics/vulkan/vulkanRenderer.hpp"
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+namespace Flare
+{
+
+    // Replaced pipeline, destroyed once the frames drawing with it have finished.
+    class VulkanRetiredPipeline : public RenderObject
+    {
+
+    public:
+
+        VulkanRetiredPipeline(VkDevice logicalDevice, VkPipeline pipeline) :
+            m_logicalDevice(logicalDevice),
+            m_pipeline(pipeline)
+        { }
+
+        ~VulkanRetiredPipeline()
+        {
+            vkDestroyPipeline(m_logicalDevice, m_pipeline, nullptr);
+        }
+
+    private:
+
+        VkDevice    m_logicalDevice;
+        VkPipeline  m_pipeline;
+
+    };
+
+    VulkanPipelineBuilder::VulkanPipelineBuilder() :
+        m_running(false)
+    {
+    }
+
+    VulkanPipelineBuilder::~VulkanPipelineBuilder()
+    {
+        stop();
+    }
+
+    void VulkanPipelineBuilder::start()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_running)
+        {
+            throw std::runtime_error("Cannot start already running pipeline builder.");
+        }
+
+        m_running = true;
+        m_thread = std::thread(&VulkanPipelineBuilder::run, this);
+    }
+
+    void VulkanPipelineBuilder::stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_running = false;
+        }
+        m_condition.notify_all();
+
+        if (m_thread.joinable())
+        {
+            m_thread.join();
+        }
+    }
+
+    bool VulkanPipelineBuilder::add(VulkanPipeline * pipeline)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!m_running)
+            {
+                return false;
+            }
+            m_queue.push_back(pipeline);
+        }
+        m_condition.notify_one();
+        return true;
+    }
+
+    void VulkanPipelineBuilder::run()
+    {
+        for (;;)
+        {
+            VulkanPipeline * pipeline = nullptr;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_condition.wait(lock, [this]() { return m_queue.size() || !m_running; });
+                if (m_queue.empty())
+                {
+                    return;
+                }
+                pipeline = m_queue.front();
+                m_queue.pop_front();
+            }
+
+            // Waiting pipelines can not be destroyed, the destructor waits for the build.
+            pipeline->build();
+        }
+    }
+
+    VulkanPipeline::~VulkanPipeline()
+    {
+        // The cleaner only deletes the pipeline once no frame uses it anymore.
+        wait();
+
+        VkDevice logicalDevice = m_vulkanRenderer.m_graphicDevice.logicalDevice;
+        if (m_pipeline)
+        {
+            vkDestroyPipeline(logicalDevice, m_pipeline, nullptr);
+        }
+        if (m_pendingPipeline)
+        {
+            vkDestroyPipeline(logicalDevice, m_pendingPipeline, nullptr);
+        }
+    }
+
+    void VulkanPipeline::load(const std::string & vertexShader, const std::string & fragmentShader)
+    {
+        // The current pipeline stays in use until the new one is ready.
+        // A finished build not yet swapped in is replaced by this one.
+        std::lock_guard<std::mutex> lock(m_mutex);
+        retire(m_pendingPipeline);
+        m_pendingPipeline = VK_NULL_HANDLE;
+
+        m_vertexShader = vertexShader;
+        m_fragmentShader = fragmentShader;
+        request();
+    }
+
+    void VulkanPipeline::unload()
+    {
+        // A running build sees the new revision and drops its result.
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            ++m_revision;
+            retire(m_pendingPipeline);
+            m_pendingPipeline = VK_NULL_HANDLE;
+            m_vertexShader.clear();
+            m_fragmentShader.clear();
+            m_status = Status::Unloaded;
+        }
+
+        retire(m_pipeline);
+        m_pipeline = VK_NULL_HANDLE;
+    }
+
+    void VulkanPipeline::wait()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_condition.wait(lock, [this]() { return !m_building; });
+    }
+
+    Pipeline::Status VulkanPipeline::getStatus() const
+    {
+        return m_status.load(std::memory_order_acquire);
+    }
+
+    std::string VulkanPipeline::getError() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_error;
+    }
+
+    VkPipeline VulkanPipeline::update()
+    {
+        // Only a build of the newest request is left pending, older results are dropped by the builder.
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_pendingPipeline)
+        {
+            retire(m_pipeline);
+            m_pipeline = m_pendingPipeline;
+            m_pendingPipeline = VK_NULL_HANDLE;
+        }
+        return m_pipeline;
+    }
+
+    VulkanPipeline::VulkanPipeline(VulkanRenderer & renderer) :
+        Pipeline(renderer),
+        m_vulkanRenderer(renderer),
+        m_renderPass(VK_NULL_HANDLE),
+        m_subpass(0),
+        m_pipeline(VK_NULL_HANDLE),
+        m_pendingPipeline(VK_NULL_HANDLE),
+        m_status(Status::Unloaded),
+        m_building(false),
+        m_revision(0)
+    {
+    }
+
+    void VulkanPipeline::rebuild()
+    {
+        // The main render pass changed, the current pipeline may no longer be compatible with it.
+        retire(m_pipeline);
+        m_pipeline = VK_NULL_HANDLE;
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        retire(m_pendingPipeline);
+        m_pendingPipeline = VK_NULL_HANDLE;
+
+        if (m_status != Status::Unloaded)
+        {
+            request();
+        }
+    }
+
+    void VulkanPipeline::request()
+    {
+        // Called with the mutex locked. The render pass is captured now, it may change before the build starts.
+        ++m_revision;
+        m_renderPass = m_vulkanRenderer.m_renderPass;
+        m_subpass = m_vulkanRenderer.m_subpass;
+        if (!m_renderPass)
+        {
+            m_error = "The main pass is not part of the render graph.";
+            m_status = Status::Failed;
+            return;
+        }
+
+        m_status = Status::Loading;
+        if (m_building)
+        {
+            return;
+        }
+        if (!m_vulkanRenderer.m_pipelineBuilder.add(this))
+        {
+            m_error = "The renderer is not loaded.";
+            m_status = Status::Failed;
+            return;
+        }
+        m_building = true;
+    }
+
+    void VulkanPipeline::build()
+    {
+        // Builds until the result matches the newest request, requests made meanwhile restart the build.
+        for (;;)
+        {
+            std::string vertexShader;
+            std::string fragmentShader;
+            VkRenderPass renderPass = VK_NULL_HANDLE;
+            uint32_t subpass = 0;
+            uint64_t revision = 0;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (m_status != Status::Loading)
+                {
+                    m_building = false;
+                    break;
+                }
+                vertexShader = m_vertexShader;
+                fragmentShader = m_fragmentShader;
+                renderPass = m_renderPass;
+                subpass = m_subpass;
+                revision = m_revision;
+            }
+
+            VkPipeline pipeline = VK_NULL_HANDLE;
+            std::string error;
+            try
+            {
+                pipeline = createPipeline(vertexShader, fragmentShader, renderPass, subpass);
+            }
+            catch (const std::exception & e)
+            {
+                error = e.what();
+            }
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (revision == m_revision)
+            {
+                m_pendingPipeline = pipeline;
+                m_error = error;
+                m_building = false;
+                m_status.store(pipeline ? Status::Ready : Status::Failed, std::memory_order_release);
+                break;
+            }
+
+            // Outdated, never drawn with.
+            if (pipeline)
+            {
+                vkDestroyPipeline(m_vulkanRenderer.m_graphicDevice.logicalDevice, pipeline, nullptr);
+            }
+        }
+        m_condition.notify_all();
+    }
+
+    VkPipeline VulkanPipeline::createPipeline(const std::string & vertexShader, const std::string & fragmentShader,
+                                              const VkRenderPass renderPass, const uint32_t subpass)
+    {
+        VkDevice logicalDevice = m_vulkanRenderer.m_graphicDevice.logicalDevice;
+
+        VkShaderModule vertShaderModule = createShaderModule(vertexShader);
+        VkShaderModule fragShaderModule = VK_NULL_HANDLE;
+        try
+        {
+            fragShaderModule = createShaderModule(fragmentShader);
+        }
+        catch (...)
+        {
+            vkDestroyShaderModule(logicalDevice, vertShaderModule, nullptr);
+            throw;
+        }
+
+        VkPipelineShaderStageCreateInfo vertShaderStageInfo = {};
+        vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
+        vertShaderStageInfo.module = vertShaderModule;
+        vertShaderStageInfo.pName = "main";
+
+        VkPipelineShaderStageCreateInfo fragShaderStageInfo = {};
+        fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+        fragShaderStageInfo.module = fragShaderModule;
+        fragShaderStageInfo.pName = "main";
+
+        VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
+
+        VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
+        vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+        vertexInputInfo.vertexBindingDescriptionCount = 0;
+        vertexInputInfo.pVertexBindingDescriptions = nullptr;
+        vertexInputInfo.vertexAttributeDescriptionCount = 0;
+        vertexInputInfo.pVertexAttributeDescriptions = nullptr;
+
+        VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
+        inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+        inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+        inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+        // Viewport and scissor are set while recording, the pipeline does not depend on the swap chain extent.
+        VkPipelineViewportStateCreateInfo viewportState = {};
+        viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+        viewportState.viewportCount = 1;
+        viewportState.pViewports = nullptr;
+        viewportState.scissorCount = 1;
+        viewportState.pScissors = nullptr;
+
+        const VkDynamicState dynamicStates[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+        VkPipelineDynamicStateCreateInfo dynamicState = {};
+        dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+        dynamicState.dynamicStateCount = 2;
+        dynamicState.pDynamicStates = dynamicStates;
+
+        VkPipelineRasterizationStateCreateInfo rasterizer = {};
+        rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+        rasterizer.depthClampEnable = VK_FALSE;
+        rasterizer.rasterizerDiscardEnable = VK_FALSE;
+        rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+        rasterizer.lineWidth = 1.0f;
+        rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
+        rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
+        rasterizer.depthBiasEnable = VK_FALSE;
+        rasterizer.depthBiasConstantFactor = 0.0f;
+        rasterizer.depthBiasClamp = 0.0f;
+        rasterizer.depthBiasSlopeFactor = 0.0f;
+
+        VkPipelineMultisampleStateCreateInfo multisampling = {};
+        multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+        multisampling.sampleShadingEnable = VK_FALSE;
+        multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+        VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
+        colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT
+            | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+        colorBlendAttachment.blendEnable = VK_FALSE;
+        colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+        colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO;
+        colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+        colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+        colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+        colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+
+        VkPipelineColorBlendStateCreateInfo colorBlend = {};
+        colorBlend.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+        colorBlend.logicOpEnable = VK_FALSE;
+        colorBlend.logicOp = VK_LOGIC_OP_COPY;
+        colorBlend.attachmentCount = 1;
+        colorBlend.pAttachments = &colorBlendAttachment;
+        colorBlend.blendConstants[0] = 0.0f;
+        colorBlend.blendConstants[1] = 0.0f;
+        colorBlend.blendConstants[2] = 0.0f;
+        colorBlend.blendConstants[3] = 0.0f;
+
+        VkGraphicsPipelineCreateInfo pipelineInfo = {};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+        pipelineInfo.stageCount = 2;
+        pipelineInfo.pStages = shaderStages;
+        pipelineInfo.pVertexInputState = &vertexInputInfo;
+        pipelineInfo.pInputAssemblyState = &inputAssembly;
+        pipelineInfo.pViewportState = &viewportState;
+        pipelineInfo.pRasterizationState = &rasterizer;
+        pipelineInfo.pMultisampleState = &multisampling;
+        pipelineInfo.pDepthStencilState = nullptr;
+        pipelineInfo.pColorBlendState = &colorBlend;
+        pipelineInfo.pDynamicState = &dynamicState;
+        pipelineInfo.layout = m_vulkanRenderer.m_pipelineLayout;
+        pipelineInfo.renderPass = renderPass;
+        pipelineInfo.subpass = subpass;
+        pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+        pipelineInfo.basePipelineIndex = -1;
+
+        // The pipeline cache is internally synchronized, builds on several workers may share it.
+        VkPipeline pipeline = VK_NULL_HANDLE;
+        const VkResult result = vkCreateGraphicsPipelines(logicalDevice, m_vulkanRenderer.m_pipelineCache, 1, &pipelineInfo, nullptr, &pipeline);
+
+        vkDestroyShaderModule(logicalDevice, fragShaderModule, nullptr);
+        vkDestroyShaderModule(logicalDevice, vertShaderModule, nullptr);
+
+        if (result != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to create graphics pipeline.");
+        }
+        return pipeline;
+    }
+
+    VkShaderModule VulkanPipeline::createShaderModule(const std::string & filename)
+    {
+        std::ifstream file(filename, std::ios::ate | std::ios::binary);
+        if (!file.is_open())
+        {
+            throw std::runtime_error("Failed to open shader: " + filename);
+        }
+
+        // SPIR-V words, read straight into 32 bit storage.
+        const size_t fileSize = static_cast<size_t>(file.tellg());
+        std::vector<uint32_t> code((fileSize + 3) / 4);
+        file.seekg(0);
+        file.read(reinterpret_cast<char *>(code.data()), fileSize);
+
+        VkShaderModuleCreateInfo createInfo = {};
+        createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+        createInfo.codeSize = fileSize;
+        createInfo.pCode = code.data();
+
+        VkShaderModule shaderModule = VK_NULL_HANDLE;
+        if (vkCreateShaderModule(m_vulkanRenderer.m_graphicDevice.logicalDevice, &createInfo, nullptr, &shaderModule) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to create shader module: " + filename);
+        }
+        return shaderModule;
+    }
+
+    void VulkanPipeline::retire(const VkPipeline pipeline)
+    {
+        if (pipeline)
+        {
+            m_vulkanRenderer.m_cleaner.add(new VulkanRetiredPipeline(m_vulkanRenderer.m_graphicDevice.logicalDevice, pipeline));
+        }
+    }
+
+}
+
+#endif
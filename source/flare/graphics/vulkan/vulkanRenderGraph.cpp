@@ -0,0 +1,796 @@
+/*
+* MIT License
+*
+* Copyright(c) 2018 Jimmie Bergmann
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*/
+
+#include "flare/graphics/vulkan/vulkanRenderGraph.hpp"
+
+#if defined(FLARE_VULKAN)
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace Flare
+{
+
+    static const VkPipelineStageFlags g_attachmentStages =
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+        VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+
+    static VkPipelineStageFlags getStages(const RenderGraphAccess access)
+    {
+        switch (access)
+        {
+            case RenderGraphAccess::ColorAttachment: return VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+            case RenderGraphAccess::DepthAttachment: return VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+            case RenderGraphAccess::InputAttachment: return VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+            case RenderGraphAccess::Sampled: return VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+        }
+        return VK_PIPELINE_STAGE_ALL_GRAPHICS_BIT;
+    }
+
+    static VkAccessFlags getAccess(const RenderGraphAccess access, const bool read, const bool write)
+    {
+        // Depth tests read the depth attachment, also when the pass only writes it.
+        switch (access)
+        {
+            case RenderGraphAccess::ColorAttachment:
+                return (read ? VK_ACCESS_COLOR_ATTACHMENT_READ_BIT : 0) | (write ? VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT : 0);
+            case RenderGraphAccess::DepthAttachment:
+                return VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | (write ? VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT : 0);
+            case RenderGraphAccess::InputAttachment: return VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
+            case RenderGraphAccess::Sampled: return VK_ACCESS_SHADER_READ_BIT;
+        }
+        return VK_ACCESS_MEMORY_READ_BIT;
+    }
+
+    static VkFormat getFormat(const RenderGraphFormat format, const VkFormat backbufferFormat)
+    {
+        switch (format)
+        {
+            case RenderGraphFormat::Backbuffer: return backbufferFormat;
+            case RenderGraphFormat::Rgba8: return VK_FORMAT_R8G8B8A8_UNORM;
+            case RenderGraphFormat::Rgba16f: return VK_FORMAT_R16G16B16A16_SFLOAT;
+            case RenderGraphFormat::Depth32f: return VK_FORMAT_D32_SFLOAT;
+            case RenderGraphFormat::Depth24Stencil8: return VK_FORMAT_D24_UNORM_S8_UINT;
+        }
+        return VK_FORMAT_UNDEFINED;
+    }
+
+
+    // Vulkan render graph context.
+    Vector2ui32 VulkanRenderGraphContext::getExtent() const
+    {
+        return Vector2ui32(m_extent.width, m_extent.height);
+    }
+
+    VkCommandBuffer VulkanRenderGraphContext::getCommandBuffer() const
+    {
+        return m_commandBuffer;
+    }
+
+    VkRenderPass VulkanRenderGraphContext::getRenderPass() const
+    {
+        return m_renderPass;
+    }
+
+    uint32_t VulkanRenderGraphContext::getSubpass() const
+    {
+        return m_subpass;
+    }
+
+    VkFramebuffer VulkanRenderGraphContext::getFramebuffer() const
+    {
+        return m_framebuffer;
+    }
+
+    uint32_t VulkanRenderGraphContext::getImageIndex() const
+    {
+        return m_imageIndex;
+    }
+
+    VkImageView VulkanRenderGraphContext::getImageView(const RenderGraphResource resource) const
+    {
+        if (resource == m_graph.m_pGraph->getBackbuffer())
+        {
+            return m_graph.m_backbufferViews[m_imageIndex];
+        }
+        return m_graph.m_images[resource].imageView;
+    }
+
+    void VulkanRenderGraphContext::setSecondaryCommandBuffers(const std::vector<VkCommandBuffer> & commandBuffers)
+    {
+        if (!m_pSecondaryCommandBuffers)
+        {
+            throw std::runtime_error("Secondary command buffers can only be set while preparing a subpass.");
+        }
+        *m_pSecondaryCommandBuffers = commandBuffers;
+    }
+
+    VulkanRenderGraphContext::VulkanRenderGraphContext(const VulkanRenderGraph & graph, VkCommandBuffer commandBuffer, const uint32_t imageIndex) :
+        m_graph(graph),
+        m_commandBuffer(commandBuffer),
+        m_renderPass(0),
+        m_subpass(0),
+        m_framebuffer(0),
+        m_extent{ 0, 0 },
+        m_imageIndex(imageIndex),
+        m_pSecondaryCommandBuffers(nullptr)
+    { }
+
+
+    // Vulkan render graph.
+    VulkanRenderGraph::VulkanRenderGraph() :
+        m_logicalDevice(0),
+        m_pMemoryAllocator(nullptr),
+        m_pGraph(nullptr),
+        m_backbufferFormat(VK_FORMAT_UNDEFINED),
+        m_extent{ 0, 0 },
+        m_backbufferLayout(VK_IMAGE_LAYOUT_PRESENT_SRC_KHR),
+        m_memorySize(0)
+    {
+    }
+
+    VulkanRenderGraph::~VulkanRenderGraph()
+    {
+        unload();
+    }
+
+    void VulkanRenderGraph::load(VkDevice logicalDevice, VulkanMemoryAllocator & memoryAllocator, const RenderGraph & graph,
+                                 const VkFormat backbufferFormat, const VkExtent2D extent,
+                                 const std::vector<VkImage> & backbufferImages, const std::vector<VkImageView> & backbufferViews,
+                                 const VkImageLayout backbufferLayout)
+    {
+        unload();
+
+        m_logicalDevice = logicalDevice;
+        m_pMemoryAllocator = &memoryAllocator;
+        m_pGraph = &graph;
+        m_backbufferFormat = backbufferFormat;
+        m_extent = extent;
+        m_backbufferImages = backbufferImages;
+        m_backbufferViews = backbufferViews;
+        m_backbufferLayout = backbufferLayout;
+
+        m_subpasses.assign(graph.getPasses().size(), RenderGraph::InvalidIndex);
+        for (auto & batch : graph.getBatches())
+        {
+            for (uint32_t i = 0; i < batch.passes.size(); i++)
+            {
+                m_subpasses[batch.passes[i]] = i;
+            }
+        }
+
+        loadCreateImages();
+        loadAliasMemory();
+
+        m_renderPasses.resize(graph.getBatches().size());
+        for (uint32_t i = 0; i < m_renderPasses.size(); i++)
+        {
+            loadCreateRenderPass(i);
+        }
+    }
+
+    void VulkanRenderGraph::unload()
+    {
+        for (auto & renderPass : m_renderPasses)
+        {
+            for (auto framebuffer : renderPass.framebuffers)
+            {
+                vkDestroyFramebuffer(m_logicalDevice, framebuffer, nullptr);
+            }
+            if (renderPass.renderPass)
+            {
+                vkDestroyRenderPass(m_logicalDevice, renderPass.renderPass, nullptr);
+            }
+        }
+        m_renderPasses.clear();
+
+        for (auto & image : m_images)
+        {
+            if (image.imageView)
+            {
+                vkDestroyImageView(m_logicalDevice, image.imageView, nullptr);
+            }
+            if (image.image)
+            {
+                vkDestroyImage(m_logicalDevice, image.image, nullptr);
+            }
+        }
+        m_images.clear();
+
+        if (m_pMemoryAllocator)
+        {
+            m_pMemoryAllocator->free(m_memory);
+        }
+        m_memorySize = 0;
+
+        m_subpasses.clear();
+        m_backbufferImages.clear();
+        m_backbufferViews.clear();
+        m_pGraph = nullptr;
+    }
+
+    void VulkanRenderGraph::record(VkCommandBuffer commandBuffer, const uint32_t imageIndex, VulkanGpuProfiler & profiler)
+    {
+        const std::vector<RenderGraph::Pass> & passes = m_pGraph->getPasses();
+        const std::vector<RenderGraph::Batch> & batches = m_pGraph->getBatches();
+
+        VulkanRenderGraphContext context(*this, commandBuffer, imageIndex);
+        std::vector<std::vector<VkCommandBuffer> > secondaryCommandBuffers;
+
+        for (uint32_t i = 0; i < batches.size(); i++)
+        {
+            const RenderGraph::Batch & batch = batches[i];
+            RenderPass & renderPass = m_renderPasses[i];
+
+            context.m_renderPass = renderPass.renderPass;
+            context.m_framebuffer = renderPass.framebuffers[renderPass.framebuffers.size() > 1 ? imageIndex : 0];
+            context.m_extent = renderPass.extent;
+
+            // Passes may record secondary command buffers before the render pass begins.
+            secondaryCommandBuffers.assign(batch.passes.size(), std::vector<VkCommandBuffer>());
+            for (uint32_t j = 0; j < batch.passes.size(); j++)
+            {
+                context.m_subpass = j;
+                context.m_pSecondaryCommandBuffers = &secondaryCommandBuffers[j];
+                passes[batch.passes[j]].subpass->prepare(context);
+            }
+            context.m_pSecondaryCommandBuffers = nullptr;
+
+            profiler.beginScope(commandBuffer, renderPass.name);
+
+            if (renderPass.barriers.size())
+            {
+                std::vector<VkImageMemoryBarrier> imageBarriers(renderPass.barriers.size());
+                VkPipelineStageFlags srcStages = 0;
+                VkPipelineStageFlags dstStages = 0;
+
+                for (size_t j = 0; j < renderPass.barriers.size(); j++)
+                {
+                    const ImageBarrier & barrier = renderPass.barriers[j];
+                    const bool backbuffer = barrier.resource == m_pGraph->getBackbuffer();
+
+                    VkImageMemoryBarrier & imageBarrier = imageBarriers[j];
+                    imageBarrier = {};
+                    imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+                    imageBarrier.oldLayout = barrier.oldLayout;
+                    imageBarrier.newLayout = barrier.newLayout;
+                    imageBarrier.srcAccessMask = barrier.srcAccess;
+                    imageBarrier.dstAccessMask = barrier.dstAccess;
+                    imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                    imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                    imageBarrier.image = backbuffer ? m_backbufferImages[imageIndex] : m_images[barrier.resource].image;
+                    imageBarrier.subresourceRange.aspectMask = backbuffer ? static_cast<VkImageAspectFlags>(VK_IMAGE_ASPECT_COLOR_BIT) : m_images[barrier.resource].aspect;
+                    imageBarrier.subresourceRange.baseMipLevel = 0;
+                    imageBarrier.subresourceRange.levelCount = 1;
+                    imageBarrier.subresourceRange.baseArrayLayer = 0;
+                    imageBarrier.subresourceRange.layerCount = 1;
+
+                    srcStages |= barrier.srcStage;
+                    dstStages |= barrier.dstStage;
+                }
+
+                vkCmdPipelineBarrier(commandBuffer, srcStages, dstStages, 0, 0, nullptr, 0, nullptr,
+                                     static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+            }
+
+            VkRenderPassBeginInfo renderPassInfo = {};
+            renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+            renderPassInfo.renderPass = renderPass.renderPass;
+            renderPassInfo.framebuffer = context.m_framebuffer;
+            renderPassInfo.renderArea.offset = { 0, 0 };
+            renderPassInfo.renderArea.extent = renderPass.extent;
+            renderPassInfo.clearValueCount = static_cast<uint32_t>(renderPass.clearValues.size());
+            renderPassInfo.pClearValues = renderPass.clearValues.data();
+
+            for (uint32_t j = 0; j < batch.passes.size(); j++)
+            {
+                const std::vector<VkCommandBuffer> & commandBuffers = secondaryCommandBuffers[j];
+                const VkSubpassContents contents = commandBuffers.size() ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE;
+
+                if (j == 0)
+                {
+                    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, contents);
+                }
+                else
+                {
+                    vkCmdNextSubpass(commandBuffer, contents);
+                }
+
+                if (commandBuffers.size())
+                {
+                    vkCmdExecuteCommands(commandBuffer, static_cast<uint32_t>(commandBuffers.size()), commandBuffers.data());
+                }
+                else
+                {
+                    context.m_subpass = j;
+                    passes[batch.passes[j]].subpass->execute(context);
+                }
+            }
+            vkCmdEndRenderPass(commandBuffer);
+
+            profiler.endScope(commandBuffer);
+        }
+    }
+
+    VkRenderPass VulkanRenderGraph::getRenderPass(const uint32_t pass) const
+    {
+        const uint32_t batch = m_pGraph->getPasses()[pass].batch;
+        return batch == RenderGraph::InvalidIndex ? VK_NULL_HANDLE : m_renderPasses[batch].renderPass;
+    }
+
+    uint32_t VulkanRenderGraph::getSubpass(const uint32_t pass) const
+    {
+        return m_subpasses[pass];
+    }
+
+    VkDeviceSize VulkanRenderGraph::getTransientMemorySize() const
+    {
+        return m_memorySize;
+    }
+
+    VkExtent2D VulkanRenderGraph::getExtent(const RenderGraphResource resource) const
+    {
+        const Vector2ui32 size = m_pGraph->getResources()[resource].desc.size;
+        if (size.x == 0 || size.y == 0)
+        {
+            return m_extent;
+        }
+        return { size.x, size.y };
+    }
+
+    void VulkanRenderGraph::loadCreateImages()
+    {
+        const std::vector<RenderGraph::Resource> & resources = m_pGraph->getResources();
+        m_images.assign(resources.size(), Image{ 0, 0, VK_FORMAT_UNDEFINED, 0, {}, 0 });
+
+        // Usage is the union of all accesses.
+        std::vector<VkImageUsageFlags> usages(resources.size(), 0);
+        for (auto & pass : m_pGraph->getPasses())
+        {
+            for (auto & access : pass.accesses)
+            {
+                switch (access.access)
+                {
+                    case RenderGraphAccess::ColorAttachment: usages[access.resource] |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT; break;
+                    case RenderGraphAccess::DepthAttachment: usages[access.resource] |= VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT; break;
+                    case RenderGraphAccess::InputAttachment: usages[access.resource] |= VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT; break;
+                    case RenderGraphAccess::Sampled: usages[access.resource] |= VK_IMAGE_USAGE_SAMPLED_BIT; break;
+                }
+            }
+        }
+
+        for (uint32_t i = 0; i < resources.size(); i++)
+        {
+            const RenderGraph::Resource & resource = resources[i];
+            Image & image = m_images[i];
+            image.format = getFormat(resource.desc.format, m_backbufferFormat);
+            image.aspect = isDepth(i) ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+            if (image.format == VK_FORMAT_D24_UNORM_S8_UINT)
+            {
+                image.aspect |= VK_IMAGE_ASPECT_STENCIL_BIT;
+            }
+
+            // Culled resources are never created.
+            if (resource.imported || resource.firstBatch == RenderGraph::InvalidIndex)
+            {
+                continue;
+            }
+
+            const VkExtent2D extent = getExtent(i);
+
+            VkImageCreateInfo imageInfo = {};
+            imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+            imageInfo.imageType = VK_IMAGE_TYPE_2D;
+            imageInfo.extent = { extent.width, extent.height, 1 };
+            imageInfo.mipLevels = 1;
+            imageInfo.arrayLayers = 1;
+            imageInfo.format = image.format;
+            imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+            imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            imageInfo.usage = usages[i];
+            imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+            imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+            if (vkCreateImage(m_logicalDevice, &imageInfo, nullptr, &image.image) != VK_SUCCESS)
+            {
+                throw std::runtime_error("Failed to create render graph image \"" + resource.name + "\".");
+            }
+            vkGetImageMemoryRequirements(m_logicalDevice, image.image, &image.requirements);
+        }
+    }
+
+    void VulkanRenderGraph::loadAliasMemory()
+    {
+        std::vector<RenderGraphResource> order;
+        for (uint32_t i = 0; i < m_images.size(); i++)
+        {
+            if (m_images[i].image)
+            {
+                order.push_back(i);
+            }
+        }
+        if (!order.size())
+        {
+            return;
+        }
+
+        // Place the largest first, each at the lowest offset not overlapping any placed image alive at the same time.
+        std::sort(order.begin(), order.end(), [this](const RenderGraphResource a, const RenderGraphResource b)
+        {
+            return m_images[a].requirements.size > m_images[b].requirements.size;
+        });
+
+        VkMemoryRequirements requirements = { 0, 1, ~0U };
+        std::vector<RenderGraphResource> placed;
+        for (auto resource : order)
+        {
+            Image & image = m_images[resource];
+            const VkDeviceSize alignment = image.requirements.alignment;
+
+            std::vector<VkDeviceSize> candidates(1, 0);
+            for (auto other : placed)
+            {
+                if (!m_pGraph->canAlias(resource, other))
+                {
+                    const VkDeviceSize end = m_images[other].offset + m_images[other].requirements.size;
+                    candidates.push_back((end + alignment - 1) / alignment * alignment);
+                }
+            }
+            std::sort(candidates.begin(), candidates.end());
+
+            for (auto offset : candidates)
+            {
+                bool fits = true;
+                for (auto other : placed)
+                {
+                    const Image & otherImage = m_images[other];
+                    if (!m_pGraph->canAlias(resource, other) &&
+                        offset < otherImage.offset + otherImage.requirements.size &&
+                        otherImage.offset < offset + image.requirements.size)
+                    {
+                        fits = false;
+                        break;
+                    }
+                }
+                if (fits)
+                {
+                    image.offset = offset;
+                    break;
+                }
+            }
+
+            placed.push_back(resource);
+            requirements.size = std::max(requirements.size, image.offset + image.requirements.size);
+            requirements.alignment = std::max(requirements.alignment, alignment);
+            requirements.memoryTypeBits &= image.requirements.memoryTypeBits;
+        }
+
+        if (!requirements.memoryTypeBits)
+        {
+            throw std::runtime_error("Render graph images have no memory type in common.");
+        }
+
+        m_memory = m_pMemoryAllocator->allocate(requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VulkanMemoryAllocator::ResourceType::Optimal);
+        m_memorySize = requirements.size;
+
+        for (auto resource : order)
+        {
+            Image & image = m_images[resource];
+            if (vkBindImageMemory(m_logicalDevice, image.image, m_memory.memory, m_memory.offset + image.offset) != VK_SUCCESS)
+            {
+                throw std::runtime_error("Failed to bind render graph image memory.");
+            }
+
+            VkImageViewCreateInfo viewInfo = {};
+            viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+            viewInfo.image = image.image;
+            viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+            viewInfo.format = image.format;
+            viewInfo.subresourceRange.aspectMask = image.aspect;
+            viewInfo.subresourceRange.baseMipLevel = 0;
+            viewInfo.subresourceRange.levelCount = 1;
+            viewInfo.subresourceRange.baseArrayLayer = 0;
+            viewInfo.subresourceRange.layerCount = 1;
+
+            if (vkCreateImageView(m_logicalDevice, &viewInfo, nullptr, &image.imageView) != VK_SUCCESS)
+            {
+                throw std::runtime_error("Failed to create render graph image view.");
+            }
+        }
+    }
+
+    void VulkanRenderGraph::loadCreateRenderPass(const uint32_t batchIndex)
+    {
+        const std::vector<RenderGraph::Pass> & passes = m_pGraph->getPasses();
+        const std::vector<RenderGraph::Resource> & resources = m_pGraph->getResources();
+        const RenderGraph::Batch & batch = m_pGraph->getBatches()[batchIndex];
+        const RenderGraphResource backbuffer = m_pGraph->getBackbuffer();
+        RenderPass & renderPass = m_renderPasses[batchIndex];
+
+        renderPass.renderPass = 0;
+        renderPass.extent = m_extent;
+
+        // Collect attachments in order of first use, with their first and last access within the batch.
+        std::vector<RenderGraphResource> attachments;
+        std::vector<uint32_t> attachmentIndices(resources.size(), RenderGraph::InvalidIndex);
+        std::vector<const RenderGraph::Access *> firstAccesses;
+        std::vector<const RenderGraph::Access *> lastAccesses;
+        std::vector<uint32_t> firstSubpasses;
+        std::vector<uint32_t> lastSubpasses;
+
+        for (uint32_t i = 0; i < batch.passes.size(); i++)
+        {
+            const RenderGraph::Pass & pass = passes[batch.passes[i]];
+            if (i == 0)
+            {
+                renderPass.name = pass.name;
+            }
+            else
+            {
+                renderPass.name += " + " + pass.name;
+            }
+
+            for (auto & access : pass.accesses)
+            {
+                if (access.access == RenderGraphAccess::Sampled)
+                {
+                    continue;
+                }
+
+                if (attachmentIndices[access.resource] == RenderGraph::InvalidIndex)
+                {
+                    attachmentIndices[access.resource] = static_cast<uint32_t>(attachments.size());
+                    attachments.push_back(access.resource);
+                    firstAccesses.push_back(&access);
+                    firstSubpasses.push_back(i);
+                    lastAccesses.push_back(&access);
+                    lastSubpasses.push_back(i);
+                    renderPass.extent = getExtent(access.resource);
+                }
+                else
+                {
+                    lastAccesses[attachmentIndices[access.resource]] = &access;
+                    lastSubpasses[attachmentIndices[access.resource]] = i;
+                }
+            }
+
+            // Dependencies on earlier batches are resolved by one barrier in front of the render pass.
+            for (auto & barrier : pass.barriers)
+            {
+                if (!barrier.discard && passes[barrier.srcPass].batch == batchIndex)
+                {
+                    continue;
+                }
+
+                ImageBarrier imageBarrier;
+                imageBarrier.resource = barrier.resource;
+                imageBarrier.newLayout = getLayout(barrier.resource, barrier.dstAccess);
+                imageBarrier.dstStage = getStages(barrier.dstAccess);
+                imageBarrier.dstAccess = getAccess(barrier.dstAccess, barrier.dstRead, barrier.dstWrite);
+
+                if (!barrier.discard)
+                {
+                    imageBarrier.oldLayout = getLayout(barrier.resource, barrier.srcAccess);
+                    imageBarrier.srcStage = getStages(barrier.srcAccess);
+                    imageBarrier.srcAccess = barrier.srcWrite ? getAccess(barrier.srcAccess, false, true) : 0;
+                }
+                else if (barrier.resource == backbuffer)
+                {
+                    // Ordered after the image acquire semaphore wait.
+                    imageBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+                    imageBarrier.srcStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+                    imageBarrier.srcAccess = 0;
+                }
+                else
+                {
+                    // Transient memory is shared with aliased resources and the previous frame, wait for all their writes.
+                    imageBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+                    imageBarrier.srcStage = g_attachmentStages;
+                    imageBarrier.srcAccess = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+                }
+
+                renderPass.barriers.push_back(imageBarrier);
+            }
+        }
+
+        // Create attachment descriptions.
+        std::vector<VkAttachmentDescription> descriptions(attachments.size());
+        renderPass.clearValues.resize(attachments.size());
+        for (uint32_t i = 0; i < attachments.size(); i++)
+        {
+            const RenderGraphResource resource = attachments[i];
+            const RenderGraph::Access & first = *firstAccesses[i];
+            const RenderGraph::Access & last = *lastAccesses[i];
+
+            bool discard = false;
+            for (auto & barrier : passes[batch.passes[firstSubpasses[i]]].barriers)
+            {
+                discard = discard || (barrier.resource == resource && barrier.discard);
+            }
+
+            // Contents are only kept if used by a later batch, or presented. Like culling, writes not read replace them.
+            const bool store = resource == backbuffer || resources[resource].lastBatch > batchIndex;
+            const bool replace = discard || (!first.read && resource != backbuffer);
+            const VkAttachmentLoadOp loadOp = replace ? (first.write ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_DONT_CARE) : VK_ATTACHMENT_LOAD_OP_LOAD;
+            const VkAttachmentStoreOp storeOp = store ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+            const bool stencil = m_images[resource].format == VK_FORMAT_D24_UNORM_S8_UINT;
+
+            VkAttachmentDescription & description = descriptions[i];
+            description = {};
+            description.format = m_images[resource].format;
+            description.samples = VK_SAMPLE_COUNT_1_BIT;
+            description.loadOp = loadOp;
+            description.storeOp = storeOp;
+            description.stencilLoadOp = stencil ? loadOp : VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+            description.stencilStoreOp = stencil ? storeOp : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+            description.initialLayout = getLayout(resource, first.access);
+            description.finalLayout = resource == backbuffer && resources[resource].lastBatch == batchIndex ?
+                m_backbufferLayout : getLayout(resource, last.access);
+
+            if (isDepth(resource))
+            {
+                renderPass.clearValues[i].depthStencil = { 1.0f, 0 };
+            }
+            else
+            {
+                renderPass.clearValues[i].color = { 0.0f, 0.0f, 0.0f, 1.0f };
+            }
+        }
+
+        // Create subpasses, attachments alive across a subpass not using them are preserved.
+        std::vector<std::vector<VkAttachmentReference> > colorReferences(batch.passes.size());
+        std::vector<std::vector<VkAttachmentReference> > inputReferences(batch.passes.size());
+        std::vector<VkAttachmentReference> depthReferences(batch.passes.size());
+        std::vector<std::vector<uint32_t> > preserveAttachments(batch.passes.size());
+        std::vector<VkSubpassDescription> subpasses(batch.passes.size());
+        std::vector<VkSubpassDependency> dependencies;
+
+        for (uint32_t i = 0; i < batch.passes.size(); i++)
+        {
+            const RenderGraph::Pass & pass = passes[batch.passes[i]];
+            bool hasDepth = false;
+            std::vector<bool> used(attachments.size(), false);
+
+            for (auto & access : pass.accesses)
+            {
+                if (access.access == RenderGraphAccess::Sampled)
+                {
+                    continue;
+                }
+
+                const uint32_t attachment = attachmentIndices[access.resource];
+                const VkAttachmentReference reference = { attachment, getLayout(access.resource, access.access) };
+                used[attachment] = true;
+
+                switch (access.access)
+                {
+                    case RenderGraphAccess::ColorAttachment: colorReferences[i].push_back(reference); break;
+                    case RenderGraphAccess::DepthAttachment: depthReferences[i] = reference; hasDepth = true; break;
+                    case RenderGraphAccess::InputAttachment: inputReferences[i].push_back(reference); break;
+                    default: break;
+                }
+            }
+
+            for (uint32_t j = 0; j < attachments.size(); j++)
+            {
+                if (!used[j] && firstSubpasses[j] < i && i < lastSubpasses[j])
+                {
+                    preserveAttachments[i].push_back(j);
+                }
+            }
+
+            VkSubpassDescription & subpass = subpasses[i];
+            subpass = {};
+            subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+            subpass.colorAttachmentCount = static_cast<uint32_t>(colorReferences[i].size());
+            subpass.pColorAttachments = colorReferences[i].data();
+            subpass.inputAttachmentCount = static_cast<uint32_t>(inputReferences[i].size());
+            subpass.pInputAttachments = inputReferences[i].data();
+            subpass.pDepthStencilAttachment = hasDepth ? &depthReferences[i] : nullptr;
+            subpass.preserveAttachmentCount = static_cast<uint32_t>(preserveAttachments[i].size());
+            subpass.pPreserveAttachments = preserveAttachments[i].data();
+
+            // Dependencies within the batch only need to hold per pixel.
+            for (auto & barrier : pass.barriers)
+            {
+                if (barrier.discard || passes[barrier.srcPass].batch != batchIndex)
+                {
+                    continue;
+                }
+
+                VkSubpassDependency dependency = {};
+                dependency.srcSubpass = m_subpasses[barrier.srcPass];
+                dependency.dstSubpass = i;
+                dependency.srcStageMask = getStages(barrier.srcAccess);
+                dependency.dstStageMask = getStages(barrier.dstAccess);
+                dependency.srcAccessMask = barrier.srcWrite ? getAccess(barrier.srcAccess, false, true) : 0;
+                dependency.dstAccessMask = getAccess(barrier.dstAccess, barrier.dstRead, barrier.dstWrite);
+                dependency.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+                dependencies.push_back(dependency);
+            }
+        }
+
+        VkRenderPassCreateInfo renderPassInfo = {};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+        renderPassInfo.attachmentCount = static_cast<uint32_t>(descriptions.size());
+        renderPassInfo.pAttachments = descriptions.data();
+        renderPassInfo.subpassCount = static_cast<uint32_t>(subpasses.size());
+        renderPassInfo.pSubpasses = subpasses.data();
+        renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+        renderPassInfo.pDependencies = dependencies.data();
+
+        if (vkCreateRenderPass(m_logicalDevice, &renderPassInfo, nullptr, &renderPass.renderPass) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to create render pass \"" + renderPass.name + "\".");
+        }
+
+        // Create framebuffers, one per backbuffer image if the backbuffer is attached.
+        const bool usesBackbuffer = attachmentIndices[backbuffer] != RenderGraph::InvalidIndex;
+        renderPass.framebuffers.assign(usesBackbuffer ? m_backbufferViews.size() : 1, VkFramebuffer(0));
+
+        for (size_t i = 0; i < renderPass.framebuffers.size(); i++)
+        {
+            std::vector<VkImageView> views(attachments.size());
+            for (size_t j = 0; j < attachments.size(); j++)
+            {
+                views[j] = attachments[j] == backbuffer ? m_backbufferViews[i] : m_images[attachments[j]].imageView;
+            }
+
+            VkFramebufferCreateInfo framebufferInfo = {};
+            framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+            framebufferInfo.renderPass = renderPass.renderPass;
+            framebufferInfo.attachmentCount = static_cast<uint32_t>(views.size());
+            framebufferInfo.pAttachments = views.data();
+            framebufferInfo.width = renderPass.extent.width;
+            framebufferInfo.height = renderPass.extent.height;
+            framebufferInfo.layers = 1;
+
+            if (vkCreateFramebuffer(m_logicalDevice, &framebufferInfo, nullptr, &renderPass.framebuffers[i]) != VK_SUCCESS)
+            {
+                throw std::runtime_error("Failed to create framebuffer.");
+            }
+        }
+    }
+
+    VkImageLayout VulkanRenderGraph::getLayout(const RenderGraphResource resource, const RenderGraphAccess access) const
+    {
+        switch (access)
+        {
+            case RenderGraphAccess::ColorAttachment: return VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+            case RenderGraphAccess::DepthAttachment: return VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+            default: break;
+        }
+        return isDepth(resource) ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    }
+
+    bool VulkanRenderGraph::isDepth(const RenderGraphResource resource) const
+    {
+        const RenderGraphFormat format = m_pGraph->getResources()[resource].desc.format;
+        return format == RenderGraphFormat::Depth32f || format == RenderGraphFormat::Depth24Stencil8;
+    }
+
+}
+
+#endif
@@ -28,13 +28,33 @@
 #if defined(FLARE_VULKAN)
 
 #include "flare/graphics/vulkan/vulkanTexture.hpp"
+#include "flare/graphics/textureCompressor.hpp"
+#include "flare/graphics/pixelConverter.hpp"
 #include "flare/graphics/pipeline.hpp"
 #include <iostream>
 #include <map>
 #include <algorithm>
 #include <fstream>
-
-#define FLARE_MAX_FRAMES_IN_FLIGHT 2
+#include <cstdio>
+#include <cstring>
+
+#define FLARE_CLEANER_MAX_BATCH_SIZE 256
+#define FLARE_CLEANER_NODE_COUNT 4096
+#define FLARE_FRAME_UNIFORM_BUFFER_SIZE (1024 * 1024)
+#define FLARE_DRAW_COMMANDS_PER_RECORD_JOB 256
+#define FLARE_STAGING_BUFFER_SIZE (32 * 1024 * 1024)
+#define FLARE_DEVICE_MEMORY_PAGE_SIZE (64 * 1024 * 1024)
+#define FLARE_GPU_PROFILER_MAX_SCOPES 256
+#define FLARE_PIPELINE_CACHE_MAGIC 0x43504C46 // "FLPC"
+#define FLARE_PIPELINE_CACHE_VERSION 1
+#define FLARE_DESCRIPTOR_TABLE_MAX_TEXTURES 16384
+#define FLARE_DESCRIPTOR_TABLE_MAX_BUFFERS 4096
+#define FLARE_DRAW_PACKET_VERTEX_STRIDE 32
+#define FLARE_DRAW_PACKET_MAX_VERTICES (256 * 1024)
+#define FLARE_DRAW_PACKET_MAX_INDICES (1024 * 1024)
+#define FLARE_TEXTURE_STREAMING_BASE_SIZE 64
+#define FLARE_TEXTURE_STREAMING_UPLOAD_LIMIT (16 * 1024 * 1024)
+#define FLARE_TEXTURE_STREAMING_IDLE_FRAMES 120
 
 #define CHECK_LOADED \
     if(!m_loaded) { throw std::runtime_error("Renderer has not been loaded."); }\
@@ -52,13 +72,99 @@ static const std::vector<const char *> g_deviceExtensions =
     VK_KHR_SWAPCHAIN_EXTENSION_NAME
 };
 
+static const std::vector<const char *> g_headlessDeviceExtensions;
+
 static VkResult vulkanCreateDebugUtilsMessengerEXT(VkInstance instance, const VkDebugUtilsMessengerCreateInfoEXT* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkDebugUtilsMessengerEXT* pCallback);
 static VkResult vulkanDestroyDebugUtilsMessengerEXT(VkInstance instance, VkDebugUtilsMessengerEXT callback, const VkAllocationCallbacks* pAllocator);
-static std::vector<char> readFile(const std::string & filename);
+static uint64_t hashData(const uint8_t * data, const size_t size);
+
+// Header written in front of the driver's pipeline cache data.
+// The driver's own header lacks the driver version, and nothing guards against a truncated file.
+struct PipelineCacheFileHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vendorID;
+    uint32_t deviceID;
+    uint32_t driverVersion;
+    uint8_t  pipelineCacheUUID[VK_UUID_SIZE];
+    uint64_t dataSize;
+    uint64_t dataHash;
+};
 
 namespace Flare
 {
 
+    // Main subpass.
+    VulkanRenderer::MainSubpass::MainSubpass(VulkanRenderer & renderer) :
+        m_renderer(renderer)
+    { }
+
+    void VulkanRenderer::MainSubpass::load(Renderer &)
+    { }
+
+    void VulkanRenderer::MainSubpass::setup(RenderGraphBuilder & builder)
+    {
+        builder.setName("Main pass");
+        builder.write(builder.getBackbuffer(), RenderGraphAccess::ColorAttachment);
+    }
+
+    void VulkanRenderer::MainSubpass::prepare(RenderGraphContext & context)
+    {
+        // Small draw lists are cheaper to record inline than to split across workers.
+        if (m_renderer.m_drawCommands.size() <= FLARE_DRAW_COMMANDS_PER_RECORD_JOB)
+        {
+            return;
+        }
+
+        VulkanRenderGraphContext & vulkanContext = static_cast<VulkanRenderGraphContext &>(context);
+        std::vector<VkCommandBuffer> secondaryCommandBuffers;
+        m_renderer.recordSecondaryCommandBuffers(*m_renderer.m_frames[m_renderer.m_currentFrame], vulkanContext, secondaryCommandBuffers);
+        vulkanContext.setSecondaryCommandBuffers(secondaryCommandBuffers);
+    }
+
+    void VulkanRenderer::MainSubpass::execute(RenderGraphContext & context)
+    {
+        VulkanRenderGraphContext & vulkanContext = static_cast<VulkanRenderGraphContext &>(context);
+        m_renderer.recordDrawCommands(vulkanContext.getCommandBuffer(), vulkanContext.getExtent(), 0, m_renderer.m_drawCommands.size(),
+                                      m_renderer.m_drawStatistics);
+        m_renderer.recordDrawPackets(vulkanContext.getCommandBuffer(), m_renderer.m_drawStatistics);
+    }
+
+
+    // Retired swap chain.
+    VulkanRenderer::RetiredSwapChain::RetiredSwapChain(VkDevice logicalDevice, VulkanMemoryAllocator & memoryAllocator) :
+        logicalDevice(logicalDevice),
+        memoryAllocator(memoryAllocator),
+        swapChain(0)
+    {
+    }
+
+    VulkanRenderer::RetiredSwapChain::~RetiredSwapChain()
+    {
+        renderGraph.reset();
+
+        for (auto imageView : imageViews)
+        {
+            vkDestroyImageView(logicalDevice, imageView, nullptr);
+        }
+
+        if (swapChain)
+        {
+            vkDestroySwapchainKHR(logicalDevice, swapChain, nullptr);
+        }
+        for (auto image : offscreenImages)
+        {
+            vkDestroyImage(logicalDevice, image, nullptr);
+        }
+        for (auto & memory : offscreenMemory)
+        {
+            memoryAllocator.free(memory);
+        }
+    }
+
+
+    // Vulkan renderer.
     VulkanRenderer::VulkanRenderer() :
         m_instance(0),
         m_callback(0),
@@ -66,14 +172,28 @@ namespace Flare
         m_graphicDevice(),
         m_graphicQueue(0),
         m_presentQueue(0),
+        m_transferQueue(0),
         m_swapChain(0),
+        m_swapChainOutdated(false),
+        m_lastImageIndex(0),
+        m_hasRenderedImage(false),
+        m_readbackCommandPool(0),
+        m_readbackCommandBuffer(0),
+        m_readbackFence(0),
+        m_pipelineCache(0),
+        m_mainSubpass(*this),
+        m_multipassRevision(0),
         m_renderPass(0),
+        m_subpass(0),
         m_pipelineLayout(0),
-        m_graphicsPipeline(0),
-        m_commandPool(0),
+        m_packetPipeline(VK_NULL_HANDLE),
         m_currentFrame(0),
+        m_hasInputTime(false),
+        m_pJobSystem(nullptr),
+        m_textureFormats(),
         m_loaded(false)
     {
+        m_multipass.addSubpass(&m_mainSubpass);
     }
 
     VulkanRenderer::VulkanRenderer(const RendererSettings & settings) :
@@ -96,55 +216,113 @@ namespace Flare
         }
 
         m_settings = settings;
+        if (m_settings.getMaxFramesInFlight() == 0)
+        {
+            throw std::runtime_error("Renderer needs at least one frame in flight.");
+        }
+
+        m_pJobSystem = m_settings.getJobSystem();
+        if (!m_pJobSystem)
+        {
+            m_ownedJobSystem = std::make_unique<JobSystem>();
+            m_pJobSystem = m_ownedJobSystem.get();
+        }
+
+        m_framePacer.setTargetFrameRate(m_settings.getMaxFrameRate());
+        m_framePacer.reset();
+        m_latency = RenderLatency();
+        m_drawStatistics = DrawStatistics();
+        m_hasInputTime = false;
+        m_swapChainOutdated = false;
 
         loadCreateInstance();
         loadSetupDebugCallback();
         loadCreateSurface();
         loadPickPhysicalDevice();
         loadCreateLogicalDevice();
-        loadCreateSwapChain();
+        loadNegotiateTextureFormats();
+        m_memoryAllocator.load(m_graphicDevice.physicalDevice, m_graphicDevice.logicalDevice, FLARE_DEVICE_MEMORY_PAGE_SIZE, m_memory);
+        if (m_graphicDevice.hasDescriptorIndexing)
+        {
+            m_descriptorTable.load(m_graphicDevice.physicalDevice, m_graphicDevice.logicalDevice,
+                                   FLARE_DESCRIPTOR_TABLE_MAX_TEXTURES, FLARE_DESCRIPTOR_TABLE_MAX_BUFFERS);
+        }
+        loadCreatePipelineCache();
+        loadCreateSwapChain(VK_NULL_HANDLE);
         loadCreateImageViews();
-        loadCreateRenderPass();
+        loadCreateRenderGraph();
+        loadCreatePipelineLayout();
+        m_pipelineBuilder.start();
         loadCreateGraphicsPipeline();
-        loadCreateFramebuffers();
-        loadCreateCommandPool();
-        loadCreateCommandBuffers();
-        loadCreateSyncObjects();
+        loadCreateFrames();
+        if (m_settings.getGpuProfiling())
+        {
+            m_gpuProfiler.load(m_graphicDevice.physicalDevice, m_graphicDevice.logicalDevice, m_graphicDevice.graphicsFamily.value(),
+                               m_frames.size(), FLARE_GPU_PROFILER_MAX_SCOPES);
+        }
+        m_uploader.load(m_graphicDevice.physicalDevice, m_graphicDevice.logicalDevice, m_graphicDevice.transferFamily.value(),
+                        m_transferQueue, m_queueMutex, FLARE_STAGING_BUFFER_SIZE);
+        if (m_descriptorTable.isLoaded())
+        {
+            m_drawPackets.load(m_graphicDevice.logicalDevice, m_graphicDevice.enabledFeatures, m_memoryAllocator, m_uploader,
+                               m_descriptorTable, m_graphicDevice.graphicsFamily.value(), FLARE_DRAW_PACKET_VERTEX_STRIDE,
+                               FLARE_DRAW_PACKET_MAX_VERTICES, FLARE_DRAW_PACKET_MAX_INDICES);
+        }
+        m_textureStreamer.load(FLARE_TEXTURE_STREAMING_BASE_SIZE, FLARE_TEXTURE_STREAMING_UPLOAD_LIMIT, FLARE_TEXTURE_STREAMING_IDLE_FRAMES,
+                               m_frames.size());
 
-        m_cleaner.start(0.01f, 0.01f);
+        m_cleaner.start(FLARE_CLEANER_MAX_BATCH_SIZE, FLARE_CLEANER_NODE_COUNT);
         m_loaded = true;
     }
 
     void VulkanRenderer::unload()
     {
+        m_loaded = false;
+
+        if (m_graphicDevice.logicalDevice)
+        {
+            vkDeviceWaitIdle(m_graphicDevice.logicalDevice);
+        }
+        if (m_pipeline)
+        {
+            m_pipeline->unload();
+            m_pipeline.reset();
+        }
+        if (m_fallbackPipeline)
+        {
+            m_fallbackPipeline->unload();
+        }
+        m_fallbackPipeline.reset();
+        for (auto & frame : m_frames)
+        {
+            m_uploader.releaseSemaphores(frame->getUploadSemaphores());
+            m_cleaner.flush(frame->getRetired());
+        }
         m_cleaner.stop();
 
+        // Deleted pipelines have waited for their builds, the rest finish before the render pass is destroyed.
+        m_pipelineBuilder.stop();
+        m_textureStreamer.unload();
+        m_drawPackets.unload();
+        m_uploader.unload();
+        m_gpuProfiler.unload();
 
         unloadSwapChain();
+        unloadPipelineCache();
+        unloadReadback();
 
         if (m_graphicDevice.logicalDevice)
         {
-            for (auto & sem : m_renderFinishedSemaphores)
-            {
-                vkDestroySemaphore(m_graphicDevice.logicalDevice, sem, nullptr);
-            }
-            for (auto & sem : m_imageAvailableSemaphores)
-            {
-                vkDestroySemaphore(m_graphicDevice.logicalDevice, sem, nullptr);
-            }
-            for (auto & fence : m_inFlightFences)
+            if (m_pipelineLayout)
             {
-                vkDestroyFence(m_graphicDevice.logicalDevice, fence, nullptr);
+                vkDestroyPipelineLayout(m_graphicDevice.logicalDevice, m_pipelineLayout, nullptr);
+                m_pipelineLayout = 0;
             }
-            m_renderFinishedSemaphores.clear();
-            m_imageAvailableSemaphores.clear();
-            m_inFlightFences.clear();
+            m_descriptorTable.unload();
 
-            if (m_commandPool)
-            {
-                vkDestroyCommandPool(m_graphicDevice.logicalDevice, m_commandPool, nullptr);
-                m_commandPool = 0;
-            }
+            m_frames.clear();
+            m_currentFrame = 0;
+            m_memoryAllocator.unload();
 
             vkDestroyDevice(m_graphicDevice.logicalDevice, nullptr);
             m_graphicDevice.logicalDevice = 0;
@@ -167,17 +345,39 @@ namespace Flare
             vkDestroyInstance(m_instance, nullptr);
             m_instance = 0;
         }
+
+        m_pJobSystem = nullptr;
+        m_ownedJobSystem.reset();
     }
 
     void VulkanRenderer::render()
     {
+        CHECK_LOADED;
+
+        if (m_swapChainOutdated || m_multipass.getRevision() != m_multipassRevision)
+        {
+            recreateSwapChain();
+        }
+
+        // Nothing to present to while the window is minimized.
+        if (m_swapChainOutdated)
+        {
+            return;
+        }
+
         loadDrawFrame();
-        vkDeviceWaitIdle(m_graphicDevice.logicalDevice);
     }
 
     void VulkanRenderer::resize(const Vector2ui32 & size)
     {
+        CHECK_LOADED;
 
+        // The swap chain follows the surface extent, recreated before the next frame.
+        if (m_settings.getHeadless())
+        {
+            m_settings.setHeadlessSize(size);
+        }
+        m_swapChainOutdated = true;
     }
 
     const RenderMemoryAllocator & VulkanRenderer::memory() const
@@ -185,33 +385,259 @@ namespace Flare
         return m_memory;
     }
 
+    bool VulkanRenderer::getGpuProfile(GpuFrameProfile & profile) const
+    {
+        return m_gpuProfiler.getLatestProfile(profile);
+    }
+
     std::shared_ptr<Texture> VulkanRenderer::createTexture()
     {
         CHECK_LOADED;
 
-        auto texture = new VulkanTexture(m_memory);
+        auto texture = new VulkanTexture(*this, m_memory);
         auto ptr = std::shared_ptr<VulkanTexture>(texture, LAMBA_ADD_TO_CLEANER);
         return ptr;
     }
 
-    std::shared_ptr<Pipeline> VulkanRenderer::createPipeline()
+    void VulkanRenderer::readFrame(std::vector<uint8_t> & pixels, Vector2ui32 & size)
+    {
+        CHECK_LOADED;
+
+        if (!m_settings.getHeadless())
+        {
+            throw std::runtime_error("Reading frames is only supported in headless mode.");
+        }
+
+        size = Vector2ui32(m_swapChainExtent.width, m_swapChainExtent.height);
+        const size_t pixelCount = static_cast<size_t>(size.x) * size.y;
+        pixels.assign(pixelCount * 4, 0);
+        if (!m_hasRenderedImage)
+        {
+            return;
+        }
+
+        VkDevice logicalDevice = m_graphicDevice.logicalDevice;
+        const VkDeviceSize bufferSize = pixelCount * 4;
+
+        // Copy the image, left in transfer source layout by the render graph, to a host visible buffer.
+        VkBufferCreateInfo bufferInfo = {};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size = bufferSize;
+        bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        VkBuffer buffer = 0;
+        if (vkCreateBuffer(logicalDevice, &bufferInfo, nullptr, &buffer) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to create readback buffer.");
+        }
+        VulkanMemoryAllocator::Allocation memory = m_memoryAllocator.allocate(buffer,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+        // The command pool, buffer and fence are created by the first read and reused by the following ones.
+        if (!m_readbackCommandPool)
+        {
+            VkCommandPoolCreateInfo poolInfo = {};
+            poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+            poolInfo.queueFamilyIndex = m_graphicDevice.graphicsFamily.value();
+            poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+            if (vkCreateCommandPool(logicalDevice, &poolInfo, nullptr, &m_readbackCommandPool) != VK_SUCCESS)
+            {
+                m_readbackCommandPool = 0;
+                vkDestroyBuffer(logicalDevice, buffer, nullptr);
+                m_memoryAllocator.free(memory);
+                throw std::runtime_error("Failed to create readback command pool.");
+            }
+
+            VkCommandBufferAllocateInfo allocInfo = {};
+            allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            allocInfo.commandPool = m_readbackCommandPool;
+            allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+            allocInfo.commandBufferCount = 1;
+
+            VkFenceCreateInfo fenceInfo = {};
+            fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+            if (vkAllocateCommandBuffers(logicalDevice, &allocInfo, &m_readbackCommandBuffer) != VK_SUCCESS ||
+                vkCreateFence(logicalDevice, &fenceInfo, nullptr, &m_readbackFence) != VK_SUCCESS)
+            {
+                unloadReadback();
+                vkDestroyBuffer(logicalDevice, buffer, nullptr);
+                m_memoryAllocator.free(memory);
+                throw std::runtime_error("Failed to create readback command buffer.");
+            }
+        }
+        else
+        {
+            vkResetCommandPool(logicalDevice, m_readbackCommandPool, 0);
+            vkResetFences(logicalDevice, 1, &m_readbackFence);
+        }
+        VkCommandBuffer commandBuffer = m_readbackCommandBuffer;
+
+        VkCommandBufferBeginInfo beginInfo = {};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+        VkBufferImageCopy region = {};
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.layerCount = 1;
+        region.imageExtent = { size.x, size.y, 1 };
+        vkCmdCopyImageToBuffer(commandBuffer, m_swapChainImages[m_lastImageIndex], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, buffer, 1, &region);
+
+        VkBufferMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.buffer = buffer;
+        barrier.size = VK_WHOLE_SIZE;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+        vkEndCommandBuffer(commandBuffer);
+
+        // Submitted after the frame on the same queue, the frame's final barrier orders the copy after its writes.
+        // Only the copy is waited for, other work queued meanwhile keeps running.
+        VkSubmitInfo submitInfo = {};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &commandBuffer;
+        VkResult result;
+        {
+            std::lock_guard<std::mutex> lock(m_queueMutex);
+            result = vkQueueSubmit(m_graphicQueue, 1, &submitInfo, m_readbackFence);
+        }
+        if (result == VK_SUCCESS)
+        {
+            result = vkWaitForFences(logicalDevice, 1, &m_readbackFence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+        }
+        if (result != VK_SUCCESS)
+        {
+            vkDestroyBuffer(logicalDevice, buffer, nullptr);
+            m_memoryAllocator.free(memory);
+            throw std::runtime_error("Failed to submit readback command buffer.");
+        }
+
+        // Offscreen images are BGRA.
+        PixelConverter::bgraToRgba(memory.pMappedData, pixels.data(), pixelCount);
+
+        vkDestroyBuffer(logicalDevice, buffer, nullptr);
+        m_memoryAllocator.free(memory);
+    }
+
+    void VulkanRenderer::waitForInput()
     {
         CHECK_LOADED;
 
-        std::shared_ptr<Pipeline> ptr;
-        //auto ptr = std::shared_ptr<Pipeline>(pipeline, LAMBA_ADD_TO_CLEANER);
+        // The oldest frame in flight is reused next. In low latency mode the latest frame has to finish as well,
+        // so no queued frame delays the one about to sample input.
+        if (m_settings.getLowLatency())
+        {
+            m_frames[(m_currentFrame + m_frames.size() - 1) % m_frames.size()]->wait();
+        }
+        m_frames[m_currentFrame]->wait();
+
+        m_inputTime = std::chrono::steady_clock::now();
+        m_hasInputTime = true;
+    }
+
+    const RenderLatency & VulkanRenderer::getLatency() const
+    {
+        return m_latency;
+    }
+
+    const DrawStatistics & VulkanRenderer::getDrawStatistics() const
+    {
+        return m_drawStatistics;
+    }
+
+    FramePacer & VulkanRenderer::getFramePacer()
+    {
+        return m_framePacer;
+    }
+
+    Multipass & VulkanRenderer::getMultipass()
+    {
+        return m_multipass;
+    }
+
+    VulkanDescriptorTable & VulkanRenderer::getDescriptorTable()
+    {
+        return m_descriptorTable;
+    }
+
+    VulkanDrawPackets & VulkanRenderer::getDrawPackets()
+    {
+        return m_drawPackets;
+    }
 
+    VulkanTextureStreamer & VulkanRenderer::getTextureStreamer()
+    {
+        return m_textureStreamer;
+    }
+
+    void VulkanRenderer::draw(const uint32_t vertexCount, const uint32_t instanceCount, const uint32_t textureIndex, const uint32_t bufferIndex,
+                              VkBuffer vertexBuffer, const float depth)
+    {
+        const DrawConstants constants = { textureIndex, bufferIndex };
+        std::lock_guard<std::mutex> lock(m_submittedDrawMutex);
+        m_submittedDraws.push_back(DrawCommand{ VK_NULL_HANDLE, vertexCount, instanceCount, 0, 0, constants, vertexBuffer, depth });
+    }
+
+    Texture::PixelFormat VulkanRenderer::getTextureFormat(const Texture::PixelFormat pixelFormat) const
+    {
+        return m_textureFormats[static_cast<size_t>(pixelFormat)];
+    }
+
+    std::shared_ptr<Pipeline> VulkanRenderer::createPipeline()
+    {
+        CHECK_LOADED;
+
+        auto pipeline = new VulkanPipeline(*this);
+        auto ptr = std::shared_ptr<VulkanPipeline>(pipeline, LAMBA_ADD_TO_CLEANER);
         return ptr;
     }
 
+    void VulkanRenderer::setPipeline(const std::shared_ptr<Pipeline> & pipeline)
+    {
+        CHECK_LOADED;
+
+        m_pipeline = std::static_pointer_cast<VulkanPipeline>(pipeline);
+    }
+
+    uint32_t VulkanRenderer::findMemoryType(VkPhysicalDevice physicalDevice, const uint32_t typeFilter, const VkMemoryPropertyFlags properties)
+    {
+        VkPhysicalDeviceMemoryProperties memoryProperties;
+        vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+        for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+        {
+            if ((typeFilter & (1 << i)) && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
+            {
+                return i;
+            }
+        }
+
+        throw std::runtime_error("Failed to find suitable memory type.");
+    }
+
     VulkanRenderer::VulkanGraphicDevice::VulkanGraphicDevice() :
         physicalDevice(nullptr),
         logicalDevice(nullptr),
-        hasDeviceExtensionSupport(false)
+        hasDeviceExtensionSupport(false),
+        hasDescriptorIndexing(false),
+        enabledFeatures{}
     { }
 
-    bool VulkanRenderer::VulkanGraphicDevice::isSuitable() const
+    bool VulkanRenderer::VulkanGraphicDevice::isSuitable(const bool headless) const
     {
+        if (headless)
+        {
+            return graphicsFamily.has_value() && hasDeviceExtensionSupport;
+        }
+
         return graphicsFamily.has_value() && presentFamily.has_value() && hasDeviceExtensionSupport &&
                !surfaceFormats.empty() && !presentModes.empty();
     }
@@ -306,6 +732,11 @@ namespace Flare
 
         for (auto & extension : availableExtensions)
         {
+            if (m_settings.getHeadless())
+            {
+                break;
+            }
+
             if (strcmp("VK_KHR_surface", extension.extensionName) == 0)
             {
                 extensions.push_back("VK_KHR_surface");
@@ -395,6 +826,11 @@ namespace Flare
 
     void VulkanRenderer::loadCreateSurface()
     {
+        if (m_settings.getHeadless())
+        {
+            return;
+        }
+
 #if defined(FLARE_PLATFORM_WINDOWS)
         HWND hWnd;
         HINSTANCE hInstance;
@@ -459,8 +895,16 @@ namespace Flare
                     graphicDevice.graphicsFamily = index;
                 }
 
+                // Headless rendering never presents, the graphics queue stands in for the present queue.
                 VkBool32 presentSupport = false;
-                vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice, index, m_surface, &presentSupport);
+                if (m_settings.getHeadless())
+                {
+                    presentSupport = graphicDevice.graphicsFamily.has_value() && graphicDevice.graphicsFamily.value() == index;
+                }
+                else
+                {
+                    vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice, index, m_surface, &presentSupport);
+                }
                 if (presentSupport)
                 {
                     graphicDevice.presentFamily = index;
@@ -475,6 +919,24 @@ namespace Flare
             index++;
         }
 
+        // Prefer a dedicated transfer queue family for uploads, running alongside rendering.
+        index = 0;
+        for (const auto & queueFamily : queueFamilies)
+        {
+            if (queueFamily.queueCount > 0 && (queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT) &&
+                !(queueFamily.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)))
+            {
+                graphicDevice.transferFamily = index;
+                break;
+            }
+
+            index++;
+        }
+        if (!graphicDevice.transferFamily.has_value())
+        {
+            graphicDevice.transferFamily = graphicDevice.graphicsFamily;
+        }
+
 
         // Check device extension support
         uint32_t extensionCount;
@@ -482,16 +944,48 @@ namespace Flare
         std::vector<VkExtensionProperties> availableExtensions(extensionCount);
         vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, availableExtensions.data());
 
-        std::set<std::string> requiredExtensions(g_deviceExtensions.begin(), g_deviceExtensions.end());
+        const std::vector<const char *> & deviceExtensions = getDeviceExtensions();
+        std::set<std::string> requiredExtensions(deviceExtensions.begin(), deviceExtensions.end());
         for (const auto & extension : availableExtensions)
         {
             requiredExtensions.erase(extension.extensionName);
         }
         graphicDevice.hasDeviceExtensionSupport = requiredExtensions.empty();
+
+        // Descriptor indexing is optional, without it there is no bindless descriptor table.
+        graphicDevice.hasDescriptorIndexing = false;
+        for (const auto & extension : availableExtensions)
+        {
+            if (std::strcmp(extension.extensionName, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) == 0)
+            {
+                VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures = {};
+                indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+                VkPhysicalDeviceFeatures2 features = {};
+                features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+                features.pNext = &indexingFeatures;
+                vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+
+                graphicDevice.hasDescriptorIndexing = indexingFeatures.runtimeDescriptorArray &&
+                                                      indexingFeatures.descriptorBindingPartiallyBound &&
+                                                      indexingFeatures.descriptorBindingUpdateUnusedWhilePending &&
+                                                      indexingFeatures.descriptorBindingSampledImageUpdateAfterBind &&
+                                                      indexingFeatures.descriptorBindingStorageBufferUpdateAfterBind &&
+                                                      indexingFeatures.shaderSampledImageArrayNonUniformIndexing;
+                break;
+            }
+        }
       
 
         // Query swapchain.
-        loadQuerySwapChainSupport(graphicDevice, physicalDevice);
+        if (!m_settings.getHeadless())
+        {
+            loadQuerySwapChainSupport(graphicDevice, physicalDevice);
+        }
+    }
+
+    const std::vector<const char *> & VulkanRenderer::getDeviceExtensions() const
+    {
+        return m_settings.getHeadless() ? g_headlessDeviceExtensions : g_deviceExtensions;
     }
 
     void VulkanRenderer::loadScorePhysicalDevice(VkPhysicalDevice physicalDevice, uint32_t & score)
@@ -540,7 +1034,7 @@ namespace Flare
             VulkanGraphicDevice newDevice;
             loadGraphicDevice(newDevice, physicalDevice);
 
-            if (!newDevice.isSuitable())
+            if (!newDevice.isSuitable(m_settings.getHeadless()))
             {
                 continue;
             }
@@ -564,7 +1058,8 @@ namespace Flare
     void VulkanRenderer::loadCreateLogicalDevice()
     {
         std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-        std::set<uint32_t> uniqueQueueFamilies = { m_graphicDevice.graphicsFamily.value(), m_graphicDevice.presentFamily.has_value() };
+        std::set<uint32_t> uniqueQueueFamilies = { m_graphicDevice.graphicsFamily.value(), m_graphicDevice.presentFamily.value(),
+                                                   m_graphicDevice.transferFamily.value() };
 
         float queuePriority = 1.0f;
         for (uint32_t queueFamily : uniqueQueueFamilies)
@@ -577,14 +1072,38 @@ namespace Flare
             queueCreateInfos.push_back(queueCreateInfo);
         }
 
+        std::vector<const char *> extensions = getDeviceExtensions();
+
+        VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures = {};
+        indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+        if (m_graphicDevice.hasDescriptorIndexing)
+        {
+            extensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+            indexingFeatures.runtimeDescriptorArray = VK_TRUE;
+            indexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+            indexingFeatures.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+            indexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+            indexingFeatures.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+            indexingFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+        }
+
+        // Indirect multi-draw is optional, draw packets fall back to one draw per command.
+        VkPhysicalDeviceFeatures supportedFeatures;
+        vkGetPhysicalDeviceFeatures(m_graphicDevice.physicalDevice, &supportedFeatures);
         VkPhysicalDeviceFeatures deviceFeatures = {};
+        deviceFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+        deviceFeatures.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance;
+        deviceFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
+        m_graphicDevice.enabledFeatures = deviceFeatures;
+
         VkDeviceCreateInfo createInfo = {};
         createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+        createInfo.pNext = m_graphicDevice.hasDescriptorIndexing ? &indexingFeatures : nullptr;
         createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
         createInfo.pQueueCreateInfos = queueCreateInfos.data();
         createInfo.pEnabledFeatures = &deviceFeatures;
-        createInfo.enabledExtensionCount = static_cast<uint32_t>(g_deviceExtensions.size());
-        createInfo.ppEnabledExtensionNames = g_deviceExtensions.data();
+        createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+        createInfo.ppEnabledExtensionNames = extensions.data();
 
         // Set validation layers.
         if (m_settings.getDebug())
@@ -605,6 +1124,86 @@ namespace Flare
 
         vkGetDeviceQueue(m_graphicDevice.logicalDevice, m_graphicDevice.graphicsFamily.value(), 0, &m_graphicQueue);
         vkGetDeviceQueue(m_graphicDevice.logicalDevice, m_graphicDevice.presentFamily.value(), 0, &m_presentQueue);
+        vkGetDeviceQueue(m_graphicDevice.logicalDevice, m_graphicDevice.transferFamily.value(), 0, &m_transferQueue);
+    }
+
+    void VulkanRenderer::loadNegotiateTextureFormats()
+    {
+        // Three byte layouts lack optimal tiling and filtering on most devices, RGB is always stored as RGBA.
+        // Block compressed formats are stored as is if sampled and filtered by the device, else decompressed to RGBA.
+        const VkFormatFeatureFlags requiredFeatures = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+        const size_t formatCount = sizeof(m_textureFormats) / sizeof(m_textureFormats[0]);
+        for (size_t i = 0; i < formatCount; i++)
+        {
+            const Texture::PixelFormat pixelFormat = static_cast<Texture::PixelFormat>(i);
+            m_textureFormats[i] = Texture::PixelFormat::RGBA;
+            if (!TextureCompressor::isCompressed(pixelFormat) || !m_graphicDevice.enabledFeatures.textureCompressionBC)
+            {
+                continue;
+            }
+
+            VkFormatProperties properties;
+            vkGetPhysicalDeviceFormatProperties(m_graphicDevice.physicalDevice, VulkanTexture::getImageFormat(pixelFormat), &properties);
+            if ((properties.optimalTilingFeatures & requiredFeatures) == requiredFeatures)
+            {
+                m_textureFormats[i] = pixelFormat;
+            }
+        }
+    }
+
+    void VulkanRenderer::loadCreatePipelineCache()
+    {
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(m_graphicDevice.physicalDevice, &properties);
+
+        // Read cache file, any mismatch against the current device and driver discards it.
+        std::vector<uint8_t> data;
+        const std::string & filename = m_settings.getPipelineCacheFile();
+        std::ifstream file(filename, std::ios::binary);
+        if (!filename.empty() && file.is_open())
+        {
+            PipelineCacheFileHeader header;
+            if (file.read(reinterpret_cast<char *>(&header), sizeof(header)) &&
+                header.magic == FLARE_PIPELINE_CACHE_MAGIC &&
+                header.version == FLARE_PIPELINE_CACHE_VERSION &&
+                header.vendorID == properties.vendorID &&
+                header.deviceID == properties.deviceID &&
+                header.driverVersion == properties.driverVersion &&
+                std::memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0)
+            {
+                // The stored size must match the rest of the file, damaged or truncated files are discarded before allocating.
+                const std::streamoff dataOffset = file.tellg();
+                file.seekg(0, std::ios::end);
+                const std::streamoff fileSize = file.tellg();
+                file.seekg(dataOffset);
+                if (dataOffset >= 0 && fileSize >= dataOffset &&
+                    header.dataSize == static_cast<uint64_t>(fileSize - dataOffset))
+                {
+                    data.resize(static_cast<size_t>(header.dataSize));
+                    if (!file.read(reinterpret_cast<char *>(data.data()), data.size()) ||
+                        hashData(data.data(), data.size()) != header.dataHash)
+                    {
+                        data.clear();
+                    }
+                }
+            }
+        }
+
+        VkPipelineCacheCreateInfo createInfo = {};
+        createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+        createInfo.initialDataSize = data.size();
+        createInfo.pInitialData = data.size() ? data.data() : nullptr;
+
+        if (vkCreatePipelineCache(m_graphicDevice.logicalDevice, &createInfo, nullptr, &m_pipelineCache) != VK_SUCCESS)
+        {
+            // The driver may still reject data it wrote itself, start over with an empty cache.
+            createInfo.initialDataSize = 0;
+            createInfo.pInitialData = nullptr;
+            if (vkCreatePipelineCache(m_graphicDevice.logicalDevice, &createInfo, nullptr, &m_pipelineCache) != VK_SUCCESS)
+            {
+                throw std::runtime_error("Failed to create pipeline cache.");
+            }
+        }
     }
 
     void VulkanRenderer::loadChooseSwapSurfaceFormat()
@@ -628,19 +1227,24 @@ namespace Flare
 
     void VulkanRenderer::loadChooseSwapPresentMode()
     {
-        m_swapChainPresentMode = VK_PRESENT_MODE_FIFO_KHR;
+        // Fallbacks of the requested mode in order, fifo is always supported.
+        std::vector<VkPresentModeKHR> candidates;
+        switch (m_settings.getPresentMode())
+        {
+            case PresentMode::Fifo: break;
+            case PresentMode::FifoRelaxed: candidates = { VK_PRESENT_MODE_FIFO_RELAXED_KHR }; break;
+            case PresentMode::Mailbox: candidates = { VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR }; break;
+            case PresentMode::Immediate: candidates = { VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR }; break;
+        }
 
-        for (const auto & mode : m_graphicDevice.presentModes)
+        m_swapChainPresentMode = VK_PRESENT_MODE_FIFO_KHR;
+        for (const auto & candidate : candidates)
         {
-            if (mode == VK_PRESENT_MODE_MAILBOX_KHR)
+            if (std::find(m_graphicDevice.presentModes.begin(), m_graphicDevice.presentModes.end(), candidate) != m_graphicDevice.presentModes.end())
             {
-                m_swapChainPresentMode = mode;
+                m_swapChainPresentMode = candidate;
                 return;
             }
-            else if (mode == VK_PRESENT_MODE_IMMEDIATE_KHR)
-            {
-                m_swapChainPresentMode = mode;
-            }
         }
     }
 
@@ -653,6 +1257,7 @@ namespace Flare
         else
         {
             m_swapChainExtent = { 0,0 };
+            #if defined(FLARE_PLATFORM_WINDOWS)
             const Window * window = m_settings.getWindow();
             if (window)
             {
@@ -660,24 +1265,33 @@ namespace Flare
                 m_swapChainExtent.width = windowSize.x;
                 m_swapChainExtent.height = windowSize.y;
             }
+            #endif
             m_swapChainExtent.width = std::max(m_graphicDevice.surfaceCapabilities.minImageExtent.width, std::min(m_graphicDevice.surfaceCapabilities.maxImageExtent.width, m_swapChainExtent.width));
             m_swapChainExtent.height = std::max(m_graphicDevice.surfaceCapabilities.minImageExtent.height, std::min(m_graphicDevice.surfaceCapabilities.maxImageExtent.height, m_swapChainExtent.height));
         }
        
     }
 
-    void VulkanRenderer::loadCreateSwapChain()
+    void VulkanRenderer::loadCreateSwapChain(VkSwapchainKHR oldSwapChain)
     {
+        if (m_settings.getHeadless())
+        {
+            loadCreateOffscreenImages();
+            return;
+        }
+
         loadQuerySwapChainSupport(m_graphicDevice, m_graphicDevice.physicalDevice);
 
         loadChooseSwapSurfaceFormat();
         loadChooseSwapPresentMode();
         loadChooseSwapExtent();
 
-        uint32_t imageCount = m_graphicDevice.surfaceCapabilities.minImageCount + 1;
-        if (m_graphicDevice.surfaceCapabilities.maxImageCount > 0 && imageCount > m_graphicDevice.surfaceCapabilities.maxImageCount)
+        const VkSurfaceCapabilitiesKHR & capabilities = m_graphicDevice.surfaceCapabilities;
+        uint32_t imageCount = m_settings.getSwapChainImageCount() ? m_settings.getSwapChainImageCount() : capabilities.minImageCount + 1;
+        imageCount = std::max(imageCount, capabilities.minImageCount);
+        if (capabilities.maxImageCount > 0 && imageCount > capabilities.maxImageCount)
         {
-            imageCount = m_graphicDevice.surfaceCapabilities.maxImageCount;
+            imageCount = capabilities.maxImageCount;
         }
 
         VkSwapchainCreateInfoKHR createInfo = {};
@@ -709,7 +1323,7 @@ namespace Flare
         createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
         createInfo.presentMode = m_swapChainPresentMode;
         createInfo.clipped = VK_TRUE;
-        createInfo.oldSwapchain = VK_NULL_HANDLE;
+        createInfo.oldSwapchain = oldSwapChain;
 
         if (vkCreateSwapchainKHR(m_graphicDevice.logicalDevice, &createInfo, nullptr, &m_swapChain) != VK_SUCCESS)
         {
@@ -719,6 +1333,49 @@ namespace Flare
         vkGetSwapchainImagesKHR(m_graphicDevice.logicalDevice, m_swapChain, &imageCount, nullptr);
         m_swapChainImages.resize(imageCount);
         vkGetSwapchainImagesKHR(m_graphicDevice.logicalDevice, m_swapChain, &imageCount, m_swapChainImages.data());
+        m_imagesInFlight.assign(imageCount, VK_NULL_HANDLE);
+    }
+
+    void VulkanRenderer::loadCreateOffscreenImages()
+    {
+        const Vector2ui32 & size = m_settings.getHeadlessSize();
+        if (size.x == 0 || size.y == 0)
+        {
+            throw std::runtime_error("Headless rendering needs a non-zero size.");
+        }
+
+        m_swapChainSurfaceFormat = { VK_FORMAT_B8G8R8A8_UNORM, VK_COLORSPACE_SRGB_NONLINEAR_KHR };
+        m_swapChainExtent = { size.x, size.y };
+
+        // One image per frame in flight, so an image is free again once its frame has been waited for.
+        const size_t imageCount = m_settings.getMaxFramesInFlight();
+        m_swapChainImages.assign(imageCount, VkImage(0));
+        m_offscreenMemory.resize(imageCount);
+        m_imagesInFlight.assign(imageCount, VK_NULL_HANDLE);
+        m_hasRenderedImage = false;
+
+        for (size_t i = 0; i < imageCount; i++)
+        {
+            VkImageCreateInfo imageInfo = {};
+            imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+            imageInfo.imageType = VK_IMAGE_TYPE_2D;
+            imageInfo.extent = { size.x, size.y, 1 };
+            imageInfo.mipLevels = 1;
+            imageInfo.arrayLayers = 1;
+            imageInfo.format = m_swapChainSurfaceFormat.format;
+            imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+            imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+            imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+            imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+            if (vkCreateImage(m_graphicDevice.logicalDevice, &imageInfo, nullptr, &m_swapChainImages[i]) != VK_SUCCESS)
+            {
+                throw std::runtime_error("Failed to create offscreen image.");
+            }
+
+            m_offscreenMemory[i] = m_memoryAllocator.allocate(m_swapChainImages[i], VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        }
     }
 
     void VulkanRenderer::loadCreateImageViews()
@@ -750,322 +1407,189 @@ namespace Flare
         }
     }
 
-    void VulkanRenderer::loadCreateRenderPass()
+    void VulkanRenderer::loadCreateRenderGraph()
     {
-        VkAttachmentDescription colorAttachment = {};
-        colorAttachment.format = m_swapChainSurfaceFormat.format;
-        colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-        colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-        colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-        colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-
-        VkAttachmentReference colorAttachmentRef = {};
-        colorAttachmentRef.attachment = 0;
-        colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-        VkSubpassDescription subpass = {};
-        subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-        subpass.colorAttachmentCount = 1;
-        subpass.pColorAttachments = &colorAttachmentRef;
-
-
-        VkSubpassDependency dependency = {};
-        dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-        dependency.dstSubpass = 0;
-        dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-        dependency.srcAccessMask = 0;
-        dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-        dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-
-
-        VkRenderPassCreateInfo renderPassInfo = {};
-        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-        renderPassInfo.attachmentCount = 1;
-        renderPassInfo.pAttachments = &colorAttachment;
-        renderPassInfo.subpassCount = 1;
-        renderPassInfo.pSubpasses = &subpass;
-        renderPassInfo.dependencyCount = 1;
-        renderPassInfo.pDependencies = &dependency;
-
-        if (vkCreateRenderPass(m_graphicDevice.logicalDevice, &renderPassInfo, nullptr, &m_renderPass) != VK_SUCCESS)
-        {
-            throw std::runtime_error("Failed to create render pass.");
-        }
+        m_multipassRevision = m_multipass.getRevision();
+        m_renderGraph.setup(m_multipass);
+        m_renderGraph.compile();
+        // Offscreen images are left ready for readback instead of presentation.
+        const VkImageLayout backbufferLayout = m_settings.getHeadless() ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        m_vulkanRenderGraph = std::make_unique<VulkanRenderGraph>();
+        m_vulkanRenderGraph->load(m_graphicDevice.logicalDevice, m_memoryAllocator, m_renderGraph, m_swapChainSurfaceFormat.format,
+                                 m_swapChainExtent, m_swapChainImages, m_swapChainImageViews, backbufferLayout);
+
+        // The main pass may have been culled, if a later pass overwrites the backbuffer.
+        const uint32_t mainPass = m_renderGraph.findPass(&m_mainSubpass);
+        m_renderPass = mainPass != RenderGraph::InvalidIndex ? m_vulkanRenderGraph->getRenderPass(mainPass) : VK_NULL_HANDLE;
+        m_subpass = m_renderPass ? m_vulkanRenderGraph->getSubpass(mainPass) : 0;
     }
 
-    void VulkanRenderer::loadCreateGraphicsPipeline()
+    void VulkanRenderer::loadCreatePipelineLayout()
     {
-        auto vertShaderCode = readFile("shaders/vert.spv");
-        auto fragShaderCode = readFile("shaders/frag.spv");
-
-        VkShaderModule vertShaderModule; 
-        VkShaderModule fragShaderModule; 
-        loadCreateShaderModule(vertShaderCode, vertShaderModule);
-        loadCreateShaderModule(fragShaderCode, fragShaderModule);
-
-        VkPipelineShaderStageCreateInfo vertShaderStageInfo = {};
-        vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-        vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-        vertShaderStageInfo.module = vertShaderModule;
-        vertShaderStageInfo.pName = "main";
+        // Shared by all pipelines, set 0 is the descriptor table and draws push their resource indices.
+        const VkDescriptorSetLayout setLayout = m_descriptorTable.getLayout();
 
-        VkPipelineShaderStageCreateInfo fragShaderStageInfo = {};
-        fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-        fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-        fragShaderStageInfo.module = fragShaderModule;
-        fragShaderStageInfo.pName = "main";
-
-        VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
-
-        VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
-        vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-        vertexInputInfo.vertexBindingDescriptionCount = 0;
-        vertexInputInfo.pVertexBindingDescriptions = nullptr;
-        vertexInputInfo.vertexAttributeDescriptionCount = 0;
-        vertexInputInfo.pVertexAttributeDescriptions = nullptr;
-
-        VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
-        inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-        inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-        inputAssembly.primitiveRestartEnable = VK_FALSE;
-
-        VkViewport viewport = {};
-        viewport.x = 0.0f;
-        viewport.y = 0.0f;
-        viewport.width = static_cast<float>(m_swapChainExtent.width);
-        viewport.height = static_cast<float>(m_swapChainExtent.height);
-        viewport.minDepth = 0.0f;
-        viewport.maxDepth = 1.0f;
-
-        VkRect2D scissor = {};
-        scissor.offset = { 0, 0 };
-        scissor.extent = m_swapChainExtent;
-
-        VkPipelineViewportStateCreateInfo viewportState = {};
-        viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-        viewportState.viewportCount = 1;
-        viewportState.pViewports = &viewport;
-        viewportState.scissorCount = 1;
-        viewportState.pScissors = &scissor;
-
-        VkPipelineRasterizationStateCreateInfo rasterizer = {};
-        rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-        rasterizer.depthClampEnable = VK_FALSE;
-        rasterizer.rasterizerDiscardEnable = VK_FALSE;
-        rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
-        rasterizer.lineWidth = 1.0f;
-        rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
-        rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
-        rasterizer.depthBiasEnable = VK_FALSE;
-        rasterizer.depthBiasConstantFactor = 0.0f;
-        rasterizer.depthBiasClamp = 0.0f;
-        rasterizer.depthBiasSlopeFactor = 0.0f;
-
-        VkPipelineMultisampleStateCreateInfo multisampling = {};
-        multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-        multisampling.sampleShadingEnable = VK_FALSE;
-        multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-
-        VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
-        colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT
-            | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-        colorBlendAttachment.blendEnable = VK_FALSE;
-        colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
-        colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO;
-        colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
-        colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
-        colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
-        colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
-
-        VkPipelineColorBlendStateCreateInfo colorBlend = {};
-        colorBlend.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-        colorBlend.logicOpEnable = VK_FALSE;
-        colorBlend.logicOp = VK_LOGIC_OP_COPY;
-        colorBlend.attachmentCount = 1;
-        colorBlend.pAttachments = &colorBlendAttachment;
-        colorBlend.blendConstants[0] = 0.0f;
-        colorBlend.blendConstants[1] = 0.0f;
-        colorBlend.blendConstants[2] = 0.0f;
-        colorBlend.blendConstants[3] = 0.0f;
+        VkPushConstantRange pushConstantRange = {};
+        pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+        pushConstantRange.offset = 0;
+        pushConstantRange.size = sizeof(DrawConstants);
 
         VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
         pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-        pipelineLayoutInfo.setLayoutCount = 0;
-        pipelineLayoutInfo.pSetLayouts = nullptr;
-        pipelineLayoutInfo.pushConstantRangeCount = 0;
-        pipelineLayoutInfo.pPushConstantRanges = nullptr;
+        pipelineLayoutInfo.setLayoutCount = setLayout ? 1 : 0;
+        pipelineLayoutInfo.pSetLayouts = setLayout ? &setLayout : nullptr;
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
 
         if (vkCreatePipelineLayout(m_graphicDevice.logicalDevice, &pipelineLayoutInfo, nullptr, &m_pipelineLayout) != VK_SUCCESS)
         {
             throw std::runtime_error("Failed to create pipeline layout.");
         }
-
-        VkGraphicsPipelineCreateInfo pipelineInfo = {};
-        pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-        pipelineInfo.stageCount = 2;
-        pipelineInfo.pStages = shaderStages;
-        pipelineInfo.pVertexInputState = &vertexInputInfo;
-        pipelineInfo.pInputAssemblyState = &inputAssembly;
-        pipelineInfo.pViewportState = &viewportState;
-        pipelineInfo.pRasterizationState = &rasterizer;
-        pipelineInfo.pMultisampleState = &multisampling;
-        pipelineInfo.pDepthStencilState = nullptr;
-        pipelineInfo.pColorBlendState = &colorBlend;
-        pipelineInfo.pDynamicState = nullptr;
-        pipelineInfo.layout = m_pipelineLayout;
-        pipelineInfo.renderPass = m_renderPass;
-        pipelineInfo.subpass = 0;
-        pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
-        pipelineInfo.basePipelineIndex = -1;
-
-        if (vkCreateGraphicsPipelines(m_graphicDevice.logicalDevice, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_graphicsPipeline) != VK_SUCCESS)
-        {
-            throw std::runtime_error("Failed to create graphics pipeline.");
-        }
-
-        vkDestroyShaderModule(m_graphicDevice.logicalDevice, fragShaderModule, nullptr);
-        vkDestroyShaderModule(m_graphicDevice.logicalDevice, vertShaderModule, nullptr);
     }
 
-    void VulkanRenderer::loadCreateShaderModule(const std::vector<char> & code, VkShaderModule & shaderModule) const
+    void VulkanRenderer::loadCreateGraphicsPipeline()
     {
-        VkShaderModuleCreateInfo createInfo = {};
-        createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-        createInfo.codeSize = code.size();
-        createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
-
-        if (vkCreateShaderModule(m_graphicDevice.logicalDevice, &createInfo, nullptr, &shaderModule) != VK_SUCCESS)
+        // Built in the background, nothing is drawn until the fallback pipeline is ready.
+        if (!m_fallbackPipeline)
         {
-            throw std::runtime_error("Failed to create shader module.");
+            m_fallbackPipeline = std::shared_ptr<VulkanPipeline>(new VulkanPipeline(*this), LAMBA_ADD_TO_CLEANER);
+            m_fallbackPipeline->load("shaders/vert.spv", "shaders/frag.spv");
+        }
+        else
+        {
+            m_fallbackPipeline->rebuild();
         }
-    }
-
-    void VulkanRenderer::loadCreateFramebuffers()
-    {
-        m_swapChainFramebuffers.resize(m_swapChainImageViews.size());
 
-        for (size_t i = 0; i < m_swapChainImageViews.size(); i++)
+        if (m_pipeline)
         {
-            VkImageView attachments[] =
-            {
-                m_swapChainImageViews[i]
-            };
-
-            VkFramebufferCreateInfo framebufferInfo = {};
-            framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-            framebufferInfo.renderPass = m_renderPass;
-            framebufferInfo.attachmentCount = 1;
-            framebufferInfo.pAttachments = attachments;
-            framebufferInfo.width = m_swapChainExtent.width;
-            framebufferInfo.height = m_swapChainExtent.height;
-            framebufferInfo.layers = 1;
-
-            if (vkCreateFramebuffer(m_graphicDevice.logicalDevice, &framebufferInfo, nullptr, &m_swapChainFramebuffers[i]) != VK_SUCCESS)
-            {
-                throw std::runtime_error("Failed to create framebuffer.");
-            }
+            m_pipeline->rebuild();
         }
     }
 
-    void VulkanRenderer::loadCreateCommandPool()
+    void VulkanRenderer::loadCreateFrames()
     {
-        VkCommandPoolCreateInfo poolInfo = {};
-        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-        poolInfo.queueFamilyIndex = m_graphicDevice.graphicsFamily.value();
-        poolInfo.flags = 0;
-
-        if (vkCreateCommandPool(m_graphicDevice.logicalDevice, &poolInfo, nullptr, &m_commandPool) != VK_SUCCESS)
+        m_frames.resize(m_settings.getMaxFramesInFlight());
+        for (auto & frame : m_frames)
         {
-            throw std::runtime_error("Faild to create command pool.");
+            frame = std::make_unique<VulkanFrame>();
+            // One extra worker slot for recording from threads outside of the job system.
+            frame->load(m_graphicDevice.physicalDevice, m_graphicDevice.logicalDevice, m_memoryAllocator,
+                        m_graphicDevice.graphicsFamily.value(), FLARE_FRAME_UNIFORM_BUFFER_SIZE,
+                        m_pJobSystem->getWorkerCount() + 1);
         }
+        m_currentFrame = 0;
     }
 
-    void VulkanRenderer::loadCreateCommandBuffers()
+    void VulkanRenderer::loadDrawFrame()
     {
-        m_commandBuffers.resize(m_swapChainFramebuffers.size());
+        VulkanFrame & frame = *m_frames[m_currentFrame];
 
-        VkCommandBufferAllocateInfo allocInfo = {};
-        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-        allocInfo.commandPool = m_commandPool;
-        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-        allocInfo.commandBufferCount = static_cast<uint32_t>(m_commandBuffers.size());
-        if (vkAllocateCommandBuffers(m_graphicDevice.logicalDevice, &allocInfo, m_commandBuffers.data()) != VK_SUCCESS)
+        // Everything owned by this frame is free to reuse once its fence has signaled.
+        if (!m_hasInputTime)
         {
-            throw std::runtime_error("Failed to allocate command buffers.");
+            waitForInput();
         }
 
-        for (size_t i = 0; i < m_commandBuffers.size(); i++)
+        const bool headless = m_settings.getHeadless();
+        uint32_t imageIndex = static_cast<uint32_t>(m_currentFrame);
+        VkResult result = VK_SUCCESS;
+
+        if (!headless)
         {
-            VkCommandBufferBeginInfo beginInfo = {};
-            beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-            beginInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
-            beginInfo.pInheritanceInfo = nullptr;
+            result = vkAcquireNextImageKHR(m_graphicDevice.logicalDevice, m_swapChain, std::numeric_limits<uint64_t>::max(),
+                frame.getImageAvailableSemaphore(), VK_NULL_HANDLE, &imageIndex);
 
-            if (vkBeginCommandBuffer(m_commandBuffers[i], &beginInfo) != VK_SUCCESS)
+            // Recreated in place and acquired again, instead of dropping the frame.
+            if (result == VK_ERROR_OUT_OF_DATE_KHR)
             {
-                throw std::runtime_error("Failed to begin recording of command buffer.");
+                recreateSwapChain();
+                if (m_swapChainOutdated)
+                {
+                    return;
+                }
+                result = vkAcquireNextImageKHR(m_graphicDevice.logicalDevice, m_swapChain, std::numeric_limits<uint64_t>::max(),
+                    frame.getImageAvailableSemaphore(), VK_NULL_HANDLE, &imageIndex);
             }
 
-            VkRenderPassBeginInfo renderPassInfo = {};
-            renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-            renderPassInfo.renderPass = m_renderPass;
-            renderPassInfo.framebuffer = m_swapChainFramebuffers[i];
-            renderPassInfo.renderArea.offset = { 0, 0 };
-            renderPassInfo.renderArea.extent = m_swapChainExtent;
-
-            VkClearValue clearColor = { 0.0f, 0.0f, 0.0f, 1.0f };
-            renderPassInfo.clearValueCount = 1;
-            renderPassInfo.pClearValues = &clearColor;
-
-            vkCmdBeginRenderPass(m_commandBuffers[i], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-            vkCmdBindPipeline(m_commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, m_graphicsPipeline);
-            vkCmdDraw(m_commandBuffers[i], 3, 1, 0, 0);
-            vkCmdEndRenderPass(m_commandBuffers[i]);
-
-            if (vkEndCommandBuffer(m_commandBuffers[i]) != VK_SUCCESS)
+            if (result == VK_ERROR_OUT_OF_DATE_KHR)
             {
-                throw std::runtime_error("Failed to record command buffer.");
+                m_swapChainOutdated = true;
+                return;
+            }
+            else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+                throw std::runtime_error("failed to acquire swap chain image!");
             }
         }
-    }
-
-    void VulkanRenderer::loadDrawFrame()
-    {
-        vkWaitForFences(m_graphicDevice.logicalDevice, 1, &m_inFlightFences[m_currentFrame], VK_TRUE, std::numeric_limits<uint64_t>::max());
-        vkResetFences(m_graphicDevice.logicalDevice, 1, &m_inFlightFences[m_currentFrame]);
 
-        uint32_t imageIndex;
-        VkResult result = vkAcquireNextImageKHR(m_graphicDevice.logicalDevice, m_swapChain, std::numeric_limits<uint64_t>::max(),
-            m_imageAvailableSemaphores[m_currentFrame], VK_NULL_HANDLE, &imageIndex);
-
-        if (result == VK_ERROR_OUT_OF_DATE_KHR) {
-            recreateSwapChain();
-            return;
+        // With more frames in flight than swap chain images, the image may still be used by another frame.
+        if (m_imagesInFlight[imageIndex] && m_imagesInFlight[imageIndex] != frame.getInFlightFence())
+        {
+            vkWaitForFences(m_graphicDevice.logicalDevice, 1, &m_imagesInFlight[imageIndex], VK_TRUE, std::numeric_limits<uint64_t>::max());
         }
-        else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
-            throw std::runtime_error("failed to acquire swap chain image!");
+        m_imagesInFlight[imageIndex] = frame.getInFlightFence();
+
+        // Only hand off retired objects and reset the fence now that the frame is guaranteed to be submitted.
+        // A frame dropped before has to keep its retire list, objects moved into it may still be used by other frames.
+        m_cleaner.nextFrame(frame.getRetired());
+        m_uploader.releaseSemaphores(frame.getUploadSemaphores());
+        frame.reset();
+        m_drawStatistics = DrawStatistics();
+        loadDecodedTextures();
+        m_textureStreamer.update();
+        loadUpdateDrawCommands();
+        m_drawPackets.build(frame, *m_pJobSystem);
+        recordCommandBuffer(frame, imageIndex);
+
+        // Wait for this frame's uploads as well, submitted right before.
+        std::vector<VkSemaphore> & uploadSemaphores = frame.getUploadSemaphores();
+        m_uploader.submit(uploadSemaphores);
+
+        std::vector<VkSemaphore> waitSemaphores;
+        std::vector<VkPipelineStageFlags> waitStages;
+        if (!headless)
+        {
+            waitSemaphores.push_back(frame.getImageAvailableSemaphore());
+            waitStages.push_back(VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+        }
+        for (auto semaphore : uploadSemaphores)
+        {
+            waitSemaphores.push_back(semaphore);
+            waitStages.push_back(VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
         }
-
-
 
         VkSubmitInfo submitInfo = {};
         submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-        VkSemaphore waitSemaphore[] = { m_imageAvailableSemaphores[m_currentFrame] };
-        VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-        submitInfo.waitSemaphoreCount = 1;
-        submitInfo.pWaitSemaphores = waitSemaphore;
-        submitInfo.pWaitDstStageMask = waitStages;
+        VkCommandBuffer commandBuffer = frame.getCommandBuffer();
+        submitInfo.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
+        submitInfo.pWaitSemaphores = waitSemaphores.data();
+        submitInfo.pWaitDstStageMask = waitStages.data();
         submitInfo.commandBufferCount = 1;
-        submitInfo.pCommandBuffers = &m_commandBuffers[imageIndex];
-        VkSemaphore signalSemaphores[] = { m_renderFinishedSemaphores[m_currentFrame] };
-        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.pCommandBuffers = &commandBuffer;
+        VkSemaphore signalSemaphores[] = { frame.getRenderFinishedSemaphore() };
+        submitInfo.signalSemaphoreCount = headless ? 0 : 1;
         submitInfo.pSignalSemaphores = signalSemaphores;
 
-        if (vkQueueSubmit(m_graphicQueue, 1, &submitInfo, m_inFlightFences[m_currentFrame]) != VK_SUCCESS)
         {
-            throw std::runtime_error("Failed to submit draw command buffer!");
+            std::lock_guard<std::mutex> lock(m_queueMutex);
+            if (vkQueueSubmit(m_graphicQueue, 1, &submitInfo, frame.getInFlightFence()) != VK_SUCCESS)
+            {
+                throw std::runtime_error("Failed to submit draw command buffer!");
+            }
+        }
+
+        m_currentFrame = (m_currentFrame + 1) % m_frames.size();
+
+        // Paced right before presenting, the frame's work is already queued and overlaps the wait.
+        m_framePacer.wait();
+
+        if (headless)
+        {
+            m_lastImageIndex = imageIndex;
+            m_hasRenderedImage = true;
+            m_latency.record(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_inputTime).count());
+            m_hasInputTime = false;
+            return;
         }
 
         VkPresentInfoKHR presentInfo = {};
@@ -1079,108 +1603,409 @@ namespace Flare
         presentInfo.pImageIndices = &imageIndex;
         presentInfo.pResults = nullptr;
 
-        result = vkQueuePresentKHR(m_presentQueue, &presentInfo);
+        {
+            std::lock_guard<std::mutex> lock(m_queueMutex);
+            result = vkQueuePresentKHR(m_presentQueue, &presentInfo);
+        }
+        m_latency.record(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_inputTime).count());
+        m_hasInputTime = false;
+
         if (result == VK_ERROR_OUT_OF_DATE_KHR)
         {
-            recreateSwapChain();
+            m_swapChainOutdated = true;
             return;
         }
         else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
             throw std::runtime_error("failed to acquire swap chain image!");
         }
+    }
+
+    void VulkanRenderer::loadDecodedTextures()
+    {
+        // Chains decoded by jobs are uploaded with this frame's other uploads.
+        std::vector<VulkanTexture *> textures;
+        {
+            std::lock_guard<std::mutex> lock(m_decodedTextureMutex);
+            textures.swap(m_decodedTextures);
+        }
+        for (auto texture : textures)
+        {
+            texture->loadDecodedChain();
+        }
+    }
+
+    void VulkanRenderer::loadUpdateDrawCommands()
+    {
+        // Finished builds are swapped in here, the fallback pipeline is used until the main pipeline is ready.
+        VkPipeline pipeline = m_fallbackPipeline ? m_fallbackPipeline->update() : VK_NULL_HANDLE;
+        m_packetPipeline = VK_NULL_HANDLE;
+        if (m_pipeline)
+        {
+            const VkPipeline mainPipeline = m_pipeline->update();
+            if (mainPipeline)
+            {
+                pipeline = mainPipeline;
+                m_packetPipeline = mainPipeline;
+            }
+        }
 
+        // Draws submitted since the last frame, dropped if there is no pipeline to draw them with.
+        m_drawCommands.clear();
+        {
+            std::lock_guard<std::mutex> lock(m_submittedDrawMutex);
+            m_drawCommands.swap(m_submittedDraws);
+        }
+        if (!pipeline)
+        {
+            m_drawCommands.clear();
+        }
+        for (auto & draw : m_drawCommands)
+        {
+            draw.pipeline = pipeline;
+        }
 
-        m_currentFrame = (m_currentFrame + 1) % FLARE_MAX_FRAMES_IN_FLIGHT;
+        // Default draw list, a single triangle.
+        if (pipeline && m_drawCommands.empty())
+        {
+            const DrawConstants constants = { VulkanDescriptorTable::InvalidIndex, VulkanDescriptorTable::InvalidIndex };
+            m_drawCommands.push_back(DrawCommand{ pipeline, 3, 1, 0, 0, constants, VK_NULL_HANDLE, 0.0f });
+        }
 
+        loadSortDrawCommands();
     }
 
-    void VulkanRenderer::loadCreateSyncObjects()
+    void VulkanRenderer::loadSortDrawCommands()
     {
-        m_imageAvailableSemaphores.resize(FLARE_MAX_FRAMES_IN_FLIGHT);
-        m_renderFinishedSemaphores.resize(FLARE_MAX_FRAMES_IN_FLIGHT);
-        m_inFlightFences.resize(FLARE_MAX_FRAMES_IN_FLIGHT);
+        // Pipelines and meshes get small ids in order of first use this frame, to fit the key.
+        // A mesh is the bound vertex buffer or the table buffer vertices are pulled from, both change between draws.
+        m_sortPipelineIds.clear();
+        m_sortMeshIds.clear();
+        m_renderQueue.clear();
+        m_renderQueue.reserve(m_drawCommands.size());
+
+        for (size_t i = 0; i < m_drawCommands.size(); i++)
+        {
+            const DrawCommand & draw = m_drawCommands[i];
+            const uint32_t pipelineId = m_sortPipelineIds.emplace(draw.pipeline, static_cast<uint32_t>(m_sortPipelineIds.size())).first->second;
+            const auto mesh = std::make_pair(draw.vertexBuffer, draw.constants.bufferIndex);
+            const uint32_t meshId = m_sortMeshIds.emplace(mesh, static_cast<uint32_t>(m_sortMeshIds.size())).first->second;
+            m_renderQueue.push(RenderQueue::createKey(0, pipelineId, draw.constants.textureIndex, meshId, draw.depth), static_cast<uint32_t>(i));
+        }
+        m_renderQueue.sort();
 
-        VkSemaphoreCreateInfo semaphoreInfo = {};
-        semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        m_sortedDrawCommands.clear();
+        for (const auto & item : m_renderQueue.getItems())
+        {
+            m_sortedDrawCommands.push_back(m_drawCommands[item.index]);
+        }
+        m_drawCommands.swap(m_sortedDrawCommands);
+    }
+
+    void VulkanRenderer::recordCommandBuffer(VulkanFrame & frame, const uint32_t imageIndex)
+    {
+        VkCommandBuffer commandBuffer = frame.getCommandBuffer();
 
-        VkFenceCreateInfo fenceInfo = {};
-        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-        fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+        VkCommandBufferBeginInfo beginInfo = {};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        beginInfo.pInheritanceInfo = nullptr;
 
-        for (size_t i = 0; i < FLARE_MAX_FRAMES_IN_FLIGHT; i++)
+        if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
         {
-            if (vkCreateSemaphore(m_graphicDevice.logicalDevice, &semaphoreInfo, nullptr, &m_imageAvailableSemaphores[i]) != VK_SUCCESS ||
-                vkCreateSemaphore(m_graphicDevice.logicalDevice, &semaphoreInfo, nullptr, &m_renderFinishedSemaphores[i]) != VK_SUCCESS ||
-                vkCreateFence(m_graphicDevice.logicalDevice, &fenceInfo, nullptr, &m_inFlightFences[i]) != VK_SUCCESS)
-            {
-                throw std::runtime_error("Failed to create synchronization objects for a frame.");
-            }
+            throw std::runtime_error("Failed to begin recording of command buffer.");
+        }
+
+        m_gpuProfiler.beginFrame(commandBuffer, m_currentFrame);
+        m_gpuProfiler.beginScope(commandBuffer, "Frame");
+
+        m_vulkanRenderGraph->record(commandBuffer, imageIndex, m_gpuProfiler);
+        m_gpuProfiler.endScope(commandBuffer);
+
+        if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to record command buffer.");
         }
     }
 
-    void VulkanRenderer::unloadSwapChain()
+    void VulkanRenderer::recordSecondaryCommandBuffers(VulkanFrame & frame, const VulkanRenderGraphContext & context, std::vector<VkCommandBuffer> & commandBuffers)
     {
-        if (m_graphicDevice.logicalDevice)
+        // Each job records a fixed range of draws into its own slot, so the submission order stays the same as the draw list.
+        const size_t drawCount = m_drawCommands.size();
+        const size_t grainSize = FLARE_DRAW_COMMANDS_PER_RECORD_JOB;
+        commandBuffers.resize((drawCount + grainSize - 1) / grainSize);
+
+        VkCommandBufferInheritanceInfo inheritanceInfo = {};
+        inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+        inheritanceInfo.renderPass = context.getRenderPass();
+        inheritanceInfo.subpass = context.getSubpass();
+        inheritanceInfo.framebuffer = context.getFramebuffer();
+
+        std::vector<DrawStatistics> statistics(commandBuffers.size());
+        m_pJobSystem->parallelFor(0, commandBuffers.size(), 1, [&](const size_t first, const size_t last)
         {
-            for (auto framebuffer : m_swapChainFramebuffers)
+            const size_t workerIndex = std::min(m_pJobSystem->getWorkerIndex(), m_pJobSystem->getWorkerCount());
+
+            for (size_t i = first; i < last; i++)
             {
-                vkDestroyFramebuffer(m_graphicDevice.logicalDevice, framebuffer, nullptr);
+                VkCommandBuffer commandBuffer = frame.allocateSecondaryCommandBuffer(workerIndex);
+
+                VkCommandBufferBeginInfo beginInfo = {};
+                beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+                beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+                beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+                if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+                {
+                    throw std::runtime_error("Failed to begin recording of secondary command buffer.");
+                }
+
+                recordDrawCommands(commandBuffer, context.getExtent(), i * grainSize, std::min((i + 1) * grainSize, drawCount), statistics[i]);
+                if (i + 1 == commandBuffers.size())
+                {
+                    recordDrawPackets(commandBuffer, statistics[i]);
+                }
+
+                if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+                {
+                    throw std::runtime_error("Failed to record secondary command buffer.");
+                }
+
+                commandBuffers[i] = commandBuffer;
             }
-            m_swapChainFramebuffers.clear();
+        });
+
+        for (const auto & chunkStatistics : statistics)
+        {
+            m_drawStatistics.add(chunkStatistics);
+        }
+    }
+
+    void VulkanRenderer::recordDrawCommands(VkCommandBuffer commandBuffer, const Vector2ui32 & extent, const size_t begin, const size_t end,
+                                            DrawStatistics & statistics) const
+    {
+        // Dynamic state is not inherited by secondary command buffers, each one sets its own.
+        VkViewport viewport = {};
+        viewport.x = 0.0f;
+        viewport.y = 0.0f;
+        viewport.width = static_cast<float>(extent.x);
+        viewport.height = static_cast<float>(extent.y);
+        viewport.minDepth = 0.0f;
+        viewport.maxDepth = 1.0f;
+        vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
 
-            vkFreeCommandBuffers(m_graphicDevice.logicalDevice, m_commandPool, static_cast<uint32_t>(m_commandBuffers.size()), m_commandBuffers.data());
-            m_commandBuffers.clear();
+        VkRect2D scissor = {};
+        scissor.offset = { 0, 0 };
+        scissor.extent = { extent.x, extent.y };
+        vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
-            if (m_graphicsPipeline)
+        // All pipelines share the layout, the descriptor table stays bound for the whole command buffer.
+        const VkDescriptorSet descriptorSet = m_descriptorTable.getDescriptorSet();
+        if (descriptorSet)
+        {
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+        }
+
+        // Draws are sorted by state, only binds differing from the previous draw are recorded.
+        VkPipeline boundPipeline = VK_NULL_HANDLE;
+        VkBuffer boundVertexBuffer = VK_NULL_HANDLE;
+        DrawConstants pushedConstants = {};
+        for (size_t i = begin; i < end; i++)
+        {
+            const DrawCommand & draw = m_drawCommands[i];
+            if (draw.pipeline != boundPipeline)
             {
-                vkDestroyPipeline(m_graphicDevice.logicalDevice, m_graphicsPipeline, nullptr);
-                m_graphicsPipeline = 0;
+                vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, draw.pipeline);
+                boundPipeline = draw.pipeline;
+                statistics.pipelineBinds++;
             }
-
-            if (m_pipelineLayout)
+            else
             {
-                vkDestroyPipelineLayout(m_graphicDevice.logicalDevice, m_pipelineLayout, nullptr);
-                m_pipelineLayout = 0;
+                statistics.pipelineBindsAvoided++;
             }
 
-            if (m_renderPass)
+            if (i == begin || std::memcmp(&draw.constants, &pushedConstants, sizeof(DrawConstants)) != 0)
             {
-                vkDestroyRenderPass(m_graphicDevice.logicalDevice, m_renderPass, nullptr);
-                m_renderPass = 0;
+                vkCmdPushConstants(commandBuffer, m_pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+                                   0, sizeof(DrawConstants), &draw.constants);
+                pushedConstants = draw.constants;
+                statistics.constantPushes++;
+            }
+            else
+            {
+                statistics.constantPushesAvoided++;
             }
 
-            for (auto & imageView : m_swapChainImageViews)
+            if (draw.vertexBuffer && draw.vertexBuffer != boundVertexBuffer)
+            {
+                const VkDeviceSize offset = 0;
+                vkCmdBindVertexBuffers(commandBuffer, 0, 1, &draw.vertexBuffer, &offset);
+                boundVertexBuffer = draw.vertexBuffer;
+                statistics.vertexBufferBinds++;
+            }
+            else if (draw.vertexBuffer)
             {
-                vkDestroyImageView(m_graphicDevice.logicalDevice, imageView, nullptr);
+                statistics.vertexBufferBindsAvoided++;
             }
-            m_swapChainImageViews.clear();
 
-            if (m_swapChain)
+            vkCmdDraw(commandBuffer, draw.vertexCount, draw.instanceCount, draw.firstVertex, draw.firstInstance);
+            statistics.draws++;
+        }
+    }
+
+    void VulkanRenderer::recordDrawPackets(VkCommandBuffer commandBuffer, DrawStatistics & statistics)
+    {
+        // The fallback pipeline has no vertex pulling, packets wait for the main pipeline.
+        if (!m_packetPipeline || !m_drawPackets.getInstanceCount())
+        {
+            return;
+        }
+
+        const DrawConstants constants = { VulkanDescriptorTable::InvalidIndex, m_drawPackets.getVertexBufferIndex() };
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_packetPipeline);
+        vkCmdPushConstants(commandBuffer, m_pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+                           0, sizeof(DrawConstants), &constants);
+        m_drawPackets.record(commandBuffer);
+
+        statistics.draws += m_drawPackets.getStatistics().visibleInstances;
+        statistics.pipelineBinds++;
+        statistics.constantPushes++;
+    }
+
+    void VulkanRenderer::unloadSwapChain()
+    {
+        if (m_graphicDevice.logicalDevice)
+        {
+            m_drawCommands.clear();
+
+            RetiredSwapChain retired(m_graphicDevice.logicalDevice, m_memoryAllocator);
+            retireSwapChain(retired);
+        }
+    }
+
+    void VulkanRenderer::retireSwapChain(RetiredSwapChain & retired)
+    {
+        m_imagesInFlight.clear();
+
+        retired.renderGraph = std::move(m_vulkanRenderGraph);
+        m_renderPass = 0;
+        m_subpass = 0;
+
+        retired.imageViews.swap(m_swapChainImageViews);
+
+        retired.swapChain = m_swapChain;
+        m_swapChain = 0;
+        if (!retired.swapChain)
+        {
+            retired.offscreenImages.swap(m_swapChainImages);
+            retired.offscreenMemory.swap(m_offscreenMemory);
+            m_hasRenderedImage = false;
+        }
+        m_swapChainImages.clear();
+    }
+
+    void VulkanRenderer::unloadPipelineCache()
+    {
+        if (!m_graphicDevice.logicalDevice || !m_pipelineCache)
+        {
+            return;
+        }
+
+        const std::string & filename = m_settings.getPipelineCacheFile();
+        size_t dataSize = 0;
+        if (!filename.empty() &&
+            vkGetPipelineCacheData(m_graphicDevice.logicalDevice, m_pipelineCache, &dataSize, nullptr) == VK_SUCCESS &&
+            dataSize)
+        {
+            std::vector<uint8_t> data(dataSize);
+            if (vkGetPipelineCacheData(m_graphicDevice.logicalDevice, m_pipelineCache, &dataSize, data.data()) == VK_SUCCESS)
             {
-                vkDestroySwapchainKHR(m_graphicDevice.logicalDevice, m_swapChain, nullptr);
-                m_swapChain = 0;
+                VkPhysicalDeviceProperties properties;
+                vkGetPhysicalDeviceProperties(m_graphicDevice.physicalDevice, &properties);
+
+                PipelineCacheFileHeader header;
+                header.magic = FLARE_PIPELINE_CACHE_MAGIC;
+                header.version = FLARE_PIPELINE_CACHE_VERSION;
+                header.vendorID = properties.vendorID;
+                header.deviceID = properties.deviceID;
+                header.driverVersion = properties.driverVersion;
+                std::memcpy(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE);
+                header.dataSize = dataSize;
+                header.dataHash = hashData(data.data(), dataSize);
+
+                // Write to a temporary file first, a crash while saving must not leave a broken cache behind.
+                const std::string tempFilename = filename + ".tmp";
+                std::ofstream file(tempFilename, std::ios::binary | std::ios::trunc);
+                if (file.is_open())
+                {
+                    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+                    file.write(reinterpret_cast<const char *>(data.data()), dataSize);
+                    file.close();
+
+                    if (file)
+                    {
+                        std::remove(filename.c_str());
+                        std::rename(tempFilename.c_str(), filename.c_str());
+                    }
+                    else
+                    {
+                        std::remove(tempFilename.c_str());
+                    }
+                }
             }
         }
 
+        vkDestroyPipelineCache(m_graphicDevice.logicalDevice, m_pipelineCache, nullptr);
+        m_pipelineCache = 0;
+    }
+
+    void VulkanRenderer::unloadReadback()
+    {
+        if (m_readbackFence)
+        {
+            vkDestroyFence(m_graphicDevice.logicalDevice, m_readbackFence, nullptr);
+            m_readbackFence = 0;
+        }
+        if (m_readbackCommandPool)
+        {
+            vkDestroyCommandPool(m_graphicDevice.logicalDevice, m_readbackCommandPool, nullptr);
+            m_readbackCommandPool = 0;
+        }
+        m_readbackCommandBuffer = 0;
     }
 
-    void VulkanRenderer::recreateSwapChain() {
-        /*int width = 0, height = 0;
-        while (width == 0 || height == 0) {
-            glfwGetFramebufferSize(window, &width, &height);
-            glfwWaitEvents();
-        }*/
+    void VulkanRenderer::recreateSwapChain()
+    {
+        // A minimized window has no extent, keep the current swap chain until it is restored.
+        if (!m_settings.getHeadless())
+        {
+            vkGetPhysicalDeviceSurfaceCapabilitiesKHR(m_graphicDevice.physicalDevice, m_surface, &m_graphicDevice.surfaceCapabilities);
+            const VkExtent2D & extent = m_graphicDevice.surfaceCapabilities.currentExtent;
+            if (extent.width == 0 || extent.height == 0)
+            {
+                m_swapChainOutdated = true;
+                return;
+            }
+        }
+        m_swapChainOutdated = false;
 
-        vkDeviceWaitIdle(m_graphicDevice.logicalDevice);
+        // Rebuilt render passes stay compatible with the pipeline, unless the render graph itself changed.
+        const bool graphChanged = m_multipass.getRevision() != m_multipassRevision;
 
-        unloadSwapChain();
+        // No device idle, frames in flight keep using the old resources until their fences have signaled.
+        // The old swap chain is handed to the new one, so the presentation engine can reuse its images.
+        auto retired = new RetiredSwapChain(m_graphicDevice.logicalDevice, m_memoryAllocator);
+        retireSwapChain(*retired);
+        const VkSwapchainKHR oldSwapChain = retired->swapChain;
+        m_cleaner.add(retired);
+
+        loadCreateSwapChain(oldSwapChain);
 
-        loadCreateSwapChain();
         loadCreateImageViews();
-        loadCreateRenderPass();
-        loadCreateGraphicsPipeline();
-        loadCreateFramebuffers();
-        loadCreateCommandBuffers();
+        loadCreateRenderGraph();
+        if (graphChanged)
+        {
+            loadCreateGraphicsPipeline();
+        }
     }
 
 }
@@ -1210,21 +2035,16 @@ VkResult vulkanDestroyDebugUtilsMessengerEXT(VkInstance instance, VkDebugUtilsMe
     return VK_ERROR_EXTENSION_NOT_PRESENT;
 }
 
-std::vector<char> readFile(const std::string & filename)
+uint64_t hashData(const uint8_t * data, const size_t size)
 {
-    std::ifstream file(filename, std::ios::ate | std::ios::binary);
-    if (!file.is_open())
+    // FNV-1a.
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < size; i++)
     {
-        throw std::runtime_error(("Failed to open shader: " + filename).c_str());
+        hash ^= data[i];
+        hash *= 1099511628211ULL;
     }
-
-    size_t fileSize = static_cast<size_t>(file.tellg());
-    file.seekg(0);
-
-    std::vector<char> buffer(fileSize);
-    file.read(buffer.data(), fileSize);
-
-    return buffer;
+    return hash;
 }
 
 #endif
\ No newline at end of file
@@ -27,10 +27,36 @@
 
 #if defined(FLARE_VULKAN)
 
+#include "flare/graphics/vulkan/vulkanRenderer.hpp"
+#include "flare/graphics/imageDecoder.hpp"
+#include "flare/graphics/mipmapGenerator.hpp"
+#include "flare/graphics/textureCompressor.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <cstring>
+
 namespace Flare
 {
 
-    static const size_t g_pixelFormatBytes[2] = { 3, 4 };
+    static void getCopyRegions(const std::vector<MipmapGenerator::Level> & levels, const uint32_t firstLevel,
+                               std::vector<VkBufferImageCopy> & regions)
+    {
+        regions.resize(levels.size() - firstLevel);
+        for (size_t i = 0; i < regions.size(); i++)
+        {
+            const MipmapGenerator::Level & level = levels[firstLevel + i];
+            VkBufferImageCopy & region = regions[i];
+            region.bufferOffset = level.offset - levels[firstLevel].offset;
+            region.bufferRowLength = 0;
+            region.bufferImageHeight = 0;
+            region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            region.imageSubresource.mipLevel = static_cast<uint32_t>(i);
+            region.imageSubresource.baseArrayLayer = 0;
+            region.imageSubresource.layerCount = 1;
+            region.imageOffset = { 0, 0, 0 };
+            region.imageExtent = { level.size.x, level.size.y, 1 };
+        }
+    }
 
     VulkanTexture::~VulkanTexture()
     {
@@ -43,17 +69,247 @@ namespace Flare
                              const PixelFormat & pixelFormat,
                              const bool storeBuffer)
     {
-    
+        unload();
+
+        m_size = size;
+        m_pixelFormat = pixelFormat;
+        m_storageFormat = m_renderer.getTextureFormat(m_pixelFormat);
+
+        if (m_size.x == 0 || m_size.y == 0)
+        {
+            return;
+        }
+
+        const size_t bufferSize = TextureCompressor::getBufferSize(m_size, m_pixelFormat);
+        size_t ramUsage = sizeof(VulkanTexture);
+
+        if (buffer && storeBuffer)
+        {
+            m_pBuffer = new uint8_t[bufferSize];
+            std::memcpy(m_pBuffer, buffer, bufferSize);
+            ramUsage += bufferSize;
+        }
+
+        // Empty textures are render targets or filled later, only loaded pixels get a mip chain.
+        m_mipLevels = (buffer || TextureCompressor::isCompressed(m_pixelFormat)) ? MipmapGenerator::getLevelCount(m_size) : 1;
+        m_residentLevel = 0;
+
+        // Streamed textures keep the whole chain in host memory and start with their base levels resident.
+        VulkanTextureStreamer & streamer = m_renderer.m_textureStreamer;
+        if (buffer && streamer.isEnabled())
+        {
+            m_streamChain.resize(TextureCompressor::getLevels(m_size, m_mipLevels, m_storageFormat, m_streamLevels));
+            loadWriteChain(buffer, m_streamChain.data(), m_streamLevels);
+            setRamUsage(ramUsage + m_streamChain.size());
+
+            m_residentLevel = streamer.getBaseLevel(*this);
+            loadCreateImage();
+            loadUploadChain(m_streamChain.data(), m_streamLevels);
+            streamer.add(this);
+            m_status = Status::Ready;
+            return;
+        }
+
+        setRamUsage(ramUsage);
+        loadCreateImage();
+
+        if (!buffer)
+        {
+            m_status = Status::Ready;
+            return;
+        }
+
+        // Compressed buffers stored as is already hold the whole chain.
+        std::vector<MipmapGenerator::Level> levels;
+        const size_t chainSize = TextureCompressor::getLevels(m_size, m_mipLevels, m_storageFormat, levels);
+        if (m_storageFormat == m_pixelFormat && TextureCompressor::isCompressed(m_storageFormat))
+        {
+            loadUploadChain(buffer, levels);
+            m_status = Status::Ready;
+            return;
+        }
+
+        // Other chains are expanded, filtered or decompressed to RGBA straight into staging memory.
+        VulkanUploader & uploader = m_renderer.m_uploader;
+        VulkanUploader::Allocation allocation = uploader.allocate(chainSize);
+        loadWriteChain(buffer, static_cast<uint8_t *>(allocation.pData), levels);
+
+        std::vector<VkBufferImageCopy> regions;
+        getCopyRegions(levels, 0, regions);
+        uploader.copyToImage(allocation, m_image, regions.data(), static_cast<uint32_t>(regions.size()), m_mipLevels);
+        m_status = Status::Ready;
     }
 
     void VulkanTexture::load(const std::string & filename, const bool storeBuffer)
     {
+        unload();
+
+        std::vector<uint8_t> file;
+        ImageDecoder::readFile(filename, file);
+        const ImageDecoder::Info info = ImageDecoder::readInfo(file.data(), file.size());
+
+        m_size = info.size;
+        m_pixelFormat = info.pixelFormat;
+        m_storageFormat = m_renderer.getTextureFormat(m_pixelFormat);
+
+        const size_t bufferSize = ImageDecoder::getOutputSize(info);
+        size_t ramUsage = sizeof(VulkanTexture);
+        if (storeBuffer)
+        {
+            m_pBuffer = new uint8_t[bufferSize];
+            ramUsage += bufferSize;
+        }
+
+        m_mipLevels = MipmapGenerator::getLevelCount(m_size);
+        m_residentLevel = 0;
+
+        std::vector<MipmapGenerator::Level> levels;
+        const size_t chainSize = TextureCompressor::getLevels(m_size, m_mipLevels, m_storageFormat, levels);
+        ImageDecoder decoder(m_renderer.m_pJobSystem);
+
+        // Streamed textures decode into their host chain, the remaining levels are generated in place.
+        VulkanTextureStreamer & streamer = m_renderer.m_textureStreamer;
+        if (streamer.isEnabled())
+        {
+            m_streamLevels = levels;
+            m_streamChain.resize(chainSize);
+
+            // Decoded pixels are RGBA or a compressed chain, written in place unless decompressed.
+            std::vector<uint8_t> pixels;
+            uint8_t * pDecoded = m_streamChain.data();
+            if (m_storageFormat != m_pixelFormat)
+            {
+                pDecoded = m_pBuffer;
+                if (!pDecoded)
+                {
+                    pixels.resize(bufferSize);
+                    pDecoded = pixels.data();
+                }
+            }
+            decoder.decode(file.data(), file.size(), info, pDecoded);
+            loadWriteChain(pDecoded, m_streamChain.data(), m_streamLevels);
+            if (m_pBuffer && pDecoded != m_pBuffer)
+            {
+                std::memcpy(m_pBuffer, m_streamChain.data(), bufferSize);
+            }
+            setRamUsage(ramUsage + m_streamChain.size());
+
+            m_residentLevel = streamer.getBaseLevel(*this);
+            loadCreateImage();
+            loadUploadChain(m_streamChain.data(), m_streamLevels);
+            streamer.add(this);
+            m_status = Status::Ready;
+            return;
+        }
+
+        setRamUsage(ramUsage);
+        loadCreateImage();
+
+        // Staging memory is write combined and never read back. Compressed images stored as is are decoded straight into it,
+        // unless the buffer is stored, other ones into host memory read by the mipmap generator or decompressor.
+        VulkanUploader & uploader = m_renderer.m_uploader;
+        VulkanUploader::Allocation allocation;
+        std::vector<uint8_t> pixels;
+        uint8_t * pDecoded = m_pBuffer;
+        if (!pDecoded && !TextureCompressor::isCompressed(m_storageFormat))
+        {
+            pixels.resize(bufferSize);
+            pDecoded = pixels.data();
+        }
 
+        if (pDecoded)
+        {
+            decoder.decode(file.data(), file.size(), info, pDecoded);
+            allocation = uploader.allocate(chainSize);
+            try
+            {
+                loadWriteChain(pDecoded, static_cast<uint8_t *>(allocation.pData), levels);
+            }
+            catch (...)
+            {
+                uploader.cancel(allocation);
+                throw;
+            }
+        }
+        else
+        {
+            allocation = uploader.allocate(chainSize);
+            try
+            {
+                decoder.decode(file.data(), file.size(), info, static_cast<uint8_t *>(allocation.pData));
+            }
+            catch (...)
+            {
+                uploader.cancel(allocation);
+                throw;
+            }
+        }
+
+        std::vector<VkBufferImageCopy> regions;
+        getCopyRegions(levels, 0, regions);
+        uploader.copyToImage(allocation, m_image, regions.data(), static_cast<uint32_t>(regions.size()), m_mipLevels);
+        m_status = Status::Ready;
+    }
+
+    void VulkanTexture::loadAsync(const std::string & filename, const bool storeBuffer)
+    {
+        unload();
+
+        // Run outside of the lock, a full queue executes the job right away.
+        JobSystem & jobSystem = *m_renderer.m_pJobSystem;
+        Job * job = jobSystem.createJob([this, filename, storeBuffer]()
+        {
+            loadDecodeFile(filename, storeBuffer);
+        });
+        {
+            std::lock_guard<std::mutex> lock(m_decodeMutex);
+            m_decoding = true;
+            m_status = Status::Loading;
+            m_pDecodeJob = job;
+        }
+        jobSystem.run(job);
     }
 
     void VulkanTexture::unload()
     {
+        // A decoded chain not yet uploaded is dropped. The decode job is unfinished while decoding, so it can be waited for,
+        // the job system runs other jobs meanwhile and the decode can not be stuck in this thread's own queue.
+        {
+            std::unique_lock<std::mutex> lock(m_decodeMutex);
+            if (m_decoding)
+            {
+                Job * job = m_pDecodeJob;
+                lock.unlock();
+                m_renderer.m_pJobSystem->wait(job);
+                lock.lock();
+            }
+            m_decodeCondition.wait(lock, [this]() { return !m_decoding; });
+            m_pDecodeJob = nullptr;
+
+            std::lock_guard<std::mutex> queueLock(m_renderer.m_decodedTextureMutex);
+            std::vector<VulkanTexture *> & decoded = m_renderer.m_decodedTextures;
+            decoded.erase(std::remove(decoded.begin(), decoded.end(), this), decoded.end());
+            m_decodedChain.clear();
+            m_decodedChain.shrink_to_fit();
+            m_decodedLevels.clear();
+            m_status = Status::Unloaded;
+        }
 
+        if (!m_streamLevels.empty())
+        {
+            m_renderer.m_textureStreamer.remove(this);
+        }
+        unloadImage();
+
+        m_streamChain.clear();
+        m_streamChain.shrink_to_fit();
+        m_streamLevels.clear();
+        m_residentLevel = 0;
+        m_requestedLevel = VulkanTextureStreamer::NoRequest;
+
+        delete[] m_pBuffer;
+        m_pBuffer = nullptr;
+        setRamUsage(sizeof(VulkanTexture));
     }
 
     const uint8_t * VulkanTexture::getBuffer() const
@@ -68,7 +324,7 @@ namespace Flare
             return 0;
         }
 
-        return m_size.x * m_size.y * g_pixelFormatBytes[static_cast<size_t>(m_pixelFormat)];
+        return TextureCompressor::getBufferSize(m_size, m_pixelFormat);
     }
 
     VulkanTexture::PixelFormat VulkanTexture::getPixelFormat() const
@@ -76,19 +332,373 @@ namespace Flare
         return m_pixelFormat;
     }
 
+    VulkanTexture::PixelFormat VulkanTexture::getStorageFormat() const
+    {
+        return m_storageFormat;
+    }
+
     Vector2ui32 VulkanTexture::getSize() const
     {
         return m_size;
     }
 
-    VulkanTexture::VulkanTexture(RenderMemoryAllocator & allocator) :
+    Texture::Status VulkanTexture::getStatus() const
+    {
+        return m_status;
+    }
+
+    std::string VulkanTexture::getError() const
+    {
+        std::lock_guard<std::mutex> lock(m_decodeMutex);
+        return m_error;
+    }
+
+    uint32_t VulkanTexture::getDescriptorIndex() const
+    {
+        return m_descriptorIndex;
+    }
+
+    bool VulkanTexture::isStreamed() const
+    {
+        return !m_streamLevels.empty();
+    }
+
+    uint32_t VulkanTexture::getResidentLevel() const
+    {
+        return m_residentLevel;
+    }
+
+    VulkanTexture::RetiredImage::RetiredImage(VulkanRenderer & renderer) :
+        renderer(renderer),
+        image(0),
+        memory(),
+        imageView(0),
+        descriptorIndex(VulkanDescriptorTable::InvalidIndex)
+    {
+    }
+
+    VulkanTexture::RetiredImage::~RetiredImage()
+    {
+        VkDevice logicalDevice = renderer.m_graphicDevice.logicalDevice;
+
+        if (descriptorIndex != VulkanDescriptorTable::InvalidIndex)
+        {
+            renderer.m_descriptorTable.removeTexture(descriptorIndex);
+        }
+        if (imageView)
+        {
+            vkDestroyImageView(logicalDevice, imageView, nullptr);
+        }
+        if (image)
+        {
+            vkDestroyImage(logicalDevice, image, nullptr);
+        }
+        renderer.m_memoryAllocator.free(memory);
+    }
+
+    VulkanTexture::VulkanTexture(VulkanRenderer & renderer, RenderMemoryAllocator & allocator) :
         Texture(allocator),
+        m_renderer(renderer),
         m_size(0, 0),
-        m_pBuffer(nullptr)
+        m_pixelFormat(PixelFormat::RGBA),
+        m_storageFormat(PixelFormat::RGBA),
+        m_pBuffer(nullptr),
+        m_mipLevels(1),
+        m_image(0),
+        m_memory(),
+        m_imageView(0),
+        m_descriptorIndex(VulkanDescriptorTable::InvalidIndex),
+        m_residentLevel(0),
+        m_baseLevel(0),
+        m_wantedLevel(0),
+        m_lastRequestFrame(0),
+        m_requestedLevel(VulkanTextureStreamer::NoRequest),
+        m_pReplacedImage(nullptr),
+        m_replaceFrame(0),
+        m_status(Status::Unloaded),
+        m_decoding(false),
+        m_pDecodeJob(nullptr)
     {
       setRamUsage(sizeof(VulkanTexture));
     }
 
+    VkFormat VulkanTexture::getImageFormat(const PixelFormat pixelFormat)
+    {
+        switch (pixelFormat)
+        {
+            case PixelFormat::BC1: return VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+            case PixelFormat::BC3: return VK_FORMAT_BC3_UNORM_BLOCK;
+            case PixelFormat::BC5: return VK_FORMAT_BC5_UNORM_BLOCK;
+            case PixelFormat::BC7: return VK_FORMAT_BC7_UNORM_BLOCK;
+            default: return VK_FORMAT_R8G8B8A8_UNORM;
+        }
+    }
+
+    void VulkanTexture::loadCreateImage()
+    {
+        VkDevice logicalDevice = m_renderer.m_graphicDevice.logicalDevice;
+
+        // Written on the transfer queue and sampled on the graphics queue.
+        const uint32_t queueFamilies[] = { m_renderer.m_graphicDevice.graphicsFamily.value(), m_renderer.m_uploader.getQueueFamily() };
+        const bool concurrent = queueFamilies[0] != queueFamilies[1];
+
+        // Only the levels from the first resident one are part of the image.
+        const Vector2ui32 size = { std::max<uint32_t>(m_size.x >> m_residentLevel, 1), std::max<uint32_t>(m_size.y >> m_residentLevel, 1) };
+        const uint32_t mipLevels = m_mipLevels - m_residentLevel;
+
+        VkImageCreateInfo imageInfo = {};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.extent = { size.x, size.y, 1 };
+        imageInfo.mipLevels = mipLevels;
+        imageInfo.arrayLayers = 1;
+        imageInfo.format = getImageFormat(m_storageFormat);
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.sharingMode = concurrent ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+        imageInfo.queueFamilyIndexCount = concurrent ? 2 : 0;
+        imageInfo.pQueueFamilyIndices = concurrent ? queueFamilies : nullptr;
+
+        if (vkCreateImage(logicalDevice, &imageInfo, nullptr, &m_image) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to create texture image.");
+        }
+
+        m_memory = m_renderer.m_memoryAllocator.allocate(m_image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        setVramUsage(static_cast<size_t>(m_memory.size));
+
+        VkImageViewCreateInfo viewInfo = {};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = m_image;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = getImageFormat(m_storageFormat);
+        viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        viewInfo.subresourceRange.baseMipLevel = 0;
+        viewInfo.subresourceRange.levelCount = mipLevels;
+        viewInfo.subresourceRange.baseArrayLayer = 0;
+        viewInfo.subresourceRange.layerCount = 1;
+
+        if (vkCreateImageView(logicalDevice, &viewInfo, nullptr, &m_imageView) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to create texture image view.");
+        }
+
+        // Registered once, the index stays the same until the texture is unloaded.
+        if (m_descriptorIndex == VulkanDescriptorTable::InvalidIndex)
+        {
+            m_descriptorIndex = m_renderer.m_descriptorTable.addTexture(m_imageView);
+        }
+    }
+
+    void VulkanTexture::loadWriteChain(const uint8_t * pixels, uint8_t * chain, const std::vector<MipmapGenerator::Level> & levels) const
+    {
+        // Uncompressed pixels are expanded to RGBA and filtered, pixels and chain may be the same memory.
+        if (!TextureCompressor::isCompressed(m_pixelFormat))
+        {
+            MipmapGenerator generator(m_renderer.m_pJobSystem);
+            generator.generate(pixels, m_size, m_pixelFormat, chain, levels);
+            return;
+        }
+        if (m_storageFormat == m_pixelFormat)
+        {
+            if (chain != pixels)
+            {
+                std::memcpy(chain, pixels, levels.back().offset + levels.back().byteSize);
+            }
+            return;
+        }
+
+        // Block compressed formats not supported by the device are decompressed level by level.
+        std::vector<MipmapGenerator::Level> blockLevels;
+        TextureCompressor::getLevels(m_size, m_mipLevels, m_pixelFormat, blockLevels);
+        for (size_t i = 0; i < levels.size(); i++)
+        {
+            TextureCompressor::decompress(pixels + blockLevels[i].offset, levels[i].size, m_pixelFormat, chain + levels[i].offset);
+        }
+    }
+
+    void VulkanTexture::loadUploadChain(const uint8_t * chain, const std::vector<MipmapGenerator::Level> & levels)
+    {
+        const size_t offset = levels[m_residentLevel].offset;
+        const size_t size = levels.back().offset + levels.back().byteSize - offset;
+
+        VulkanUploader & uploader = m_renderer.m_uploader;
+        VulkanUploader::Allocation allocation = uploader.allocate(size);
+        std::memcpy(allocation.pData, chain + offset, size);
+
+        std::vector<VkBufferImageCopy> regions;
+        getCopyRegions(levels, m_residentLevel, regions);
+        uploader.copyToImage(allocation, m_image, regions.data(), static_cast<uint32_t>(regions.size()), m_mipLevels - m_residentLevel);
+    }
+
+    void VulkanTexture::loadDecodeFile(const std::string & filename, const bool storeBuffer)
+    {
+        // Runs on a worker, the texture is not sampled before the render thread has uploaded the chain.
+        std::string error;
+        try
+        {
+            std::vector<uint8_t> file;
+            ImageDecoder::readFile(filename, file);
+            const ImageDecoder::Info info = ImageDecoder::readInfo(file.data(), file.size());
+
+            m_size = info.size;
+            m_pixelFormat = info.pixelFormat;
+            m_storageFormat = m_renderer.getTextureFormat(m_pixelFormat);
+            m_mipLevels = MipmapGenerator::getLevelCount(m_size);
+
+            std::vector<uint8_t> pixels(ImageDecoder::getOutputSize(info));
+            ImageDecoder decoder(m_renderer.m_pJobSystem);
+            decoder.decode(file.data(), file.size(), info, pixels.data());
+            if (storeBuffer)
+            {
+                m_pBuffer = new uint8_t[pixels.size()];
+                std::memcpy(m_pBuffer, pixels.data(), pixels.size());
+            }
+
+            // Compressed chains stored as is are used right away, other ones are filtered or decompressed here.
+            const size_t chainSize = TextureCompressor::getLevels(m_size, m_mipLevels, m_storageFormat, m_decodedLevels);
+            if (m_storageFormat == m_pixelFormat && TextureCompressor::isCompressed(m_storageFormat))
+            {
+                m_decodedChain.swap(pixels);
+            }
+            else
+            {
+                m_decodedChain.resize(chainSize);
+                loadWriteChain(pixels.data(), m_decodedChain.data(), m_decodedLevels);
+            }
+        }
+        catch (const std::exception & e)
+        {
+            error = e.what();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_decodeMutex);
+            m_decoding = false;
+            if (error.size())
+            {
+                m_error = error;
+                m_decodedChain.clear();
+                m_decodedLevels.clear();
+                m_status = Status::Failed;
+            }
+            else
+            {
+                std::lock_guard<std::mutex> queueLock(m_renderer.m_decodedTextureMutex);
+                m_renderer.m_decodedTextures.push_back(this);
+            }
+        }
+        m_decodeCondition.notify_all();
+    }
+
+    void VulkanTexture::loadDecodedChain()
+    {
+        // Render thread, the image is created and the host chain copied to staging memory.
+        std::lock_guard<std::mutex> lock(m_decodeMutex);
+        if (m_decoding || m_status != Status::Loading || m_decodedLevels.empty())
+        {
+            return;
+        }
+
+        try
+        {
+            const size_t ramUsage = sizeof(VulkanTexture) + getBufferSize();
+            m_residentLevel = 0;
+
+            VulkanTextureStreamer & streamer = m_renderer.m_textureStreamer;
+            if (streamer.isEnabled())
+            {
+                m_streamLevels.swap(m_decodedLevels);
+                m_streamChain.swap(m_decodedChain);
+                setRamUsage(ramUsage + m_streamChain.size());
+
+                m_residentLevel = streamer.getBaseLevel(*this);
+                loadCreateImage();
+                loadUploadChain(m_streamChain.data(), m_streamLevels);
+                streamer.add(this);
+            }
+            else
+            {
+                setRamUsage(ramUsage);
+                loadCreateImage();
+                loadUploadChain(m_decodedChain.data(), m_decodedLevels);
+            }
+            m_status = Status::Ready;
+        }
+        catch (const std::exception & e)
+        {
+            m_error = e.what();
+            m_status = Status::Failed;
+        }
+
+        m_decodedChain.clear();
+        m_decodedChain.shrink_to_fit();
+        m_decodedLevels.clear();
+    }
+
+    void VulkanTexture::loadResidentLevel(const uint32_t level, const uint64_t replaceFrame)
+    {
+        // The descriptor keeps sampling the replaced image until the new levels are uploaded, see loadReplacedImage().
+        // An image replaced before that was never sampled and is retired right away.
+        RetiredImage * replaced = new RetiredImage(m_renderer);
+        replaced->image = m_image;
+        replaced->memory = m_memory;
+        replaced->imageView = m_imageView;
+        if (m_pReplacedImage || m_descriptorIndex == VulkanDescriptorTable::InvalidIndex)
+        {
+            m_renderer.m_cleaner.add(replaced);
+        }
+        else
+        {
+            m_pReplacedImage = replaced;
+        }
+
+        m_image = 0;
+        m_memory = VulkanMemoryAllocator::Allocation();
+        m_imageView = 0;
+
+        m_residentLevel = level;
+        m_replaceFrame = replaceFrame;
+        loadCreateImage();
+        loadUploadChain(m_streamChain.data(), m_streamLevels);
+    }
+
+    void VulkanTexture::loadReplacedImage()
+    {
+        // Frames in flight may still sample the replaced image, it is retired instead of destroyed.
+        m_renderer.m_descriptorTable.updateTexture(m_descriptorIndex, m_imageView);
+        m_renderer.m_cleaner.add(m_pReplacedImage);
+        m_pReplacedImage = nullptr;
+    }
+
+    void VulkanTexture::unloadImage()
+    {
+        // Frames in flight may still sample the image through its descriptor, so it is retired instead of destroyed.
+        if (m_image || m_imageView || m_descriptorIndex != VulkanDescriptorTable::InvalidIndex)
+        {
+            RetiredImage * retired = new RetiredImage(m_renderer);
+            retired->image = m_image;
+            retired->memory = m_memory;
+            retired->imageView = m_imageView;
+            retired->descriptorIndex = m_descriptorIndex;
+            m_renderer.m_cleaner.add(retired);
+        }
+
+        m_image = 0;
+        m_memory = VulkanMemoryAllocator::Allocation();
+        m_imageView = 0;
+        m_descriptorIndex = VulkanDescriptorTable::InvalidIndex;
+        setVramUsage(0);
+
+        if (m_pReplacedImage)
+        {
+            m_renderer.m_cleaner.add(m_pReplacedImage);
+            m_pReplacedImage = nullptr;
+        }
+    }
+
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,285 @@
+/*
+* MIT License
+*
+* Copyright(c) 2018 Jimmie Bergmann
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*/
+
+#include "flare/graphics/vulkan/vulkanTextureStreamer.hpp"
+
+#if defined(FLARE_VULKAN)
+
+#include "flare/graphics/vulkan/vulkanTexture.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace Flare
+{
+
+    VulkanTextureStreamer::VulkanTextureStreamer() :
+        m_budget(0),
+        m_baseSize(0),
+        m_uploadLimit(0),
+        m_idleFrames(0),
+        m_framesInFlight(0),
+        m_frame(0),
+        m_statistics{}
+    {
+    }
+
+    VulkanTextureStreamer::~VulkanTextureStreamer()
+    {
+        unload();
+    }
+
+    void VulkanTextureStreamer::load(const uint32_t baseSize, const size_t uploadLimit, const uint64_t idleFrames, const uint64_t framesInFlight)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_baseSize = std::max<uint32_t>(baseSize, 1);
+        m_uploadLimit = uploadLimit;
+        m_idleFrames = idleFrames;
+        m_framesInFlight = framesInFlight;
+        m_frame = 0;
+    }
+
+    void VulkanTextureStreamer::unload()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_textures.clear();
+        m_order.clear();
+        m_statistics = Statistics();
+    }
+
+    void VulkanTextureStreamer::setBudget(const size_t bytes)
+    {
+        m_budget = bytes;
+    }
+
+    size_t VulkanTextureStreamer::getBudget() const
+    {
+        return m_budget;
+    }
+
+    bool VulkanTextureStreamer::isEnabled() const
+    {
+        return m_budget > 0;
+    }
+
+    void VulkanTextureStreamer::requestFootprint(VulkanTexture & texture, const float screenSize)
+    {
+        if (texture.m_streamLevels.empty())
+        {
+            return;
+        }
+
+        // The finest level with at least one texel per pixel.
+        const uint32_t lastLevel = static_cast<uint32_t>(texture.m_streamLevels.size()) - 1;
+        const float ratio = static_cast<float>(std::max(texture.m_size.x, texture.m_size.y)) / std::max(screenSize, 1.0f);
+        const uint32_t level = ratio > 1.0f ? std::min(static_cast<uint32_t>(std::log2(ratio)), lastLevel) : 0;
+
+        uint32_t current = texture.m_requestedLevel.load(std::memory_order_relaxed);
+        while (level < current && !texture.m_requestedLevel.compare_exchange_weak(current, level, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    float VulkanTextureStreamer::getScreenSize(const float radius, const float distance, const float verticalFov, const uint32_t viewportHeight)
+    {
+        if (distance <= radius)
+        {
+            return std::numeric_limits<float>::max();
+        }
+        return radius / (distance * std::tan(verticalFov * 0.5f)) * static_cast<float>(viewportHeight);
+    }
+
+    void VulkanTextureStreamer::update()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        m_frame++;
+        m_statistics = Statistics();
+        m_statistics.textures = m_textures.size();
+
+        // The frames uploading new levels have finished, descriptors are pointed at the new images.
+        for (auto texture : m_textures)
+        {
+            if (texture->m_pReplacedImage && m_frame >= texture->m_replaceFrame)
+            {
+                texture->loadReplacedImage();
+            }
+        }
+
+        if (!isEnabled())
+        {
+            return;
+        }
+
+        // Requests of this frame become the wanted levels, textures idle for too long fall back to their base levels.
+        size_t wantedBytes = 0;
+        for (auto texture : m_textures)
+        {
+            const uint32_t requested = texture->m_requestedLevel.exchange(NoRequest, std::memory_order_relaxed);
+            if (requested != NoRequest)
+            {
+                texture->m_lastRequestFrame = m_frame;
+                texture->m_wantedLevel = std::min(requested, texture->m_baseLevel);
+            }
+            else if (m_frame - texture->m_lastRequestFrame > m_idleFrames)
+            {
+                texture->m_wantedLevel = texture->m_baseLevel;
+            }
+            wantedBytes += getResidentSize(*texture, texture->m_wantedLevel);
+        }
+
+        // Over budget, drop one level at a time from the least recently used textures, finest levels first.
+        if (wantedBytes > m_budget)
+        {
+            m_order = m_textures;
+            std::sort(m_order.begin(), m_order.end(), [](const VulkanTexture * a, const VulkanTexture * b)
+            {
+                if (a->m_lastRequestFrame != b->m_lastRequestFrame)
+                {
+                    return a->m_lastRequestFrame < b->m_lastRequestFrame;
+                }
+                return a->m_wantedLevel < b->m_wantedLevel;
+            });
+
+            bool dropped = true;
+            while (wantedBytes > m_budget && dropped)
+            {
+                dropped = false;
+                for (auto texture : m_order)
+                {
+                    if (wantedBytes <= m_budget)
+                    {
+                        break;
+                    }
+                    if (texture->m_wantedLevel < texture->m_baseLevel)
+                    {
+                        wantedBytes -= texture->m_streamLevels[texture->m_wantedLevel].byteSize;
+                        texture->m_wantedLevel++;
+                        dropped = true;
+                    }
+                }
+            }
+        }
+        m_statistics.wantedBytes = wantedBytes;
+
+        // Evictions free memory and are never deferred, the remaining levels are uploaded again.
+        for (auto texture : m_textures)
+        {
+            if (texture->m_wantedLevel > texture->m_residentLevel)
+            {
+                m_statistics.evictedLevels += texture->m_wantedLevel - texture->m_residentLevel;
+                m_statistics.uploadedBytes += getResidentSize(*texture, texture->m_wantedLevel);
+                texture->loadResidentLevel(texture->m_wantedLevel, m_frame + m_framesInFlight);
+            }
+        }
+
+        // Loads of the most recently used textures first, furthest from their wanted level first.
+        m_order.clear();
+        for (auto texture : m_textures)
+        {
+            if (texture->m_wantedLevel < texture->m_residentLevel)
+            {
+                m_order.push_back(texture);
+            }
+        }
+        std::sort(m_order.begin(), m_order.end(), [](const VulkanTexture * a, const VulkanTexture * b)
+        {
+            if (a->m_lastRequestFrame != b->m_lastRequestFrame)
+            {
+                return a->m_lastRequestFrame > b->m_lastRequestFrame;
+            }
+            return (a->m_residentLevel - a->m_wantedLevel) > (b->m_residentLevel - b->m_wantedLevel);
+        });
+
+        // At least one load per frame, even if larger than the limit.
+        size_t loadedBytes = 0;
+        for (auto texture : m_order)
+        {
+            const size_t size = getResidentSize(*texture, texture->m_wantedLevel);
+            if (loadedBytes > 0 && loadedBytes + size > m_uploadLimit)
+            {
+                continue;
+            }
+            m_statistics.loadedLevels += texture->m_residentLevel - texture->m_wantedLevel;
+            loadedBytes += size;
+            texture->loadResidentLevel(texture->m_wantedLevel, m_frame + m_framesInFlight);
+        }
+        m_statistics.uploadedBytes += loadedBytes;
+
+        for (auto texture : m_textures)
+        {
+            m_statistics.residentBytes += getResidentSize(*texture, texture->m_residentLevel);
+        }
+    }
+
+    const VulkanTextureStreamer::Statistics & VulkanTextureStreamer::getStatistics() const
+    {
+        return m_statistics;
+    }
+
+    uint32_t VulkanTextureStreamer::getBaseLevel(const VulkanTexture & texture) const
+    {
+        const uint32_t lastLevel = static_cast<uint32_t>(texture.m_streamLevels.size()) - 1;
+        uint32_t level = 0;
+        while (level < lastLevel && std::max(texture.m_streamLevels[level].size.x, texture.m_streamLevels[level].size.y) > m_baseSize)
+        {
+            level++;
+        }
+        return level;
+    }
+
+    size_t VulkanTextureStreamer::getResidentSize(const VulkanTexture & texture, const uint32_t firstLevel)
+    {
+        size_t size = 0;
+        for (size_t i = firstLevel; i < texture.m_streamLevels.size(); i++)
+        {
+            size += texture.m_streamLevels[i].byteSize;
+        }
+        return size;
+    }
+
+    void VulkanTextureStreamer::add(VulkanTexture * texture)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        texture->m_baseLevel = getBaseLevel(*texture);
+        texture->m_wantedLevel = texture->m_residentLevel;
+        texture->m_lastRequestFrame = m_frame;
+        m_textures.push_back(texture);
+    }
+
+    void VulkanTextureStreamer::remove(VulkanTexture * texture)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = std::find(m_textures.begin(), m_textures.end(), texture);
+        if (it != m_textures.end())
+        {
+            *it = m_textures.back();
+            m_textures.pop_back();
+        }
+    }
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,473 @@
+/*
+* MIT License
+*
+* Copyright(c) 2018 Jimmie Bergmann
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*/
+
+#include "flare/graphics/vulkan/vulkanUploader.hpp"
+
+#if defined(FLARE_VULKAN)
+
+#include "flare/graphics/vulkan/vulkanRenderer.hpp"
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <cstring>
+
+namespace Flare
+{
+
+    static const size_t g_noBatch = std::numeric_limits<size_t>::max();
+    static const VkDeviceSize g_minAlignment = 16;
+
+    VulkanUploader::VulkanUploader() :
+        m_logicalDevice(0),
+        m_queueFamily(0),
+        m_queue(0),
+        m_pQueueMutex(nullptr),
+        m_buffer(0),
+        m_memory(0),
+        m_pData(nullptr),
+        m_size(0),
+        m_head(0),
+        m_tail(0),
+        m_currentBatch(g_noBatch)
+    {
+    }
+
+    VulkanUploader::~VulkanUploader()
+    {
+        unload();
+    }
+
+    void VulkanUploader::load(VkPhysicalDevice physicalDevice, VkDevice logicalDevice, const uint32_t queueFamily, VkQueue queue,
+                              std::mutex & queueMutex, const VkDeviceSize size)
+    {
+        unload();
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        m_logicalDevice = logicalDevice;
+        m_queueFamily = queueFamily;
+        m_queue = queue;
+        m_pQueueMutex = &queueMutex;
+        m_size = size;
+        m_head = 0;
+        m_tail = 0;
+
+        // Create staging buffer.
+        VkBufferCreateInfo bufferInfo = {};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size = size;
+        bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        if (vkCreateBuffer(m_logicalDevice, &bufferInfo, nullptr, &m_buffer) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to create staging buffer.");
+        }
+
+        VkMemoryRequirements memoryRequirements;
+        vkGetBufferMemoryRequirements(m_logicalDevice, m_buffer, &memoryRequirements);
+
+        VkMemoryAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = memoryRequirements.size;
+        allocInfo.memoryTypeIndex = VulkanRenderer::findMemoryType(physicalDevice, memoryRequirements.memoryTypeBits,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+        if (vkAllocateMemory(m_logicalDevice, &allocInfo, nullptr, &m_memory) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to allocate staging buffer memory.");
+        }
+
+        vkBindBufferMemory(m_logicalDevice, m_buffer, m_memory, 0);
+
+        void * pData = nullptr;
+        if (vkMapMemory(m_logicalDevice, m_memory, 0, size, 0, &pData) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to map staging buffer memory.");
+        }
+        m_pData = static_cast<uint8_t *>(pData);
+    }
+
+    void VulkanUploader::unload()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if (!m_logicalDevice)
+        {
+            return;
+        }
+
+        // Unsubmitted copies are dropped with their command pool.
+        while (m_submittedBatches.size())
+        {
+            reclaimBatches(true);
+        }
+
+        for (auto & batch : m_batches)
+        {
+            vkDestroyFence(m_logicalDevice, batch.fence, nullptr);
+            vkDestroyCommandPool(m_logicalDevice, batch.commandPool, nullptr);
+        }
+        m_batches.clear();
+        m_freeBatches.clear();
+        m_currentBatch = g_noBatch;
+
+        for (auto semaphore : m_semaphores)
+        {
+            vkDestroySemaphore(m_logicalDevice, semaphore, nullptr);
+        }
+        m_semaphores.clear();
+        m_freeSemaphores.clear();
+        m_signaledSemaphores.clear();
+        m_openAllocations.clear();
+
+        if (m_memory)
+        {
+            if (m_pData)
+            {
+                vkUnmapMemory(m_logicalDevice, m_memory);
+                m_pData = nullptr;
+            }
+            vkFreeMemory(m_logicalDevice, m_memory, nullptr);
+            m_memory = 0;
+        }
+        if (m_buffer)
+        {
+            vkDestroyBuffer(m_logicalDevice, m_buffer, nullptr);
+            m_buffer = 0;
+        }
+
+        m_size = 0;
+        m_pQueueMutex = nullptr;
+        m_logicalDevice = 0;
+    }
+
+    VulkanUploader::Allocation VulkanUploader::allocate(const VkDeviceSize size, const VkDeviceSize alignment)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if (!m_logicalDevice)
+        {
+            throw std::runtime_error("Uploader has not been loaded.");
+        }
+        if (size > m_size)
+        {
+            throw std::runtime_error("Upload is larger than the staging buffer.");
+        }
+
+        const VkDeviceSize align = std::max(alignment, g_minAlignment);
+        while (true)
+        {
+            uint64_t position = (m_head + align - 1) & ~(align - 1);
+
+            // Allocations are contiguous, skip the end of the buffer instead of wrapping around.
+            const VkDeviceSize offset = position % m_size;
+            if (offset + size > m_size)
+            {
+                position += m_size - offset;
+            }
+
+            if (position + size - m_tail <= m_size)
+            {
+                m_head = position + size;
+                m_openAllocations.insert(position);
+
+                Allocation allocation;
+                allocation.offset = position % m_size;
+                allocation.pData = m_pData + allocation.offset;
+                allocation.size = size;
+                allocation.position = position;
+                return allocation;
+            }
+
+            // Out of staging memory, wait for the oldest submission or flush the current batch.
+            if (m_submittedBatches.size())
+            {
+                reclaimBatches(true);
+            }
+            else if (m_currentBatch != g_noBatch)
+            {
+                submitBatch();
+            }
+            else
+            {
+                throw std::runtime_error("Staging buffer is full of unfinished uploads.");
+            }
+        }
+    }
+
+    void VulkanUploader::cancel(const Allocation & allocation)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        // Reclaimed with the memory of the next batch.
+        m_openAllocations.erase(m_openAllocations.find(allocation.position));
+    }
+
+    void VulkanUploader::copyToBuffer(const Allocation & allocation, VkBuffer buffer, const VkDeviceSize bufferOffset)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        VkCommandBuffer commandBuffer = getCommandBuffer();
+
+        VkBufferCopy region = {};
+        region.srcOffset = allocation.offset;
+        region.dstOffset = bufferOffset;
+        region.size = allocation.size;
+        vkCmdCopyBuffer(commandBuffer, m_buffer, buffer, 1, &region);
+
+        m_openAllocations.erase(m_openAllocations.find(allocation.position));
+    }
+
+    void VulkanUploader::copyToImage(const Allocation & allocation, VkImage image, const VkBufferImageCopy * regions, const uint32_t regionCount, const uint32_t mipLevels)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        VkCommandBuffer commandBuffer = getCommandBuffer();
+
+        // Previous content is discarded.
+        VkImageMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = image;
+        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        barrier.subresourceRange.baseMipLevel = 0;
+        barrier.subresourceRange.levelCount = mipLevels;
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount = 1;
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                             0, nullptr, 0, nullptr, 1, &barrier);
+
+        std::vector<VkBufferImageCopy> copies(regions, regions + regionCount);
+        for (auto & copy : copies)
+        {
+            copy.bufferOffset += allocation.offset;
+        }
+        vkCmdCopyBufferToImage(commandBuffer, m_buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                               static_cast<uint32_t>(copies.size()), copies.data());
+
+        // The graphics queue waits on the batch semaphore, no further access mask is needed.
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = 0;
+
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+                             0, nullptr, 0, nullptr, 1, &barrier);
+
+        m_openAllocations.erase(m_openAllocations.find(allocation.position));
+    }
+
+    void VulkanUploader::uploadBuffer(VkBuffer buffer, const VkDeviceSize bufferOffset, const void * data, const VkDeviceSize size)
+    {
+        Allocation allocation = allocate(size);
+        std::memcpy(allocation.pData, data, static_cast<size_t>(size));
+        copyToBuffer(allocation, buffer, bufferOffset);
+    }
+
+    void VulkanUploader::submit(std::vector<VkSemaphore> & signalSemaphores)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        reclaimBatches(false);
+        if (m_currentBatch != g_noBatch)
+        {
+            submitBatch();
+        }
+
+        signalSemaphores.insert(signalSemaphores.end(), m_signaledSemaphores.begin(), m_signaledSemaphores.end());
+        m_signaledSemaphores.clear();
+    }
+
+    void VulkanUploader::releaseSemaphores(std::vector<VkSemaphore> & semaphores)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        m_freeSemaphores.insert(m_freeSemaphores.end(), semaphores.begin(), semaphores.end());
+        semaphores.clear();
+    }
+
+    uint32_t VulkanUploader::getQueueFamily() const
+    {
+        return m_queueFamily;
+    }
+
+    VkCommandBuffer VulkanUploader::getCommandBuffer()
+    {
+        if (m_currentBatch != g_noBatch)
+        {
+            return m_batches[m_currentBatch].commandBuffer;
+        }
+
+        reclaimBatches(false);
+
+        if (m_freeBatches.size())
+        {
+            m_currentBatch = m_freeBatches.back();
+            m_freeBatches.pop_back();
+
+            Batch & batch = m_batches[m_currentBatch];
+            vkResetFences(m_logicalDevice, 1, &batch.fence);
+            vkResetCommandPool(m_logicalDevice, batch.commandPool, 0);
+        }
+        else
+        {
+            Batch batch = {};
+
+            VkCommandPoolCreateInfo poolInfo = {};
+            poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+            poolInfo.queueFamilyIndex = m_queueFamily;
+            poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+            if (vkCreateCommandPool(m_logicalDevice, &poolInfo, nullptr, &batch.commandPool) != VK_SUCCESS)
+            {
+                throw std::runtime_error("Failed to create upload command pool.");
+            }
+
+            VkCommandBufferAllocateInfo allocInfo = {};
+            allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            allocInfo.commandPool = batch.commandPool;
+            allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+            allocInfo.commandBufferCount = 1;
+
+            VkFenceCreateInfo fenceInfo = {};
+            fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+            if (vkAllocateCommandBuffers(m_logicalDevice, &allocInfo, &batch.commandBuffer) != VK_SUCCESS ||
+                vkCreateFence(m_logicalDevice, &fenceInfo, nullptr, &batch.fence) != VK_SUCCESS)
+            {
+                vkDestroyCommandPool(m_logicalDevice, batch.commandPool, nullptr);
+                throw std::runtime_error("Failed to create upload batch.");
+            }
+
+            m_currentBatch = m_batches.size();
+            m_batches.push_back(batch);
+        }
+
+        VkCommandBufferBeginInfo beginInfo = {};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+        VkCommandBuffer commandBuffer = m_batches[m_currentBatch].commandBuffer;
+        if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to begin recording of upload command buffer.");
+        }
+
+        return commandBuffer;
+    }
+
+    void VulkanUploader::submitBatch()
+    {
+        Batch & batch = m_batches[m_currentBatch];
+        if (vkEndCommandBuffer(batch.commandBuffer) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to record upload command buffer.");
+        }
+
+        VkSemaphore semaphore = getSemaphore();
+
+        VkSubmitInfo submitInfo = {};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &batch.commandBuffer;
+        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.pSignalSemaphores = &semaphore;
+
+        {
+            std::lock_guard<std::mutex> queueLock(*m_pQueueMutex);
+            if (vkQueueSubmit(m_queue, 1, &submitInfo, batch.fence) != VK_SUCCESS)
+            {
+                throw std::runtime_error("Failed to submit upload command buffer.");
+            }
+        }
+
+        batch.end = m_head;
+        m_submittedBatches.push_back(m_currentBatch);
+        m_signaledSemaphores.push_back(semaphore);
+        m_currentBatch = g_noBatch;
+    }
+
+    void VulkanUploader::reclaimBatches(const bool wait)
+    {
+        // Submissions finish in order, only the oldest one is ever waited for.
+        bool waitForBatch = wait;
+        while (m_submittedBatches.size())
+        {
+            const size_t index = m_submittedBatches.front();
+            Batch & batch = m_batches[index];
+
+            if (waitForBatch)
+            {
+                vkWaitForFences(m_logicalDevice, 1, &batch.fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+                waitForBatch = false;
+            }
+            else if (vkGetFenceStatus(m_logicalDevice, batch.fence) != VK_SUCCESS)
+            {
+                break;
+            }
+
+            m_tail = batch.end;
+            m_freeBatches.push_back(index);
+            m_submittedBatches.pop_front();
+        }
+
+        // Memory handed out but not yet copied from must stay untouched.
+        if (m_openAllocations.size())
+        {
+            m_tail = std::min<uint64_t>(m_tail, *m_openAllocations.begin());
+        }
+    }
+
+    VkSemaphore VulkanUploader::getSemaphore()
+    {
+        if (m_freeSemaphores.size())
+        {
+            VkSemaphore semaphore = m_freeSemaphores.back();
+            m_freeSemaphores.pop_back();
+            return semaphore;
+        }
+
+        VkSemaphoreCreateInfo semaphoreInfo = {};
+        semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+        VkSemaphore semaphore;
+        if (vkCreateSemaphore(m_logicalDevice, &semaphoreInfo, nullptr, &semaphore) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to create upload semaphore.");
+        }
+        m_semaphores.push_back(semaphore);
+        return semaphore;
+    }
+
+}
+
+#endif
@@ -0,0 +1,223 @@
+/*
+* MIT License
+*
+* Copyright(c) 2018 Jimmie Bergmann
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*/
+
+#include "flare/system/framePacer.hpp"
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+#if defined(FLARE_PLATFORM_WINDOWS) && !defined(CREATE_WAITABLE_TIMER_HIGH_RESOLUTION)
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+namespace Flare
+{
+
+    // Spun at least this long before every deadline, covers the wake-up latency of the scheduler.
+    static const std::chrono::microseconds g_minSpinDuration(200);
+
+    FramePacer::FramePacer() :
+        m_targetFrameRate(0.0f),
+        m_interval(0),
+        m_started(false),
+        m_sleepError(0),
+        m_frameCount(0),
+        m_lastFrameTime(0.0),
+        m_frameTimeSum(0.0),
+        m_frameTimeSquareSum(0.0),
+        m_minFrameTime(0.0),
+        m_maxFrameTime(0.0),
+        m_histogram(HistogramBucketCount, 0)
+    {
+    #if defined(FLARE_PLATFORM_WINDOWS)
+        // High resolution timers are not limited to the system timer resolution, available since Windows 10 1803.
+        m_timer = CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+        if (!m_timer)
+        {
+            m_timer = CreateWaitableTimerExW(NULL, NULL, 0, TIMER_ALL_ACCESS);
+        }
+    #endif
+    }
+
+    FramePacer::~FramePacer()
+    {
+    #if defined(FLARE_PLATFORM_WINDOWS)
+        if (m_timer)
+        {
+            CloseHandle(m_timer);
+        }
+    #endif
+    }
+
+    void FramePacer::setTargetFrameRate(const float fps)
+    {
+        m_targetFrameRate = fps > 0.0f ? fps : 0.0f;
+        m_interval = m_targetFrameRate > 0.0f ?
+            std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / m_targetFrameRate)) : Clock::duration(0);
+        m_started = false;
+    }
+
+    float FramePacer::getTargetFrameRate() const
+    {
+        return m_targetFrameRate;
+    }
+
+    void FramePacer::wait()
+    {
+        if (m_interval.count() <= 0)
+        {
+            record(Clock::now());
+            return;
+        }
+
+        const Clock::time_point now = Clock::now();
+        if (!m_started || now - m_deadline > m_interval)
+        {
+            m_deadline = now;
+            m_started = true;
+        }
+
+        waitUntil(m_deadline);
+        record(Clock::now());
+        m_deadline += m_interval;
+    }
+
+    void FramePacer::reset()
+    {
+        m_started = false;
+        m_frameCount = 0;
+        m_lastFrameTime = 0.0;
+        m_frameTimeSum = 0.0;
+        m_frameTimeSquareSum = 0.0;
+        m_minFrameTime = 0.0;
+        m_maxFrameTime = 0.0;
+        std::fill(m_histogram.begin(), m_histogram.end(), 0);
+    }
+
+    double FramePacer::getLastFrameTime() const
+    {
+        return m_lastFrameTime;
+    }
+
+    double FramePacer::getPercentile(const double percentile) const
+    {
+        if (m_frameCount < 2)
+        {
+            return m_lastFrameTime;
+        }
+
+        // Upper edge of the bucket holding the percentile, intervals are one less than the recorded frames.
+        const double target = std::min(std::max(percentile, 0.0), 1.0) * static_cast<double>(m_frameCount - 1);
+        uint64_t count = 0;
+        for (size_t i = 0; i < m_histogram.size(); i++)
+        {
+            count += m_histogram[i];
+            if (static_cast<double>(count) >= target)
+            {
+                return std::min(static_cast<double>(i + 1) * HistogramBucketWidth, m_maxFrameTime);
+            }
+        }
+        return m_maxFrameTime;
+    }
+
+    FramePacer::Statistics FramePacer::getStatistics() const
+    {
+        Statistics statistics;
+        statistics.frameCount = m_frameCount;
+        statistics.averageFrameTime = 0.0;
+        statistics.minFrameTime = m_minFrameTime;
+        statistics.maxFrameTime = m_maxFrameTime;
+        statistics.standardDeviation = 0.0;
+        statistics.histogram = m_histogram;
+
+        if (m_frameCount > 1)
+        {
+            const double intervals = static_cast<double>(m_frameCount - 1);
+            statistics.averageFrameTime = m_frameTimeSum / intervals;
+            const double variance = m_frameTimeSquareSum / intervals - statistics.averageFrameTime * statistics.averageFrameTime;
+            statistics.standardDeviation = std::sqrt(std::max(variance, 0.0));
+        }
+        return statistics;
+    }
+
+    void FramePacer::waitUntil(const Clock::time_point & deadline)
+    {
+        // Sleep all but the final stretch, the oversleep estimate decays slowly so a single late wake-up
+        // does not keep the pacer spinning for long.
+        const Clock::duration margin = std::max<Clock::duration>(m_sleepError, g_minSpinDuration);
+        const Clock::time_point sleepStart = Clock::now();
+        if (deadline - sleepStart > margin)
+        {
+            const Clock::duration requested = deadline - sleepStart - margin;
+            sleep(requested);
+            const Clock::duration error = Clock::now() - sleepStart - requested;
+            m_sleepError = std::max(error, m_sleepError - m_sleepError / 16);
+        }
+
+        while (Clock::now() < deadline)
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    void FramePacer::sleep(const Clock::duration & duration)
+    {
+    #if defined(FLARE_PLATFORM_WINDOWS)
+        if (m_timer)
+        {
+            // Relative due time in 100 nanosecond units.
+            LARGE_INTEGER dueTime;
+            dueTime.QuadPart = -static_cast<LONGLONG>(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count() / 100);
+            if (SetWaitableTimer(m_timer, &dueTime, 0, NULL, NULL, FALSE))
+            {
+                WaitForSingleObject(m_timer, INFINITE);
+                return;
+            }
+        }
+    #endif
+        std::this_thread::sleep_for(duration);
+    }
+
+    void FramePacer::record(const Clock::time_point & time)
+    {
+        if (m_frameCount++ == 0)
+        {
+            m_lastFrame = time;
+            return;
+        }
+
+        const double frameTime = std::chrono::duration<double, std::milli>(time - m_lastFrame).count();
+        m_lastFrame = time;
+        m_lastFrameTime = frameTime;
+        m_frameTimeSum += frameTime;
+        m_frameTimeSquareSum += frameTime * frameTime;
+        m_minFrameTime = m_frameCount == 2 ? frameTime : std::min(m_minFrameTime, frameTime);
+        m_maxFrameTime = std::max(m_maxFrameTime, frameTime);
+
+        const size_t bucket = static_cast<size_t>(frameTime / HistogramBucketWidth);
+        m_histogram[std::min(bucket, HistogramBucketCount - 1)]++;
+    }
+
+}
@@ -0,0 +1,440 @@
+/*
+* MIT License
+*
+* Copyright(c) 2018 Jimmie Bergmann
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*/
+
+#include "flare/system/jobSystem.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+static_assert((FLARE_JOB_SYSTEM_MAX_JOBS & (FLARE_JOB_SYSTEM_MAX_JOBS - 1)) == 0,
+              "FLARE_JOB_SYSTEM_MAX_JOBS must be a power of two.");
+
+namespace Flare
+{
+
+    static thread_local JobSystem * t_pJobSystem = nullptr;
+    static thread_local size_t t_workerIndex = 0;
+
+    static const size_t g_idleSpinCount = 64;
+
+    static std::mutex g_exceptionMutex;
+
+    // Job.
+    Job::Job() :
+        m_pFunction(nullptr),
+        m_pParent(nullptr),
+        m_unfinishedJobs(0),
+        m_exception(nullptr)
+    { }
+
+    bool Job::isFinished() const
+    {
+        return m_unfinishedJobs.load(std::memory_order_acquire) == 0;
+    }
+
+
+    // Job deque, Chase-Lev work-stealing deque with a fixed capacity.
+    JobSystem::JobDeque::JobDeque() :
+        m_top(0),
+        m_bottom(0)
+    {
+        for (auto & job : m_jobs)
+        {
+            job.store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    bool JobSystem::JobDeque::push(Job * job)
+    {
+        const int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+        const int64_t top = m_top.load(std::memory_order_acquire);
+        if (bottom - top >= FLARE_JOB_SYSTEM_MAX_JOBS)
+        {
+            return false;
+        }
+
+        m_jobs[bottom & (FLARE_JOB_SYSTEM_MAX_JOBS - 1)].store(job, std::memory_order_relaxed);
+        m_bottom.store(bottom + 1, std::memory_order_release);
+        return true;
+    }
+
+    Job * JobSystem::JobDeque::pop()
+    {
+        const int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+        m_bottom.store(bottom, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t top = m_top.load(std::memory_order_relaxed);
+
+        if (top > bottom)
+        {
+            // Empty.
+            m_bottom.store(bottom + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        Job * job = m_jobs[bottom & (FLARE_JOB_SYSTEM_MAX_JOBS - 1)].load(std::memory_order_relaxed);
+        if (top == bottom)
+        {
+            // Last job, race against thieves.
+            if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            {
+                job = nullptr;
+            }
+            m_bottom.store(bottom + 1, std::memory_order_relaxed);
+        }
+
+        return job;
+    }
+
+    Job * JobSystem::JobDeque::steal()
+    {
+        int64_t top = m_top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        const int64_t bottom = m_bottom.load(std::memory_order_acquire);
+
+        if (top >= bottom)
+        {
+            return nullptr;
+        }
+
+        Job * job = m_jobs[top & (FLARE_JOB_SYSTEM_MAX_JOBS - 1)].load(std::memory_order_relaxed);
+        if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        {
+            return nullptr;
+        }
+
+        return job;
+    }
+
+
+    // Job system.
+    JobSystem::Worker::Worker() :
+        m_jobs(new Job[FLARE_JOB_SYSTEM_MAX_JOBS]),
+        m_jobIndex(0),
+        m_random(0)
+    { }
+
+    JobSystem::JobSystem(const size_t workerCount) :
+        m_running(true),
+        m_mainThreadId(std::this_thread::get_id()),
+        m_sharedJobs(new Job[FLARE_JOB_SYSTEM_MAX_JOBS]),
+        m_sharedJobIndex(0),
+        m_sharedQueueSize(0),
+        m_sleepingWorkers(0),
+        m_wakeSemaphore(0)
+    {
+        size_t count = workerCount;
+        if (count == 0)
+        {
+            count = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+        }
+
+        for (size_t i = 0; i < count; i++)
+        {
+            m_workers.push_back(std::make_unique<Worker>());
+            m_workers.back()->m_random = static_cast<uint32_t>(i * 2654435761U + 1);
+        }
+
+        // Worker 0 is the calling thread.
+        for (size_t i = 1; i < count; i++)
+        {
+            m_workers[i]->m_thread = std::thread(&JobSystem::workerLoop, this, i);
+        }
+    }
+
+    JobSystem::~JobSystem()
+    {
+        m_running = false;
+        m_wakeSemaphore.release(static_cast<int>(m_workers.size()));
+
+        for (auto & worker : m_workers)
+        {
+            if (worker->m_thread.joinable())
+            {
+                worker->m_thread.join();
+            }
+        }
+    }
+
+    void JobSystem::run(Job * job)
+    {
+        const size_t index = getWorkerIndex();
+        if (index < m_workers.size())
+        {
+            // Deque is full, execute it right away instead.
+            if (!m_workers[index]->m_deque.push(job))
+            {
+                execute(job);
+                return;
+            }
+        }
+        else
+        {
+            std::lock_guard<std::mutex> lock(m_sharedMutex);
+            m_sharedQueue.push_back(job);
+            m_sharedQueueSize.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        wakeWorkers();
+    }
+
+    void JobSystem::wait(const Job * job)
+    {
+        const size_t index = getWorkerIndex();
+
+        // Threads outside of the job system only wait, so jobs always run on a worker.
+        if (index >= m_workers.size())
+        {
+            while (!job->isFinished())
+            {
+                std::this_thread::yield();
+            }
+        }
+        else
+        {
+            Worker & worker = *m_workers[index];
+            while (!job->isFinished())
+            {
+                Job * next = getJob(worker);
+                if (next)
+                {
+                    execute(next);
+                }
+                else
+                {
+                    std::this_thread::yield();
+                }
+            }
+        }
+
+        if (job->m_exception)
+        {
+            std::rethrow_exception(job->m_exception);
+        }
+    }
+
+    size_t JobSystem::getWorkerCount() const
+    {
+        return m_workers.size();
+    }
+
+    size_t JobSystem::getWorkerIndex() const
+    {
+        if (t_pJobSystem == this)
+        {
+            return t_workerIndex;
+        }
+        if (std::this_thread::get_id() == m_mainThreadId)
+        {
+            return 0;
+        }
+
+        return m_workers.size();
+    }
+
+    void JobSystem::setException(Job & job, std::exception_ptr exception)
+    {
+        // Unfinished jobs keep their ancestors unfinished, so the whole chain is still alive.
+        std::lock_guard<std::mutex> lock(g_exceptionMutex);
+        for (Job * current = &job; current && !current->m_exception; current = current->m_pParent)
+        {
+            current->m_exception = exception;
+        }
+    }
+
+    Job * JobSystem::allocateJob(Job * parent)
+    {
+        const size_t index = getWorkerIndex();
+        Job * job = nullptr;
+
+        // Slots of unfinished jobs are skipped. If the whole ring is in use, help out until a job finishes.
+        while (!job)
+        {
+            for (size_t i = 0; i < FLARE_JOB_SYSTEM_MAX_JOBS && !job; i++)
+            {
+                Job * candidate = nullptr;
+                if (index < m_workers.size())
+                {
+                    Worker & worker = *m_workers[index];
+                    candidate = &worker.m_jobs[worker.m_jobIndex++ & (FLARE_JOB_SYSTEM_MAX_JOBS - 1)];
+                }
+                else
+                {
+                    candidate = &m_sharedJobs[m_sharedJobIndex.fetch_add(1, std::memory_order_relaxed) & (FLARE_JOB_SYSTEM_MAX_JOBS - 1)];
+                }
+
+                int32_t unfinishedJobs = 0;
+                if (candidate->m_unfinishedJobs.compare_exchange_strong(unfinishedJobs, 1, std::memory_order_acquire, std::memory_order_relaxed))
+                {
+                    job = candidate;
+                }
+            }
+
+            if (!job)
+            {
+                Job * next = index < m_workers.size() ? getJob(*m_workers[index]) : nullptr;
+                if (next)
+                {
+                    execute(next);
+                }
+                else
+                {
+                    std::this_thread::yield();
+                }
+            }
+        }
+
+        job->m_pParent = parent;
+        job->m_exception = nullptr;
+        if (parent)
+        {
+            parent->m_unfinishedJobs.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        return job;
+    }
+
+    Job * JobSystem::getJob(Worker & worker)
+    {
+        Job * job = worker.m_deque.pop();
+        if (job)
+        {
+            return job;
+        }
+
+        if (m_sharedQueueSize.load(std::memory_order_relaxed))
+        {
+            std::lock_guard<std::mutex> lock(m_sharedMutex);
+            if (m_sharedQueue.size())
+            {
+                job = m_sharedQueue.front();
+                m_sharedQueue.pop_front();
+                m_sharedQueueSize.fetch_sub(1, std::memory_order_relaxed);
+                return job;
+            }
+        }
+
+        // Steal from the other workers, starting at a random one.
+        worker.m_random ^= worker.m_random << 13;
+        worker.m_random ^= worker.m_random >> 17;
+        worker.m_random ^= worker.m_random << 5;
+
+        const size_t count = m_workers.size();
+        const size_t start = worker.m_random % count;
+        for (size_t i = 0; i < count; i++)
+        {
+            Worker & victim = *m_workers[(start + i) % count];
+            if (&victim == &worker)
+            {
+                continue;
+            }
+
+            job = victim.m_deque.steal();
+            if (job)
+            {
+                return job;
+            }
+        }
+
+        return nullptr;
+    }
+
+    void JobSystem::execute(Job * job)
+    {
+        job->m_pFunction(*job);
+        finish(job);
+    }
+
+    void JobSystem::finish(Job * job)
+    {
+        while (job)
+        {
+            // The slot may be reused as soon as the job is finished, read the parent first.
+            Job * parent = job->m_pParent;
+            if (job->m_unfinishedJobs.fetch_sub(1, std::memory_order_acq_rel) != 1)
+            {
+                return;
+            }
+            job = parent;
+        }
+    }
+
+    void JobSystem::wakeWorkers()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_sleepingWorkers.load(std::memory_order_relaxed) > 0)
+        {
+            m_wakeSemaphore.release(1);
+        }
+    }
+
+    void JobSystem::workerLoop(const size_t index)
+    {
+        t_pJobSystem = this;
+        t_workerIndex = index;
+
+        Worker & worker = *m_workers[index];
+        size_t idleCount = 0;
+
+        while (m_running.load(std::memory_order_relaxed))
+        {
+            Job * job = getJob(worker);
+            if (job)
+            {
+                execute(job);
+                idleCount = 0;
+                continue;
+            }
+
+            if (++idleCount < g_idleSpinCount)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+
+            // Register as sleeping before the last look for work, so a new job either is found or wakes us up.
+            m_sleepingWorkers.fetch_add(1, std::memory_order_seq_cst);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            job = getJob(worker);
+            if (job || !m_running.load(std::memory_order_relaxed))
+            {
+                m_sleepingWorkers.fetch_sub(1, std::memory_order_relaxed);
+                if (job)
+                {
+                    execute(job);
+                }
+                idleCount = 0;
+                continue;
+            }
+
+            m_wakeSemaphore.acquire();
+            m_sleepingWorkers.fetch_sub(1, std::memory_order_relaxed);
+            idleCount = 0;
+        }
+
+        t_pJobSystem = nullptr;
+    }
+
+}
@@ -0,0 +1,351 @@
+/*
+* MIT License
+*
+* Copyright(c) 2018 Jimmie Bergmann
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+*/
+
+#include "flare/system/tlsfAllocator.hpp"
+#include <algorithm>
+#include <stdexcept>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace Flare
+{
+
+    static uint32_t findLowestBit(const uint64_t value)
+    {
+    #if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanForward64(&index, value);
+        return static_cast<uint32_t>(index);
+    #else
+        return static_cast<uint32_t>(__builtin_ctzll(value));
+    #endif
+    }
+
+    static uint32_t findHighestBit(const uint64_t value)
+    {
+    #if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanReverse64(&index, value);
+        return static_cast<uint32_t>(index);
+    #else
+        return static_cast<uint32_t>(63 - __builtin_clzll(value));
+    #endif
+    }
+
+    TlsfAllocator::TlsfAllocator(const uint64_t size)
+    {
+        reset(size);
+    }
+
+    void TlsfAllocator::reset(const uint64_t size)
+    {
+        if (size >= (uint64_t(1) << FirstLevelCount))
+        {
+            throw std::runtime_error("TLSF allocator range is too large.");
+        }
+
+        m_size = size;
+        m_usedSize = 0;
+        m_allocationCount = 0;
+        m_blocks.clear();
+        m_unusedBlocks.clear();
+        m_firstLevelBitmap = 0;
+        for (uint32_t i = 0; i < FirstLevelCount; i++)
+        {
+            m_secondLevelBitmaps[i] = 0;
+            for (uint32_t j = 0; j < SecondLevelCount; j++)
+            {
+                m_freeLists[i][j] = InvalidBlock;
+            }
+        }
+
+        if (size >= MinBlockSize)
+        {
+            const uint32_t block = createBlock();
+            m_blocks[block].offset = 0;
+            m_blocks[block].size = size;
+            insertFreeBlock(block);
+        }
+    }
+
+    bool TlsfAllocator::allocate(const uint64_t size, const uint64_t alignment, uint64_t & offset, uint32_t & block)
+    {
+        // Sizes are kept a multiple of the minimum block size, alignment must be a power of two.
+        const uint64_t alignedSize = (std::max<uint64_t>(size, 1) + MinBlockSize - 1) & ~(MinBlockSize - 1);
+        const uint64_t align = std::max<uint64_t>(alignment, 1);
+
+        // Search with room for the worst case padding, so any block found fits.
+        const uint64_t searchSize = alignedSize + (align > MinBlockSize ? align - MinBlockSize : 0);
+        if (searchSize > m_size)
+        {
+            return false;
+        }
+
+        block = findFreeBlock(searchSize);
+        if (block == InvalidBlock)
+        {
+            return false;
+        }
+        removeFreeBlock(block);
+
+        // Return the padding in front to the free lists.
+        const uint64_t padding = ((m_blocks[block].offset + align - 1) & ~(align - 1)) - m_blocks[block].offset;
+        if (padding)
+        {
+            const uint32_t aligned = splitBlock(block, padding);
+            const uint32_t prev = m_blocks[block].prevPhysical;
+            if (prev != InvalidBlock && m_blocks[prev].free)
+            {
+                removeFreeBlock(prev);
+                mergeBlocks(prev, block);
+                insertFreeBlock(prev);
+            }
+            else
+            {
+                insertFreeBlock(block);
+            }
+            block = aligned;
+        }
+
+        // Return the remainder behind to the free lists.
+        if (m_blocks[block].size - alignedSize >= MinBlockSize)
+        {
+            const uint32_t remainder = splitBlock(block, alignedSize);
+            insertFreeBlock(remainder);
+        }
+
+        m_blocks[block].free = false;
+        m_usedSize += m_blocks[block].size;
+        ++m_allocationCount;
+
+        offset = m_blocks[block].offset;
+        return true;
+    }
+
+    void TlsfAllocator::free(const uint32_t block)
+    {
+        if (block >= m_blocks.size() || m_blocks[block].free)
+        {
+            throw std::runtime_error("Freeing invalid TLSF block.");
+        }
+
+        m_usedSize -= m_blocks[block].size;
+        --m_allocationCount;
+
+        uint32_t current = block;
+        m_blocks[current].free = true;
+
+        const uint32_t next = m_blocks[current].nextPhysical;
+        if (next != InvalidBlock && m_blocks[next].free)
+        {
+            removeFreeBlock(next);
+            mergeBlocks(current, next);
+        }
+
+        const uint32_t prev = m_blocks[current].prevPhysical;
+        if (prev != InvalidBlock && m_blocks[prev].free)
+        {
+            removeFreeBlock(prev);
+            mergeBlocks(prev, current);
+            current = prev;
+        }
+
+        insertFreeBlock(current);
+    }
+
+    uint64_t TlsfAllocator::getSize() const
+    {
+        return m_size;
+    }
+
+    uint64_t TlsfAllocator::getUsedSize() const
+    {
+        return m_usedSize;
+    }
+
+    size_t TlsfAllocator::getAllocationCount() const
+    {
+        return m_allocationCount;
+    }
+
+    bool TlsfAllocator::isEmpty() const
+    {
+        return m_allocationCount == 0;
+    }
+
+    void TlsfAllocator::mapping(const uint64_t size, uint32_t & firstLevel, uint32_t & secondLevel)
+    {
+        firstLevel = findHighestBit(size);
+        secondLevel = static_cast<uint32_t>(size >> (firstLevel - SecondLevelLog2)) & (SecondLevelCount - 1);
+    }
+
+    uint32_t TlsfAllocator::findFreeBlock(const uint64_t size)
+    {
+        // Round up to the next list, every block in it is large enough.
+        const uint32_t highestBit = findHighestBit(size);
+        const uint64_t roundedSize = size + (uint64_t(1) << (highestBit - SecondLevelLog2)) - 1;
+
+        uint32_t firstLevel, secondLevel;
+        mapping(roundedSize, firstLevel, secondLevel);
+        if (firstLevel >= FirstLevelCount)
+        {
+            return InvalidBlock;
+        }
+
+        uint32_t secondLevelMap = m_secondLevelBitmaps[firstLevel] & (~0U << secondLevel);
+        if (!secondLevelMap)
+        {
+            const uint64_t firstLevelMap = firstLevel + 1 < 64 ? m_firstLevelBitmap & (~uint64_t(0) << (firstLevel + 1)) : 0;
+            if (!firstLevelMap)
+            {
+                return InvalidBlock;
+            }
+
+            firstLevel = findLowestBit(firstLevelMap);
+            secondLevelMap = m_secondLevelBitmaps[firstLevel];
+        }
+        secondLevel = findLowestBit(secondLevelMap);
+
+        return m_freeLists[firstLevel][secondLevel];
+    }
+
+    uint32_t TlsfAllocator::createBlock()
+    {
+        uint32_t block;
+        if (m_unusedBlocks.size())
+        {
+            block = m_unusedBlocks.back();
+            m_unusedBlocks.pop_back();
+        }
+        else
+        {
+            block = static_cast<uint32_t>(m_blocks.size());
+            m_blocks.push_back(Block());
+        }
+
+        Block & data = m_blocks[block];
+        data.offset = 0;
+        data.size = 0;
+        data.prevPhysical = InvalidBlock;
+        data.nextPhysical = InvalidBlock;
+        data.prevFree = InvalidBlock;
+        data.nextFree = InvalidBlock;
+        data.free = true;
+        return block;
+    }
+
+    void TlsfAllocator::destroyBlock(const uint32_t block)
+    {
+        m_unusedBlocks.push_back(block);
+    }
+
+    void TlsfAllocator::insertFreeBlock(const uint32_t block)
+    {
+        uint32_t firstLevel, secondLevel;
+        mapping(m_blocks[block].size, firstLevel, secondLevel);
+
+        const uint32_t head = m_freeLists[firstLevel][secondLevel];
+        m_blocks[block].free = true;
+        m_blocks[block].prevFree = InvalidBlock;
+        m_blocks[block].nextFree = head;
+        if (head != InvalidBlock)
+        {
+            m_blocks[head].prevFree = block;
+        }
+        m_freeLists[firstLevel][secondLevel] = block;
+
+        m_firstLevelBitmap |= uint64_t(1) << firstLevel;
+        m_secondLevelBitmaps[firstLevel] |= 1U << secondLevel;
+    }
+
+    void TlsfAllocator::removeFreeBlock(const uint32_t block)
+    {
+        uint32_t firstLevel, secondLevel;
+        mapping(m_blocks[block].size, firstLevel, secondLevel);
+
+        const uint32_t prev = m_blocks[block].prevFree;
+        const uint32_t next = m_blocks[block].nextFree;
+        if (prev != InvalidBlock)
+        {
+            m_blocks[prev].nextFree = next;
+        }
+        else
+        {
+            m_freeLists[firstLevel][secondLevel] = next;
+            if (next == InvalidBlock)
+            {
+                m_secondLevelBitmaps[firstLevel] &= ~(1U << secondLevel);
+                if (!m_secondLevelBitmaps[firstLevel])
+                {
+                    m_firstLevelBitmap &= ~(uint64_t(1) << firstLevel);
+                }
+            }
+        }
+        if (next != InvalidBlock)
+        {
+            m_blocks[next].prevFree = prev;
+        }
+
+        m_blocks[block].prevFree = InvalidBlock;
+        m_blocks[block].nextFree = InvalidBlock;
+        m_blocks[block].free = false;
+    }
+
+    uint32_t TlsfAllocator::splitBlock(const uint32_t block, const uint64_t size)
+    {
+        // Creating a block may reallocate the block storage, no references are held across it.
+        const uint32_t remainder = createBlock();
+        Block & current = m_blocks[block];
+        Block & rest = m_blocks[remainder];
+
+        rest.offset = current.offset + size;
+        rest.size = current.size - size;
+        rest.prevPhysical = block;
+        rest.nextPhysical = current.nextPhysical;
+        rest.free = false;
+        if (rest.nextPhysical != InvalidBlock)
+        {
+            m_blocks[rest.nextPhysical].prevPhysical = remainder;
+        }
+
+        current.size = size;
+        current.nextPhysical = remainder;
+        return remainder;
+    }
+
+    void TlsfAllocator::mergeBlocks(const uint32_t block, const uint32_t next)
+    {
+        Block & current = m_blocks[block];
+        current.size += m_blocks[next].size;
+        current.nextPhysical = m_blocks[next].nextPhysical;
+        if (current.nextPhysical != InvalidBlock)
+        {
+            m_blocks[current.nextPhysical].prevPhysical = block;
+        }
+        destroyBlock(next);
+    }
+
+}